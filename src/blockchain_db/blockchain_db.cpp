@@ -423,10 +423,13 @@ void BlockchainDB::reset_stats()
   time_add_block1 = 0;
   time_add_transaction = 0;
   time_commit1 = 0;
+  bytes_batch_payload = 0;
+  bytes_batch_growth = 0;
 }
 
 void BlockchainDB::show_stats()
 {
+  const read_txn_stats_t rtxn_stats = get_read_txn_stats();
   LOG_PRINT_L1(ENDL
     << "*********************************"
     << ENDL
@@ -442,6 +445,15 @@ void BlockchainDB::show_stats()
     << ENDL
     << "time_commit1: " << time_commit1 << "ms"
     << ENDL
+    << "bytes_batch_payload: " << bytes_batch_payload
+    << ENDL
+    << "bytes_batch_growth: " << bytes_batch_growth
+    << (bytes_batch_payload ? " (" + std::to_string(bytes_batch_growth / (double)bytes_batch_payload) + "x)" : std::string())
+    << ENDL
+    << "read txns: " << rtxn_stats.live << "/" << rtxn_stats.readers << " open, oldest " << rtxn_stats.oldest_age_ms << "ms"
+    << ENDL
+    << "read snapshots reused: " << rtxn_stats.reused << ", renewed: " << rtxn_stats.renewed
+    << ENDL
     << "*********************************"
     << ENDL
   );
@@ -187,6 +187,34 @@ struct txpool_tx_meta_t
   }
 };
 
+/**
+ * @brief the state of an online pruning run, carried between prune_blockchain_step calls
+ */
+struct pruning_progress_t
+{
+  crypto::hash next_tx_hash; //!< transactions are visited in hash order, resume from this one
+  bool started;
+  bool done;
+  uint64_t n_total_records;
+  uint64_t n_pruned_records;
+  uint64_t n_bytes;
+
+  pruning_progress_t(): next_tx_hash(crypto::null_hash), started(false), done(false), n_total_records(0), n_pruned_records(0), n_bytes(0) {}
+};
+
+/**
+ * @brief a snapshot of the state of the per-thread read transactions
+ */
+struct read_txn_stats_t
+{
+  uint64_t readers;        //!< threads owning a read txn
+  uint64_t live;           //!< of which currently hold a snapshot open
+  uint64_t oldest_age_ms;  //!< age of the oldest open snapshot, 0 if none
+  uint64_t reused;         //!< reads served from an already open snapshot
+  uint64_t renewed;        //!< reads which had to open a new snapshot
+
+  read_txn_stats_t(): readers(0), live(0), oldest_age_ms(0), reused(0), renewed(0) {}
+};
 
 #define DBF_SAFE       1
 #define DBF_FAST       2
@@ -551,12 +579,13 @@ private:
 
   uint64_t num_calls = 0;  //!< a performance metric
   uint64_t time_blk_hash = 0;  //!< a performance metric
-  uint64_t time_add_block1 = 0;  //!< a performance metric
-  uint64_t time_add_transaction = 0;  //!< a performance metric
 
 
 protected:
 
+  uint64_t time_add_block1 = 0;  //!< a performance metric
+  uint64_t time_add_transaction = 0;  //!< a performance metric
+
   /**
    * @brief helper function for add_transactions, to add each individual transaction
    *
@@ -572,6 +601,8 @@ protected:
 
   mutable uint64_t time_tx_exists = 0;  //!< a performance metric
   uint64_t time_commit1 = 0;  //!< a performance metric
+  uint64_t bytes_batch_payload = 0;  //!< a performance metric
+  uint64_t bytes_batch_growth = 0;  //!< a performance metric
   bool m_auto_remove_logs = true;  //!< whether or not to automatically remove old logs
 
   HardFork* m_hardfork;
@@ -828,6 +859,17 @@ public:
   virtual void block_rtxn_stop() const = 0;
   virtual void block_rtxn_abort() const = 0;
 
+  /**
+   * @brief get statistics about the read transactions in use
+   *
+   * An open snapshot keeps the pages it references from being reused, so
+   * the age of the oldest one shows whether a stale reader is making the
+   * database grow.
+   *
+   * @return the current statistics, all zero if not tracked
+   */
+  virtual read_txn_stats_t get_read_txn_stats() const { return read_txn_stats_t(); }
+
   virtual void set_hard_fork(HardFork* hf);
 
   // adds a block with the given metadata to the top of the blockchain, returns the new height
@@ -1614,6 +1656,43 @@ public:
    */
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) = 0;
 
+  /**
+   * @brief prunes a bounded batch of the blockchain in place
+   *
+   * Unlike prune_blockchain, this does one short write transaction per
+   * call so it can be interleaved with normal operation. The first call
+   * sets the pruning seed, so transactions added afterwards are tracked
+   * by update_pruning as usual.
+   *
+   * @param progress the state of this run, to pass back unchanged until done is set
+   * @param pruning_seed the seed to use, 0 for default (highly recommended)
+   * @param max_records the maximum number of transactions to visit
+   * @return success iff true
+   */
+  virtual bool prune_blockchain_step(pruning_progress_t &progress, uint32_t pruning_seed, size_t max_records) = 0;
+
+  /**
+   * @brief writes a compacted copy of the database
+   *
+   * The copy is taken from a consistent snapshot while the database stays
+   * in use, and leaves out free pages, so it can replace the original once
+   * the database is closed to reclaim space freed by pruning.
+   *
+   * A resize of the database or cancel_copy_compacted stops the copy, as
+   * it could otherwise block all other transactions until it is done.
+   *
+   * @param path the directory to write the copy to, which must exist and be empty
+   * @return true if the copy was written, false if it was cancelled
+   */
+  virtual bool copy_compacted(const std::string &path) = 0;
+
+  /**
+   * @brief stops a copy_compacted running on another thread, if any
+   *
+   * The copy returns false soon after, and its partial output is removed.
+   */
+  virtual void cancel_copy_compacted() = 0;
+
   /**
    * @brief prunes recent blockchain changes as needed, iff pruning is enabled
    * @return success iff true
@@ -30,13 +30,22 @@
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 #include <boost/circular_buffer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
 #include <memory>  // std::unique_ptr
 #include <cstring>  // memcpy
+#include <unordered_set>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "string_tools.h"
 #include "file_io_utils.h"
 #include "common/util.h"
+#include "common/metrics.h"
 #include "common/pruning.h"
+#include "common/trace.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "profile_tools.h"
@@ -353,9 +362,24 @@ typedef struct outtx {
 
 std::atomic<uint64_t> mdb_txn_safe::num_active_txns{0};
 std::atomic_flag mdb_txn_safe::creation_gate = ATOMIC_FLAG_INIT;
+std::atomic<uint64_t> mdb_threadinfo::commit_generation{0};
+
+// all thread infos, so idle snapshots can be reset from any thread
+static boost::mutex threadinfo_lock;
+static std::unordered_set<mdb_threadinfo*> threadinfos;
+
+mdb_threadinfo::mdb_threadinfo(MDB_env *env): m_ti_env(env), m_ti_rtxn(NULL), m_ti_state(rtxn_active), m_ti_generation(0), m_ti_start_time(0)
+{
+  boost::lock_guard<boost::mutex> lock(threadinfo_lock);
+  threadinfos.insert(this);
+}
 
 mdb_threadinfo::~mdb_threadinfo()
 {
+  {
+    boost::lock_guard<boost::mutex> lock(threadinfo_lock);
+    threadinfos.erase(this);
+  }
   MDB_cursor **cur = &m_ti_rcursors.m_txc_blocks;
   unsigned i;
   for (i=0; i<sizeof(mdb_txn_cursors)/sizeof(MDB_cursor *); i++)
@@ -365,6 +389,58 @@ mdb_threadinfo::~mdb_threadinfo()
     mdb_txn_abort(m_ti_rtxn);
 }
 
+// owner only, when not already active: returns the state the txn was left in
+int mdb_threadinfo::acquire()
+{
+  while (true)
+  {
+    int state = m_ti_state.load();
+    if (state == rtxn_resetting)
+      continue; // another thread is resetting our idle snapshot, this is short
+    if (m_ti_state.compare_exchange_weak(state, rtxn_active))
+      return state;
+  }
+}
+
+// owner only: done with the txn for now, but keep the snapshot if we have one
+void mdb_threadinfo::release()
+{
+  m_ti_state = m_ti_rflags.m_rf_txn ? rtxn_idle_live : rtxn_idle_reset;
+}
+
+// owner only: drop the snapshot, whether or not it is in use
+void mdb_threadinfo::reset_own()
+{
+  if (m_ti_state != rtxn_active)
+    acquire();
+  if (m_ti_rflags.m_rf_txn)
+    mdb_txn_reset(m_ti_rtxn);
+  memset(&m_ti_rflags, 0, sizeof(m_ti_rflags));
+  m_ti_start_time = 0;
+  m_ti_state = rtxn_idle_reset;
+}
+
+// any thread: drop the snapshot if the owner is not using it
+bool mdb_threadinfo::reset_idle()
+{
+  int state = rtxn_idle_live;
+  if (!m_ti_state.compare_exchange_strong(state, rtxn_resetting))
+    return false;
+  mdb_txn_reset(m_ti_rtxn);
+  memset(&m_ti_rflags, 0, sizeof(m_ti_rflags));
+  m_ti_start_time = 0;
+  m_ti_state = rtxn_idle_reset;
+  return true;
+}
+
+void mdb_threadinfo::reset_idle_all(MDB_env *env)
+{
+  boost::lock_guard<boost::mutex> lock(threadinfo_lock);
+  for (mdb_threadinfo *tinfo: threadinfos)
+    if (tinfo->m_ti_env == env)
+      tinfo->reset_idle();
+}
+
 mdb_txn_safe::mdb_txn_safe(const bool check) : m_txn(NULL), m_tinfo(NULL), m_check(check)
 {
   if (check)
@@ -382,8 +458,7 @@ mdb_txn_safe::~mdb_txn_safe()
   LOG_PRINT_L3("mdb_txn_safe: destructor");
   if (m_tinfo != nullptr)
   {
-    mdb_txn_reset(m_tinfo->m_ti_rtxn);
-    memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+    m_tinfo->release();
   } else if (m_txn != nullptr)
   {
     if (m_batch_txn) // this is a batch txn and should have been handled before this point for safety
@@ -418,12 +493,25 @@ void mdb_txn_safe::commit(std::string message)
     message = "Failed to commit a transaction to the db";
   }
 
+  static tools::metrics::histogram &commit_metric = tools::metrics::get_histogram("lmdb_commit_seconds", "Time taken to commit LMDB transactions", "batch=\"false\"");
+  static tools::metrics::histogram &batch_commit_metric = tools::metrics::get_histogram("lmdb_commit_seconds", "Time taken to commit LMDB transactions", "batch=\"true\"");
+
+  MDB_env *env = mdb_txn_env(m_txn);
+  TRACE_SPAN_ARG(lmdb_commit, m_batch_txn ? 1 : 0);
+  TIME_MEASURE_NS_START(commit_time);
   if (auto result = mdb_txn_commit(m_txn))
   {
     m_txn = nullptr;
     throw0(DB_ERROR(lmdb_error(message + ": ", result).c_str()));
   }
+  TIME_MEASURE_NS_FINISH(commit_time);
+  TRACE_SPAN_STOP(lmdb_commit);
   m_txn = nullptr;
+  (m_batch_txn ? batch_commit_metric : commit_metric).record(commit_time);
+
+  // snapshots taken before this commit are now stale
+  ++mdb_threadinfo::commit_generation;
+  mdb_threadinfo::reset_idle_all(env);
 }
 
 void mdb_txn_safe::abort()
@@ -505,6 +593,7 @@ void lmdb_resized(MDB_env *env, int isactive)
   if (isactive)
     mdb_txn_safe::increment_txns(-1);
   mdb_txn_safe::wait_no_active_txns();
+  mdb_threadinfo::reset_idle_all(env);
   if (isactive)
     mdb_txn_safe::increment_txns(1);
 
@@ -570,6 +659,9 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
     MWARNING("Unable to query free disk space.");
   }
 
+  // a compacted copy would hold up the resize until it is done
+  cancel_copy_compacted();
+
   MDB_envinfo mei;
 
   mdb_env_info(m_env, &mei);
@@ -604,6 +696,7 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
   }
 
   mdb_txn_safe::wait_no_active_txns();
+  mdb_threadinfo::reset_idle_all(m_env);
 
   int result = mdb_env_set_mapsize(m_env, new_mapsize);
   if (result)
@@ -681,6 +774,25 @@ void BlockchainLMDB::check_and_resize_for_batch(uint64_t batch_num_blocks, uint6
     // minimum size increase is used to avoid frequent resizes when the batch
     // size is set to a very small numbers of blocks.
     increase_size = (threshold_size > min_increase_size) ? threshold_size : min_increase_size;
+
+    // Spans being synced pass their size in. For those, also grow by a part
+    // of the current map size, so a full sync needs a logarithmic rather
+    // than linear number of resizes, each of which waits for all readers.
+    if (batch_bytes > 0)
+    {
+      const uint64_t max_sync_increase_size = 4ull << 30;
+      MDB_envinfo mei;
+      mdb_env_info(m_env, &mei);
+      uint64_t sync_increase_size = std::min<uint64_t>(mei.me_mapsize / 4, max_sync_increase_size);
+      try
+      {
+        // leave room on disk, the map is not sparse on every platform
+        boost::filesystem::space_info si = boost::filesystem::space(boost::filesystem::path(m_folder));
+        sync_increase_size = std::min<uint64_t>(sync_increase_size, si.available / 2);
+      }
+      catch (...) {}
+      increase_size = std::max(increase_size, sync_increase_size);
+    }
     MDEBUG("increase size: " << increase_size);
   }
 
@@ -952,7 +1064,8 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   if (get_blockchain_pruning_seed())
   {
     MDB_val_set(val_height, m_height);
-    result = mdb_cursor_put(m_cur_txs_prunable_tip, &val_tx_id, &val_height, 0);
+    // tx ids only grow, so this always goes at the end
+    result = mdb_cursor_put(m_cur_txs_prunable_tip, &val_tx_id, &val_height, MDB_APPEND);
     if (result)
       throw0(DB_ERROR(lmdb_error("Failed to add prunable tx id to db transaction: ", result).c_str()));
   }
@@ -1313,8 +1426,16 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_write_txn = nullptr;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  m_batch_num_blocks = 0;
+  m_batch_payload = 0;
+  m_batch_start_pages = 0;
+  m_batch_start_write_time = 0;
+  m_rtxn_reused = 0;
+  m_rtxn_renewed = 0;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_compact_fd = -1;
+  m_compact_cancelled = false;
 
   // reset may also need changing when initialize things here
 
@@ -1324,7 +1445,7 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
 void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 {
   int result;
-  int mdb_flags = MDB_NORDAHEAD;
+  int mdb_flags = MDB_NORDAHEAD | MDB_NOTLS;
 
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
 
@@ -1380,7 +1501,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   if (db_flags & DBF_FASTEST)
     mdb_flags |= MDB_NOSYNC | MDB_WRITEMAP | MDB_MAPASYNC;
   if (db_flags & DBF_RDONLY)
-    mdb_flags = MDB_RDONLY;
+    mdb_flags = MDB_RDONLY | MDB_NOTLS;
   if (db_flags & DBF_SALVAGE)
     mdb_flags |= MDB_PREVSNAPSHOT;
 
@@ -1572,6 +1693,7 @@ void BlockchainLMDB::close()
   }
   BlockchainLMDB::sync();
   m_tinfo.reset();
+  mdb_threadinfo::reset_idle_all(m_env);
 
   // FIXME: not yet thread safe!!!  Use with care.
   mdb_env_close(m_env);
@@ -1983,46 +2105,24 @@ static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
 
 enum { prune_mode_prune, prune_mode_update, prune_mode_check };
 
-bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
+uint32_t BlockchainLMDB::open_pruning_seed(MDB_txn *txn, uint32_t pruning_seed, bool create, bool &existed)
 {
-  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   const uint32_t log_stripes = tools::get_pruning_log_stripes(pruning_seed);
   if (log_stripes && log_stripes != CRYPTONOTE_PRUNING_LOG_STRIPES)
     throw0(DB_ERROR("Pruning seed not in range"));
   pruning_seed = tools::get_pruning_stripe(pruning_seed);
   if (pruning_seed > (1ul << CRYPTONOTE_PRUNING_LOG_STRIPES))
     throw0(DB_ERROR("Pruning seed not in range"));
-  check_open();
-
-  TIME_MEASURE_START(t);
-
-  size_t n_total_records = 0, n_prunable_records = 0, n_pruned_records = 0, commit_counter = 0;
-  uint64_t n_bytes = 0;
-
-  mdb_txn_safe txn;
-  auto result = mdb_txn_begin(m_env, NULL, 0, txn);
-  if (result)
-    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
-
-  MDB_stat db_stats;
-  if ((result = mdb_stat(txn, m_txs_prunable, &db_stats)))
-    throw0(DB_ERROR(lmdb_error("Failed to query m_txs_prunable: ", result).c_str()));
-  const size_t pages0 = db_stats.ms_branch_pages + db_stats.ms_leaf_pages + db_stats.ms_overflow_pages;
 
   MDB_val_str(k, "pruning_seed");
   MDB_val v;
-  result = mdb_get(txn, m_properties, &k, &v);
-  bool prune_tip_table = false;
+  int result = mdb_get(txn, m_properties, &k, &v);
   if (result == MDB_NOTFOUND)
   {
     // not pruned yet
-    if (mode != prune_mode_prune)
-    {
-      txn.abort();
-      TIME_MEASURE_FINISH(t);
-      MDEBUG("Pruning not enabled, nothing to do");
-      return true;
-    }
+    existed = false;
+    if (!create)
+      return 0;
     if (pruning_seed == 0)
       pruning_seed = tools::get_random_stripe();
     pruning_seed = tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
@@ -2031,27 +2131,129 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     result = mdb_put(txn, m_properties, &k, &v, 0);
     if (result)
       throw0(DB_ERROR("Failed to save pruning seed"));
-    prune_tip_table = false;
+    return pruning_seed;
   }
-  else if (result == 0)
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve or create pruning seed: ", result).c_str()));
+
+  // pruned already
+  existed = true;
+  if (v.mv_size != sizeof(uint32_t))
+    throw0(DB_ERROR("Failed to retrieve or create pruning seed: unexpected value size"));
+  const uint32_t data = *(const uint32_t*)v.mv_data;
+  if (pruning_seed == 0)
+    pruning_seed = tools::get_pruning_stripe(data);
+  if (tools::get_pruning_stripe(data) != pruning_seed)
+    throw0(DB_ERROR("Blockchain already pruned with different seed"));
+  if (tools::get_pruning_log_stripes(data) != CRYPTONOTE_PRUNING_LOG_STRIPES)
+    throw0(DB_ERROR("Blockchain already pruned with different base"));
+  return tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
+}
+
+// Adds a tx_indices record to the tip table if it is recent, and prunes (or,
+// in check mode, verifies) its prunable data. Returns true if data was deleted.
+static bool prune_tx_index(int mode, const txindex &ti, uint64_t blockchain_height, uint32_t pruning_seed,
+    MDB_cursor *c_txs_pruned, MDB_cursor *c_txs_prunable, MDB_cursor *c_txs_prunable_tip,
+    size_t &n_prunable_records, size_t &n_pruned_records, uint64_t &n_bytes)
+{
+  const uint64_t block_height = ti.data.block_id;
+  MDB_val v;
+  int result;
+  if (block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS >= blockchain_height)
   {
-    // pruned already
-    if (v.mv_size != sizeof(uint32_t))
-      throw0(DB_ERROR("Failed to retrieve or create pruning seed: unexpected value size"));
-    const uint32_t data = *(const uint32_t*)v.mv_data;
-    if (pruning_seed == 0)
-      pruning_seed = tools::get_pruning_stripe(data);
-    if (tools::get_pruning_stripe(data) != pruning_seed)
-      throw0(DB_ERROR("Blockchain already pruned with different seed"));
-    if (tools::get_pruning_log_stripes(data) != CRYPTONOTE_PRUNING_LOG_STRIPES)
-      throw0(DB_ERROR("Blockchain already pruned with different base"));
-    pruning_seed = tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
-    prune_tip_table = (mode == prune_mode_update);
+    MDB_val_set(kp, ti.data.tx_id);
+    MDB_val_set(vp, block_height);
+    if (mode == prune_mode_check)
+    {
+      result = mdb_cursor_get(c_txs_prunable_tip, &kp, &vp, MDB_SET);
+      if (result && result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
+      if (result == MDB_NOTFOUND)
+        MERROR("Transaction not found in prunable tip table for height " << block_height << "/" << blockchain_height <<
+            ", seed " << epee::string_tools::to_string_hex(pruning_seed));
+    }
+    else
+    {
+      result = mdb_cursor_put(c_txs_prunable_tip, &kp, &vp, 0);
+      if (result && result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
+    }
+  }
+  MDB_val_set(kp, ti.data.tx_id);
+  if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kp))
+  {
+    result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
+    if (mode == prune_mode_check)
+    {
+      if (result != MDB_NOTFOUND)
+        MERROR("Prunable data found for pruned height " << block_height << "/" << blockchain_height <<
+            ", seed " << epee::string_tools::to_string_hex(pruning_seed));
+    }
+    else
+    {
+      ++n_prunable_records;
+      if (result == MDB_NOTFOUND)
+        MDEBUG("Already pruned at height " << block_height << "/" << blockchain_height);
+      else
+      {
+        MDEBUG("Pruning at height " << block_height << "/" << blockchain_height);
+        ++n_pruned_records;
+        n_bytes += kp.mv_size + v.mv_size;
+        result = mdb_cursor_del(c_txs_prunable, 0);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to delete transaction prunable data: ", result).c_str()));
+        return true;
+      }
+    }
   }
   else
   {
-    throw0(DB_ERROR(lmdb_error("Failed to retrieve or create pruning seed: ", result).c_str()));
+    if (mode == prune_mode_check)
+    {
+      result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
+      if (result && result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
+      if (result == MDB_NOTFOUND)
+        MERROR("Prunable data not found for unpruned height " << block_height << "/" << blockchain_height <<
+            ", seed " << epee::string_tools::to_string_hex(pruning_seed));
+    }
+  }
+  return false;
+}
+
+bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TIME_MEASURE_START(t);
+
+  size_t n_total_records = 0, n_prunable_records = 0, n_pruned_records = 0, commit_counter = 0;
+  uint64_t n_bytes = 0;
+
+  mdb_txn_safe txn;
+  auto result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+  MDB_stat db_stats;
+  if ((result = mdb_stat(txn, m_txs_prunable, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_txs_prunable: ", result).c_str()));
+  const size_t pages0 = db_stats.ms_branch_pages + db_stats.ms_leaf_pages + db_stats.ms_overflow_pages;
+
+  bool existed;
+  pruning_seed = open_pruning_seed(txn, pruning_seed, mode == prune_mode_prune, existed);
+  if (!pruning_seed)
+  {
+    txn.abort();
+    TIME_MEASURE_FINISH(t);
+    MDEBUG("Pruning not enabled, nothing to do");
+    return true;
   }
+  const bool prune_tip_table = existed && mode == prune_mode_update;
+  MDB_val k, v;
 
   if (mode == prune_mode_check)
     MINFO("Checking blockchain pruning...");
@@ -2151,69 +2353,9 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       //const txindex *ti = (const txindex *)v.mv_data;
       txindex ti;
       memcpy(&ti, v.mv_data, sizeof(ti));
-      const uint64_t block_height = ti.data.block_id;
-      if (block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS >= blockchain_height)
-      {
-        MDB_val_set(kp, ti.data.tx_id);
-        MDB_val_set(vp, block_height);
-        if (mode == prune_mode_check)
-        {
-          result = mdb_cursor_get(c_txs_prunable_tip, &kp, &vp, MDB_SET);
-          if (result && result != MDB_NOTFOUND)
-            throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
-          if (result == MDB_NOTFOUND)
-            MERROR("Transaction not found in prunable tip table for height " << block_height << "/" << blockchain_height <<
-                ", seed " << epee::string_tools::to_string_hex(pruning_seed));
-        }
-        else
-        {
-          result = mdb_cursor_put(c_txs_prunable_tip, &kp, &vp, 0);
-          if (result && result != MDB_NOTFOUND)
-            throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
-        }
-      }
-      MDB_val_set(kp, ti.data.tx_id);
-      if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kp))
-      {
-        result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
-        if (result && result != MDB_NOTFOUND)
-          throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
-        if (mode == prune_mode_check)
-        {
-          if (result != MDB_NOTFOUND)
-            MERROR("Prunable data found for pruned height " << block_height << "/" << blockchain_height <<
-                ", seed " << epee::string_tools::to_string_hex(pruning_seed));
-        }
-        else
-        {
-          ++n_prunable_records;
-          if (result == MDB_NOTFOUND)
-            MDEBUG("Already pruned at height " << block_height << "/" << blockchain_height);
-          else
-          {
-            MDEBUG("Pruning at height " << block_height << "/" << blockchain_height);
-            ++n_pruned_records;
-            n_bytes += kp.mv_size + v.mv_size;
-            result = mdb_cursor_del(c_txs_prunable, 0);
-            if (result)
-              throw0(DB_ERROR(lmdb_error("Failed to delete transaction prunable data: ", result).c_str()));
-            ++commit_counter;
-          }
-        }
-      }
-      else
-      {
-        if (mode == prune_mode_check)
-        {
-          MDB_val_set(kp, ti.data.tx_id);
-          result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
-          if (result && result != MDB_NOTFOUND)
-            throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
-          if (result == MDB_NOTFOUND)
-            MERROR("Prunable data not found for unpruned height " << block_height << "/" << blockchain_height <<
-                ", seed " << epee::string_tools::to_string_hex(pruning_seed));
-        }
-      }
+      if (prune_tx_index(mode, ti, blockchain_height, pruning_seed, c_txs_pruned, c_txs_prunable, c_txs_prunable_tip,
+          n_prunable_records, n_pruned_records, n_bytes))
+        ++commit_counter;
 
       if (mode != prune_mode_check && commit_counter >= 4096)
       {
@@ -2271,6 +2413,90 @@ bool BlockchainLMDB::prune_blockchain(uint32_t pruning_seed)
   return prune_worker(prune_mode_prune, pruning_seed);
 }
 
+bool BlockchainLMDB::prune_blockchain_step(pruning_progress_t &progress, uint32_t pruning_seed, size_t max_records)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (progress.done)
+    return true;
+
+  mdb_txn_safe txn;
+  auto result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+  bool existed;
+  pruning_seed = open_pruning_seed(txn, pruning_seed, true, existed);
+  if (!progress.started)
+    MINFO("Pruning blockchain in the background with seed " << epee::string_tools::to_string_hex(pruning_seed) << "...");
+
+  MDB_cursor *c_txs_pruned, *c_txs_prunable, *c_txs_prunable_tip, *c_tx_indices;
+  result = mdb_cursor_open(txn, m_txs_pruned, &c_txs_pruned);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+  result = mdb_cursor_open(txn, m_txs_prunable, &c_txs_prunable);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
+  result = mdb_cursor_open(txn, m_txs_prunable_tip, &c_txs_prunable_tip);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable_tip: ", result).c_str()));
+  result = mdb_cursor_open(txn, m_tx_indices, &c_tx_indices);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
+  const uint64_t blockchain_height = height();
+
+  // tx_indices is sorted by hash, so a run resumes at the first hash not
+  // visited yet. Transactions added since then are in the tip table already
+  // since the seed was set by the first step, and those removed are skipped.
+  txindex ti;
+  MDB_val k = zerokval, v;
+  MDB_cursor_op op = MDB_FIRST;
+  if (progress.started)
+  {
+    ti.key = progress.next_tx_hash;
+    v.mv_size = sizeof(ti);
+    v.mv_data = (void *)&ti;
+    op = MDB_GET_BOTH_RANGE;
+  }
+  size_t n_prunable_records = 0, n_pruned_records = 0, n_records = 0;
+  while (1)
+  {
+    result = mdb_cursor_get(c_tx_indices, &k, &v, op);
+    op = MDB_NEXT;
+    if (result == MDB_NOTFOUND)
+    {
+      progress.done = true;
+      break;
+    }
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", result).c_str()));
+    memcpy(&ti, v.mv_data, sizeof(ti));
+    if (n_records == max_records)
+    {
+      progress.next_tx_hash = ti.key;
+      break;
+    }
+    ++n_records;
+    prune_tx_index(prune_mode_prune, ti, blockchain_height, pruning_seed, c_txs_pruned, c_txs_prunable, c_txs_prunable_tip,
+        n_prunable_records, n_pruned_records, progress.n_bytes);
+  }
+
+  mdb_cursor_close(c_tx_indices);
+  mdb_cursor_close(c_txs_prunable_tip);
+  mdb_cursor_close(c_txs_prunable);
+  mdb_cursor_close(c_txs_pruned);
+
+  txn.commit();
+
+  progress.started = true;
+  progress.n_total_records += n_records;
+  progress.n_pruned_records += n_pruned_records;
+  if (progress.done)
+    MINFO("Background pruning done: " << (progress.n_bytes/1024.0f/1024.0f) << " MB pruned in " <<
+        progress.n_pruned_records << "/" << progress.n_total_records << " records");
+  return true;
+}
+
 bool BlockchainLMDB::update_pruning()
 {
   return prune_worker(prune_mode_update, 0);
@@ -2281,6 +2507,79 @@ bool BlockchainLMDB::check_pruning()
   return prune_worker(prune_mode_check, 0);
 }
 
+bool BlockchainLMDB::copy_compacted(const std::string &path)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  MINFO("Writing a compacted copy of the blockchain to " << path << "...");
+  TIME_MEASURE_START(t);
+#ifdef _WIN32
+  // the copy cannot be interrupted here, so resizes and shutdown wait for it
+  mdb_txn_safe active_txn_guard;
+  int result = mdb_env_copy2(m_env, path.c_str(), MDB_CP_COMPACT);
+#else
+  const std::string filename = (boost::filesystem::path(path) / CRYPTONOTE_BLOCKCHAINDATA_FILENAME).string();
+  const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+    throw0(DB_ERROR(("Failed to create " + filename + ": " + strerror(errno)).c_str()));
+  {
+    boost::lock_guard<boost::mutex> lock(m_compact_lock);
+    m_compact_fd = fd;
+    m_compact_cancelled = false;
+  }
+  int result;
+  {
+    // the copy reads the map directly, so resizes wait for it, after
+    // cancelling it so they are not held up for the whole copy
+    mdb_txn_safe active_txn_guard;
+    result = mdb_env_copyfd2(m_env, fd, MDB_CP_COMPACT);
+  }
+  bool cancelled;
+  {
+    boost::lock_guard<boost::mutex> lock(m_compact_lock);
+    m_compact_fd = -1;
+    cancelled = m_compact_cancelled;
+  }
+  ::close(fd);
+  if (cancelled)
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove(filename, ec);
+    MINFO("Compacted copy cancelled");
+    return false;
+  }
+#endif
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to write a compacted copy of the db: ", result).c_str()));
+  TIME_MEASURE_FINISH(t);
+  MINFO("Compacted copy written in " << t << " ms");
+  return true;
+}
+
+void BlockchainLMDB::cancel_copy_compacted()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+#ifndef _WIN32
+  boost::lock_guard<boost::mutex> lock(m_compact_lock);
+  if (m_compact_fd < 0 || m_compact_cancelled)
+    return;
+
+  // the copy writes from its own thread, so swap its file for a read only
+  // one: the next write fails and the copy stops
+  const int null_fd = ::open("/dev/null", O_RDONLY);
+  if (null_fd < 0 || ::dup2(null_fd, m_compact_fd) < 0)
+  {
+    MERROR("Failed to cancel the compacted copy: " << strerror(errno));
+    if (null_fd >= 0)
+      ::close(null_fd);
+    return;
+  }
+  ::close(null_fd);
+  m_compact_cancelled = true;
+#endif
+}
+
 bool BlockchainLMDB::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob, relay_category category) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3767,13 +4066,18 @@ bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks, uint64_t batch_bytes
   m_write_txn = m_write_batch_txn;
 
   m_batch_active = true;
-  memset(&m_wcursors, 0, sizeof(m_wcursors));
-  if (m_tinfo.get())
+  m_batch_num_blocks = batch_num_blocks;
+  m_batch_payload = batch_bytes;
+  if (m_batch_payload)
   {
-    if (m_tinfo->m_ti_rflags.m_rf_txn)
-      mdb_txn_reset(m_tinfo->m_ti_rtxn);
-    memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+    MDB_envinfo mei;
+    mdb_env_info(m_env, &mei);
+    m_batch_start_pages = mei.me_last_pgno;
+    m_batch_start_write_time = time_add_transaction + time_add_block1 + time_commit1;
   }
+  memset(&m_wcursors, 0, sizeof(m_wcursors));
+  if (m_tinfo.get())
+    m_tinfo->reset_own();
 
   LOG_PRINT_L3("batch transaction: begin");
   return true;
@@ -3816,6 +4120,29 @@ void BlockchainLMDB::cleanup_batch()
   memset(&m_wcursors, 0, sizeof(m_wcursors));
 }
 
+// Compares how much the database grew with the size of the blocks and txes
+// a batch added. LMDB does not expose the pages a commit dirtied, so pages
+// rewritten in place from the freelist are not counted.
+void BlockchainLMDB::report_batch_stats()
+{
+  if (!m_batch_payload)
+    return;
+
+  MDB_envinfo mei;
+  mdb_env_info(m_env, &mei);
+  MDB_stat mst;
+  mdb_env_stat(m_env, &mst);
+  const uint64_t growth = mei.me_last_pgno > m_batch_start_pages ? (mei.me_last_pgno - m_batch_start_pages) * mst.ms_psize : 0;
+  const uint64_t write_time = time_add_transaction + time_add_block1 + time_commit1 - m_batch_start_write_time;
+  bytes_batch_payload += m_batch_payload;
+  bytes_batch_growth += growth;
+
+  MINFO("Batch of " << m_batch_num_blocks << " blocks: " << m_batch_payload / 1024 << " kB added, db grew by " << growth / 1024 <<
+      " kB (" << growth / (double)m_batch_payload << "x), written in " << write_time << " ms (" <<
+      (write_time ? m_batch_payload / 1024.0 / 1024.0 * 1000 / write_time : 0.0) << " MB/s)");
+  m_batch_payload = 0;
+}
+
 void BlockchainLMDB::batch_stop()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3836,6 +4163,7 @@ void BlockchainLMDB::batch_stop()
     TIME_MEASURE_FINISH(time1);
     time_commit1 += time1;
     cleanup_batch();
+    report_batch_stats();
   }
   catch (const std::exception &e)
   {
@@ -3892,19 +4220,45 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
   /* Check for existing info and force reset if env doesn't match -
    * only happens if env was opened/closed multiple times in same process
    */
-  if (!(tinfo = m_tinfo.get()) || mdb_txn_env(tinfo->m_ti_rtxn) != m_env)
+  if (!(tinfo = m_tinfo.get()) || tinfo->m_ti_env != m_env)
   {
-    tinfo = new mdb_threadinfo;
+    tinfo = new mdb_threadinfo(m_env);
     m_tinfo.reset(tinfo);
     memset(&tinfo->m_ti_rcursors, 0, sizeof(tinfo->m_ti_rcursors));
     memset(&tinfo->m_ti_rflags, 0, sizeof(tinfo->m_ti_rflags));
+    tinfo->m_ti_generation = mdb_threadinfo::commit_generation;
     if (auto mdb_res = lmdb_txn_begin(m_env, NULL, MDB_RDONLY, &tinfo->m_ti_rtxn))
+    {
+      m_tinfo.reset();
       throw0(DB_ERROR_TXN_START(lmdb_error("Failed to create a read transaction for the db: ", mdb_res).c_str()));
+    }
+    tinfo->m_ti_start_time = epee::misc_utils::get_tick_count();
+    ++m_rtxn_renewed;
     ret = true;
-  } else if (!tinfo->m_ti_rflags.m_rf_txn)
+  } else if (tinfo->m_ti_state != mdb_threadinfo::rtxn_active)
   {
-    if (auto mdb_res = lmdb_txn_renew(tinfo->m_ti_rtxn))
-      throw0(DB_ERROR_TXN_START(lmdb_error("Failed to renew a read transaction for the db: ", mdb_res).c_str()));
+    // reuse the snapshot we kept from the last call unless something was committed since
+    if (tinfo->acquire() == mdb_threadinfo::rtxn_idle_live)
+    {
+      if (tinfo->m_ti_generation == mdb_threadinfo::commit_generation)
+        ++m_rtxn_reused;
+      else
+      {
+        mdb_txn_reset(tinfo->m_ti_rtxn);
+        memset(&tinfo->m_ti_rflags, 0, sizeof(tinfo->m_ti_rflags));
+      }
+    }
+    if (!tinfo->m_ti_rflags.m_rf_txn)
+    {
+      tinfo->m_ti_generation = mdb_threadinfo::commit_generation;
+      if (auto mdb_res = lmdb_txn_renew(tinfo->m_ti_rtxn))
+      {
+        tinfo->m_ti_state = mdb_threadinfo::rtxn_idle_reset;
+        throw0(DB_ERROR_TXN_START(lmdb_error("Failed to renew a read transaction for the db: ", mdb_res).c_str()));
+      }
+      tinfo->m_ti_start_time = epee::misc_utils::get_tick_count();
+      ++m_rtxn_renewed;
+    }
     ret = true;
   }
   if (ret)
@@ -3920,8 +4274,9 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
 void BlockchainLMDB::block_rtxn_stop() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  mdb_txn_reset(m_tinfo->m_ti_rtxn);
-  memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+  /* a write txn started meanwhile may already have reset it */
+  if (m_tinfo->m_ti_state == mdb_threadinfo::rtxn_active)
+    m_tinfo->release();
   /* cancel out the increment from rtxn_start */
   mdb_txn_safe::increment_txns(-1);
 }
@@ -3962,11 +4317,7 @@ void BlockchainLMDB::block_wtxn_start()
     }
     memset(&m_wcursors, 0, sizeof(m_wcursors));
     if (m_tinfo.get())
-    {
-      if (m_tinfo->m_ti_rflags.m_rf_txn)
-        mdb_txn_reset(m_tinfo->m_ti_rtxn);
-      memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
-    }
+      m_tinfo->reset_own();
   } else if (m_writer != boost::this_thread::get_id())
     throw0(DB_ERROR_TXN_START((std::string("Attempted to start new write txn when batch txn already exists in ")+__FUNCTION__).c_str()));
 }
@@ -4012,8 +4363,31 @@ void BlockchainLMDB::block_wtxn_abort()
 void BlockchainLMDB::block_rtxn_abort() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  mdb_txn_reset(m_tinfo->m_ti_rtxn);
-  memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+  m_tinfo->reset_own();
+}
+
+read_txn_stats_t BlockchainLMDB::get_read_txn_stats() const
+{
+  read_txn_stats_t stats;
+  const uint64_t now = epee::misc_utils::get_tick_count();
+  {
+    boost::lock_guard<boost::mutex> lock(threadinfo_lock);
+    for (const mdb_threadinfo *tinfo: threadinfos)
+    {
+      if (tinfo->m_ti_env != m_env)
+        continue;
+      ++stats.readers;
+      const uint64_t start_time = tinfo->m_ti_start_time;
+      if (start_time)
+      {
+        ++stats.live;
+        stats.oldest_age_ms = std::max(stats.oldest_age_ms, now > start_time ? now - start_time : 0);
+      }
+    }
+  }
+  stats.reused = m_rtxn_reused;
+  stats.renewed = m_rtxn_renewed;
+  return stats;
 }
 
 uint64_t BlockchainLMDB::add_block(const std::pair<block, blobdata>& blk, size_t block_weight, uint64_t long_term_block_weight, const difficulty_type& cumulative_difficulty, const uint64_t& coins_generated,
@@ -32,6 +32,7 @@
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
 #include <boost/thread/tss.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <lmdb.h>
 
@@ -116,13 +117,32 @@ typedef struct mdb_rflags
   bool m_rf_properties;
 } mdb_rflags;
 
+// The per-thread read txn is kept open between calls, so the snapshot and
+// its cursors are reused until a write is committed. Idle snapshots are
+// reset from other threads after commits and before resizes, so the env
+// must be opened with MDB_NOTLS.
 typedef struct mdb_threadinfo
 {
+  enum rtxn_state { rtxn_idle_reset, rtxn_idle_live, rtxn_active, rtxn_resetting };
+
+  MDB_env *m_ti_env;	// env the read txn belongs to
   MDB_txn *m_ti_rtxn;	// per-thread read txn
   mdb_txn_cursors m_ti_rcursors;	// per-thread read cursors
   mdb_rflags m_ti_rflags;	// per-thread read state
+  std::atomic<int> m_ti_state;	// rtxn_state, only the owner leaves rtxn_active
+  uint64_t m_ti_generation;	// commit generation the snapshot was opened at
+  std::atomic<uint64_t> m_ti_start_time;	// when the snapshot was opened, in ms, 0 if reset
 
+  mdb_threadinfo(MDB_env *env);
   ~mdb_threadinfo();
+
+  int acquire();
+  void release();
+  void reset_own();
+  bool reset_idle();
+
+  static void reset_idle_all(MDB_env *env);
+  static std::atomic<uint64_t> commit_generation;
 } mdb_threadinfo;
 
 struct mdb_txn_safe
@@ -294,8 +314,11 @@ public:
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const;
   virtual uint32_t get_blockchain_pruning_seed() const;
   virtual bool prune_blockchain(uint32_t pruning_seed = 0);
+  virtual bool prune_blockchain_step(pruning_progress_t &progress, uint32_t pruning_seed, size_t max_records);
   virtual bool update_pruning();
   virtual bool check_pruning();
+  virtual bool copy_compacted(const std::string &path);
+  virtual void cancel_copy_compacted();
 
   virtual void add_alt_block(const crypto::hash &blkid, const cryptonote::alt_block_data_t &data, const cryptonote::blobdata_ref &blob);
   virtual bool get_alt_block(const crypto::hash &blkid, alt_block_data_t *data, cryptonote::blobdata *blob);
@@ -335,6 +358,8 @@ public:
 
   bool block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) const;
 
+  virtual read_txn_stats_t get_read_txn_stats() const;
+
   virtual void pop_block(block& blk, std::vector<transaction>& txs);
 
   virtual bool can_thread_bulk_indices() const { return true; }
@@ -412,6 +437,7 @@ private:
   inline void check_open() const;
 
   bool prune_worker(int mode, uint32_t pruning_seed);
+  uint32_t open_pruning_seed(MDB_txn *txn, uint32_t pruning_seed, bool create, bool &existed);
 
   virtual bool is_read_only() const;
 
@@ -444,6 +470,7 @@ private:
   void migrate_4_5();
 
   void cleanup_batch();
+  void report_batch_stats();
 
 private:
   MDB_env* m_env;
@@ -485,8 +512,20 @@ private:
   bool m_batch_transactions; // support for batch transactions
   bool m_batch_active; // whether batch transaction is in progress
 
+  // write statistics for the current batch, when started with its size
+  uint64_t m_batch_num_blocks;
+  uint64_t m_batch_payload;
+  uint64_t m_batch_start_pages;
+  uint64_t m_batch_start_write_time;
+
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
+  mutable std::atomic<uint64_t> m_rtxn_reused;
+  mutable std::atomic<uint64_t> m_rtxn_renewed;
+
+  boost::mutex m_compact_lock;
+  int m_compact_fd; // the file a compacted copy is being written to, -1 if none
+  bool m_compact_cancelled;
 
 #if defined(__arm__)
   // force a value so it can compile with 32-bit ARM
@@ -153,6 +153,9 @@ public:
 
   virtual uint32_t get_blockchain_pruning_seed() const override { return 0; }
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) override { return true; }
+  virtual bool prune_blockchain_step(pruning_progress_t &progress, uint32_t pruning_seed, size_t max_records) override { progress.done = true; return true; }
+  virtual bool copy_compacted(const std::string &path) override { return true; }
+  virtual void cancel_copy_compacted() override {}
   virtual bool update_pruning() override { return true; }
   virtual bool check_pruning() override { return true; }
   virtual void prune_outputs(uint64_t amount) override {}
@@ -0,0 +1,100 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct output_data
+{
+  uint64_t amount;
+  uint64_t offset;
+  output_data(): amount(0), offset(0) {}
+  output_data(uint64_t a, uint64_t i): amount(a), offset(i) {}
+  bool operator==(const output_data &other) const { return other.amount == amount && other.offset == offset; }
+  bool operator<(const output_data &other) const { return amount < other.amount || (amount == other.amount && offset < other.offset); }
+};
+
+struct chain_reaction_candidate
+{
+  output_data od;
+  size_t ring_size;
+};
+
+// If all members of a ring but one are known to be spent, that one is the
+// real spend, and it is returned in candidate
+template<typename t_is_spent>
+bool find_ring_candidate(uint64_t amount, const std::vector<uint64_t> &absolute_ring, const t_is_spent &is_spent, chain_reaction_candidate &candidate)
+{
+  size_t known = 0;
+  uint64_t last_unknown = 0;
+  for (uint64_t out: absolute_ring)
+  {
+    if (is_spent(output_data(amount, out)))
+      ++known;
+    else
+      last_unknown = out;
+  }
+  if (absolute_ring.empty() || known != absolute_ring.size() - 1)
+    return false;
+  candidate = {output_data(amount, last_unknown), absolute_ring.size()};
+  return true;
+}
+
+// The outputs the chain reaction pass starts from: the rings using them are
+// the only ones which may have changed since the last pass. That is those
+// marked as spent in this run, and one member of each ring added in this
+// run, whose other members may have been marked as spent by earlier runs.
+inline std::vector<output_data> chain_reaction_seeds(const std::vector<output_data> &newly_spent, const std::vector<output_data> &new_ring_members)
+{
+  std::vector<output_data> seeds;
+  seeds.reserve(newly_spent.size() + new_ring_members.size());
+  seeds.insert(seeds.end(), newly_spent.begin(), newly_spent.end());
+  seeds.insert(seeds.end(), new_ring_members.begin(), new_ring_members.end());
+  return seeds;
+}
+
+// Runs chain reaction passes from the given outputs until no more outputs
+// are found to be spent. find(outs, candidates) looks up the rings using
+// any of outs, mark(candidates, marked) marks the candidates as spent and
+// returns those which were not already. Either returning false stops.
+template<typename t_find, typename t_mark>
+bool run_chain_reaction(std::vector<output_data> work, const t_find &find, const t_mark &mark)
+{
+  while (!work.empty())
+  {
+    std::vector<chain_reaction_candidate> candidates;
+    if (!find(work, candidates))
+      return false;
+    work.clear();
+    if (!mark(candidates, work))
+      return false;
+  }
+  return true;
+}
@@ -32,6 +32,7 @@
 #include "common/unordered_containers_boost_serialization.h"
 #include "common/command_line.h"
 #include "common/varint.h"
+#include "common/threadpool.h"
 #include "serialization/crypto.h"
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
 #include "cryptonote_core/tx_pool.h"
@@ -40,6 +41,7 @@
 #include "blockchain_db/blockchain_db.h"
 #include "wallet/ringdb.h"
 #include "version.h"
+#include "blackball_chain_reaction.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "bcutil"
@@ -59,14 +61,10 @@ static MDB_dbi dbi_ring_instances;
 static MDB_dbi dbi_stats;
 static MDB_env *env = NULL;
 
-struct output_data
-{
-  uint64_t amount;
-  uint64_t offset;
-  output_data(): amount(0), offset(0) {}
-  output_data(uint64_t a, uint64_t i): amount(a), offset(i) {}
-  bool operator==(const output_data &other) const { return other.amount == amount && other.offset == offset; }
-};
+// outputs marked as spent during this run, seeds the chain reaction pass
+static std::vector<output_data> newly_spent;
+// one member of each ring added during this run, also seeds it
+static std::vector<output_data> new_ring_members;
 
 //
 // relative_rings: key_image -> vector<uint64_t>
@@ -652,6 +650,7 @@ static bool add_spent_output(MDB_cursor *cur, const output_data &od)
   if (dbr == MDB_KEYEXIST)
     return false;
   CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to add spent output: " + std::string(mdb_strerror(dbr)));
+  newly_spent.push_back(od);
   return true;
 }
 
@@ -935,6 +934,15 @@ static void set_stat(MDB_txn *txn, const char *key, uint64_t data)
   CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to set stat record");
 }
 
+static void del_stat(MDB_txn *txn, const char *key)
+{
+  MDB_val k;
+  k.mv_data = (void*)key;
+  k.mv_size = strlen(key);
+  int dbr = mdb_del(txn, dbi_stats, &k, NULL);
+  CHECK_AND_ASSERT_THROW_MES(!dbr || dbr == MDB_NOTFOUND, "Failed to delete stat record");
+}
+
 static void inc_stat(MDB_txn *txn, const char *key)
 {
   uint64_t data;
@@ -1100,6 +1108,45 @@ static std::vector<std::pair<uint64_t, uint64_t>> load_outputs(const std::string
   return outputs;
 }
 
+// Writes outputs in the format read by load_outputs and the wallet's
+// mark_output_spent command: an "@amount" line whenever the amount changes,
+// then one line per run of consecutive offsets. Outputs must come sorted.
+class spent_output_writer
+{
+public:
+  spent_output_writer(FILE *f): f(f), pending_amount(std::numeric_limits<uint64_t>::max()), run_start(0), run_length(0) {}
+  ~spent_output_writer() { flush(); }
+
+  void add(uint64_t amount, uint64_t offset)
+  {
+    if (run_length > 0 && (amount != pending_amount || run_start + run_length != offset))
+      flush();
+    if (pending_amount != amount)
+    {
+      fprintf(f, "@%" PRIu64 "\n", amount);
+      pending_amount = amount;
+    }
+    if (run_length == 0)
+      run_start = offset;
+    ++run_length;
+  }
+
+  void flush()
+  {
+    if (run_length == 1)
+      fprintf(f, "%" PRIu64 "\n", run_start);
+    else if (run_length > 1)
+      fprintf(f, "%" PRIu64 "*%" PRIu64 "\n", run_start, run_length);
+    run_length = 0;
+  }
+
+private:
+  FILE *f;
+  uint64_t pending_amount;
+  uint64_t run_start;
+  uint64_t run_length;
+};
+
 static bool export_spent_outputs(MDB_cursor *cur, const std::string &filename)
 {
   FILE *f = fopen(filename.c_str(), "w");
@@ -1109,48 +1156,115 @@ static bool export_spent_outputs(MDB_cursor *cur, const std::string &filename)
     return false;
   }
 
-  uint64_t pending_amount = std::numeric_limits<uint64_t>::max();
-  std::vector<uint64_t> pending_offsets;
-  MDB_val k, v;
-  MDB_cursor_op op = MDB_FIRST;
-  while (1)
   {
-    int dbr = mdb_cursor_get(cur, &k, &v, op);
-    if (dbr == MDB_NOTFOUND)
-      break;
-    op = MDB_NEXT;
-    if (dbr)
+    spent_output_writer writer(f);
+    MDB_val k, v;
+    MDB_cursor_op op = MDB_FIRST;
+    while (1)
     {
-      fclose(f);
-      MERROR("Failed to enumerate spent outputs: " << mdb_strerror(dbr));
-      return false;
-    }
-    const uint64_t amount = *(const uint64_t*)k.mv_data;
-    const uint64_t offset = *(const uint64_t*)v.mv_data;
-    if (!pending_offsets.empty() && (amount != pending_amount || pending_offsets.back()+1 != offset))
-    {
-      if (pending_offsets.size() == 1)
-        fprintf(f, "%" PRIu64 "\n", pending_offsets.front());
-      else
-        fprintf(f, "%" PRIu64 "*%zu\n", pending_offsets.front(), pending_offsets.size());
-      pending_offsets.clear();
-    }
-    if (pending_amount != amount)
-    {
-      fprintf(f, "@%" PRIu64 "\n", amount);
-      pending_amount = amount;
+      int dbr = mdb_cursor_get(cur, &k, &v, op);
+      if (dbr == MDB_NOTFOUND)
+        break;
+      op = MDB_NEXT;
+      if (dbr)
+      {
+        writer.flush();
+        fclose(f);
+        MERROR("Failed to enumerate spent outputs: " << mdb_strerror(dbr));
+        return false;
+      }
+      writer.add(*(const uint64_t*)k.mv_data, *(const uint64_t*)v.mv_data);
     }
-    pending_offsets.push_back(offset);
   }
-  if (!pending_offsets.empty())
+  fclose(f);
+  return true;
+}
+
+static bool export_new_spent_outputs(std::vector<output_data> outs, const std::string &filename)
+{
+  FILE *f = fopen(filename.c_str(), "w");
+  if (!f)
   {
-    if (pending_offsets.size() == 1)
-      fprintf(f, "%" PRIu64 "\n", pending_offsets.front());
-    else
-      fprintf(f, "%" PRIu64 "*%zu\n", pending_offsets.front(), pending_offsets.size());
-    pending_offsets.clear();
+    MERROR("Failed to open " << filename << ": " << strerror(errno));
+    return false;
+  }
+
+  std::sort(outs.begin(), outs.end());
+  outs.erase(std::unique(outs.begin(), outs.end()), outs.end());
+  {
+    spent_output_writer writer(f);
+    for (const output_data &od: outs)
+      writer.add(od.amount, od.offset);
+  }
+  const bool failed = ferror(f);
+  if (fclose(f) || failed)
+  {
+    MERROR("Failed to write " << filename);
+    return false;
+  }
+  return true;
+}
+
+// Finds the rings using any of the given spent outputs in which all members
+// but one are known to be spent. This only reads from the last committed
+// state, so slices of outs are checked in parallel with their own read txn;
+// outputs the caller marks as spent from the result are fed to the next pass,
+// which picks up rings this one could not resolve yet.
+static bool find_chain_reaction_candidates(const std::vector<output_data> &outs, std::vector<chain_reaction_candidate> &candidates)
+{
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  const size_t n_slices = std::min<size_t>(outs.size(), 4 * std::max(tpool.get_max_concurrency(), 1u));
+  std::vector<std::vector<chain_reaction_candidate>> found(n_slices);
+  std::unique_ptr<bool[]> results(new bool[n_slices]);
+  tools::threadpool::waiter waiter(tpool);
+  for (size_t i = 0; i < n_slices; ++i)
+  {
+    const size_t begin = outs.size() * i / n_slices;
+    const size_t end = outs.size() * (i + 1) / n_slices;
+    tpool.submit(&waiter, [&, i, begin, end](){
+      MDB_txn *txn = NULL;
+      MDB_cursor *cur = NULL;
+      try
+      {
+        int dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+        CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+        dbr = mdb_cursor_open(txn, dbi_spent, &cur);
+        CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
+        for (size_t n = begin; n < end; ++n)
+        {
+          const output_data &od = outs[n];
+          for (const crypto::key_image &ki: get_key_images(txn, od))
+          {
+            std::vector<uint64_t> relative_ring;
+            CHECK_AND_ASSERT_THROW_MES(get_relative_ring(txn, ki, relative_ring), "Relative ring not found");
+            const std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(relative_ring);
+            chain_reaction_candidate candidate;
+            if (find_ring_candidate(od.amount, absolute, [cur](const output_data &out) { return is_output_spent(cur, out); }, candidate))
+              found[i].push_back(candidate);
+          }
+        }
+        results[i] = true;
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Error looking for chain reaction candidates: " << e.what());
+        results[i] = false;
+      }
+      if (cur)
+        mdb_cursor_close(cur);
+      if (txn)
+        mdb_txn_abort(txn);
+    }, true);
+  }
+  if (!waiter.wait())
+    return false;
+
+  for (size_t i = 0; i < n_slices; ++i)
+  {
+    if (!results[i])
+      return false;
+    candidates.insert(candidates.end(), found[i].begin(), found[i].end());
   }
-  fclose(f);
   return true;
 }
 
@@ -1184,6 +1298,7 @@ int main(int argc, char* argv[])
   };
   const command_line::arg_descriptor<std::string> arg_extra_spent_list = {"extra-spent-list", "Optional list of known spent outputs",""};
   const command_line::arg_descriptor<std::string> arg_export = {"export", "Filename to export the backball list to"};
+  const command_line::arg_descriptor<std::string> arg_export_new = {"export-new", "Filename to export the outputs newly marked as spent by this run to, for use with mark_output_spent <filename> add"};
   const command_line::arg_descriptor<bool> arg_force_chain_reaction_pass = {"force-chain-reaction-pass", "Run the chain reaction pass even if no new blockchain data was processed"};
   const command_line::arg_descriptor<bool> arg_historical_stat = {"historical-stat", "Report historical stat of spent outputs for every 10000 blocks window"};
 
@@ -1195,6 +1310,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_db_sync_mode);
   command_line::add_arg(desc_cmd_sett, arg_extra_spent_list);
   command_line::add_arg(desc_cmd_sett, arg_export);
+  command_line::add_arg(desc_cmd_sett, arg_export_new);
   command_line::add_arg(desc_cmd_sett, arg_force_chain_reaction_pass);
   command_line::add_arg(desc_cmd_sett, arg_historical_stat);
   command_line::add_arg(desc_cmd_sett, arg_inputs);
@@ -1239,6 +1355,7 @@ int main(int argc, char* argv[])
   bool opt_force_chain_reaction_pass = command_line::get_arg(vm, arg_force_chain_reaction_pass);
   bool opt_historical_stat = command_line::get_arg(vm, arg_historical_stat);
   std::string opt_export = command_line::get_arg(vm, arg_export);
+  std::string opt_export_new = command_line::get_arg(vm, arg_export_new);
   std::string extra_spent_list = command_line::get_arg(vm, arg_extra_spent_list);
   std::vector<std::pair<uint64_t, uint64_t>> extra_spent_outputs = extra_spent_list.empty() ? std::vector<std::pair<uint64_t, uint64_t>>() : load_outputs(extra_spent_list);
 
@@ -1264,6 +1381,19 @@ int main(int argc, char* argv[])
 
   const uint64_t start_blackballed_outputs = get_num_spent_outputs();
 
+  // the chain reaction pass only needs to start from what changed in this
+  // run, unless the previous one did not run to completion
+  bool incremental_chain_reaction = false;
+  if (!opt_force_chain_reaction_pass)
+  {
+    uint64_t chain_reaction_spent;
+    MDB_txn *txn;
+    int dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+    CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+    incremental_chain_reaction = get_stat(txn, "chain-reaction-spent", chain_reaction_spent) && chain_reaction_spent == start_blackballed_outputs;
+    mdb_txn_abort(txn);
+  }
+
   tools::ringdb ringdb(output_file_path.string(), epee::string_tools::pod_to_hex(get_genesis_block_hash(inputs[0])));
 
   bool stop_requested = false;
@@ -1282,6 +1412,7 @@ int main(int argc, char* argv[])
   open_db(inputs[0], &env0, &txn0, &cur0, &dbi0);
 
   std::vector<output_data> work_spent;
+  bool chain_reaction_invalidated = false;
 
   if (opt_historical_stat)
   {
@@ -1523,7 +1654,17 @@ int main(int argc, char* argv[])
         }
         if (n == 0)
         {
+          // rings committed from here on are not covered by the last chain
+          // reaction pass, so a run stopping before its own pass must not
+          // leave the next one incremental
+          if (!chain_reaction_invalidated)
+          {
+            del_stat(txn, "chain-reaction-spent");
+            chain_reaction_invalidated = true;
+          }
           set_relative_ring(txn, txin.k_image, new_ring);
+          if (incremental_chain_reaction)
+            new_ring_members.push_back(output_data(txin.amount, absolute[0]));
           if (!opt_rct_only)
             inc_per_amount_outputs(txn, txin.amount, 0, 1);
         }
@@ -1583,79 +1724,80 @@ int main(int argc, char* argv[])
   if (stop_requested)
     goto skip_secondary_passes;
 
-  if (opt_force_chain_reaction_pass || get_num_spent_outputs() > start_blackballed_outputs)
   {
-    MDB_txn *txn;
-    dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
-    CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
-    work_spent = get_spent_outputs(txn);
-    mdb_txn_abort(txn);
+    // with no spent outputs before this run, all are in newly_spent
+    if (incremental_chain_reaction || start_blackballed_outputs == 0)
+    {
+      work_spent = chain_reaction_seeds(newly_spent, new_ring_members);
+    }
+    else
+    {
+      MDB_txn *txn;
+      dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+      work_spent = get_spent_outputs(txn);
+      mdb_txn_abort(txn);
+    }
   }
 
-  while (!work_spent.empty())
   {
-    LOG_PRINT_L0("Secondary pass on " << work_spent.size() << " spent outputs");
-
-    int dbr = resize_env(cache_dir.c_str());
-    CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to resize LMDB database: " + std::string(mdb_strerror(dbr)));
-
-    MDB_txn *txn;
-    dbr = mdb_txn_begin(env, NULL, 0, &txn);
-    CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
-    MDB_cursor *cur;
-    dbr = mdb_cursor_open(txn, dbi_spent, &cur);
-    CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
-
-    std::vector<std::pair<uint64_t, uint64_t>> blackballs;
-    std::vector<output_data> scan_spent = std::move(work_spent);
-    work_spent.clear();
-    for (const output_data &od: scan_spent)
-    {
-      std::vector<crypto::key_image> key_images = get_key_images(txn, od);
-      for (const crypto::key_image &ki: key_images)
+    const auto find = [&stop_requested](const std::vector<output_data> &outs, std::vector<chain_reaction_candidate> &candidates) {
+      LOG_PRINT_L0("Secondary pass on " << outs.size() << " outputs");
+      CHECK_AND_ASSERT_THROW_MES(find_chain_reaction_candidates(outs, candidates), "Failed to scan rings of spent outputs");
+      return !stop_requested;
+    };
+    const auto mark = [&cache_dir, &ringdb, opt_verbose](const std::vector<chain_reaction_candidate> &candidates, std::vector<output_data> &marked) {
+      int dbr = resize_env(cache_dir.c_str());
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to resize LMDB database: " + std::string(mdb_strerror(dbr)));
+
+      MDB_txn *txn;
+      dbr = mdb_txn_begin(env, NULL, 0, &txn);
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+      MDB_cursor *cur;
+      dbr = mdb_cursor_open(txn, dbi_spent, &cur);
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
+
+      std::vector<std::pair<uint64_t, uint64_t>> blackballs;
+      for (const chain_reaction_candidate &candidate: candidates)
       {
-        std::vector<uint64_t> relative_ring;
-        CHECK_AND_ASSERT_THROW_MES(get_relative_ring(txn, ki, relative_ring), "Relative ring not found");
-        std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(relative_ring);
-        size_t known = 0;
-        uint64_t last_unknown = 0;
-        for (uint64_t out: absolute)
-        {
-          output_data new_od(od.amount, out);
-          if (is_output_spent(cur, new_od))
-            ++known;
-          else
-            last_unknown = out;
-        }
-        if (known == absolute.size() - 1)
+        // several rings may resolve to the same output
+        if (!add_spent_output(cur, candidate.od))
+          continue;
+        const std::pair<uint64_t, uint64_t> output = std::make_pair(candidate.od.amount, candidate.od.offset);
+        if (opt_verbose)
         {
-          const std::pair<uint64_t, uint64_t> output = std::make_pair(od.amount, last_unknown);
-          if (opt_verbose)
-          {
-            MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in a " <<
-                absolute.size() << "-ring where all other outputs are known to be spent");
-          }
-          blackballs.push_back(output);
-          if (add_spent_output(cur, output_data(od.amount, last_unknown)))
-            inc_stat(txn, od.amount ? "pre-rct-chain-reaction" : "rct-chain-reaction");
-          work_spent.push_back(output_data(od.amount, last_unknown));
+          MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in a " <<
+              candidate.ring_size << "-ring where all other outputs are known to be spent");
         }
+        blackballs.push_back(output);
+        inc_stat(txn, candidate.od.amount ? "pre-rct-chain-reaction" : "rct-chain-reaction");
+        marked.push_back(candidate.od);
       }
-
-      if (stop_requested)
+      if (!blackballs.empty())
       {
-        MINFO("Stopping secondary passes. Secondary passes are not incremental, they will re-run fully.");
-        return 0;
+        ringdb.blackball(blackballs);
+        blackballs.clear();
       }
-    }
-    if (!blackballs.empty())
+      mdb_cursor_close(cur);
+      dbr = mdb_txn_commit(txn);
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to commit txn creating/opening database: " + std::string(mdb_strerror(dbr)));
+      return true;
+    };
+    if (!run_chain_reaction(std::move(work_spent), find, mark))
     {
-      ringdb.blackball(blackballs);
-      blackballs.clear();
+      MINFO("Stopping secondary passes. They will re-run fully next time.");
+      return 0;
     }
-    mdb_cursor_close(cur);
+  }
+
+  {
+    const uint64_t num_spent_outputs = get_num_spent_outputs();
+    MDB_txn *txn;
+    dbr = mdb_txn_begin(env, NULL, 0, &txn);
+    CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+    set_stat(txn, "chain-reaction-spent", num_spent_outputs);
     dbr = mdb_txn_commit(txn);
-    CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to commit txn creating/opening database: " + std::string(mdb_strerror(dbr)));
+    CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to commit txn: " + std::string(mdb_strerror(dbr)));
   }
 
 skip_secondary_passes:
@@ -1700,6 +1842,16 @@ skip_secondary_passes:
     mdb_cursor_close(cur);
     mdb_txn_abort(txn);
   }
+  if (!opt_export_new.empty())
+  {
+    LOG_PRINT_L0("Exporting " << newly_spent.size() << " newly spent outputs to " << opt_export_new);
+    if (!export_new_spent_outputs(newly_spent, opt_export_new))
+    {
+      close_db(env0, txn0, cur0, dbi0);
+      close();
+      return 1;
+    }
+  }
 
   LOG_PRINT_L0("Blockchain spent output data exported OK");
   close_db(env0, txn0, cur0, dbi0);
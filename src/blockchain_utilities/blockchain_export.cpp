@@ -50,6 +50,8 @@ int main(int argc, char* argv[])
   uint64_t block_start = 0;
   uint64_t block_stop = 0;
   bool blocks_dat = false;
+  bool indexed = false;
+  bool compress = false;
 
   tools::on_startup();
 
@@ -62,6 +64,8 @@ int main(int argc, char* argv[])
   const command_line::arg_descriptor<uint64_t> arg_block_start = {"block-start", "Start at block number", block_start};
   const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop at block number", block_stop};
   const command_line::arg_descriptor<bool> arg_blocks_dat = {"blocksdat", "Output in blocks.dat format", blocks_dat};
+  const command_line::arg_descriptor<bool> arg_indexed = {"indexed", "Output in the seekable, indexed bootstrap format", indexed};
+  const command_line::arg_descriptor<bool> arg_compress = {"compress", "Compress chunks with zstd (implies --indexed)", compress};
 
 
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
@@ -72,6 +76,8 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_block_start);
   command_line::add_arg(desc_cmd_sett, arg_block_stop);
   command_line::add_arg(desc_cmd_sett, arg_blocks_dat);
+  command_line::add_arg(desc_cmd_sett, arg_indexed);
+  command_line::add_arg(desc_cmd_sett, arg_compress);
 
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
@@ -113,6 +119,18 @@ int main(int argc, char* argv[])
     return 1;
   }
   bool opt_blocks_dat = command_line::get_arg(vm, arg_blocks_dat);
+  bool opt_compress = command_line::get_arg(vm, arg_compress);
+  bool opt_indexed = command_line::get_arg(vm, arg_indexed) || opt_compress;
+  if (opt_blocks_dat && opt_indexed)
+  {
+    std::cerr << "Can't specify --blocksdat with --indexed or --compress" << std::endl;
+    return 1;
+  }
+  if (opt_compress && !BootstrapFile::can_compress())
+  {
+    std::cerr << "Can't compress, built without zstd" << std::endl;
+    return 1;
+  }
 
   std::string m_config_folder;
 
@@ -179,6 +197,11 @@ int main(int argc, char* argv[])
     BlocksdatFile blocksdat;
     r = blocksdat.store_blockchain_raw(core_storage, NULL, output_file_path, block_stop);
   }
+  else if (opt_indexed)
+  {
+    BootstrapFile bootstrap;
+    r = bootstrap.store_blockchain_indexed(core_storage, output_file_path, block_start, block_stop, opt_compress);
+  }
   else
   {
     BootstrapFile bootstrap;
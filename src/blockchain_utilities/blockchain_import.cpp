@@ -29,10 +29,14 @@
 #include <atomic>
 #include <cstdio>
 #include <algorithm>
+#include <deque>
 #include <fstream>
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <unistd.h>
 #include "misc_log_ex.h"
 #include "bootstrap_file.h"
@@ -42,6 +46,8 @@
 #include "serialization/binary_utils.h" // dump_binary(), parse_binary()
 #include "serialization/json_utils.h" // dump_json()
 #include "include_base_utils.h"
+#include "common/threadpool.h"
+#include "common/util.h"
 #include "cryptonote_core/cryptonote_core.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -69,6 +75,14 @@ uint64_t db_batch_size = 100;
 // frequently saved
 uint64_t db_batch_size_verify = 5000;
 
+// number of deserialized spans the reader thread may hold ahead of the
+// verifier
+const size_t spans_read_ahead = 2;
+
+const uint64_t progress_interval = 10;
+
+std::atomic<bool> stop_requested(false);
+
 std::string refresh_string = "\r                                    \r";
 }
 
@@ -127,32 +141,284 @@ int pop_blocks(cryptonote::core& core, int num_blocks)
   return num_blocks;
 }
 
-int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &blocks, bool force)
+// A block read from the bootstrap file, along with the blobs and hash which
+// would otherwise be recomputed serially when it is added
+struct import_block
 {
-  if (blocks.empty())
-    return 0;
-  if (!force && blocks.size() < db_batch_size)
-    return 0;
+  bootstrap::block_package package;
+  cryptonote::blobdata block_blob;
+  std::vector<cryptonote::blobdata> tx_blobs;
+  crypto::hash hash;
+};
+
+// A run of consecutive blocks which is verified and committed as one batch
+struct import_span
+{
+  std::vector<import_block> blocks;
+  uint64_t bytes;
+};
 
-  // wait till we can verify a full HOH without extra, for speed
-  uint64_t new_height = core.get_blockchain_storage().get_db().height() + blocks.size();
-  if (!force && new_height % HASH_OF_HASHES_STEP)
-    return 0;
+void prepare_import_block(import_block &ib)
+{
+  const bootstrap::block_package &bp = ib.package;
+  ib.block_blob = cryptonote::block_to_blob(bp.block);
+  ib.tx_blobs.clear();
+  ib.tx_blobs.reserve(bp.txs.size());
+  for (const auto &tx: bp.txs)
+    ib.tx_blobs.push_back(cryptonote::tx_to_blob(tx));
+  ib.hash = cryptonote::get_block_hash(bp.block);
+}
 
-  std::vector<crypto::hash> hashes;
-  for (const auto &b: blocks)
+bool parse_import_chunk(const std::string &chunk, uint8_t major_version, std::vector<import_block> &blocks)
+{
+  if (major_version >= 2)
   {
-    cryptonote::block block;
-    if (!parse_and_validate_block_from_blob(b.block, block))
+    std::vector<bootstrap::block_package> packages;
+    if (!BootstrapFile::parse_chunk(chunk, packages))
+      return false;
+    blocks.resize(packages.size());
+    for (size_t i = 0; i < packages.size(); ++i)
     {
-      MERROR("Failed to parse block: "
-          << epee::string_tools::buff_to_hex_nodelimer(b.block));
-      core.cleanup_handle_incoming_blocks();
-      return 1;
+      blocks[i].package = std::move(packages[i]);
+      prepare_import_block(blocks[i]);
+    }
+    return true;
+  }
+
+  blocks.resize(1);
+  bootstrap::block_package &bp = blocks[0].package;
+  bool res;
+  if (major_version == 0)
+  {
+    bootstrap::block_package_1 bp1;
+    res = ::serialization::parse_binary(chunk, bp1);
+    if (res)
+    {
+      bp.block = std::move(bp1.block);
+      bp.txs = std::move(bp1.txs);
+      bp.block_weight = bp1.block_weight;
+      bp.cumulative_difficulty = bp1.cumulative_difficulty;
+      bp.coins_generated = bp1.coins_generated;
+    }
+  }
+  else
+    res = ::serialization::parse_binary(chunk, bp);
+  if (!res)
+    return false;
+
+  prepare_import_block(blocks[0]);
+  return true;
+}
+
+// Number of blocks in the span starting at the given height. When verifying,
+// spans end on a multiple of HASH_OF_HASHES_STEP so whole hashes of hashes
+// can be checked without having to wait for blocks from the next span
+uint64_t get_span_size(uint64_t height, uint64_t block_stop)
+{
+  uint64_t span_size = db_batch_size;
+  if (opt_verify)
+    span_size += (HASH_OF_HASHES_STEP - (height + span_size) % HASH_OF_HASHES_STEP) % HASH_OF_HASHES_STEP;
+  return std::min(span_size, block_stop + 1 - height);
+}
+
+// Reads the bootstrap file on its own thread, deserializing each span in
+// parallel while the previous one is being verified
+class span_reader
+{
+public:
+  span_reader(std::ifstream &import_file, uint8_t major_version, uint64_t chunks_end, uint64_t blocks_per_chunk, uint64_t skip, uint64_t height, uint64_t block_stop);
+  ~span_reader();
+
+  // blocks until the next span is ready, returns false once there are no more
+  bool next(import_span &span);
+  void stop();
+  bool failed() const { return m_failed; }
+
+private:
+  void run();
+  bool read_chunks(std::vector<std::string> &chunks, uint64_t count);
+  void parse_chunks(const std::vector<std::string> &chunks);
+
+  std::ifstream &m_import_file;
+  const uint8_t m_major_version;
+  const uint64_t m_chunks_end; // chunk index position of version 2 files, 0 otherwise
+  const uint64_t m_blocks_per_chunk;
+  uint64_t m_skip; // blocks to drop from the first chunk when resuming
+  std::deque<import_block> m_pending;
+  uint64_t m_height;
+  const uint64_t m_block_stop;
+
+  boost::mutex m_lock;
+  boost::condition_variable m_cond;
+  std::deque<import_span> m_spans;
+  bool m_stop;
+  bool m_done;
+  std::atomic<bool> m_failed;
+  boost::thread m_thread;
+};
+
+span_reader::span_reader(std::ifstream &import_file, uint8_t major_version, uint64_t chunks_end, uint64_t blocks_per_chunk, uint64_t skip, uint64_t height, uint64_t block_stop):
+  m_import_file(import_file),
+  m_major_version(major_version),
+  m_chunks_end(chunks_end),
+  m_blocks_per_chunk(blocks_per_chunk),
+  m_skip(skip),
+  m_height(height),
+  m_block_stop(block_stop),
+  m_stop(false),
+  m_done(false),
+  m_failed(false)
+{
+  m_thread = boost::thread([this](){ run(); });
+}
+
+span_reader::~span_reader()
+{
+  stop();
+  m_thread.join();
+}
+
+void span_reader::stop()
+{
+  boost::unique_lock<boost::mutex> lock(m_lock);
+  m_stop = true;
+  m_cond.notify_all();
+}
+
+bool span_reader::next(import_span &span)
+{
+  boost::unique_lock<boost::mutex> lock(m_lock);
+  while (m_spans.empty() && !m_done)
+    m_cond.wait(lock);
+  if (m_spans.empty())
+    return false;
+  span = std::move(m_spans.front());
+  m_spans.pop_front();
+  m_cond.notify_all();
+  return true;
+}
+
+void span_reader::run()
+{
+  try
+  {
+    bool eof = false;
+    std::vector<std::string> chunks;
+    while (m_height <= m_block_stop)
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(m_lock);
+        while (m_spans.size() >= spans_read_ahead && !m_stop)
+          m_cond.wait(lock);
+        if (m_stop)
+          break;
+      }
+
+      const uint64_t span_size = get_span_size(m_height, m_block_stop);
+      while (!eof && m_pending.size() < span_size)
+      {
+        const uint64_t needed = m_skip + span_size - m_pending.size();
+        eof = !read_chunks(chunks, (needed + m_blocks_per_chunk - 1) / m_blocks_per_chunk);
+        parse_chunks(chunks);
+      }
+      if (m_pending.empty())
+        break;
+
+      import_span span;
+      span.bytes = 0;
+      const uint64_t n_blocks = std::min<uint64_t>(span_size, m_pending.size());
+      span.blocks.reserve(n_blocks);
+      for (uint64_t i = 0; i < n_blocks; ++i)
+      {
+        import_block &ib = m_pending.front();
+        span.bytes += ib.block_blob.size();
+        for (const cryptonote::blobdata &blob: ib.tx_blobs)
+          span.bytes += blob.size();
+        span.blocks.push_back(std::move(ib));
+        m_pending.pop_front();
+      }
+      m_height += n_blocks;
+
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      m_spans.push_back(std::move(span));
+      m_cond.notify_all();
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cout << refresh_string;
+    MFATAL("exception while reading from file, height=" << m_height << ": " << e.what());
+    m_failed = true;
+  }
+
+  boost::unique_lock<boost::mutex> lock(m_lock);
+  m_done = true;
+  m_cond.notify_all();
+}
+
+// returns false once the end of the chunks is reached
+bool span_reader::read_chunks(std::vector<std::string> &chunks, uint64_t count)
+{
+  chunks.clear();
+  while (chunks.size() < count)
+  {
+    std::string chunk;
+    if (!BootstrapFile::read_chunk(m_import_file, m_chunks_end, m_blocks_per_chunk, chunk))
+    {
+      std::cout << refresh_string;
+      return false;
     }
-    hashes.push_back(cryptonote::get_block_hash(block));
+    chunks.push_back(std::move(chunk));
   }
-  core.prevalidate_block_hashes(core.get_blockchain_storage().get_db().height(), hashes, {});
+  return true;
+}
+
+void span_reader::parse_chunks(const std::vector<std::string> &chunks)
+{
+  std::vector<std::vector<import_block>> blocks(chunks.size());
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  const size_t threads = std::max<size_t>(tpool.get_max_concurrency(), 1);
+  const size_t per_thread = (chunks.size() + threads - 1) / threads;
+  std::atomic<size_t> bad_chunk(chunks.size());
+  for (size_t start = 0; start < chunks.size(); start += per_thread)
+  {
+    const size_t end = std::min(start + per_thread, chunks.size());
+    tpool.submit(&waiter, [&, start, end](){
+      for (size_t i = start; i < end; ++i)
+      {
+        if (!parse_import_chunk(chunks[i], m_major_version, blocks[i]))
+        {
+          bad_chunk = i;
+          return;
+        }
+      }
+    }, true);
+  }
+  if (!waiter.wait())
+    throw std::runtime_error("Error waiting for chunk deserialization");
+  if (bad_chunk != chunks.size())
+  {
+    throw std::runtime_error("Error in deserialization of chunk");
+  }
+
+  for (std::vector<import_block> &chunk_blocks: blocks)
+  {
+    for (import_block &ib: chunk_blocks)
+    {
+      if (m_skip)
+        --m_skip;
+      else
+        m_pending.push_back(std::move(ib));
+    }
+  }
+}
+
+int add_verified_span(cryptonote::core &core, const std::vector<block_complete_entry> &blocks, const std::vector<crypto::hash> &hashes, uint64_t block_stop)
+{
+  const uint64_t start_height = core.get_blockchain_storage().get_db().height();
+  core.prevalidate_block_hashes(start_height, hashes, {});
 
   std::vector<block> pblocks;
   if (!core.prepare_handle_incoming_blocks(blocks, pblocks))
@@ -170,15 +436,21 @@ int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &block
   size_t blockidx = 0;
   for(const block_complete_entry& block_entry: blocks)
   {
-    // process transactions
-    for(auto& tx_blob: block_entry.txs)
+    // process transactions, verifying them in parallel
+    std::vector<tx_verification_context> tvc;
+    core.handle_incoming_txs(block_entry.txs, tvc, relay_method::block, true);
+    if (tvc.size() != block_entry.txs.size())
     {
-      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-      core.handle_incoming_tx(tx_blob, tvc, relay_method::block, true);
-      if(tvc.m_verifivation_failed)
+      MERROR("Internal error: tvc.size() != block_entry.txs.size()");
+      core.cleanup_handle_incoming_blocks();
+      return 1;
+    }
+    for (size_t i = 0; i < tvc.size(); ++i)
+    {
+      if(tvc[i].m_verifivation_failed)
       {
         cryptonote::transaction transaction;
-        if (cryptonote::parse_and_validate_tx_from_blob(tx_blob.blob, transaction))
+        if (cryptonote::parse_and_validate_tx_from_blob(block_entry.txs[i].blob, transaction))
           MERROR("Transaction verification failed, tx_id = " << cryptonote::get_transaction_hash(transaction));
         else
           MERROR("Transaction verification failed, transaction is unparsable");
@@ -191,15 +463,11 @@ int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &block
 
     block_verification_context bvc = {};
 
-    core.handle_incoming_block(block_entry.block, pblocks.empty() ? NULL : &pblocks[blockidx++], bvc, false); // <--- process block
+    core.handle_incoming_block(block_entry.block, pblocks.empty() ? NULL : &pblocks[blockidx], bvc, false); // <--- process block
 
     if(bvc.m_verifivation_failed)
     {
-      cryptonote::block block;
-      if (cryptonote::parse_and_validate_block_from_blob(block_entry.block, block))
-        MERROR("Block verification failed, id = " << cryptonote::get_block_hash(block));
-      else
-        MERROR("Block verification failed, block is unparsable");
+      MERROR("Block verification failed, id = " << hashes[blockidx]);
       core.cleanup_handle_incoming_blocks();
       return 1;
     }
@@ -210,11 +478,19 @@ int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &block
       return 1;
     }
 
+    const uint64_t height = start_height + blockidx++;
+    if (height % progress_interval == 0)
+    {
+      std::cout << refresh_string << "block " << height
+        << " / " << block_stop
+        << "\r" << std::flush;
+    }
   } // each download block
-  if (!core.cleanup_handle_incoming_blocks())
+
+  // sync now, so an interrupted import can resume after this span
+  if (!core.cleanup_handle_incoming_blocks(true))
     return 1;
 
-  blocks.clear();
   return 0;
 }
 
@@ -267,21 +543,15 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
 
   // 4 byte magic + (currently) 1024 byte header structures
   uint8_t major_version, minor_version;
-  uint64_t dummy;
-  bootstrap.seek_to_first_chunk(import_file, major_version, minor_version, dummy, dummy);
-
-  std::string str1;
-  char buffer1[1024];
-  char buffer_block[BUFFER_SIZE];
-  block b;
-  transaction tx;
+  uint64_t dummy, block_last_pos;
+  bootstrap.seek_to_first_chunk(import_file, major_version, minor_version, dummy, dummy, block_last_pos);
+
   int quit = 0;
-  uint64_t bytes_read;
 
   // Note that a new blockchain will start with block number 0 (total blocks: 1)
   // due to genesis block being added at initialization.
 
-  if (! block_stop)
+  if (! block_stop || block_stop > total_source_blocks+block_first - 1)
   {
     block_stop = total_source_blocks+block_first - 1;
   }
@@ -296,199 +566,98 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   MINFO("Reading blockchain from bootstrap file...");
   std::cout << ENDL;
 
-  std::vector<block_complete_entry> blocks;
-
   // Skip to start_height before we start adding.
+  uint64_t blocks_per_chunk = NUM_BLOCKS_PER_CHUNK, skip = 0;
+  if (major_version >= 2)
+  {
+    // pos is the start of the chunk holding seek_height, the reader drops
+    // the blocks before start_height
+    bootstrap::chunk_index index;
+    if (!bootstrap.read_chunk_index(import_file, block_last_pos, index))
+      return 2;
+    blocks_per_chunk = index.blocks_per_chunk;
+    import_file.seekg(pos);
+    skip = start_height > seek_height ? start_height - seek_height : 0;
+    h = start_height;
+  }
+  else
   {
     bool q2 = false;
     import_file.seekg(pos);
-    bytes_read = bootstrap.count_bytes(import_file, start_height-seek_height, h, q2);
+    bootstrap.count_bytes(import_file, start_height-seek_height, h, q2);
     if (q2)
-    {
       quit = 2;
-      goto quitting;
-    }
     h = start_height;
   }
 
-  if (use_batch)
+  if (!quit && h <= block_stop)
   {
-    uint64_t bytes, h2;
-    bool q2;
-    pos = import_file.tellg();
-    bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-    if (import_file.eof())
-      import_file.clear();
-    import_file.seekg(pos);
-    core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
-  }
-  while (! quit)
-  {
-    uint32_t chunk_size;
-    import_file.read(buffer1, sizeof(chunk_size));
-    // TODO: bootstrap.read_chunk();
-    if (! import_file) {
-      std::cout << refresh_string;
-      MINFO("End of file reached");
-      quit = 1;
-      break;
-    }
-    bytes_read += sizeof(chunk_size);
-
-    str1.assign(buffer1, sizeof(chunk_size));
-    if (! ::serialization::parse_binary(str1, chunk_size))
+    span_reader reader(import_file, major_version, major_version >= 2 ? block_last_pos : 0, blocks_per_chunk, skip, h, block_stop);
+    import_span span;
+    while (!quit && reader.next(span))
     {
-      throw std::runtime_error("Error in deserialization of chunk size");
-    }
-    MDEBUG("chunk_size: " << chunk_size);
-
-    if (chunk_size > BUFFER_SIZE)
-    {
-      MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
-      throw std::runtime_error("Aborting: chunk size exceeds buffer size");
-    }
-    if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
-    {
-      MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
-    }
-    else if (chunk_size == 0) {
-      MFATAL("ERROR: chunk_size == 0");
-      return 2;
-    }
-    import_file.read(buffer_block, chunk_size);
-    if (! import_file) {
-      if (import_file.eof())
-      {
-        std::cout << refresh_string;
-        MINFO("End of file reached - file was truncated");
-        quit = 1;
-        break;
-      }
-      else
+      if (opt_verify)
       {
-        MFATAL("ERROR: unexpected end of file: bytes read before error: "
-            << import_file.gcount() << " of chunk_size " << chunk_size);
-        return 2;
-      }
-    }
-    bytes_read += chunk_size;
-    MDEBUG("Total bytes read: " << bytes_read);
-
-    if (h > block_stop)
-    {
-      std::cout << refresh_string << "block " << h-1
-        << " / " << block_stop
-        << "\r" << std::flush;
-      std::cout << ENDL << ENDL;
-      MINFO("Specified block number reached - stopping.  block: " << h-1 << "  total blocks: " << h);
-      quit = 1;
-      break;
-    }
-
-    try
-    {
-      str1.assign(buffer_block, chunk_size);
-      bootstrap::block_package bp;
-      bool res;
-      if (major_version == 0)
-      {
-        bootstrap::block_package_1 bp1;
-        res = ::serialization::parse_binary(str1, bp1);
-        if (res)
+        std::vector<block_complete_entry> blocks;
+        std::vector<crypto::hash> hashes;
+        blocks.reserve(span.blocks.size());
+        hashes.reserve(span.blocks.size());
+        for (import_block &ib: span.blocks)
         {
-          bp.block = std::move(bp1.block);
-          bp.txs = std::move(bp1.txs);
-          bp.block_weight = bp1.block_weight;
-          bp.cumulative_difficulty = bp1.cumulative_difficulty;
-          bp.coins_generated = bp1.coins_generated;
+          block_complete_entry bce;
+          bce.pruned = false;
+          bce.block = std::move(ib.block_blob);
+          bce.txs.reserve(ib.tx_blobs.size());
+          for (cryptonote::blobdata &blob: ib.tx_blobs)
+            bce.txs.push_back({std::move(blob), crypto::null_hash});
+          blocks.push_back(std::move(bce));
+          hashes.push_back(ib.hash);
         }
+        int ret = add_verified_span(core, blocks, hashes, block_stop);
+        if (ret)
+        {
+          quit = 2; // make sure we don't commit partial block data
+          break;
+        }
+        h += blocks.size();
+        num_imported += blocks.size();
       }
       else
-        res = ::serialization::parse_binary(str1, bp);
-      if (!res)
-        throw std::runtime_error("Error in deserialization of chunk");
-
-      int display_interval = 1000;
-      int progress_interval = 10;
-      // NOTE: use of NUM_BLOCKS_PER_CHUNK is a placeholder in case multi-block chunks are later supported.
-      for (int chunk_ind = 0; chunk_ind < NUM_BLOCKS_PER_CHUNK; ++chunk_ind)
       {
-        ++h;
-        if ((h-1) % display_interval == 0)
-        {
-          std::cout << refresh_string;
-          MDEBUG("loading block number " << h-1);
-        }
-        else
-        {
-          MDEBUG("loading block number " << h-1);
-        }
-        b = bp.block;
-        MDEBUG("block prev_id: " << b.prev_id << ENDL);
-
-        if ((h-1) % progress_interval == 0)
-        {
-          std::cout << refresh_string << "block " << h-1
-            << " / " << block_stop
-            << "\r" << std::flush;
-        }
+        if (use_batch)
+          core.get_blockchain_storage().get_db().batch_start(span.blocks.size(), span.bytes);
 
-        if (opt_verify)
+        for (import_block &ib: span.blocks)
         {
-          cryptonote::blobdata block;
-          cryptonote::block_to_blob(bp.block, block);
-          std::vector<tx_blob_entry> txs;
-          for (const auto &tx: bp.txs)
-          {
-            txs.push_back({cryptonote::blobdata(), crypto::null_hash});
-            cryptonote::tx_to_blob(tx, txs.back().blob);
-          }
-          block_complete_entry bce;
-          bce.pruned = false;
-          bce.block = std::move(block);
-          bce.txs = std::move(txs);
-          blocks.push_back(bce);
-          int ret = check_flush(core, blocks, false);
-          if (ret)
-          {
-            quit = 2; // make sure we don't commit partial block data
-            break;
-          }
-        }
-        else
-        {
-          std::vector<std::pair<transaction, blobdata>> txs;
-          std::vector<transaction> archived_txs;
-
-          archived_txs = bp.txs;
+          ++h;
+          MDEBUG("loading block number " << h-1);
+          MDEBUG("block prev_id: " << ib.package.block.prev_id << ENDL);
 
-          // tx number 1: coinbase tx
-          // tx number 2 onwards: archived_txs
-          for (const transaction &tx : archived_txs)
+          if ((h-1) % progress_interval == 0)
           {
-            // add blocks with verification.
-            // for Blockchain and blockchain_storage add_new_block().
-            // for add_block() method, without (much) processing.
-            // don't add coinbase transaction to txs.
-            //
-            // because add_block() calls
-            // add_transaction(blk_hash, blk.miner_tx) first, and
-            // then a for loop for the transactions in txs.
-            txs.push_back(std::make_pair(tx, tx_to_blob(tx)));
+            std::cout << refresh_string << "block " << h-1
+              << " / " << block_stop
+              << "\r" << std::flush;
           }
 
-          size_t block_weight;
-          difficulty_type cumulative_difficulty;
-          uint64_t coins_generated;
-
-          block_weight = bp.block_weight;
-          cumulative_difficulty = bp.cumulative_difficulty;
-          coins_generated = bp.coins_generated;
+          // add blocks with verification.
+          // for Blockchain and blockchain_storage add_new_block().
+          // for add_block() method, without (much) processing.
+          // don't add coinbase transaction to txs.
+          //
+          // because add_block() calls
+          // add_transaction(blk_hash, blk.miner_tx) first, and
+          // then a for loop for the transactions in txs.
+          std::vector<std::pair<transaction, blobdata>> txs;
+          txs.reserve(ib.package.txs.size());
+          for (size_t i = 0; i < ib.package.txs.size(); ++i)
+            txs.push_back(std::make_pair(std::move(ib.package.txs[i]), std::move(ib.tx_blobs[i])));
 
           try
           {
+            const size_t block_weight = ib.package.block_weight;
             uint64_t long_term_block_weight = core.get_blockchain_storage().get_next_long_term_block_weight(block_weight);
-            core.get_blockchain_storage().get_db().add_block(std::make_pair(b, block_to_blob(b)), block_weight, long_term_block_weight, cumulative_difficulty, coins_generated, txs);
+            core.get_blockchain_storage().get_db().add_block(std::make_pair(std::move(ib.package.block), std::move(ib.block_blob)), block_weight, long_term_block_weight, ib.package.cumulative_difficulty, ib.package.coins_generated, txs);
           }
           catch (const std::exception& e)
           {
@@ -497,68 +666,53 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
             quit = 2; // make sure we don't commit partial block data
             break;
           }
+          ++num_imported;
+        }
 
-          if (use_batch)
+        if (use_batch)
+        {
+          if (quit > 1)
           {
-            if ((h-1) % db_batch_size == 0)
-            {
-              uint64_t bytes, h2;
-              bool q2;
-              std::cout << refresh_string;
-              // zero-based height
-              std::cout << ENDL << "[- batch commit at height " << h-1 << " -]" << ENDL;
-              core.get_blockchain_storage().get_db().batch_stop();
-              pos = import_file.tellg();
-              bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-              import_file.seekg(pos);
-              core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
-              std::cout << ENDL;
-              core.get_blockchain_storage().get_db().show_stats();
-            }
+            // There was an error, so don't commit pending data.
+            core.get_blockchain_storage().get_db().batch_abort();
+            break;
           }
+          std::cout << refresh_string;
+          // zero-based height
+          std::cout << ENDL << "[- batch commit at height " << h-1 << " -]" << ENDL;
+          core.get_blockchain_storage().get_db().batch_stop();
+          std::cout << ENDL;
+          core.get_blockchain_storage().get_db().show_stats();
         }
-        ++num_imported;
       }
-    }
-    catch (const std::exception& e)
-    {
-      std::cout << refresh_string;
-      MFATAL("exception while reading from file, height=" << h << ": " << e.what());
-      return 2;
-    }
-  } // while
 
-quitting:
-  import_file.close();
-
-  if (opt_verify)
-  {
-    int ret = check_flush(core, blocks, true);
-    if (ret)
-      return ret;
+      if (stop_requested)
+      {
+        std::cout << refresh_string;
+        MINFO("Stop requested, import can be resumed from block " << h);
+        break;
+      }
+    }
+    reader.stop();
+    if (reader.failed())
+      quit = 2;
   }
 
-  if (use_batch)
+  if (h > block_stop && !quit)
   {
-    if (quit > 1)
-    {
-      // There was an error, so don't commit pending data.
-      // Destructor will abort write txn.
-    }
-    else
-    {
-      core.get_blockchain_storage().get_db().batch_stop();
-    }
+    std::cout << ENDL << ENDL;
+    MINFO("Specified block number reached - stopping.  block: " << h-1 << "  total blocks: " << h);
   }
 
+  import_file.close();
+
   core.get_blockchain_storage().get_db().show_stats();
   MINFO("Number of blocks imported: " << num_imported);
   if (h > 0)
-    // TODO: if there was an error, the last added block is probably at zero-based height h-2
     MINFO("Finished at block: " << h-1 << "  total blocks: " << h);
 
   std::cout << ENDL;
-  return 0;
+  return quit > 1 ? 2 : 0;
 }
 
 int main(int argc, char* argv[])
@@ -763,6 +917,10 @@ int main(int argc, char* argv[])
     return 0;
   }
 
+  tools::signal_handler::install([](int type) {
+    stop_requested = true;
+  });
+
   import_from_file(core, import_file_path, block_stop);
 
   // ensure db closed
@@ -0,0 +1,146 @@
+// Copyright (c) 2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "common/threadpool.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_scan.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "bcutil"
+
+BlockchainScanner::BlockchainScanner(cryptonote::BlockchainDB& db, uint64_t blocks_per_range):
+  m_db(db),
+  m_blocks_per_range(std::max<uint64_t>(blocks_per_range, 1)),
+  m_need_tx_sizes(false)
+{
+}
+
+void BlockchainScanner::add(ScanAggregator& aggregator)
+{
+  m_aggregators.push_back(&aggregator);
+  m_need_tx_sizes |= aggregator.needs_tx_sizes();
+}
+
+bool BlockchainScanner::scan_range(uint64_t start_height, uint64_t end_height, std::vector<std::unique_ptr<ScanAggregator::Partial>>& partials) const
+{
+  cryptonote::db_rtxn_guard rtxn_guard(&m_db);
+  ScannedBlock b;
+  cryptonote::blobdata bd;
+  for (uint64_t height = start_height; height < end_height; ++height)
+  {
+    bd = m_db.get_block_blob_from_height(height);
+    b.height = height;
+    b.block_size = bd.size();
+    if (!cryptonote::parse_and_validate_block_from_blob(bd, b.block))
+    {
+      MERROR("Bad block from db at height " << height);
+      return false;
+    }
+
+    b.txs.resize(b.block.tx_hashes.size());
+    b.tx_sizes.clear();
+    for (size_t i = 0; i < b.block.tx_hashes.size(); ++i)
+    {
+      const crypto::hash& txid = b.block.tx_hashes[i];
+      if (!m_db.get_pruned_tx_blob(txid, bd))
+      {
+        MERROR("Failed to get txid " << txid << " from db");
+        return false;
+      }
+      if (!cryptonote::parse_and_validate_tx_base_from_blob(bd, b.txs[i]))
+      {
+        MERROR("Bad txn from db: " << txid);
+        return false;
+      }
+      if (m_need_tx_sizes)
+      {
+        size_t size = bd.size();
+        if (m_db.get_prunable_tx_blob(txid, bd))
+          size += bd.size();
+        b.tx_sizes.push_back(size);
+      }
+    }
+
+    for (const auto& partial: partials)
+      if (!partial->add_block(b))
+        return false;
+  }
+  return true;
+}
+
+bool BlockchainScanner::scan(uint64_t start_height, uint64_t stop_height, const std::atomic<bool>* stop)
+{
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  // enough ranges in flight to keep every thread busy while the oldest
+  // ones are merged
+  const uint64_t window = 2 * std::max(tpool.get_max_concurrency(), 1u);
+
+  uint64_t height = start_height;
+  while (height < stop_height)
+  {
+    if (stop && *stop)
+      return true;
+
+    const uint64_t n_ranges = std::min(window, (stop_height - height + m_blocks_per_range - 1) / m_blocks_per_range);
+    std::vector<std::vector<std::unique_ptr<ScanAggregator::Partial>>> partials(n_ranges);
+    std::unique_ptr<bool[]> results(new bool[n_ranges]);
+    tools::threadpool::waiter waiter(tpool);
+    for (uint64_t i = 0; i < n_ranges; ++i)
+    {
+      for (ScanAggregator* aggregator: m_aggregators)
+        partials[i].push_back(aggregator->make_partial());
+      const uint64_t range_start = height + i * m_blocks_per_range;
+      const uint64_t range_end = std::min(range_start + m_blocks_per_range, stop_height);
+      tpool.submit(&waiter, [&, i, range_start, range_end](){
+        try
+        {
+          results[i] = scan_range(range_start, range_end, partials[i]);
+        }
+        catch (const std::exception& e)
+        {
+          MERROR("Error scanning heights " << range_start << "-" << range_end << ": " << e.what());
+          results[i] = false;
+        }
+      }, true);
+    }
+    if (!waiter.wait())
+      return false;
+
+    for (uint64_t i = 0; i < n_ranges; ++i)
+    {
+      if (!results[i])
+        return false;
+      const uint64_t range_end = std::min(height + m_blocks_per_range, stop_height);
+      for (size_t n = 0; n < m_aggregators.size(); ++n)
+        m_aggregators[n]->merge(std::move(partials[i][n]), range_end);
+      height = range_end;
+    }
+    MDEBUG("Scanned up to height " << height);
+  }
+  return true;
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "blockchain_db/blockchain_db.h"
+
+
+// A block and its transactions, deserialized once and shared by every
+// aggregator in a scan
+struct ScannedBlock
+{
+  uint64_t height;
+  cryptonote::block block;
+  size_t block_size;
+  // pruned, in the order of block.tx_hashes
+  std::vector<cryptonote::transaction> txs;
+  // pruned plus prunable size, only filled if an aggregator needs it
+  std::vector<size_t> tx_sizes;
+};
+
+class ScanAggregator
+{
+public:
+  // Results for one range of heights, filled from a worker thread
+  class Partial
+  {
+  public:
+    virtual ~Partial() {}
+    // called for each block of the range, in height order
+    virtual bool add_block(const ScannedBlock& b) = 0;
+  };
+
+  virtual ~ScanAggregator() {}
+  virtual std::unique_ptr<Partial> make_partial() = 0;
+  // called on the scanning thread, for consecutive ranges in height order
+  virtual void merge(std::unique_ptr<Partial> partial, uint64_t range_end) = 0;
+  virtual bool needs_tx_sizes() const { return false; }
+};
+
+// Scans a height range once, in parallel: ranges of blocks are read through
+// independent LMDB read txns on the compute threadpool, and each block is
+// deserialized once and passed to every aggregator
+class BlockchainScanner
+{
+public:
+  BlockchainScanner(cryptonote::BlockchainDB& db, uint64_t blocks_per_range = 1000);
+
+  void add(ScanAggregator& aggregator);
+  // scans heights [start_height, stop_height), returns false on error, and
+  // stops after the ranges in progress if stop is set
+  bool scan(uint64_t start_height, uint64_t stop_height, const std::atomic<bool>* stop = NULL);
+
+private:
+  bool scan_range(uint64_t start_height, uint64_t end_height, std::vector<std::unique_ptr<ScanAggregator::Partial>>& partials) const;
+
+  cryptonote::BlockchainDB& m_db;
+  const uint64_t m_blocks_per_range;
+  std::vector<ScanAggregator*> m_aggregators;
+  bool m_need_tx_sizes;
+};
@@ -35,6 +35,7 @@
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_core/blockchain.h"
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_scan.h"
 #include "version.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -44,76 +45,234 @@ namespace po = boost::program_options;
 using namespace epee;
 using namespace cryptonote;
 
-static bool stop_requested = false;
+static std::atomic<bool> stop_requested(false);
 
 static bool do_inputs, do_outputs, do_ringsize, do_hours, do_emission, do_fees, do_diff;
 
-static struct tm prevtm, currtm;
-static uint64_t prevsz, currsz;
-static uint64_t prevtxs, currtxs;
-static uint64_t currblks;
-static uint64_t h;
-static uint64_t totins, totouts, totrings;
-static boost::multiprecision::uint128_t prevemission, prevfees;
-static boost::multiprecision::uint128_t emission, fees;
-static boost::multiprecision::uint128_t totdiff, mindiff, maxdiff;
-
 #define MAX_INOUT	0xffffffff
 #define MAX_RINGS	0xffffffff
 
-static uint32_t minins = MAX_INOUT, maxins;
-static uint32_t minouts = MAX_INOUT, maxouts;
-static uint32_t minrings = MAX_RINGS, maxrings;
-static uint32_t io, tottxs;
-static uint32_t txhr[24];
+struct day_stats
+{
+  struct tm tm; // of the day's first block
+  uint64_t start_height;
+  uint64_t blocks, txs, size;
+  uint64_t totins, totouts, totrings;
+  boost::multiprecision::uint128_t emission, fees;
+  boost::multiprecision::uint128_t totdiff, mindiff, maxdiff;
+  uint32_t minins, maxins;
+  uint32_t minouts, maxouts;
+  uint32_t minrings, maxrings;
+  uint32_t tottxs;
+  uint32_t txhr[24];
+
+  day_stats(const struct tm &tm, uint64_t start_height):
+    tm(tm), start_height(start_height), blocks(0), txs(0), size(0), totins(0), totouts(0), totrings(0),
+    emission(0), fees(0), totdiff(0), mindiff(0), maxdiff(0),
+    minins(MAX_INOUT), maxins(0), minouts(MAX_INOUT), maxouts(0), minrings(MAX_RINGS), maxrings(0), tottxs(0)
+  {
+    memset(txhr, 0, sizeof(txhr));
+  }
+
+  void merge(const day_stats &other)
+  {
+    blocks += other.blocks;
+    txs += other.txs;
+    size += other.size;
+    totins += other.totins;
+    totouts += other.totouts;
+    totrings += other.totrings;
+    emission += other.emission;
+    fees += other.fees;
+    totdiff += other.totdiff;
+    if (other.maxdiff && (!mindiff || other.mindiff < mindiff))
+      mindiff = other.mindiff;
+    maxdiff = std::max(maxdiff, other.maxdiff);
+    minins = std::min(minins, other.minins);
+    maxins = std::max(maxins, other.maxins);
+    minouts = std::min(minouts, other.minouts);
+    maxouts = std::max(maxouts, other.maxouts);
+    minrings = std::min(minrings, other.minrings);
+    maxrings = std::max(maxrings, other.maxrings);
+    tottxs += other.tottxs;
+    for (int i=0; i<24; i++)
+      txhr[i] += other.txhr[i];
+  }
+};
 
-static void doprint()
+static bool is_new_day(const struct tm &prevtm, const struct tm &currtm)
+{
+  // catch change of day
+  if (currtm.tm_mday > prevtm.tm_mday || (currtm.tm_mday == 1 && prevtm.tm_mday > 27))
+  {
+    // check for timestamp fudging around month ends
+    return !(prevtm.tm_mday == 1 && currtm.tm_mday > 27);
+  }
+  return false;
+}
+
+class StatsAggregator: public ScanAggregator
+{
+public:
+  StatsAggregator(BlockchainDB &db): m_db(db), m_height(0), prevsz(0), prevtxs(0), prevemission(0), prevfees(0) {}
+
+  std::unique_ptr<Partial> make_partial() override { return std::unique_ptr<Partial>(new StatsPartial(m_db)); }
+  void merge(std::unique_ptr<Partial> partial, uint64_t range_end) override;
+  bool needs_tx_sizes() const override { return true; }
+  // prints the last, possibly incomplete, day
+  void finish();
+
+private:
+  class StatsPartial: public Partial
+  {
+  public:
+    StatsPartial(BlockchainDB &db): m_db(db) {}
+    bool add_block(const ScannedBlock &b) override;
+
+    std::vector<day_stats> days;
+
+  private:
+    BlockchainDB &m_db;
+  };
+
+  void doprint(const day_stats &day, uint64_t h);
+
+  BlockchainDB &m_db;
+  std::unique_ptr<day_stats> m_day;
+  uint64_t m_height;
+  uint64_t prevsz, prevtxs;
+  boost::multiprecision::uint128_t prevemission, prevfees;
+};
+
+bool StatsAggregator::StatsPartial::add_block(const ScannedBlock &b)
+{
+  time_t tt = b.block.timestamp;
+  struct tm currtm;
+  epee::misc_utils::get_gmt_time(tt, currtm);
+  if (days.empty() || is_new_day(days.back().tm, currtm))
+    days.emplace_back(currtm, b.height);
+  day_stats &day = days.back();
+
+  day.size += b.block_size;
+  uint64_t coinbase_amount;
+  uint64_t tx_fee_amount = 0;
+  for (size_t i = 0; i < b.txs.size(); ++i)
+  {
+    const transaction &tx = b.txs[i];
+    uint32_t io;
+    day.size += b.tx_sizes[i];
+    day.txs++;
+    if (do_fees || do_emission) {
+      tx_fee_amount += get_tx_fee(tx);
+    }
+    if (do_hours)
+      day.txhr[currtm.tm_hour]++;
+    if (do_inputs) {
+      io = tx.vin.size();
+      if (io < day.minins)
+        day.minins = io;
+      else if (io > day.maxins)
+        day.maxins = io;
+      day.totins += io;
+    }
+    if (do_ringsize) {
+      const cryptonote::txin_to_key& tx_in_to_key
+                     = boost::get<cryptonote::txin_to_key>(tx.vin[0]);
+      io = tx_in_to_key.key_offsets.size();
+      if (io < day.minrings)
+        day.minrings = io;
+      else if (io > day.maxrings)
+        day.maxrings = io;
+      day.totrings += io;
+    }
+    if (do_outputs) {
+      io = tx.vout.size();
+      if (io < day.minouts)
+        day.minouts = io;
+      else if (io > day.maxouts)
+        day.maxouts = io;
+      day.totouts += io;
+    }
+    day.tottxs++;
+  }
+  if (do_diff) {
+    difficulty_type diff = m_db.get_block_difficulty(b.height);
+    if (!day.mindiff || diff < day.mindiff)
+      day.mindiff = diff;
+    if (diff > day.maxdiff)
+      day.maxdiff = diff;
+    day.totdiff += diff;
+  }
+  if (do_emission) {
+    coinbase_amount = get_outs_money_amount(b.block.miner_tx);
+    day.emission += coinbase_amount - tx_fee_amount;
+  }
+  if (do_fees) {
+    day.fees += tx_fee_amount;
+  }
+  day.blocks++;
+  return true;
+}
+
+void StatsAggregator::merge(std::unique_ptr<Partial> partial, uint64_t range_end)
+{
+  StatsPartial &stats = static_cast<StatsPartial&>(*partial);
+  for (const day_stats &day: stats.days)
+  {
+    // the range may have started in the middle of the current day
+    if (m_day && !is_new_day(m_day->tm, day.tm))
+    {
+      m_day->merge(day);
+      continue;
+    }
+    if (m_day)
+      doprint(*m_day, day.start_height);
+    m_day.reset(new day_stats(day));
+  }
+  m_height = range_end;
+}
+
+void StatsAggregator::finish()
+{
+  if (m_day && m_day->blocks)
+    doprint(*m_day, m_height);
+  m_day.reset();
+}
+
+void StatsAggregator::doprint(const day_stats &day, uint64_t h)
 {
   char timebuf[64];
 
-  strftime(timebuf, sizeof(timebuf), "%Y-%m-%d", &prevtm);
-  prevtm = currtm;
-  std::cout << timebuf << "\t" << currblks << "\t" << h << "\t" << currtxs << "\t" << prevtxs + currtxs << "\t" << currsz << "\t" << prevsz + currsz;
-  prevsz += currsz;
-  currsz = 0;
-  prevtxs += currtxs;
-  currtxs = 0;
-  if (!tottxs)
-    tottxs = 1;
+  strftime(timebuf, sizeof(timebuf), "%Y-%m-%d", &day.tm);
+  std::cout << timebuf << "\t" << day.blocks << "\t" << h << "\t" << day.txs << "\t" << prevtxs + day.txs << "\t" << day.size << "\t" << prevsz + day.size;
+  prevsz += day.size;
+  prevtxs += day.txs;
+  const uint32_t tottxs = day.tottxs ? day.tottxs : 1;
   if (do_emission) {
-    std::cout << "\t" << print_money(emission) << "\t" << print_money(prevemission + emission);
-    prevemission += emission;
-    emission = 0;
+    std::cout << "\t" << print_money(day.emission) << "\t" << print_money(prevemission + day.emission);
+    prevemission += day.emission;
   }
   if (do_fees) {
-    std::cout << "\t" << print_money(fees) << "\t" << print_money(prevfees + fees);
-    prevfees += fees;
-    fees = 0;
+    std::cout << "\t" << print_money(day.fees) << "\t" << print_money(prevfees + day.fees);
+    prevfees += day.fees;
   }
   if (do_diff) {
-    std::cout << "\t" << (maxdiff ? mindiff : 0) << "\t" << maxdiff << "\t" << totdiff / currblks;
-    mindiff = 0; maxdiff = 0; totdiff = 0;
+    std::cout << "\t" << (day.maxdiff ? day.mindiff : 0) << "\t" << day.maxdiff << "\t" << day.totdiff / day.blocks;
   }
   if (do_inputs) {
-    std::cout << "\t" << (maxins ? minins : 0) << "\t" << maxins << "\t" << totins * 1.0 / tottxs;
-    minins = MAX_INOUT; maxins = 0; totins = 0;
+    std::cout << "\t" << (day.maxins ? day.minins : 0) << "\t" << day.maxins << "\t" << day.totins * 1.0 / tottxs;
   }
   if (do_outputs) {
-    std::cout << "\t" << (maxouts ? minouts : 0) << "\t" << maxouts << "\t" << totouts * 1.0 / tottxs;
-    minouts = MAX_INOUT; maxouts = 0; totouts = 0;
+    std::cout << "\t" << (day.maxouts ? day.minouts : 0) << "\t" << day.maxouts << "\t" << day.totouts * 1.0 / tottxs;
   }
   if (do_ringsize) {
-    std::cout << "\t" << (maxrings ? minrings : 0) << "\t" << maxrings << "\t" << totrings * 1.0 / tottxs;
-    minrings = MAX_RINGS; maxrings = 0; totrings = 0;
+    std::cout << "\t" << (day.maxrings ? day.minrings : 0) << "\t" << day.maxrings << "\t" << day.totrings * 1.0 / tottxs;
   }
   if (do_hours) {
     for (int i=0; i<24; i++) {
-      std::cout << "\t" << txhr[i];
-      txhr[i] = 0;
+      std::cout << "\t" << day.txhr[i];
     }
   }
-  currblks = 0;
-  tottxs = 0;
   std::cout << ENDL;
 }
 
@@ -282,104 +441,15 @@ plot 'stats.csv' index "DATA" using (timecolumn(1,"%Y-%m-%d")):4 with lines, ''
   }
   std::cout << ENDL;
 
-  for (h = block_start; h < block_stop; ++h)
+  StatsAggregator stats(*db);
+  BlockchainScanner scanner(*db);
+  scanner.add(stats);
+  if (!scanner.scan(block_start, block_stop, &stop_requested))
   {
-    cryptonote::blobdata bd = db->get_block_blob_from_height(h);
-    cryptonote::block blk;
-    if (!cryptonote::parse_and_validate_block_from_blob(bd, blk))
-    {
-      LOG_PRINT_L0("Bad block from db");
-      return 1;
-    }
-    time_t tt = blk.timestamp;
-    epee::misc_utils::get_gmt_time(tt, currtm);
-    if (!prevtm.tm_year)
-      prevtm = currtm;
-    // catch change of day
-    if (currtm.tm_mday > prevtm.tm_mday || (currtm.tm_mday == 1 && prevtm.tm_mday > 27))
-    {
-      // check for timestamp fudging around month ends
-      if (!(prevtm.tm_mday == 1 && currtm.tm_mday > 27))
-        doprint();
-    }
-    currsz += bd.size();
-    uint64_t coinbase_amount;
-    uint64_t tx_fee_amount = 0;
-    for (const auto& tx_id : blk.tx_hashes)
-    {
-      if (tx_id == crypto::null_hash)
-      {
-        throw std::runtime_error("Aborting: tx == null_hash");
-      }
-      if (!db->get_pruned_tx_blob(tx_id, bd))
-      {
-        throw std::runtime_error("Aborting: tx not found");
-      }
-      transaction tx;
-      if (!parse_and_validate_tx_base_from_blob(bd, tx))
-      {
-        LOG_PRINT_L0("Bad txn from db");
-        return 1;
-      }
-      currsz += bd.size();
-      if (db->get_prunable_tx_blob(tx_id, bd))
-        currsz += bd.size();
-      currtxs++;
-      if (do_fees || do_emission) {
-        tx_fee_amount += get_tx_fee(tx);
-      }
-      if (do_hours)
-        txhr[currtm.tm_hour]++;
-      if (do_inputs) {
-        io = tx.vin.size();
-        if (io < minins)
-          minins = io;
-        else if (io > maxins)
-          maxins = io;
-        totins += io;
-      }
-      if (do_ringsize) {
-        const cryptonote::txin_to_key& tx_in_to_key
-                       = boost::get<cryptonote::txin_to_key>(tx.vin[0]);
-        io = tx_in_to_key.key_offsets.size();
-        if (io < minrings)
-          minrings = io;
-        else if (io > maxrings)
-          maxrings = io;
-        totrings += io;
-      }
-      if (do_outputs) {
-        io = tx.vout.size();
-        if (io < minouts)
-          minouts = io;
-        else if (io > maxouts)
-          maxouts = io;
-        totouts += io;
-      }
-      tottxs++;
-    }
-    if (do_diff) {
-      difficulty_type diff = db->get_block_difficulty(h);
-      if (!mindiff || diff < mindiff)
-        mindiff = diff;
-      if (diff > maxdiff)
-        maxdiff = diff;
-      totdiff += diff;
-    }
-    if (do_emission) {
-      coinbase_amount = get_outs_money_amount(blk.miner_tx);
-      emission += coinbase_amount - tx_fee_amount;
-    }
-    if (do_fees) {
-      fees += tx_fee_amount;
-    }
-    currblks++;
-
-    if (stop_requested)
-      break;
+    LOG_PRINT_L0("Error scanning blockchain");
+    return 1;
   }
-  if (currblks)
-    doprint();
+  stats.finish();
 
   core_storage->deinit();
   return 0;
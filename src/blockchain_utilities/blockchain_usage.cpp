@@ -35,6 +35,7 @@
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_core/blockchain.h"
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_scan.h"
 #include "version.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -76,6 +77,95 @@ struct reference
   reference(uint64_t h, uint64_t rs, uint64_t p): height(h), ring_size(rs), position(p) {}
 };
 
+class UsageAggregator: public ScanAggregator
+{
+public:
+  UsageAggregator(bool rct_only): m_rct_only(rct_only) {}
+
+  std::unique_ptr<Partial> make_partial() override { return std::unique_ptr<Partial>(new UsagePartial(m_rct_only)); }
+  void merge(std::unique_ptr<Partial> partial, uint64_t range_end) override;
+
+  std::unordered_map<output_data, std::list<reference>> outputs;
+
+private:
+  // outputs are numbered per amount from the start of the range, and
+  // renumbered when merged
+  class UsagePartial: public Partial
+  {
+  public:
+    UsagePartial(bool rct_only): m_rct_only(rct_only) {}
+    bool add_block(const ScannedBlock &b) override;
+
+    std::vector<output_data> new_outputs;
+    std::vector<std::pair<output_data, reference>> references;
+    std::unordered_map<uint64_t,uint64_t> indices;
+
+  private:
+    void add_tx(const cryptonote::transaction &tx, uint64_t height);
+
+    const bool m_rct_only;
+  };
+
+  const bool m_rct_only;
+  std::unordered_map<uint64_t,uint64_t> m_indices;
+};
+
+bool UsageAggregator::UsagePartial::add_block(const ScannedBlock &b)
+{
+  add_tx(b.block.miner_tx, b.height);
+  for (const auto &tx: b.txs)
+    add_tx(tx, b.height);
+  return true;
+}
+
+void UsageAggregator::UsagePartial::add_tx(const cryptonote::transaction &tx, uint64_t height)
+{
+  const bool coinbase = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
+
+  // create new outputs
+  for (const auto &out: tx.vout)
+  {
+    if (m_rct_only && out.amount)
+      continue;
+    indices[out.amount]++;
+    new_outputs.push_back(output_data(out.amount, indices[out.amount], coinbase, height));
+  }
+
+  for (const auto &in: tx.vin)
+  {
+    if (in.type() != typeid(txin_to_key))
+      continue;
+    const auto &txin = boost::get<txin_to_key>(in);
+    if (m_rct_only && txin.amount != 0)
+      continue;
+
+    const std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
+    for (size_t n = 0; n < txin.key_offsets.size(); ++n)
+    {
+      output_data od(txin.amount, absolute[n], coinbase, height);
+      references.push_back(std::make_pair(od, reference(height, txin.key_offsets.size(), n)));
+    }
+  }
+}
+
+void UsageAggregator::merge(std::unique_ptr<Partial> partial, uint64_t range_end)
+{
+  UsagePartial &usage = static_cast<UsagePartial&>(*partial);
+  for (output_data &od: usage.new_outputs)
+  {
+    od.index += m_indices[od.amount];
+    auto itb = outputs.emplace(od, std::list<reference>());
+    itb.first->first.info(od.coinbase, od.height);
+  }
+  for (const auto &i: usage.indices)
+    m_indices[i.first] += i.second;
+
+  // rings only reference outputs created before them, so adding these after
+  // the range's new outputs gives the same result as a serial pass
+  for (const auto &r: usage.references)
+    outputs[r.first].push_back(r.second);
+}
+
 int main(int argc, char* argv[])
 {
   TRY_ENTRY();
@@ -181,43 +271,17 @@ int main(int argc, char* argv[])
 
   LOG_PRINT_L0("Building usage patterns...");
 
-  std::unordered_map<output_data, std::list<reference>> outputs;
-  std::unordered_map<uint64_t,uint64_t> indices;
+  UsageAggregator usage(opt_rct_only);
+  BlockchainScanner scanner(*db);
+  scanner.add(usage);
 
   LOG_PRINT_L0("Reading blockchain from " << input);
-  core_storage->for_all_transactions([&](const crypto::hash &hash, const cryptonote::transaction &tx)->bool
+  if (!scanner.scan(0, db->height()))
   {
-    const bool coinbase = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
-    const uint64_t height = core_storage->get_db().get_tx_block_height(hash);
-
-    // create new outputs
-    for (const auto &out: tx.vout)
-    {
-      if (opt_rct_only && out.amount)
-        continue;
-      indices[out.amount]++;
-      output_data od(out.amount, indices[out.amount], coinbase, height);
-      auto itb = outputs.emplace(od, std::list<reference>());
-      itb.first->first.info(coinbase, height);
-    }
-
-    for (const auto &in: tx.vin)
-    {
-      if (in.type() != typeid(txin_to_key))
-        continue;
-      const auto &txin = boost::get<txin_to_key>(in);
-      if (opt_rct_only && txin.amount != 0)
-        continue;
-
-      const std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
-      for (size_t n = 0; n < txin.key_offsets.size(); ++n)
-      {
-        output_data od(txin.amount, absolute[n], coinbase, height);
-        outputs[od].push_back(reference(height, txin.key_offsets.size(), n));
-      }
-    }
-    return true;
-  }, true);
+    LOG_PRINT_L0("Error scanning blockchain");
+    return 1;
+  }
+  const std::unordered_map<output_data, std::list<reference>> &outputs = usage.outputs;
 
   std::unordered_map<uint64_t, uint64_t> counts;
   size_t total = 0;
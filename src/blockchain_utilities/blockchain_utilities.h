@@ -36,5 +36,8 @@
 #define BUFFER_SIZE (2 * 1024 * 1024)
 #define CHUNK_SIZE_WARNING_THRESHOLD 500000
 #define NUM_BLOCKS_PER_CHUNK 1
+// version 2 (indexed) files store several blocks per chunk
+#define NUM_BLOCKS_PER_CHUNK_V2 100
+#define MAX_BLOCKS_PER_CHUNK_V2 1000
 #define BLOCKCHAIN_RAW "blockchain.raw"
 
@@ -29,9 +29,14 @@
 #include "bootstrap_serialization.h"
 #include "serialization/binary_utils.h" // dump_binary(), parse_binary()
 #include "serialization/json_utils.h" // dump_json()
+#include "common/threadpool.h"
 
 #include "bootstrap_file.h"
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "bcutil"
 
@@ -47,12 +52,42 @@ namespace
   const uint32_t blockchain_raw_magic = 0x28721586;
   const uint32_t header_size = 1024;
 
+  // the chunk index is one varint per chunk, so this covers far more blocks
+  // than any chain will have
+  const uint32_t max_chunk_index_size = 64 * 1024 * 1024;
+
+#ifdef HAVE_ZSTD
+  const int zstd_compression_level = 9;
+
+  std::string compress_data(const std::string& data)
+  {
+    std::string out(ZSTD_compressBound(data.size()), '\0');
+    const size_t size = ZSTD_compress(&out[0], out.size(), data.data(), data.size(), zstd_compression_level);
+    if (ZSTD_isError(size))
+      throw std::runtime_error(std::string("Error compressing chunk: ") + ZSTD_getErrorName(size));
+    out.resize(size);
+    return out;
+  }
+
+  bool decompress_data(const std::string& data, uint64_t size, std::string& out)
+  {
+    out.resize(size);
+    const size_t ret = ZSTD_decompress(&out[0], out.size(), data.data(), data.size());
+    if (ZSTD_isError(ret))
+    {
+      MERROR("Error decompressing chunk: " << ZSTD_getErrorName(ret));
+      return false;
+    }
+    return ret == size;
+  }
+#endif
+
   std::string refresh_string = "\r                                    \r";
 }
 
 
 
-bool BootstrapFile::open_writer(const boost::filesystem::path& file_path, uint64_t start_block, uint64_t stop_block)
+bool BootstrapFile::open_writer(const boost::filesystem::path& file_path, uint64_t start_block, uint64_t stop_block, uint8_t major_version)
 {
   const boost::filesystem::path dir_path = file_path.parent_path();
   if (!dir_path.empty())
@@ -108,12 +143,12 @@ bool BootstrapFile::open_writer(const boost::filesystem::path& file_path, uint64
     return false;
 
   if (do_initialize_file)
-    initialize_file(start_block, stop_block);
+    initialize_file(start_block, stop_block, major_version);
 
   return true;
 }
 
-bool BootstrapFile::initialize_file(uint64_t first_block, uint64_t last_block)
+bool BootstrapFile::initialize_file(uint64_t first_block, uint64_t last_block, uint8_t major_version, uint64_t block_last_pos)
 {
   const uint32_t file_magic = blockchain_raw_magic;
 
@@ -125,14 +160,14 @@ bool BootstrapFile::initialize_file(uint64_t first_block, uint64_t last_block)
   *m_raw_data_file << blob;
 
   bootstrap::file_info bfi;
-  bfi.major_version = 1;
+  bfi.major_version = major_version;
   bfi.minor_version = 0;
   bfi.header_size = header_size;
 
   bootstrap::blocks_info bbi;
   bbi.block_first = first_block;
   bbi.block_last = last_block;
-  bbi.block_last_pos = 0;
+  bbi.block_last_pos = block_last_pos;
 
   buffer_type buffer2;
   boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>> output_stream_header(buffer2);
@@ -180,6 +215,16 @@ void BootstrapFile::flush_chunk()
     MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
   }
 
+  write_chunk(m_buffer.data(), chunk_size);
+
+  m_buffer.clear();
+  delete m_output_stream;
+  m_output_stream = new boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>(m_buffer);
+  MDEBUG("flushed chunk:  chunk_size: " << chunk_size);
+}
+
+void BootstrapFile::write_chunk(const char* data, uint32_t chunk_size)
+{
   std::string blob;
   if (! ::serialization::dump_binary(chunk_size, blob))
   {
@@ -192,7 +237,7 @@ void BootstrapFile::flush_chunk()
     m_max_chunk = chunk_size;
   }
   long pos_before = m_raw_data_file->tellp();
-  std::copy(m_buffer.begin(), m_buffer.end(), std::ostreambuf_iterator<char>(*m_raw_data_file));
+  m_raw_data_file->write(data, chunk_size);
   m_raw_data_file->flush();
   long pos_after = m_raw_data_file->tellp();
   long num_chars_written = pos_after - pos_before;
@@ -201,14 +246,9 @@ void BootstrapFile::flush_chunk()
     MFATAL("Error writing chunk:  height: " << m_cur_height << "  chunk_size: " << chunk_size << "  num chars written: " << num_chars_written);
     throw std::runtime_error("Error writing chunk");
   }
-
-  m_buffer.clear();
-  delete m_output_stream;
-  m_output_stream = new boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>(m_buffer);
-  MDEBUG("flushed chunk:  chunk_size: " << chunk_size);
 }
 
-void BootstrapFile::write_block(block& block)
+bootstrap::block_package BootstrapFile::make_block_package(const block& block) const
 {
   bootstrap::block_package bp;
   bp.block = block;
@@ -225,7 +265,7 @@ void BootstrapFile::write_block(block& block)
     {
       throw std::runtime_error("Aborting: tx == null_hash");
     }
-    transaction tx = m_blockchain_storage->get_db().get_tx(tx_id);
+    const transaction tx = m_blockchain_storage->get_db().get_tx(tx_id);
 
     txs.push_back(tx);
   }
@@ -246,10 +286,153 @@ void BootstrapFile::write_block(block& block)
     bp.coins_generated = coins_generated;
   }
 
+  return bp;
+}
+
+void BootstrapFile::write_block(block& block)
+{
+  bootstrap::block_package bp = make_block_package(block);
   blobdata bd = t_serializable_object_to_blob(bp);
   m_output_stream->write((const char*)bd.data(), bd.size());
 }
 
+std::string BootstrapFile::make_chunk(uint64_t first_height, uint64_t num_blocks, bool compress) const
+{
+  bootstrap::block_packages packages;
+  packages.blocks.reserve(num_blocks);
+  for (uint64_t height = first_height; height < first_height + num_blocks; ++height)
+    packages.blocks.push_back(make_block_package(m_blockchain_storage->get_db().get_block_from_height(height)));
+
+  std::string data;
+  if (! ::serialization::dump_binary(packages, data))
+    throw std::runtime_error("Error in serialization of chunk blocks");
+
+  bootstrap::chunk_package cp;
+  cp.block_count = num_blocks;
+  cp.data_size = data.size();
+#ifdef HAVE_ZSTD
+  if (compress)
+  {
+    cp.compression = bootstrap::compression_zstd;
+    cp.data = compress_data(data);
+  }
+  else
+#endif
+  {
+    if (compress)
+      throw std::runtime_error("Compression requested, but built without zstd");
+    cp.compression = bootstrap::compression_none;
+    cp.data = std::move(data);
+  }
+
+  std::string blob;
+  if (! ::serialization::dump_binary(cp, blob))
+    throw std::runtime_error("Error in serialization of chunk");
+  return blob;
+}
+
+bool BootstrapFile::read_chunk(std::ifstream& import_file, uint64_t chunks_end, uint64_t blocks_per_chunk, std::string& chunk)
+{
+  if (chunks_end && (uint64_t)import_file.tellg() >= chunks_end)
+  {
+    MINFO("End of chunks reached");
+    return false;
+  }
+
+  uint32_t chunk_size;
+  std::string str1(sizeof(chunk_size), '\0');
+  import_file.read(&str1[0], sizeof(chunk_size));
+  if (! import_file) {
+    MINFO("End of file reached");
+    return false;
+  }
+  if (! ::serialization::parse_binary(str1, chunk_size))
+    throw std::runtime_error("Error in deserialization of chunk size");
+  MDEBUG("chunk_size: " << chunk_size);
+
+  if (chunk_size > blocks_per_chunk * BUFFER_SIZE)
+  {
+    MWARNING("WARNING: chunk_size " << chunk_size << " > " << blocks_per_chunk * BUFFER_SIZE);
+    throw std::runtime_error("Aborting: chunk size exceeds buffer size");
+  }
+  if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD * blocks_per_chunk)
+  {
+    MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD * blocks_per_chunk);
+  }
+  else if (chunk_size == 0)
+    throw std::runtime_error("chunk_size == 0");
+  if (chunks_end && (uint64_t)import_file.tellg() + chunk_size > chunks_end)
+    throw std::runtime_error("chunk overlaps the chunk index");
+
+  chunk.resize(chunk_size);
+  import_file.read(&chunk[0], chunk_size);
+  if (! import_file) {
+    if (import_file.eof())
+    {
+      MINFO("End of file reached - file was truncated");
+      return false;
+    }
+    throw std::runtime_error("unexpected end of file: bytes read before error: "
+        + std::to_string(import_file.gcount()) + " of chunk_size " + std::to_string(chunk_size));
+  }
+  return true;
+}
+
+bool BootstrapFile::parse_chunk(const std::string& chunk, std::vector<bootstrap::block_package>& blocks)
+{
+  bootstrap::chunk_package cp;
+  if (! ::serialization::parse_binary(chunk, cp))
+  {
+    MERROR("Error in deserialization of chunk");
+    return false;
+  }
+  if (cp.block_count == 0 || cp.block_count > MAX_BLOCKS_PER_CHUNK_V2 || cp.data_size > cp.block_count * BUFFER_SIZE)
+  {
+    MERROR("Invalid chunk: " << cp.block_count << " blocks, " << cp.data_size << " bytes");
+    return false;
+  }
+
+  std::string data;
+  switch (cp.compression)
+  {
+    case bootstrap::compression_none:
+      data = std::move(cp.data);
+      break;
+#ifdef HAVE_ZSTD
+    case bootstrap::compression_zstd:
+      if (!decompress_data(cp.data, cp.data_size, data))
+        return false;
+      break;
+#endif
+    default:
+      MERROR("Unsupported chunk compression: " << unsigned(cp.compression));
+      return false;
+  }
+  if (data.size() != cp.data_size)
+  {
+    MERROR("Chunk size mismatch: expected " << cp.data_size << ", got " << data.size());
+    return false;
+  }
+
+  bootstrap::block_packages packages;
+  if (! ::serialization::parse_binary(data, packages) || packages.blocks.size() != cp.block_count)
+  {
+    MERROR("Error in deserialization of chunk blocks");
+    return false;
+  }
+  blocks = std::move(packages.blocks);
+  return true;
+}
+
+bool BootstrapFile::can_compress()
+{
+#ifdef HAVE_ZSTD
+  return true;
+#else
+  return false;
+#endif
+}
+
 bool BootstrapFile::close()
 {
   if (m_raw_data_file->fail())
@@ -262,19 +445,8 @@ bool BootstrapFile::close()
 }
 
 
-bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_memory_pool* _tx_pool, boost::filesystem::path& output_file, uint64_t start_block, uint64_t requested_block_stop)
+uint64_t BootstrapFile::get_block_stop(uint64_t requested_block_stop)
 {
-  uint64_t num_blocks_written = 0;
-  m_max_chunk = 0;
-  m_blockchain_storage = _blockchain_storage;
-  m_tx_pool = _tx_pool;
-  uint64_t progress_interval = 100;
-  MINFO("Storing blocks raw data...");
-  block b;
-
-  // block_start, block_stop use 0-based height. m_height uses 1-based height. So to resume export
-  // from last exported block, block_start doesn't need to add 1 here, as it's already at the next
-  // height.
   uint64_t block_stop = 0;
   MINFO("source blockchain height: " <<  m_blockchain_storage->get_current_blockchain_height()-1);
   if ((requested_block_stop > 0) && (requested_block_stop < m_blockchain_storage->get_current_blockchain_height()))
@@ -287,6 +459,23 @@ bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_mem
     block_stop = m_blockchain_storage->get_current_blockchain_height() - 1;
     MINFO("Using block height of source blockchain: " << block_stop);
   }
+  return block_stop;
+}
+
+bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_memory_pool* _tx_pool, boost::filesystem::path& output_file, uint64_t start_block, uint64_t requested_block_stop)
+{
+  uint64_t num_blocks_written = 0;
+  m_max_chunk = 0;
+  m_blockchain_storage = _blockchain_storage;
+  m_tx_pool = _tx_pool;
+  uint64_t progress_interval = 100;
+  MINFO("Storing blocks raw data...");
+  block b;
+
+  // block_start, block_stop use 0-based height. m_height uses 1-based height. So to resume export
+  // from last exported block, block_start doesn't need to add 1 here, as it's already at the next
+  // height.
+  uint64_t block_stop = get_block_stop(requested_block_stop);
   if (!BootstrapFile::open_writer(output_file, start_block, block_stop))
   {
     MFATAL("failed to open raw file for write");
@@ -325,8 +514,110 @@ bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_mem
   return BootstrapFile::close();
 }
 
+bool BootstrapFile::store_blockchain_indexed(Blockchain* _blockchain_storage, boost::filesystem::path& output_file, uint64_t start_block, uint64_t requested_block_stop, bool compress)
+{
+  m_max_chunk = 0;
+  m_blockchain_storage = _blockchain_storage;
+  m_tx_pool = NULL;
+  MINFO("Storing blocks raw data, indexed" << (compress ? " and compressed" : "") << "...");
+  if (compress && !can_compress())
+  {
+    MFATAL("Compression requested, but built without zstd");
+    return false;
+  }
+
+  uint64_t block_stop = get_block_stop(requested_block_stop);
+  if (start_block > block_stop)
+  {
+    MFATAL("Start block " << start_block << " is past stop block " << block_stop);
+    return false;
+  }
+  // chunks are laid out from the first block, so an indexed file can't be appended to
+  if (boost::filesystem::exists(output_file))
+  {
+    MFATAL("Output file already exists: " << output_file);
+    return false;
+  }
+  if (!BootstrapFile::open_writer(output_file, start_block, block_stop, 2))
+  {
+    MFATAL("failed to open raw file for write");
+    return false;
+  }
+  MINFO("Starting block height: " << start_block);
+
+  bootstrap::chunk_index index;
+  index.blocks_per_chunk = NUM_BLOCKS_PER_CHUNK_V2;
+  const uint64_t num_chunks = (block_stop - start_block) / index.blocks_per_chunk + 1;
+  index.offsets.reserve(num_chunks);
+
+  // each worker reads its blocks through its own LMDB read txn, while
+  // finished chunks are written out in order here
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  const uint64_t window = 2 * std::max(tpool.get_max_concurrency(), 1u);
+  std::vector<std::string> chunks;
+  for (uint64_t first_chunk = 0; first_chunk < num_chunks; first_chunk += window)
+  {
+    const uint64_t n_chunks = std::min(window, num_chunks - first_chunk);
+    chunks.assign(n_chunks, std::string());
+    std::atomic<bool> failed(false);
+    tools::threadpool::waiter waiter(tpool);
+    for (uint64_t i = 0; i < n_chunks; ++i)
+    {
+      tpool.submit(&waiter, [&, i](){
+        const uint64_t height = start_block + (first_chunk + i) * index.blocks_per_chunk;
+        try
+        {
+          chunks[i] = make_chunk(height, std::min(index.blocks_per_chunk, block_stop + 1 - height), compress);
+        }
+        catch (const std::exception& e)
+        {
+          MERROR("Error exporting chunk at height " << height << ": " << e.what());
+          failed = true;
+        }
+      }, true);
+    }
+    if (!waiter.wait() || failed)
+    {
+      BootstrapFile::close();
+      return false;
+    }
+
+    for (const std::string& chunk: chunks)
+    {
+      index.offsets.push_back(m_raw_data_file->tellp());
+      write_chunk(chunk.data(), chunk.size());
+    }
+    m_cur_height = std::min(start_block + (first_chunk + n_chunks) * index.blocks_per_chunk, block_stop + 1);
+    std::cout << refresh_string;
+    std::cout << "block " << m_cur_height-1 << "/" << block_stop << "\r" << std::flush;
+  }
+  std::cout << refresh_string;
+  std::cout << "block " << m_cur_height-1 << "/" << block_stop << ENDL;
+
+  const uint64_t index_pos = m_raw_data_file->tellp();
+  std::string blob;
+  if (! ::serialization::dump_binary(index, blob))
+    throw std::runtime_error("Error in serialization of chunk index");
+  uint32_t index_size = blob.size();
+  std::string size_blob;
+  if (! ::serialization::dump_binary(index_size, size_blob))
+    throw std::runtime_error("Error in serialization of chunk index size");
+  *m_raw_data_file << size_blob << blob;
+
+  // the index position goes in the header, so readers can find it without
+  // scanning, and a file with no index was not completely written
+  m_raw_data_file->seekp(0);
+  initialize_file(start_block, block_stop, 2, index_pos);
+
+  MINFO("Number of blocks exported: " << block_stop + 1 - start_block);
+  MINFO("Number of chunks: " << num_chunks << ", index size: " << index_size << " bytes");
+  MINFO("Largest chunk: " << m_max_chunk << " bytes");
+
+  return BootstrapFile::close();
+}
+
 uint64_t BootstrapFile::seek_to_first_chunk(std::ifstream& import_file, uint8_t &major_version, uint8_t &minor_version,
-	uint64_t &block_first, uint64_t &block_last)
+	uint64_t &block_first, uint64_t &block_last, uint64_t &block_last_pos)
 {
   uint32_t file_magic;
 
@@ -400,9 +691,60 @@ uint64_t BootstrapFile::seek_to_first_chunk(std::ifstream& import_file, uint8_t
   minor_version = bfi.minor_version;
   block_first = bbi.block_first;
   block_last = bbi.block_last;
+  block_last_pos = bbi.block_last_pos;
   return full_header_size;
 }
 
+bool BootstrapFile::read_chunk_index(std::ifstream& import_file, uint64_t index_pos, bootstrap::chunk_index& index)
+{
+  if (index_pos == 0)
+  {
+    MFATAL("bootstrap file has no chunk index, it was not completely written");
+    return false;
+  }
+
+  const std::streampos pos = import_file.tellg();
+  import_file.seekg(index_pos);
+
+  uint32_t index_size;
+  std::string str1(sizeof(index_size), '\0');
+  import_file.read(&str1[0], sizeof(index_size));
+  if (! import_file || ! ::serialization::parse_binary(str1, index_size))
+  {
+    MFATAL("Error reading chunk index size");
+    return false;
+  }
+  if (index_size > max_chunk_index_size)
+  {
+    MFATAL("Chunk index size " << index_size << " exceeds " << max_chunk_index_size);
+    return false;
+  }
+  str1.resize(index_size);
+  import_file.read(&str1[0], index_size);
+  if (! import_file || ! ::serialization::parse_binary(str1, index))
+  {
+    MFATAL("Error reading chunk index");
+    return false;
+  }
+
+  if (index.blocks_per_chunk == 0 || index.blocks_per_chunk > MAX_BLOCKS_PER_CHUNK_V2)
+  {
+    MFATAL("Invalid number of blocks per chunk: " << index.blocks_per_chunk);
+    return false;
+  }
+  for (size_t i = 0; i < index.offsets.size(); ++i)
+  {
+    if (index.offsets[i] >= index_pos || (i > 0 && index.offsets[i] <= index.offsets[i - 1]))
+    {
+      MFATAL("Invalid chunk offset in index: " << index.offsets[i]);
+      return false;
+    }
+  }
+
+  import_file.seekg(pos);
+  return true;
+}
+
 uint64_t BootstrapFile::count_bytes(std::ifstream& import_file, uint64_t blocks, uint64_t& h, bool& quit)
 {
   uint64_t bytes_read = 0;
@@ -492,8 +834,29 @@ uint64_t BootstrapFile::count_blocks(const std::string& import_file_path, std::s
 
   uint64_t full_header_size; // 4 byte magic + length of header structures
   uint8_t major_version, minor_version;
-  uint64_t block_last;
-  full_header_size = seek_to_first_chunk(import_file, major_version, minor_version, block_first, block_last);
+  uint64_t block_last, block_last_pos;
+  full_header_size = seek_to_first_chunk(import_file, major_version, minor_version, block_first, block_last, block_last_pos);
+
+  if (major_version >= 2)
+  {
+    // indexed files locate the starting chunk without scanning
+    bootstrap::chunk_index index;
+    if (!read_chunk_index(import_file, block_last_pos, index) || index.offsets.empty())
+      throw std::runtime_error("Aborting");
+    h = std::min<uint64_t>(index.offsets.size() * index.blocks_per_chunk, block_last - block_first + 1);
+    if (start_height)
+    {
+      const uint64_t chunk = std::min<uint64_t>((start_height - std::min(start_height, block_first)) / index.blocks_per_chunk, index.offsets.size() - 1);
+      start_pos = index.offsets[chunk];
+      seek_height = block_first + chunk * index.blocks_per_chunk;
+    }
+    import_file.close();
+
+    std::cout << "Number of chunks: " << index.offsets.size() << ", " << index.blocks_per_chunk << " blocks per chunk" << ENDL;
+    std::cout << "Number of blocks: " << h << ENDL;
+    std::cout << ENDL;
+    return h;
+  }
 
   MINFO("Scanning blockchain from bootstrap file...");
   bool quit = false;
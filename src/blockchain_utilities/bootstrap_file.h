@@ -47,6 +47,7 @@
 #include "version.h"
 
 #include "blockchain_utilities.h"
+#include "bootstrap_serialization.h"
 
 
 using namespace cryptonote;
@@ -59,10 +60,22 @@ public:
   uint64_t count_bytes(std::ifstream& import_file, uint64_t blocks, uint64_t& h, bool& quit);
   uint64_t count_blocks(const std::string& dir_path, std::streampos& start_pos, uint64_t& seek_height, uint64_t& block_first);
   uint64_t count_blocks(const std::string& dir_path);
-  uint64_t seek_to_first_chunk(std::ifstream& import_file, uint8_t &major_version, uint8_t &minor_version, uint64_t &block_first, uint64_t &block_last);
+  uint64_t seek_to_first_chunk(std::ifstream& import_file, uint8_t &major_version, uint8_t &minor_version, uint64_t &block_first, uint64_t &block_last, uint64_t &block_last_pos);
+  bool read_chunk_index(std::ifstream& import_file, uint64_t index_pos, bootstrap::chunk_index& index);
 
   bool store_blockchain_raw(cryptonote::Blockchain* cs, cryptonote::tx_memory_pool* txp,
       boost::filesystem::path& output_file, uint64_t start_block=0, uint64_t stop_block=0);
+  // exports to the version 2 format, building chunks in parallel
+  bool store_blockchain_indexed(cryptonote::Blockchain* cs, boost::filesystem::path& output_file,
+      uint64_t start_block=0, uint64_t stop_block=0, bool compress=false);
+
+  // reads the next chunk, stopping at chunks_end (the chunk index of a
+  // version 2 file, or 0 to read to the end of the file); returns false once
+  // there are no more chunks
+  static bool read_chunk(std::ifstream& import_file, uint64_t chunks_end, uint64_t blocks_per_chunk, std::string& chunk);
+  // decodes a version 2 chunk into its blocks
+  static bool parse_chunk(const std::string& chunk, std::vector<bootstrap::block_package>& blocks);
+  static bool can_compress();
 
 protected:
 
@@ -75,10 +88,14 @@ protected:
   boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>* m_output_stream;
 
   // open export file for write
-  bool open_writer(const boost::filesystem::path& file_path, uint64_t start_block, uint64_t stop_block);
-  bool initialize_file(uint64_t start_block, uint64_t stop_block);
+  bool open_writer(const boost::filesystem::path& file_path, uint64_t start_block, uint64_t stop_block, uint8_t major_version = 1);
+  bool initialize_file(uint64_t start_block, uint64_t stop_block, uint8_t major_version = 1, uint64_t block_last_pos = 0);
   bool close();
+  uint64_t get_block_stop(uint64_t requested_block_stop);
+  bootstrap::block_package make_block_package(const block& block) const;
+  std::string make_chunk(uint64_t first_height, uint64_t num_blocks, bool compress) const;
   void write_block(block& block);
+  void write_chunk(const char* data, uint32_t chunk_size);
   void flush_chunk();
 
 private:
@@ -30,6 +30,7 @@
 
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
 #include "serialization/difficulty_type.h"
+#include "serialization/string.h"
 
 
 namespace cryptonote
@@ -100,6 +101,54 @@ namespace cryptonote
       END_SERIALIZE()
     };
 
+    // version 2 files group blocks into independently decodable chunks,
+    // each optionally compressed
+    enum chunk_compression : uint8_t
+    {
+      compression_none = 0,
+      compression_zstd = 1,
+    };
+
+    struct block_packages
+    {
+      std::vector<block_package> blocks;
+
+      BEGIN_SERIALIZE()
+        FIELD(blocks)
+      END_SERIALIZE()
+    };
+
+    struct chunk_package
+    {
+      uint8_t compression;
+      uint64_t block_count;
+      // size of the serialized block_packages, before compression
+      uint64_t data_size;
+      std::string data;
+
+      BEGIN_SERIALIZE()
+        FIELD(compression)
+        VARINT_FIELD(block_count)
+        VARINT_FIELD(data_size)
+        FIELD(data)
+      END_SERIALIZE()
+    };
+
+    // written after the last chunk of a version 2 file, at the position
+    // stored in blocks_info::block_last_pos
+    struct chunk_index
+    {
+      uint64_t blocks_per_chunk;
+      // file position of each chunk's size field, chunk i starting at
+      // height block_first + i * blocks_per_chunk
+      std::vector<uint64_t> offsets;
+
+      BEGIN_SERIALIZE_OBJECT()
+        VARINT_FIELD(blocks_per_chunk)
+        FIELD(offsets)
+      END_SERIALIZE()
+    };
+
   }
 
 }
@@ -0,0 +1,286 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "metrics.h"
+
+namespace
+{
+  enum class metric_type { counter, histogram, callback };
+
+  struct callback_t
+  {
+    bool monotonic;
+    std::function<double()> f;
+  };
+
+  struct family_t
+  {
+    metric_type type;
+    std::string help;
+    std::map<std::string, std::unique_ptr<tools::metrics::counter>> counters;
+    std::map<std::string, std::unique_ptr<tools::metrics::histogram>> histograms;
+    std::map<std::string, callback_t> callbacks;
+  };
+
+  // function statics, as timers in static initializers may register metrics
+  boost::mutex &registry_lock()
+  {
+    static boost::mutex lock;
+    return lock;
+  }
+
+  std::map<std::string, family_t> &registry()
+  {
+    static std::map<std::string, family_t> families;
+    return families;
+  }
+
+  family_t &get_family(const std::string &name, const std::string &help, metric_type type)
+  {
+    auto it = registry().find(name);
+    if (it == registry().end())
+    {
+      it = registry().emplace(name, family_t()).first;
+      it->second.type = type;
+      it->second.help = help;
+    }
+    else if (it->second.type != type)
+      throw std::runtime_error("Metric " + name + " already registered with another type");
+    return it->second;
+  }
+
+  static __thread unsigned stripe_index = 0; // 1 based, 0 until assigned
+
+  std::size_t get_stripe(std::size_t stripes)
+  {
+    if (!stripe_index)
+    {
+      static std::atomic<unsigned> next_stripe{0};
+      stripe_index = 1 + next_stripe++ % stripes;
+    }
+    return stripe_index - 1;
+  }
+
+  std::string with_labels(const std::string &labels, const std::string &extra = std::string())
+  {
+    if (labels.empty() && extra.empty())
+      return std::string();
+    if (labels.empty() || extra.empty())
+      return "{" + labels + extra + "}";
+    return "{" + labels + "," + extra + "}";
+  }
+
+  std::string format_double(double v)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", v);
+    return buf;
+  }
+}
+
+namespace tools
+{
+namespace metrics
+{
+  constexpr const std::size_t counter::STRIPES;
+  constexpr const std::size_t histogram::SUB_BUCKETS;
+  constexpr const std::size_t histogram::BUCKETS;
+
+  counter::counter()
+  {
+    for (stripe &s: m_stripes)
+      s.value = 0;
+  }
+
+  void counter::inc(uint64_t n) noexcept
+  {
+    m_stripes[get_stripe(STRIPES)].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  uint64_t counter::value() const noexcept
+  {
+    uint64_t total = 0;
+    for (const stripe &s: m_stripes)
+      total += s.value.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  histogram::histogram()
+  {
+    for (std::atomic<uint64_t> &b: m_buckets)
+      b = 0;
+  }
+
+  std::size_t histogram::get_bucket(uint64_t ns) noexcept
+  {
+    if (ns < SUB_BUCKETS)
+      return ns;
+    const unsigned e = 63 - __builtin_clzll(ns);
+    const uint64_t sub = (ns >> (e - 3)) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + (e - 3) * SUB_BUCKETS + sub;
+  }
+
+  uint64_t histogram::get_bucket_upper_bound(std::size_t bucket) noexcept
+  {
+    if (bucket < SUB_BUCKETS)
+      return bucket;
+    const unsigned e = (bucket - SUB_BUCKETS) / SUB_BUCKETS + 3;
+    const uint64_t sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    const uint64_t lower = (SUB_BUCKETS + sub) << (e - 3);
+    return lower + (((uint64_t)1 << (e - 3)) - 1);
+  }
+
+  void histogram::record(uint64_t ns) noexcept
+  {
+    m_buckets[get_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    m_count.inc();
+    m_sum.inc(ns);
+  }
+
+  uint64_t histogram::quantile(double q) const noexcept
+  {
+    uint64_t counts[BUCKETS];
+    uint64_t total = 0;
+    for (std::size_t i = 0; i < BUCKETS; ++i)
+    {
+      counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+      total += counts[i];
+    }
+    if (total == 0)
+      return 0;
+    const uint64_t rank = std::max<uint64_t>(1, std::ceil(std::min(std::max(q, 0.0), 1.0) * total));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKETS; ++i)
+    {
+      seen += counts[i];
+      if (seen >= rank)
+        return get_bucket_upper_bound(i);
+    }
+    return get_bucket_upper_bound(BUCKETS - 1);
+  }
+
+  counter &get_counter(const std::string &name, const std::string &help, const std::string &labels)
+  {
+    boost::lock_guard<boost::mutex> lock(registry_lock());
+    std::unique_ptr<counter> &c = get_family(name, help, metric_type::counter).counters[labels];
+    if (!c)
+      c.reset(new counter());
+    return *c;
+  }
+
+  histogram &get_histogram(const std::string &name, const std::string &help, const std::string &labels)
+  {
+    boost::lock_guard<boost::mutex> lock(registry_lock());
+    std::unique_ptr<histogram> &h = get_family(name, help, metric_type::histogram).histograms[labels];
+    if (!h)
+      h.reset(new histogram());
+    return *h;
+  }
+
+  void set_callback(const std::string &name, const std::string &help, const std::string &labels, bool monotonic, std::function<double()> f)
+  {
+    boost::lock_guard<boost::mutex> lock(registry_lock());
+    get_family(name, help, metric_type::callback).callbacks[labels] = {monotonic, std::move(f)};
+  }
+
+  std::string render()
+  {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    // copy what to render, so callbacks run without the lock, as they may
+    // end up registering metrics themselves
+    struct entry_t
+    {
+      std::string name;
+      metric_type type;
+      std::string help;
+      std::vector<std::pair<std::string, const counter*>> counters;
+      std::vector<std::pair<std::string, const histogram*>> histograms;
+      std::vector<std::pair<std::string, callback_t>> callbacks;
+    };
+    std::vector<entry_t> entries;
+    {
+      boost::lock_guard<boost::mutex> lock(registry_lock());
+      entries.reserve(registry().size());
+      for (const auto &e: registry())
+      {
+        entries.push_back({e.first, e.second.type, e.second.help, {}, {}, {}});
+        for (const auto &c: e.second.counters)
+          entries.back().counters.emplace_back(c.first, c.second.get());
+        for (const auto &h: e.second.histograms)
+          entries.back().histograms.emplace_back(h.first, h.second.get());
+        for (const auto &c: e.second.callbacks)
+          entries.back().callbacks.emplace_back(c.first, c.second);
+      }
+    }
+
+    std::string s;
+    for (const entry_t &e: entries)
+    {
+      s += "# HELP " + e.name + " " + e.help + "\n";
+      switch (e.type)
+      {
+        case metric_type::counter:
+          s += "# TYPE " + e.name + " counter\n";
+          for (const auto &c: e.counters)
+            s += e.name + with_labels(c.first) + " " + std::to_string(c.second->value()) + "\n";
+          break;
+        case metric_type::histogram:
+          s += "# TYPE " + e.name + " summary\n";
+          for (const auto &h: e.histograms)
+          {
+            for (double q: quantiles)
+              s += e.name + with_labels(h.first, "quantile=\"" + format_double(q) + "\"") + " " + format_double(h.second->quantile(q) / 1e9) + "\n";
+            s += e.name + "_sum" + with_labels(h.first) + " " + format_double(h.second->sum() / 1e9) + "\n";
+            s += e.name + "_count" + with_labels(h.first) + " " + std::to_string(h.second->count()) + "\n";
+          }
+          break;
+        case metric_type::callback:
+          s += "# TYPE " + e.name + (!e.callbacks.empty() && e.callbacks.front().second.monotonic ? " counter\n" : " gauge\n");
+          for (const auto &c: e.callbacks)
+          {
+            double v;
+            try { v = c.second.f(); }
+            catch (...) { continue; }
+            s += e.name + with_labels(c.first) + " " + format_double(v) + "\n";
+          }
+          break;
+      }
+    }
+    return s;
+  }
+}
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace tools
+{
+namespace metrics
+{
+  /*! Monotonic counter, striped over cache lines so threads bumping it
+      concurrently do not contend on a single atomic. */
+  class counter
+  {
+  public:
+    counter();
+    counter(const counter&) = delete;
+    counter &operator=(const counter&) = delete;
+
+    void inc(uint64_t n = 1) noexcept;
+    uint64_t value() const noexcept;
+
+  private:
+    static constexpr const std::size_t STRIPES = 8;
+    struct stripe
+    {
+      std::atomic<uint64_t> value;
+      char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    stripe m_stripes[STRIPES];
+  };
+
+  /*! Latency histogram with log-linear buckets, 8 per power of two, so any
+      quantile is known to within 12.5% whatever the range of the values,
+      without having to configure it. Values are in nanoseconds. */
+  class histogram
+  {
+  public:
+    static constexpr const std::size_t SUB_BUCKETS = 8;
+    static constexpr const std::size_t BUCKETS = SUB_BUCKETS + (64 - 3) * SUB_BUCKETS;
+
+    histogram();
+    histogram(const histogram&) = delete;
+    histogram &operator=(const histogram&) = delete;
+
+    void record(uint64_t ns) noexcept;
+
+    uint64_t count() const noexcept { return m_count.value(); }
+    uint64_t sum() const noexcept { return m_sum.value(); }
+
+    //! \return Upper bound of the bucket holding quantile `q` (0 to 1), 0 if empty.
+    uint64_t quantile(double q) const noexcept;
+
+    static std::size_t get_bucket(uint64_t ns) noexcept;
+    static uint64_t get_bucket_upper_bound(std::size_t bucket) noexcept;
+
+  private:
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    counter m_count;
+    counter m_sum;
+  };
+
+  /*! Finds or creates a counter. The returned reference stays valid for the
+      life of the process, so callers on hot paths keep it in a static.
+
+      \param labels Prometheus style labels, eg `method="get_info"`, or empty */
+  counter &get_counter(const std::string &name, const std::string &help, const std::string &labels = std::string());
+
+  //! Finds or creates a histogram, see `get_counter`.
+  histogram &get_histogram(const std::string &name, const std::string &help, const std::string &labels = std::string());
+
+  /*! Registers a value read when the metrics are rendered, for things
+      already tracked elsewhere. Registering the same name and labels again
+      replaces the previous callback.
+
+      \param monotonic True to export it as a counter, false as a gauge */
+  void set_callback(const std::string &name, const std::string &help, const std::string &labels, bool monotonic, std::function<double()> f);
+
+  //! \return All metrics in the Prometheus text exposition format.
+  std::string render();
+}
+}
@@ -111,7 +111,7 @@ PerformanceTimer::PerformanceTimer(bool paused): started(true), paused(paused)
     ticks = get_tick_count();
 }
 
-LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l): PerformanceTimer(), name(s), cat(cat), unit(unit), level(l)
+LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l, metrics::histogram *hist): PerformanceTimer(), name(s), cat(cat), unit(unit), level(l), hist(hist)
 {
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (!performance_timers)
@@ -147,6 +147,8 @@ LoggingPerformanceTimer::~LoggingPerformanceTimer()
 {
   pause();
   performance_timers->pop_back();
+  if (hist)
+    hist->record(ticks_to_ns(ticks));
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (log)
   {
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <memory>
 #include "misc_log_ex.h"
+#include "metrics.h"
 
 namespace tools
 {
@@ -64,7 +65,7 @@ protected:
 class LoggingPerformanceTimer: public PerformanceTimer
 {
 public:
-  LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l = el::Level::Info);
+  LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l = el::Level::Info, metrics::histogram *hist = NULL);
   ~LoggingPerformanceTimer();
 
 private:
@@ -72,16 +73,19 @@ private:
   std::string cat;
   uint64_t unit;
   el::Level level;
+  metrics::histogram *hist;
 };
 
 void set_performance_timer_log_level(el::Level level);
 
 #define PERF_TIMER_NAME(name) pt_##name
-#define PERF_TIMER_UNIT(name, unit) tools::LoggingPerformanceTimer PERF_TIMER_NAME(name)(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level)
+#define PERF_TIMER_METRIC_NAME(name) ptm_##name
+#define PERF_TIMER_METRIC(name) static tools::metrics::histogram &PERF_TIMER_METRIC_NAME(name) = tools::metrics::get_histogram("perf_timer_seconds", "Time spent in PERF_TIMER sections", "category=\"" MONERO_DEFAULT_LOG_CATEGORY "\",name=\"" #name "\"")
+#define PERF_TIMER_UNIT(name, unit) PERF_TIMER_METRIC(name); tools::LoggingPerformanceTimer PERF_TIMER_NAME(name)(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level, &PERF_TIMER_METRIC_NAME(name))
 #define PERF_TIMER_UNIT_L(name, unit, l) tools::LoggingPerformanceTimer PERF_TIMER_NAME(name)t_##name(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, l)
 #define PERF_TIMER(name) PERF_TIMER_UNIT(name, 1000000)
 #define PERF_TIMER_L(name, l) PERF_TIMER_UNIT_L(name, 1000000, l)
-#define PERF_TIMER_START_UNIT(name, unit) std::unique_ptr<tools::LoggingPerformanceTimer> PERF_TIMER_NAME(name)(new tools::LoggingPerformanceTimer(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, el::Level::Info))
+#define PERF_TIMER_START_UNIT(name, unit) PERF_TIMER_METRIC(name); std::unique_ptr<tools::LoggingPerformanceTimer> PERF_TIMER_NAME(name)(new tools::LoggingPerformanceTimer(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, el::Level::Info, &PERF_TIMER_METRIC_NAME(name)))
 #define PERF_TIMER_START(name) PERF_TIMER_START_UNIT(name, 1000000)
 #define PERF_TIMER_STOP(name) do { PERF_TIMER_NAME(name).reset(NULL); } while(0)
 #define PERF_TIMER_PAUSE(name) PERF_TIMER_NAME(name).pause()
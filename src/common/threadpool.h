@@ -54,6 +54,11 @@ public:
   static threadpool *getNewForUnitTests(unsigned max_threads = 0) {
     return new threadpool(max_threads);
   }
+  // A pool of its own, for jobs which must neither queue behind the jobs of
+  // the shared pools nor be run inline by one of their waiters
+  static threadpool *getNew(unsigned max_threads) {
+    return new threadpool(max_threads);
+  }
 
   // The waiter lets the caller know when all of its
   // tasks are completed.
@@ -0,0 +1,203 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "perf_timer.h"
+#include "trace.h"
+
+namespace
+{
+  struct event_t
+  {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+    uint64_t arg;
+  };
+
+  struct thread_buffer
+  {
+    // only ever contended by a dump, so a spin lock is cheaper than a mutex
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    std::vector<event_t> events;
+    size_t next = 0;
+    bool wrapped = false;
+    size_t tid;
+
+    void lock() { while (busy.test_and_set(std::memory_order_acquire)); }
+    void unlock() { busy.clear(std::memory_order_release); }
+  };
+
+  // threads which exit keep their buffer, so bound how many are created
+  constexpr const size_t MAX_THREADS = 1024;
+
+  boost::mutex &buffers_lock()
+  {
+    static boost::mutex lock;
+    return lock;
+  }
+
+  std::vector<std::unique_ptr<thread_buffer>> &buffers()
+  {
+    static std::vector<std::unique_ptr<thread_buffer>> v;
+    return v;
+  }
+
+  static __thread thread_buffer *tls_buffer = NULL;
+  static __thread bool tls_no_buffer = false;
+
+  thread_buffer *get_buffer()
+  {
+    if (tls_buffer || tls_no_buffer)
+      return tls_buffer;
+    boost::lock_guard<boost::mutex> lock(buffers_lock());
+    if (buffers().size() >= MAX_THREADS)
+    {
+      tls_no_buffer = true;
+      return NULL;
+    }
+    std::unique_ptr<thread_buffer> buffer(new thread_buffer());
+    buffer->events.resize(tools::trace::SPANS_PER_THREAD);
+    buffer->tid = buffers().size() + 1;
+    tls_buffer = buffer.get();
+    buffers().push_back(std::move(buffer));
+    return tls_buffer;
+  }
+
+  std::string format_us(uint64_t ticks)
+  {
+    char buf[32];
+    const uint64_t ns = tools::ticks_to_ns(ticks);
+    snprintf(buf, sizeof(buf), "%llu.%03u", (unsigned long long)(ns / 1000), (unsigned)(ns % 1000));
+    return buf;
+  }
+}
+
+namespace tools
+{
+namespace trace
+{
+  std::atomic<bool> enabled{false};
+
+  void set_enabled(bool enable) noexcept
+  {
+    enabled = enable;
+  }
+
+  void clear()
+  {
+    boost::lock_guard<boost::mutex> lock(buffers_lock());
+    for (const auto &buffer: buffers())
+    {
+      buffer->lock();
+      buffer->next = 0;
+      buffer->wrapped = false;
+      buffer->unlock();
+    }
+  }
+
+  std::string dump_chrome_trace()
+  {
+    std::vector<std::pair<size_t, std::vector<event_t>>> threads;
+    {
+      boost::lock_guard<boost::mutex> lock(buffers_lock());
+      for (const auto &buffer: buffers())
+      {
+        std::vector<event_t> events;
+        buffer->lock();
+        if (buffer->wrapped)
+          events.insert(events.end(), buffer->events.begin() + buffer->next, buffer->events.end());
+        events.insert(events.end(), buffer->events.begin(), buffer->events.begin() + buffer->next);
+        buffer->unlock();
+        if (!events.empty())
+          threads.emplace_back(buffer->tid, std::move(events));
+      }
+    }
+
+    uint64_t base = std::numeric_limits<uint64_t>::max();
+    for (const auto &t: threads)
+      for (const event_t &e: t.second)
+        base = std::min(base, e.start);
+
+    std::string s = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &t: threads)
+    {
+      for (const event_t &e: t.second)
+      {
+        if (!first)
+          s += ",";
+        first = false;
+        s += "\n{\"name\":\"" + std::string(e.name) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(t.first)
+          + ",\"ts\":" + format_us(e.start - base) + ",\"dur\":" + format_us(e.end - e.start);
+        if (e.arg)
+          s += ",\"args\":{\"arg\":" + std::to_string(e.arg) + "}";
+        s += "}";
+      }
+    }
+    s += "\n]}\n";
+    return s;
+  }
+
+  void span::start(const char *name, uint64_t arg) noexcept
+  {
+    stop();
+    if (!is_enabled())
+      return;
+    m_name = name;
+    m_arg = arg;
+    m_start = tools::get_tick_count();
+  }
+
+  void span::stop() noexcept
+  {
+    if (!m_name)
+      return;
+    const uint64_t end = tools::get_tick_count();
+    thread_buffer *buffer = get_buffer();
+    if (buffer)
+    {
+      buffer->lock();
+      buffer->events[buffer->next] = {m_name, m_start, end, m_arg};
+      if (++buffer->next == buffer->events.size())
+      {
+        buffer->next = 0;
+        buffer->wrapped = true;
+      }
+      buffer->unlock();
+    }
+    m_name = NULL;
+  }
+}
+}
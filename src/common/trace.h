@@ -0,0 +1,88 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace tools
+{
+namespace trace
+{
+  //! Number of spans kept per thread, older ones are overwritten
+  constexpr const std::size_t SPANS_PER_THREAD = 4096;
+
+  extern std::atomic<bool> enabled;
+
+  void set_enabled(bool enable) noexcept;
+  inline bool is_enabled() noexcept { return enabled.load(std::memory_order_relaxed); }
+
+  //! Drops all recorded spans.
+  void clear();
+
+  /*! \return Recorded spans, oldest first per thread, in the Chrome trace
+      event JSON format, which chrome://tracing and Perfetto can load. */
+  std::string dump_chrome_trace();
+
+  /*! Records the time between its construction and destruction (or `stop`)
+      in the calling thread's ring buffer, if tracing is enabled. Costs two
+      TSC reads and a few stores, so it can stay on in hot paths, but is
+      meant for spans in the microsecond range and above. */
+  class span
+  {
+  public:
+    span() noexcept: m_name(NULL), m_start(0), m_arg(0) {}
+    explicit span(const char *name, uint64_t arg = 0) noexcept: span() { start(name, arg); }
+    span(const span&) = delete;
+    span &operator=(const span&) = delete;
+    ~span() { stop(); }
+
+    //! Starts a span declared earlier, eg where a goto would cross its declaration.
+    void start(const char *name, uint64_t arg = 0) noexcept;
+
+    //! Records the span now instead of at destruction.
+    void stop() noexcept;
+
+  private:
+    const char *m_name; //!< NULL if not recording
+    uint64_t m_start;
+    uint64_t m_arg;
+  };
+}
+}
+
+#define TRACE_SPAN_NAME(name) trace_span_##name
+//! `name` must be a valid identifier, and `arg` is shown with the span.
+#define TRACE_SPAN_ARG(name, arg) tools::trace::span TRACE_SPAN_NAME(name)(#name, arg)
+#define TRACE_SPAN(name) TRACE_SPAN_ARG(name, 0)
+#define TRACE_SPAN_DECLARE(name) tools::trace::span TRACE_SPAN_NAME(name)
+#define TRACE_SPAN_START_ARG(name, arg) TRACE_SPAN_NAME(name).start(#name, arg)
+#define TRACE_SPAN_START(name) TRACE_SPAN_START_ARG(name, 0)
+#define TRACE_SPAN_STOP(name) TRACE_SPAN_NAME(name).stop()
@@ -37,6 +37,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <boost/shared_ptr.hpp>
+#include <memory>
 
 #include "common/varint.h"
 #include "warnings.h"
@@ -202,6 +203,53 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::generate_key_derivations(const epee::span<const public_key> keys1, const secret_key &key2, const epee::span<key_derivation> derivations, std::vector<bool> &valid) {
+    const size_t n = keys1.size();
+    valid.assign(n, false);
+    if (derivations.size() != n)
+      return false;
+    if (n == 0)
+      return true;
+
+    // the secret key is the same for every point, so it is only recoded once,
+    // and all the resulting points share a single field inversion when encoded
+    signed char e[64];
+    assert(sc_check(&key2) == 0);
+    ge_scalarmult_recode(e, &unwrap(key2));
+
+    std::vector<ge_p2> points;
+    std::vector<size_t> indices;
+    points.reserve(n);
+    indices.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      ge_p3 point;
+      ge_p2 point2;
+      ge_p1p1 point3;
+      if (ge_frombytes_vartime(&point, &keys1[i]) != 0)
+        continue;
+      ge_scalarmult_recoded(&point2, e, &point);
+      ge_mul8(&point3, &point2);
+      ge_p1p1_to_p2(&point2, &point3);
+      points.push_back(point2);
+      indices.push_back(i);
+      valid[i] = true;
+    }
+    memwipe(e, sizeof(e));
+
+    if (!points.empty())
+    {
+      std::unique_ptr<fe[]> tmp(new fe[points.size()]);
+      std::vector<unsigned char> encoded(points.size() * 32);
+      ge_p2_batch_tobytes(encoded.data(), points.data(), points.size(), tmp.get());
+      for (size_t i = 0; i < indices.size(); ++i)
+        memcpy(derivations.data()[indices[i]].data, encoded.data() + 32 * i, 32);
+      memwipe(encoded.data(), encoded.size());
+      memwipe(points.data(), points.size() * sizeof(ge_p2));
+    }
+    return indices.size() == n;
+  }
+
   void crypto_ops::derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     struct {
       key_derivation derivation;
@@ -127,6 +127,8 @@ namespace crypto {
     friend bool secret_key_to_public_key(const secret_key &, public_key &);
     static bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
+    static bool generate_key_derivations(const epee::span<const public_key>, const secret_key &, const epee::span<key_derivation>, std::vector<bool> &);
+    friend bool generate_key_derivations(const epee::span<const public_key>, const secret_key &, const epee::span<key_derivation>, std::vector<bool> &);
     static void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     friend void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
@@ -232,6 +234,13 @@ namespace crypto {
   inline bool generate_key_derivation(const public_key &key1, const secret_key &key2, key_derivation &derivation) {
     return crypto_ops::generate_key_derivation(key1, key2, derivation);
   }
+  /* Batched variant of generate_key_derivation for many public keys and a single secret key, as when
+   * scanning with a view key. valid[i] is set to whether keys[i] could be decompressed; derivations for
+   * invalid keys are left untouched. Returns false if any key was invalid or the spans differ in size.
+   */
+  inline bool generate_key_derivations(const epee::span<const public_key> keys, const secret_key &key2, const epee::span<key_derivation> derivations, std::vector<bool> &valid) {
+    return crypto_ops::generate_key_derivations(keys, key2, derivations, valid);
+  }
   inline bool derive_public_key(const key_derivation &derivation, std::size_t output_index,
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
@@ -55,3 +55,14 @@ void cn_fast_hash(const void *data, size_t length, char *hash) {
   hash_process(&state, data, length);
   memcpy(hash, &state, HASH_SIZE);
 }
+
+void cn_fast_hash_multi(const void *const *data, const size_t *length, size_t count, char (*hash)[HASH_SIZE]) {
+  size_t i;
+  for (i = 0; i + 4 <= count; i += 4) {
+    const uint8_t *const in[4] = {data[i], data[i + 1], data[i + 2], data[i + 3]};
+    uint8_t *const md[4] = {(uint8_t*)hash[i], (uint8_t*)hash[i + 1], (uint8_t*)hash[i + 2], (uint8_t*)hash[i + 3]};
+    keccak_x4(in, length + i, md, HASH_SIZE);
+  }
+  for (; i < count; ++i)
+    cn_fast_hash(data[i], length[i], hash[i]);
+}
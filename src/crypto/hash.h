@@ -70,6 +70,13 @@ namespace crypto {
     return h;
   }
 
+  /* Hashes count independent messages, several at a time when SIMD is available.
+   * hashes[i] may overlap data[i], but not any other message.
+   */
+  inline void cn_fast_hash_multi(const void *const *data, const std::size_t *length, std::size_t count, hash *hashes) {
+    cn_fast_hash_multi(data, length, count, reinterpret_cast<char (*)[HASH_SIZE]>(hashes));
+  }
+
   inline void cn_slow_hash(const void *data, std::size_t length, hash &hash, int variant = 0, uint64_t height = 0) {
     cn_slow_hash(data, length, reinterpret_cast<char *>(&hash), variant, 0/*prehashed*/, height);
   }
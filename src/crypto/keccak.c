@@ -9,6 +9,11 @@
 #include "hash-ops.h"
 #include "keccak.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define KECCAK_X4_AVX2
+#include <immintrin.h>
+#endif
+
 static void local_abort(const char *msg)
 {
   fprintf(stderr, "%s\n", msg);
@@ -171,6 +176,190 @@ void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md)
     keccak(in, inlen, md, sizeof(state_t));
 }
 
+// four interleaved states, st[i][lane]
+typedef uint64_t state_x4_t[25][4];
+
+#ifdef KECCAK_X4_AVX2
+
+#define ROTL64_X4(x, y) _mm256_or_si256(_mm256_slli_epi64((x), (y)), _mm256_srli_epi64((x), 64 - (y)))
+
+// same as keccakf, on four states at once, one per 64 bit lane of each register
+__attribute__((target("avx2")))
+static void keccakf_x4_avx2(state_x4_t st, int rounds)
+{
+    int round, i;
+    __m256i s[25], t, bc[5];
+
+    for (i = 0; i < 25; ++i)
+        s[i] = _mm256_loadu_si256((const __m256i*)st[i]);
+
+    for (round = 0; round < rounds; ++round) {
+        // Theta
+        for (i = 0; i < 5; ++i)
+            bc[i] = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(s[i], s[i + 5]), _mm256_xor_si256(s[i + 10], s[i + 15])), s[i + 20]);
+
+        for (i = 0; i < 5; ++i) {
+            t = _mm256_xor_si256(bc[(i + 4) % 5], ROTL64_X4(bc[(i + 1) % 5], 1));
+            s[i     ] = _mm256_xor_si256(s[i     ], t);
+            s[i +  5] = _mm256_xor_si256(s[i +  5], t);
+            s[i + 10] = _mm256_xor_si256(s[i + 10], t);
+            s[i + 15] = _mm256_xor_si256(s[i + 15], t);
+            s[i + 20] = _mm256_xor_si256(s[i + 20], t);
+        }
+
+        // Rho Pi
+        t = s[1];
+        s[ 1] = ROTL64_X4(s[ 6], 44);
+        s[ 6] = ROTL64_X4(s[ 9], 20);
+        s[ 9] = ROTL64_X4(s[22], 61);
+        s[22] = ROTL64_X4(s[14], 39);
+        s[14] = ROTL64_X4(s[20], 18);
+        s[20] = ROTL64_X4(s[ 2], 62);
+        s[ 2] = ROTL64_X4(s[12], 43);
+        s[12] = ROTL64_X4(s[13], 25);
+        s[13] = ROTL64_X4(s[19],  8);
+        s[19] = ROTL64_X4(s[23], 56);
+        s[23] = ROTL64_X4(s[15], 41);
+        s[15] = ROTL64_X4(s[ 4], 27);
+        s[ 4] = ROTL64_X4(s[24], 14);
+        s[24] = ROTL64_X4(s[21],  2);
+        s[21] = ROTL64_X4(s[ 8], 55);
+        s[ 8] = ROTL64_X4(s[16], 45);
+        s[16] = ROTL64_X4(s[ 5], 36);
+        s[ 5] = ROTL64_X4(s[ 3], 28);
+        s[ 3] = ROTL64_X4(s[18], 21);
+        s[18] = ROTL64_X4(s[17], 15);
+        s[17] = ROTL64_X4(s[11], 10);
+        s[11] = ROTL64_X4(s[ 7],  6);
+        s[ 7] = ROTL64_X4(s[10],  3);
+        s[10] = ROTL64_X4(t, 1);
+
+        //  Chi
+        for (i = 0; i < 25; i += 5) {
+            const __m256i s0 = s[i    ];
+            const __m256i s1 = s[i + 1];
+            const __m256i s2 = s[i + 2];
+            const __m256i s3 = s[i + 3];
+            const __m256i s4 = s[i + 4];
+            s[i    ] = _mm256_xor_si256(s0, _mm256_andnot_si256(s1, s2));
+            s[i + 1] = _mm256_xor_si256(s1, _mm256_andnot_si256(s2, s3));
+            s[i + 2] = _mm256_xor_si256(s2, _mm256_andnot_si256(s3, s4));
+            s[i + 3] = _mm256_xor_si256(s3, _mm256_andnot_si256(s4, s0));
+            s[i + 4] = _mm256_xor_si256(s4, _mm256_andnot_si256(s0, s1));
+        }
+
+        //  Iota
+        s[0] = _mm256_xor_si256(s[0], _mm256_set1_epi64x(keccakf_rndc[round]));
+    }
+
+    for (i = 0; i < 25; ++i)
+        _mm256_storeu_si256((__m256i*)st[i], s[i]);
+}
+
+static int keccak_x4_avx2_supported(void)
+{
+    static int supported = -1;
+
+    if (supported >= 0)
+        return supported;
+
+    __builtin_cpu_init();
+    return supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+
+#endif
+
+// compute four keccak hashes of given byte length at once. All the inputs are
+// consumed before any of the outputs are written, so they may alias. mdlen
+// is a whole number of words, at least 32 bytes, so the rate is 1 to 17
+// words and padded blocks fit the same 144 byte buffer as in keccak()
+void keccak_x4(const uint8_t *const in[4], const size_t inlen[4], uint8_t *const md[4], int mdlen)
+{
+    uint8_t out[4][100];
+    size_t i, lane;
+
+    if (mdlen < 32 || mdlen >= 100 || ((size_t)mdlen % sizeof(uint64_t)) != 0)
+    {
+      local_abort("Bad keccak use");
+    }
+
+#ifdef KECCAK_X4_AVX2
+    if (keccak_x4_avx2_supported())
+    {
+        state_x4_t st;
+        uint8_t temp[144];
+        const size_t rsiz = 200 - 2 * mdlen, rsizw = rsiz / 8;
+        size_t blocks[4], nblocks = 0, block;
+
+        static_assert(HASH_DATA_AREA <= sizeof(temp), "Bad keccak preconditions");
+        static_assert(200 - 2 * 32 <= sizeof(temp), "Bad keccak preconditions");
+
+        // every lane ends with a padded block, possibly empty
+        for (lane = 0; lane < 4; ++lane)
+        {
+            blocks[lane] = inlen[lane] / rsiz + 1;
+            if (blocks[lane] > nblocks)
+                nblocks = blocks[lane];
+        }
+
+        memset(st, 0, sizeof(st));
+
+        for (block = 0; block < nblocks; ++block)
+        {
+            for (lane = 0; lane < 4; ++lane)
+            {
+                const uint8_t *ptr = in[lane] + block * rsiz;
+                if (block + 1 < blocks[lane])
+                {
+                    for (i = 0; i < rsizw; i++) {
+                        uint64_t ina;
+                        memcpy(&ina, ptr + i * 8, 8);
+                        st[i][lane] ^= swap64le(ina);
+                    }
+                }
+                else if (block + 1 == blocks[lane])
+                {
+                    // last block and padding
+                    const size_t rest = inlen[lane] - block * rsiz;
+                    if (rest > 0)
+                        memcpy(temp, ptr, rest);
+                    temp[rest] = 1;
+                    memset(temp + rest + 1, 0, rsiz - rest - 1);
+                    temp[rsiz - 1] |= 0x80;
+                    for (i = 0; i < rsizw; i++) {
+                        uint64_t ina;
+                        memcpy(&ina, temp + i * 8, 8);
+                        st[i][lane] ^= swap64le(ina);
+                    }
+                }
+            }
+
+            keccakf_x4_avx2(st, KECCAK_ROUNDS);
+
+            // lanes which are done are still permuted along with the others
+            // for subsequent blocks, so their result has to be taken now
+            for (lane = 0; lane < 4; ++lane)
+            {
+                if (block + 1 != blocks[lane])
+                    continue;
+                for (i = 0; i < (size_t)mdlen / 8; ++i) {
+                    const uint64_t w = swap64le(st[i][lane]);
+                    memcpy(out[lane] + i * 8, &w, 8);
+                }
+            }
+        }
+    }
+    else
+#endif
+    {
+        for (lane = 0; lane < 4; ++lane)
+            keccak(in[lane], inlen[lane], out[lane], mdlen);
+    }
+
+    for (lane = 0; lane < 4; ++lane)
+        memcpy(md[lane], out[lane], mdlen);
+}
+
 #define KECCAK_FINALIZED 0x80000000
 #define KECCAK_BLOCKLEN 136
 #define KECCAK_WORDS 17
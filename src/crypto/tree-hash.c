@@ -59,6 +59,25 @@ size_t tree_hash_cnt(size_t count) {
 	return pow >> 1;
 }
 
+/***
+* Hashes n consecutive pairs of hashes from in into n consecutive hashes in out,
+* several at a time. out may be the same as in, since each output only overwrites
+* pairs which were already consumed.
+*/
+static void tree_hash_pairs(const char *in, size_t n, char *out) {
+  const void *data[4];
+  size_t length[4] = {2 * HASH_SIZE, 2 * HASH_SIZE, 2 * HASH_SIZE, 2 * HASH_SIZE};
+  size_t i, k;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    for (k = 0; k < 4; ++k)
+      data[k] = in + (i + k) * 2 * HASH_SIZE;
+    cn_fast_hash_multi(data, length, 4, (char (*)[HASH_SIZE])(out + i * HASH_SIZE));
+  }
+  for (; i < n; ++i)
+    cn_fast_hash(in + i * 2 * HASH_SIZE, 2 * HASH_SIZE, out + i * HASH_SIZE);
+}
+
 void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 // The blockchain block at height 202612 https://moneroblocks.info/block/202612
 // contained 514 transactions, that triggered bad calculation of variable "cnt" in the original version of this function
@@ -79,7 +98,7 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
   } else if (count == 2) {
     cn_fast_hash(hashes, 2 * HASH_SIZE, root_hash);
   } else {
-    size_t i, j;
+    size_t j;
 
     size_t cnt = tree_hash_cnt( count );
 
@@ -88,16 +107,12 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 
     memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
 
-    for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, ++j) {
-      cn_fast_hash(hashes[i], 64, ints + j * HASH_SIZE);
-    }
-    assert(i == count);
+    j = 2 * cnt - count;
+    tree_hash_pairs(hashes[j], cnt - j, ints + j * HASH_SIZE);
 
     while (cnt > 2) {
       cnt >>= 1;
-      for (i = 0, j = 0; j < cnt; i += 2, ++j) {
-        cn_fast_hash(ints + i * HASH_SIZE, 64, ints + j * HASH_SIZE);
-      }
+      tree_hash_pairs(ints, cnt, ints);
     }
 
     cn_fast_hash(ints, 64, root_hash);
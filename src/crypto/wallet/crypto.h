@@ -30,6 +30,7 @@
 #pragma once
 
 #include <cstddef>
+#include <vector>
 #include "crypto/wallet/ops.h"
 
 namespace crypto {
@@ -42,6 +43,21 @@ namespace crypto {
         return monero_crypto_generate_key_derivation(out.data, tx_pub.data, view_sec.data) == 0;
       }
 
+      inline
+      bool generate_key_derivations(const epee::span<const public_key> tx_pubs, const secret_key &view_sec, const epee::span<key_derivation> out, std::vector<bool> &valid)
+      {
+        valid.assign(tx_pubs.size(), false);
+        if (out.size() != tx_pubs.size())
+          return false;
+        bool r = true;
+        for (size_t i = 0; i < tx_pubs.size(); ++i)
+        {
+          valid[i] = generate_key_derivation(tx_pubs[i], view_sec, out.data()[i]);
+          r &= valid[i];
+        }
+        return r;
+      }
+
       inline
       bool derive_subaddress_public_key(const public_key &output_pub, const key_derivation &d, std::size_t index, public_key &out)
       {
@@ -51,6 +67,7 @@ namespace crypto {
       }
 #else
     using ::crypto::generate_key_derivation;
+    using ::crypto::generate_key_derivations;
     using ::crypto::derive_subaddress_public_key;
 #endif
   }
@@ -64,6 +64,12 @@ namespace cryptonote
       return 1024 * 1024; // 1 MB
     case cryptonote::NOTIFY_GET_TXPOOL_COMPLEMENT::ID:
       return 1024 * 1024 * 4; // 4 MB
+    case cryptonote::NOTIFY_NEW_COMPACT_BLOCK::ID:
+      return 1024 * 1024 * 4; // 4 MB, same as fluffy blocks
+    case cryptonote::NOTIFY_GET_TXPOOL_SKETCH::ID:
+      return 1024 * 1024 * 4; // 4 MB
+    case cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED::ID:
+      return 4096;
     default:
       break;
     };
@@ -319,8 +319,13 @@ namespace cryptonote
     template<bool W, template <bool> class Archive>
     bool serialize_base(Archive<W> &ar)
     {
+      const auto start_pos = ar.getpos();
+
       FIELDS(*static_cast<transaction_prefix *>(this))
 
+      if (std::is_same<Archive<W>, binary_archive<W>>())
+        prefix_size = ar.getpos() - start_pos;
+
       if (version == 1)
       {
       }
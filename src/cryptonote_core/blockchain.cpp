@@ -54,6 +54,7 @@
 #include "cryptonote_core.h"
 #include "ringct/rctSigs.h"
 #include "common/perf_timer.h"
+#include "common/trace.h"
 #include "common/notify.h"
 #include "common/varint.h"
 #include "common/pruning.h"
@@ -65,6 +66,15 @@
 
 #define FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE (100*1024*1024) // 100 MB
 
+#define GET_OBJECTS_MIN_BLOCKS_PER_THREAD 8
+#define GET_TXES_MIN_TXES_PER_THREAD 16
+
+// background pruning visits this many transactions per write txn, then
+// leaves the blockchain lock alone for a while
+#define BACKGROUND_PRUNING_BATCH_SIZE 1024
+#define BACKGROUND_PRUNING_BATCH_INTERVAL_MS 20
+#define BACKGROUND_COMPACTION_ATTEMPTS 5
+
 using namespace crypto;
 
 //#include "serialization/json_archive.h"
@@ -515,6 +525,16 @@ bool Blockchain::deinit()
 
   MTRACE("Stopping blockchain read/write activity");
 
+  // background pruning stops at its next batch once cancelled, and a
+  // compacted copy in progress is interrupted
+  m_cancel = true;
+  if (m_pruning_thread.joinable())
+  {
+    if (m_db)
+      m_db->cancel_copy_compacted();
+    m_pruning_thread.join();
+  }
+
  // stop async service
   m_async_work_idle.reset();
   m_async_pool.join_all();
@@ -703,6 +723,15 @@ crypto::hash Blockchain::get_tail_id(uint64_t& height) const
   return m_db->top_block_hash(&height);
 }
 //------------------------------------------------------------------
+crypto::hash Blockchain::get_tail_id_unlocked(uint64_t& height) const
+{
+  // WARNING: this function does not take m_blockchain_lock, the read txn
+  // makes height and hash consistent with each other only
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  db_rtxn_guard rtxn_guard(m_db);
+  return m_db->top_block_hash(&height);
+}
+//------------------------------------------------------------------
 crypto::hash Blockchain::get_tail_id() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -2289,41 +2318,106 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std
   return true;
 }
 //------------------------------------------------------------------
-//TODO: This function *looks* like it won't need to be rewritten
-//      to use BlockchainDB, as it calls other functions that were,
-//      but it warrants some looking into later.
-//
-//FIXME: This function appears to want to return false if any transactions
-//       that belong with blocks are missing, but not if blocks themselves
-//       are missing.
+static bool fill(BlockchainDB *db, const crypto::hash &tx_hash, tx_blob_entry &tx, bool pruned);
+//------------------------------------------------------------------
+// Serving blocks to peers does not take the blockchain lock: all reads happen
+// within db read txns, which see a consistent snapshot of the db even while
+// another thread is adding blocks, so syncing peers do not stall our own import.
 bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  db_rtxn_guard rtxn_guard (m_db);
-  rsp.current_blockchain_height = get_current_blockchain_height();
-  std::vector<std::pair<cryptonote::blobdata,block>> blocks;
-  get_blocks(arg.blocks, blocks, rsp.missed_ids);
+  enum { object_found, object_missed, object_missed_txs, object_error };
+
+  const size_t n_blocks = arg.blocks.size();
+  std::vector<block_complete_entry> entries(n_blocks);
+  std::vector<uint8_t> status(n_blocks, object_error);
+  std::vector<uint64_t> heights(n_blocks, 0);
+  std::vector<std::vector<crypto::hash>> missed_tx_ids(n_blocks);
 
-  for (size_t i = 0; i < blocks.size(); ++i)
+  const auto get_objects = [&](size_t start, size_t end)
   {
-    auto& bl = blocks[i];
-    std::vector<crypto::hash> missed_tx_ids;
+    try
+    {
+      db_rtxn_guard rtxn_guard(m_db);
+      for (size_t i = start; i < end; ++i)
+      {
+        if (!m_db->block_exists(arg.blocks[i], &heights[i]))
+        {
+          status[i] = object_missed;
+          continue;
+        }
+        block_complete_entry &e = entries[i];
+        e.block = m_db->get_block_blob_from_height(heights[i]);
+        block b;
+        if (!parse_and_validate_block_from_blob(e.block, b))
+        {
+          LOG_ERROR("Invalid block: " << arg.blocks[i]);
+          status[i] = object_missed;
+          continue;
+        }
+        e.pruned = arg.prune;
+        e.txs.reserve(b.tx_hashes.size());
+        for (const crypto::hash &tx_hash: b.tx_hashes)
+        {
+          tx_blob_entry tx;
+          if (fill(m_db, tx_hash, tx, arg.prune))
+            e.txs.push_back(std::move(tx));
+          else
+            missed_tx_ids[i].push_back(tx_hash);
+        }
+        e.block_weight = arg.prune ? m_db->get_block_weight(heights[i]) : 0;
+        status[i] = missed_tx_ids[i].empty() ? object_found : object_missed_txs;
+      }
+    }
+    catch (const std::exception &e)
+    {
+      // blocks not reached yet are left as errors
+      MERROR("Error retrieving blocks: " << e.what());
+    }
+  };
+
+  // large requests are spread over the IO threads, each with its own read txn
+  tools::threadpool& tpool = tools::threadpool::getInstanceForIO();
+  const size_t threads = std::min<size_t>(tpool.get_max_concurrency(), (n_blocks + GET_OBJECTS_MIN_BLOCKS_PER_THREAD - 1) / GET_OBJECTS_MIN_BLOCKS_PER_THREAD);
+  {
+    db_rtxn_guard rtxn_guard(m_db);
+    rsp.current_blockchain_height = m_db->height();
+  }
+  if (threads > 1)
+  {
+    tools::threadpool::waiter waiter(tpool);
+    const size_t blocks_per_thread = (n_blocks + threads - 1) / threads;
+    for (size_t start = 0; start < n_blocks; start += blocks_per_thread)
+      tpool.submit(&waiter, [&get_objects, start, end = std::min(start + blocks_per_thread, n_blocks)]() { get_objects(start, end); });
+    if (!waiter.wait())
+      return false;
+  }
+  else
+  {
+    get_objects(0, n_blocks);
+  }
 
-    rsp.blocks.push_back(block_complete_entry());
-    block_complete_entry& e = rsp.blocks.back();
+  for (size_t i = 0; i < n_blocks; ++i)
+  {
+    if (status[i] == object_error)
+      return false;
+    if (status[i] == object_missed)
+      rsp.missed_ids.push_back(arg.blocks[i]);
+  }
 
-    // FIXME: s/rsp.missed_ids/missed_tx_id/ ?  Seems like rsp.missed_ids
-    //        is for missed blocks, not missed transactions as well.
-    e.pruned = arg.prune;
-    get_transactions_blobs(bl.second.tx_hashes, e.txs, missed_tx_ids, arg.prune);
-    if (missed_tx_ids.size() != 0)
+  rsp.blocks.reserve(n_blocks);
+  for (size_t i = 0; i < n_blocks; ++i)
+  {
+    if (status[i] == object_missed)
+      continue;
+    rsp.blocks.push_back(std::move(entries[i]));
+    if (status[i] == object_missed_txs)
     {
       // do not display an error if the peer asked for an unpruned block which we are not meant to have
-      if (tools::has_unpruned_block(get_block_height(bl.second), get_current_blockchain_height(), get_blockchain_pruning_seed()))
+      if (tools::has_unpruned_block(heights[i], rsp.current_blockchain_height, get_blockchain_pruning_seed()))
       {
-        LOG_ERROR("Error retrieving blocks, missed " << missed_tx_ids.size()
-            << " transactions for block with hash: " << get_block_hash(bl.second)
+        LOG_ERROR("Error retrieving blocks, missed " << missed_tx_ids[i].size()
+            << " transactions for block with hash: " << arg.blocks[i]
             << std::endl
         );
       }
@@ -2331,15 +2425,9 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
       // append missed transaction hashes to response missed_ids field,
       // as done below if any standalone transactions were requested
       // and missed.
-      rsp.missed_ids.insert(rsp.missed_ids.end(), missed_tx_ids.begin(), missed_tx_ids.end());
+      rsp.missed_ids.insert(rsp.missed_ids.end(), missed_tx_ids[i].begin(), missed_tx_ids[i].end());
       return false;
     }
-
-    //pack block
-    e.block = std::move(bl.first);
-    e.block_weight = 0;
-    if (arg.prune && m_db->block_exists(arg.blocks[i]))
-      e.block_weight = m_db->get_block_weight(m_db->get_block_height(arg.blocks[i]));
   }
 
   return true;
@@ -2736,32 +2824,70 @@ template<class t_ids_container, class t_tx_container, class t_missed_container>
 bool Blockchain::get_split_transactions_blobs(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  enum { tx_found, tx_missed, tx_error };
 
-  reserve_container(txs, txs_ids.size());
-  for (const auto& tx_hash : txs_ids)
+  // like handle_get_objects, reads happen within db read txns and do not
+  // need the blockchain lock, so large batches are spread over the IO threads
+  const size_t n_txes = txs_ids.size();
+  std::vector<std::tuple<crypto::hash, cryptonote::blobdata, crypto::hash, cryptonote::blobdata>> entries(n_txes);
+  std::vector<uint8_t> status(n_txes, tx_error);
+  const auto get_txes = [&](size_t start, size_t end)
   {
     try
     {
-      cryptonote::blobdata tx;
-      if (m_db->get_pruned_tx_blob(tx_hash, tx))
+      db_rtxn_guard rtxn_guard(m_db);
+      for (size_t i = start; i < end; ++i)
       {
-        txs.push_back(std::make_tuple(tx_hash, std::move(tx), crypto::null_hash, cryptonote::blobdata()));
-        if (!is_v1_tx(std::get<1>(txs.back())) && !m_db->get_prunable_tx_hash(tx_hash, std::get<2>(txs.back())))
+        const crypto::hash &tx_hash = txs_ids[i];
+        auto &e = entries[i];
+        if (!m_db->get_pruned_tx_blob(tx_hash, std::get<1>(e)))
+        {
+          status[i] = tx_missed;
+          continue;
+        }
+        std::get<0>(e) = tx_hash;
+        std::get<2>(e) = crypto::null_hash;
+        if (!is_v1_tx(std::get<1>(e)) && !m_db->get_prunable_tx_hash(tx_hash, std::get<2>(e)))
         {
           MERROR("Prunable data hash not found for " << tx_hash);
-          return false;
+          return;
         }
-        if (!m_db->get_prunable_tx_blob(tx_hash, std::get<3>(txs.back())))
-          std::get<3>(txs.back()).clear();
+        if (!m_db->get_prunable_tx_blob(tx_hash, std::get<3>(e)))
+          std::get<3>(e).clear();
+        status[i] = tx_found;
       }
-      else
-        missed_txs.push_back(tx_hash);
     }
     catch (const std::exception& e)
     {
-      return false;
+      MERROR("Error retrieving transactions: " << e.what());
     }
+  };
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForIO();
+  const size_t threads = std::min<size_t>(tpool.get_max_concurrency(), (n_txes + GET_TXES_MIN_TXES_PER_THREAD - 1) / GET_TXES_MIN_TXES_PER_THREAD);
+  if (threads > 1)
+  {
+    tools::threadpool::waiter waiter(tpool);
+    const size_t txes_per_thread = (n_txes + threads - 1) / threads;
+    for (size_t start = 0; start < n_txes; start += txes_per_thread)
+      tpool.submit(&waiter, [&get_txes, start, end = std::min(start + txes_per_thread, n_txes)]() { get_txes(start, end); });
+    if (!waiter.wait())
+      return false;
+  }
+  else
+  {
+    get_txes(0, n_txes);
+  }
+
+  reserve_container(txs, n_txes);
+  for (size_t i = 0; i < n_txes; ++i)
+  {
+    if (status[i] == tx_error)
+      return false;
+    if (status[i] == tx_missed)
+      missed_txs.push_back(txs_ids[i]);
+    else
+      txs.push_back(std::move(entries[i]));
   }
   return true;
 }
@@ -3414,6 +3540,7 @@ bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_pr
 bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height) const
 {
   PERF_TIMER(check_tx_inputs);
+  TRACE_SPAN_ARG(check_tx_inputs, tx.vin.size());
   LOG_PRINT_L3("Blockchain::" << __func__);
   size_t sig_index = 0;
   if(pmax_used_block_height)
@@ -4092,11 +4219,13 @@ bool Blockchain::check_tx_input(size_t tx_version, const txin_to_key& txin, cons
 
   // collect output keys
   outputs_visitor vi(output_keys, *this, hf_version);
+  TRACE_SPAN_ARG(ring_fetch, txin.key_offsets.size());
   if (!scan_outputkeys_for_indexes(tx_version, txin, vi, tx_prefix_hash, pmax_related_block_height))
   {
     MERROR_VER("Failed to get output keys for tx with amount = " << print_money(txin.amount) << " and count indexes " << txin.key_offsets.size());
     return false;
   }
+  TRACE_SPAN_STOP(ring_fetch);
 
   if(txin.key_offsets.size() != output_keys.size())
   {
@@ -4255,6 +4384,10 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
   TIME_MEASURE_START(block_processing_time);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   TIME_MEASURE_START(t1);
+  TRACE_SPAN_ARG(handle_block_to_main_chain, m_db->height());
+  TRACE_SPAN_DECLARE(block_pow);
+  TRACE_SPAN_DECLARE(block_txs);
+  TRACE_SPAN_DECLARE(block_db_add);
 
   static bool seen_future_version = false;
 
@@ -4318,6 +4451,7 @@ leave:
   TIME_MEASURE_FINISH(target_calculating_time);
 
   TIME_MEASURE_START(longhash_calculating_time);
+  TRACE_SPAN_START(block_pow);
 
   crypto::hash proof_of_work;
   memset(proof_of_work.data, 0xff, sizeof(proof_of_work.data));
@@ -4387,10 +4521,12 @@ leave:
   }
 
   TIME_MEASURE_FINISH(longhash_calculating_time);
+  TRACE_SPAN_STOP(block_pow);
   if (precomputed)
     longhash_calculating_time += m_fake_pow_calc_time;
 
   TIME_MEASURE_START(t3);
+  TRACE_SPAN_START_ARG(block_txs, bl.tx_hashes.size());
 
   // sanity check basic miner tx properties;
   if(!prevalidate_miner_transaction(bl, blockchain_height, hf_version))
@@ -4566,8 +4702,10 @@ leave:
   if(precomputed)
     block_processing_time += m_fake_pow_calc_time;
 
+  TRACE_SPAN_STOP(block_txs);
   rtxn_guard.stop();
   TIME_MEASURE_START(addblock);
+  TRACE_SPAN_START(block_db_add);
   uint64_t new_height = 0;
   if (!bvc.m_verifivation_failed)
   {
@@ -4601,6 +4739,7 @@ leave:
   }
 
   TIME_MEASURE_FINISH(addblock);
+  TRACE_SPAN_STOP(block_db_add);
 
   // do this after updating the hard fork state since the weight limit may change due to fork
   if (!update_next_cumulative_weight_limit())
@@ -4680,6 +4819,88 @@ bool Blockchain::check_blockchain_pruning()
   return m_db->check_pruning();
 }
 //------------------------------------------------------------------
+bool Blockchain::start_background_pruning(uint32_t pruning_seed, bool compact)
+{
+  boost::unique_lock<boost::mutex> lock(m_pruning_lock);
+  if (m_pruning_status.running)
+    return false;
+  if (m_pruning_thread.joinable())
+    m_pruning_thread.join();
+  m_pruning_status = background_pruning_status();
+  m_pruning_status.running = true;
+  m_pruning_thread = boost::thread(&Blockchain::background_pruning, this, pruning_seed, compact);
+  return true;
+}
+//------------------------------------------------------------------
+Blockchain::background_pruning_status Blockchain::get_background_pruning_status() const
+{
+  boost::unique_lock<boost::mutex> lock(m_pruning_lock);
+  return m_pruning_status;
+}
+//------------------------------------------------------------------
+void Blockchain::background_pruning(uint32_t pruning_seed, bool compact)
+{
+  pruning_progress_t progress;
+  try
+  {
+    while (!progress.done && !m_cancel)
+    {
+      {
+        m_tx_pool.lock();
+        epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
+        CRITICAL_REGION_LOCAL(m_blockchain_lock);
+        if (!m_db->prune_blockchain_step(progress, pruning_seed, BACKGROUND_PRUNING_BATCH_SIZE))
+          throw std::runtime_error("Failed to prune blockchain");
+      }
+      {
+        boost::unique_lock<boost::mutex> lock(m_pruning_lock);
+        m_pruning_status.progress = progress;
+      }
+      if (!progress.done)
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(BACKGROUND_PRUNING_BATCH_INTERVAL_MS));
+    }
+
+    if (progress.done && compact && !m_cancel)
+    {
+      // the copy takes a consistent snapshot and needs no lock
+      const std::string folder = boost::filesystem::path(m_db->get_filenames()[0]).parent_path().string();
+      const std::string path = folder + "-compacted";
+      {
+        boost::unique_lock<boost::mutex> lock(m_pruning_lock);
+        m_pruning_status.compacting = true;
+        m_pruning_status.compacted_path = path;
+      }
+      boost::system::error_code ec;
+      if (!boost::filesystem::create_directories(path, ec) && !boost::filesystem::is_empty(path, ec))
+        throw std::runtime_error("Compaction target " + path + " already exists and is not empty");
+      // a resize cancels the copy, which then starts over
+      for (size_t attempt = 1; !m_cancel; ++attempt)
+      {
+        if (m_db->copy_compacted(path))
+        {
+          MGINFO("Compacted blockchain written to " << path << ", it can replace " << folder << " once the daemon is stopped");
+          break;
+        }
+        if (m_cancel)
+          break;
+        if (attempt == BACKGROUND_COMPACTION_ATTEMPTS)
+          throw std::runtime_error("Compaction was interrupted by database resizes too often, try again once synced");
+        MINFO("Compaction interrupted by a database resize, starting over");
+      }
+    }
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Background pruning failed: " << e.what());
+    boost::unique_lock<boost::mutex> lock(m_pruning_lock);
+    m_pruning_status.error = e.what();
+  }
+
+  boost::unique_lock<boost::mutex> lock(m_pruning_lock);
+  m_pruning_status.running = false;
+  m_pruning_status.compacting = false;
+}
+//------------------------------------------------------------------
 // returns min(Mb, 1.7*Ml) as per https://github.com/ArticMine/Monero-Documents/blob/master/MoneroScaling2021-02.pdf from HF_VERSION_LONG_TERM_BLOCK_WEIGHT
 uint64_t Blockchain::get_next_long_term_block_weight(uint64_t block_weight) const
 {
@@ -5328,7 +5549,13 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
             return false; \
         } while(0); \
 
-  // generate sorted tables for all amounts and absolute offsets
+  // parse all txes first, so their prefix hashes can be computed in one batch
+  // straight from the blobs rather than by reserializing each prefix
+  std::vector<const void*> prefix_data;
+  std::vector<size_t> prefix_size;
+  std::vector<crypto::hash> prefix_hashes(total_txs);
+  prefix_data.reserve(total_txs);
+  prefix_size.reserve(total_txs);
   size_t tx_index = 0, block_index = 0;
   for (const auto &entry : blocks_entry)
   {
@@ -5340,12 +5567,33 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       if (tx_index >= txes.size())
         SCAN_TABLE_QUIT("tx_index is out of sync");
       transaction &tx = txes[tx_index].first;
-      crypto::hash &tx_prefix_hash = txes[tx_index].second;
       ++tx_index;
 
       if (!parse_and_validate_tx_base_from_blob(tx_blob.blob, tx))
         SCAN_TABLE_QUIT("Could not parse tx from incoming blocks.");
-      cryptonote::get_transaction_prefix_hash(tx, tx_prefix_hash);
+      if (tx.prefix_size > tx_blob.blob.size())
+        SCAN_TABLE_QUIT("Inconsistent tx prefix size from incoming blocks.");
+      prefix_data.push_back(tx_blob.blob.data());
+      prefix_size.push_back(tx.prefix_size);
+    }
+  }
+  crypto::cn_fast_hash_multi(prefix_data.data(), prefix_size.data(), prefix_data.size(), prefix_hashes.data());
+
+  // generate sorted tables for all amounts and absolute offsets
+  tx_index = 0;
+  for (const auto &entry : blocks_entry)
+  {
+    if (m_cancel)
+      return false;
+
+    for (size_t i = 0; i < entry.txs.size(); ++i)
+    {
+      if (tx_index >= txes.size())
+        SCAN_TABLE_QUIT("tx_index is out of sync");
+      const transaction &tx = txes[tx_index].first;
+      crypto::hash &tx_prefix_hash = txes[tx_index].second;
+      tx_prefix_hash = prefix_hashes[tx_index];
+      ++tx_index;
 
       auto its = m_scan_table.find(tx_prefix_hash);
       if (its != m_scan_table.end())
@@ -318,6 +318,18 @@ namespace cryptonote
      */
     crypto::hash get_tail_id(uint64_t& height) const;
 
+    /**
+     * @brief get the height and hash of the most recent block, without taking the blockchain lock
+     *
+     * The block may be popped or followed by another one by the time the
+     * caller looks at it, so this is only for callers which tolerate that.
+     *
+     * @param height return-by-reference variable to store the height in
+     *
+     * @return the hash
+     */
+    crypto::hash get_tail_id_unlocked(uint64_t& height) const;
+
     /**
      * @brief returns the difficulty target the next block to be added must meet
      *
@@ -1071,6 +1083,38 @@ namespace cryptonote
     bool update_blockchain_pruning();
     bool check_blockchain_pruning();
 
+    /**
+     * @brief the state of the background pruning run, if any
+     */
+    struct background_pruning_status
+    {
+      bool running;
+      bool compacting;
+      pruning_progress_t progress;
+      std::string compacted_path;
+      std::string error;
+
+      background_pruning_status(): running(false), compacting(false) {}
+    };
+
+    /**
+     * @brief starts pruning the blockchain in place in the background
+     *
+     * Each batch takes the blockchain lock only for a short write, so the
+     * daemon keeps syncing and serving while pruning goes on.
+     *
+     * @param pruning_seed the seed to use, 0 for default (highly recommended)
+     * @param compact whether to write a compacted copy of the database once pruned
+     *
+     * @return false if a background pruning run is already in progress
+     */
+    bool start_background_pruning(uint32_t pruning_seed = 0, bool compact = false);
+
+    /**
+     * @brief gets the state of the last background pruning run
+     */
+    background_pruning_status get_background_pruning_status() const;
+
     void lock();
     void unlock();
 
@@ -1235,6 +1279,11 @@ namespace cryptonote
     // cache for verifying transaction RCT non semantics
     mutable rct_ver_cache_t m_rct_ver_cache;
 
+    // background pruning
+    boost::thread m_pruning_thread;
+    mutable boost::mutex m_pruning_lock;
+    background_pruning_status m_pruning_status;
+
     /**
      * @brief collects the keys for all outputs being "spent" as an input
      *
@@ -1587,6 +1636,11 @@ namespace cryptonote
      */
     void load_compiled_in_block_hashes(const GetCheckpointsCallback& get_checkpoints);
 
+    /**
+     * @brief the background pruning thread, see start_background_pruning
+     */
+    void background_pruning(uint32_t pruning_seed, bool compact);
+
     /**
      * @brief invalidates any cached block template
      */
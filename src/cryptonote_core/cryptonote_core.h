@@ -348,6 +348,13 @@ namespace cryptonote
       */
      void get_blockchain_top(uint64_t& height, crypto::hash& top_id) const;
 
+     /**
+      * @copydoc Blockchain::get_tail_id_unlocked
+      *
+      * @note see Blockchain::get_tail_id_unlocked
+      */
+     void get_blockchain_top_unlocked(uint64_t& height, crypto::hash& top_id) const;
+
      /**
       * @copydoc Blockchain::get_blocks(uint64_t, size_t, std::vector<std::pair<cryptonote::blobdata,block>>&, std::vector<transaction>&) const
       *
@@ -564,6 +571,13 @@ namespace cryptonote
       */
      size_t get_pool_transactions_count(bool include_sensitive_txes = false) const;
 
+     /**
+      * @copydoc tx_memory_pool::cookie
+      *
+      * @note see tx_memory_pool::cookie
+      */
+     uint64_t get_pool_cookie() const;
+
      /**
       * @copydoc Blockchain::get_total_transactions
       *
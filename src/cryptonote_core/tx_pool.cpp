@@ -45,6 +45,7 @@
 #include "misc_language.h"
 #include "warnings.h"
 #include "common/perf_timer.h"
+#include "common/trace.h"
 #include "crypto/hash.h"
 #include "crypto/duration.h"
 
@@ -149,6 +150,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
     PERF_TIMER(add_tx);
+    TRACE_SPAN_ARG(add_tx, tx_weight);
     if (tx.version == 0)
     {
       // v0 never accepted
@@ -719,12 +721,12 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
 
-    m_blockchain.for_all_txpool_txes([this, &hashes, &txes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
+    const std::unordered_set<crypto::hash> known(hashes.begin(), hashes.end());
+    m_blockchain.for_all_txpool_txes([this, &known, &txes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
       const auto tx_relay_method = meta.get_relay_method();
       if (tx_relay_method != relay_method::block && tx_relay_method != relay_method::fluff)
         return true;
-      const auto i = std::find(hashes.begin(), hashes.end(), txid);
-      if (i == hashes.end())
+      if (known.find(txid) == known.end())
       {
         cryptonote::blobdata bd;
         try
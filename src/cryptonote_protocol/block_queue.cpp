@@ -405,6 +405,30 @@ size_t block_queue::get_data_size() const
   return size;
 }
 
+size_t block_queue::get_expected_data_size() const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  // spans still being downloaded will take about as much per block as what we already have
+  const float block_size = get_average_block_size_internal();
+  size_t size = 0;
+  for (const auto &span: blocks)
+    size += span.blocks.empty() ? (size_t)(span.nblocks * block_size) : span.size;
+  return size;
+}
+
+float block_queue::get_average_block_size_internal() const
+{
+  uint64_t size = 0, nblocks = 0;
+  for (const auto &span: blocks)
+  {
+    if (span.blocks.empty())
+      continue;
+    size += span.size;
+    nblocks += span.nblocks;
+  }
+  return nblocks ? size / (float)nblocks : 0.0f;
+}
+
 size_t block_queue::get_num_filled_spans_prefix() const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
@@ -521,6 +545,23 @@ float block_queue::get_download_rate(const boost::uuids::uuid &connection_id) co
   return conn_rate;
 }
 
+uint64_t block_queue::get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_blocks, uint64_t min_blocks, uint64_t max_blocks, float target_seconds) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  CHECK_AND_ASSERT_THROW_MES(min_blocks > 0 && min_blocks <= max_blocks, "Invalid span size bounds");
+
+  // size the span so that this peer should deliver it in about target_seconds,
+  // given its measured rate and the current size of blocks
+  const float block_size = get_average_block_size_internal();
+  const float rate = get_download_rate(connection_id);
+  uint64_t nblocks = default_blocks;
+  if (block_size > 0.0f && rate > 0.0f)
+    nblocks = rate * target_seconds / block_size;
+  nblocks = std::min(max_blocks, std::max(min_blocks, nblocks));
+  MTRACE("Span size for " << connection_id << ": " << nblocks << " (" << rate << " b/s, " << block_size << " bytes/block)");
+  return nblocks;
+}
+
 bool block_queue::foreach(std::function<bool(const span&)> f) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
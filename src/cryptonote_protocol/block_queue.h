@@ -89,12 +89,14 @@ namespace cryptonote
     bool has_next_span(const boost::uuids::uuid &connection_id, bool &filled, boost::posix_time::ptime &time) const;
     bool has_next_span(uint64_t height, bool &filled, boost::posix_time::ptime &time, boost::uuids::uuid &connection_id) const;
     size_t get_data_size() const;
+    size_t get_expected_data_size() const;
     size_t get_num_filled_spans_prefix() const;
     size_t get_num_filled_spans() const;
     crypto::hash get_last_known_hash(const boost::uuids::uuid &connection_id) const;
     bool has_spans(const boost::uuids::uuid &connection_id) const;
     float get_speed(const boost::uuids::uuid &connection_id) const;
     float get_download_rate(const boost::uuids::uuid &connection_id) const;
+    uint64_t get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_blocks, uint64_t min_blocks, uint64_t max_blocks, float target_seconds) const;
     bool foreach(std::function<bool(const span&)> f) const;
     bool requested(const crypto::hash &hash) const;
     bool have(const crypto::hash &hash) const;
@@ -102,6 +104,7 @@ namespace cryptonote
   private:
     void erase_block(block_map::iterator j);
     inline bool requested_internal(const crypto::hash &hash) const;
+    float get_average_block_size_internal() const;
 
   private:
     block_map blocks;
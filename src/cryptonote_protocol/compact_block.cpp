@@ -0,0 +1,107 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#include <cstring>
+#include <unordered_map>
+#include <sodium/crypto_shorthash.h>
+#include "int-util.h"
+#include "compact_block.h"
+
+namespace
+{
+  struct short_id_key
+  {
+    unsigned char data[crypto_shorthash_KEYBYTES];
+  };
+
+  short_id_key get_short_id_key(const crypto::hash &block_hash, uint64_t salt)
+  {
+    static_assert(crypto_shorthash_KEYBYTES <= sizeof(crypto::hash), "Short id key too large");
+    char data[sizeof(crypto::hash) + sizeof(salt)];
+    memcpy(data, block_hash.data, sizeof(crypto::hash));
+    salt = SWAP64LE(salt);
+    memcpy(data + sizeof(crypto::hash), &salt, sizeof(salt));
+    const crypto::hash h = crypto::cn_fast_hash(data, sizeof(data));
+    short_id_key key;
+    memcpy(key.data, h.data, sizeof(key.data));
+    return key;
+  }
+
+  uint64_t get_short_id(const crypto::hash &tx_hash, const short_id_key &key)
+  {
+    static_assert(crypto_shorthash_BYTES == sizeof(uint64_t), "Unexpected short hash size");
+    uint64_t id;
+    crypto_shorthash((unsigned char*)&id, (const unsigned char*)tx_hash.data, sizeof(tx_hash.data), key.data);
+    return SWAP64LE(id) & ((uint64_t(1) << (8 * cryptonote::COMPACT_BLOCK_SHORT_ID_SIZE)) - 1);
+  }
+}
+
+namespace cryptonote
+{
+  std::string get_compact_block_short_ids(const std::vector<crypto::hash> &tx_hashes, const crypto::hash &block_hash, uint64_t salt)
+  {
+    const short_id_key key = get_short_id_key(block_hash, salt);
+    std::string short_ids;
+    short_ids.reserve(tx_hashes.size() * COMPACT_BLOCK_SHORT_ID_SIZE);
+    for (const crypto::hash &h: tx_hashes)
+    {
+      const uint64_t id = SWAP64LE(get_short_id(h, key));
+      short_ids.append((const char*)&id, COMPACT_BLOCK_SHORT_ID_SIZE);
+    }
+    return short_ids;
+  }
+
+  std::vector<crypto::hash> resolve_compact_block_short_ids(const std::string &short_ids, const std::vector<crypto::hash> &candidates, const crypto::hash &block_hash, uint64_t salt)
+  {
+    if (short_ids.size() % COMPACT_BLOCK_SHORT_ID_SIZE)
+      return {};
+
+    // ambiguous ids map to the null hash, so they end up being requested in full
+    const short_id_key key = get_short_id_key(block_hash, salt);
+    std::unordered_map<uint64_t, crypto::hash> by_short_id;
+    by_short_id.reserve(candidates.size());
+    for (const crypto::hash &h: candidates)
+    {
+      const auto res = by_short_id.emplace(get_short_id(h, key), h);
+      if (!res.second && res.first->second != h)
+        res.first->second = crypto::null_hash;
+    }
+
+    std::vector<crypto::hash> hashes;
+    hashes.reserve(short_ids.size() / COMPACT_BLOCK_SHORT_ID_SIZE);
+    for (size_t offset = 0; offset < short_ids.size(); offset += COMPACT_BLOCK_SHORT_ID_SIZE)
+    {
+      uint64_t id = 0;
+      memcpy(&id, short_ids.data() + offset, COMPACT_BLOCK_SHORT_ID_SIZE);
+      const auto i = by_short_id.find(SWAP64LE(id));
+      hashes.push_back(i == by_short_id.end() ? crypto::null_hash : i->second);
+    }
+    return hashes;
+  }
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  //! Size in bytes of a short tx id in a NOTIFY_NEW_COMPACT_BLOCK
+  constexpr const std::size_t COMPACT_BLOCK_SHORT_ID_SIZE = 6;
+
+  /*! Short ids for the given tx hashes, salted by the block hash and a per relay salt.
+
+      \return `COMPACT_BLOCK_SHORT_ID_SIZE` bytes per tx hash, in order. */
+  std::string get_compact_block_short_ids(const std::vector<crypto::hash> &tx_hashes, const crypto::hash &block_hash, uint64_t salt);
+
+  /*! Find which of `candidates` each of `short_ids` stands for.
+
+      \return One hash per short id, `crypto::null_hash` if no candidate, or more
+        than one, has that short id. Empty if `short_ids` is not a whole number of ids. */
+  std::vector<crypto::hash> resolve_compact_block_short_ids(const std::string &short_ids, const std::vector<crypto::hash> &candidates, const crypto::hash &block_hash, uint64_t salt);
+}
@@ -35,7 +35,9 @@
 #pragma once
 
 #include <boost/program_options/variables_map.hpp>
+#include <list>
 #include <string>
+#include <unordered_set>
 
 #include "byte_slice.h"
 #include "math_helper.h"
@@ -44,6 +46,8 @@
 #include "cryptonote_protocol_defs.h"
 #include "cryptonote_protocol_handler_common.h"
 #include "block_queue.h"
+#include "compact_block.h"
+#include "txpool_sketch.h"
 #include "common/perf_timer.h"
 #include "cryptonote_basic/connection_context.h"
 #include "net/levin_base.h"
@@ -95,6 +99,9 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_NEW_FLUFFY_BLOCK, &cryptonote_protocol_handler::handle_notify_new_fluffy_block)			
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, &cryptonote_protocol_handler::handle_request_fluffy_missing_tx)						
       HANDLE_NOTIFY_T2(NOTIFY_GET_TXPOOL_COMPLEMENT, &cryptonote_protocol_handler::handle_notify_get_txpool_complement)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
+      HANDLE_NOTIFY_T2(NOTIFY_GET_TXPOOL_SKETCH, &cryptonote_protocol_handler::handle_notify_get_txpool_sketch)
+      HANDLE_NOTIFY_T2(NOTIFY_TXPOOL_SKETCH_FAILED, &cryptonote_protocol_handler::handle_notify_txpool_sketch_failed)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -143,6 +150,9 @@ namespace cryptonote
     int handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
     int handle_notify_get_txpool_complement(int command, NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
+    int handle_notify_get_txpool_sketch(int command, NOTIFY_GET_TXPOOL_SKETCH::request& arg, cryptonote_connection_context& context);
+    int handle_notify_txpool_sketch_failed(int command, NOTIFY_TXPOOL_SKETCH_FAILED::request& arg, cryptonote_connection_context& context);
 		
     //----------------- i_bc_protocol_layout ---------------------------------------
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
@@ -165,6 +175,10 @@ namespace cryptonote
     void notify_new_stripe(cryptonote_connection_context &context, uint32_t stripe);
     size_t skip_unneeded_hashes(cryptonote_connection_context& context, bool check_block_queue) const;
     bool request_txpool_complement(cryptonote_connection_context &context);
+    bool request_txpool_sketch(cryptonote_connection_context &context, uint64_t difference);
+    bool reconcile_txpool();
+    bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::unordered_set<crypto::hash> &prefill);
+    bool make_compact_block(const NOTIFY_NEW_BLOCK::request& arg, const std::unordered_set<crypto::hash> &prefill, NOTIFY_NEW_COMPACT_BLOCK::request& compact_arg);
     void hit_score(cryptonote_connection_context &context, int32_t score);
 
     t_core& m_core;
@@ -182,6 +196,7 @@ namespace cryptonote
     epee::math_helper::once_a_time_milliseconds<100> m_standby_checker;
     epee::math_helper::once_a_time_seconds<101> m_sync_search_checker;
     epee::math_helper::once_a_time_seconds<43> m_bad_peer_checker;
+    epee::math_helper::once_a_time_seconds<127> m_txpool_reconciler;
     std::unordered_map<epee::net_utils::zone, unsigned int> m_max_out_peers;
     mutable epee::critical_section m_max_out_peers_lock;
     tools::PerformanceTimer m_sync_timer, m_add_timer;
@@ -205,6 +220,18 @@ namespace cryptonote
 
     boost::mutex m_bad_peer_check_lock;
 
+    // recently served NOTIFY_RESPONSE_GET_OBJECTS payloads, most recent first, so
+    // peers syncing the same range do not each cause the blocks to be read and encoded
+    struct get_objects_response_t
+    {
+      crypto::hash key;
+      epee::byte_slice payload;
+    };
+    boost::mutex m_get_objects_cache_lock;
+    std::list<get_objects_response_t> m_get_objects_cache;
+    size_t m_get_objects_cache_size;
+    crypto::hash get_objects_cache_key(const NOTIFY_REQUEST_GET_OBJECTS::request& arg);
+
     template<class t_parameter>
       bool post_notify(typename t_parameter::request& arg, cryptonote_connection_context& context)
       {
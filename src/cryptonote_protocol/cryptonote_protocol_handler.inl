@@ -41,6 +41,7 @@
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "profile_tools.h"
 #include "net/network_throttle-detail.hpp"
+#include "common/metrics.h"
 #include "common/pruning.h"
 #include "common/util.h"
 
@@ -62,8 +63,8 @@
 #define MLOG_PEER_STATE(x) \
   MCINFO(MONERO_DEFAULT_LOG_CATEGORY, context << "[" << epee::string_tools::to_string_hex(context.m_pruning_seed) << "] state: " << x << " in state " << cryptonote::get_protocol_state_string(context.m_state))
 
-#define BLOCK_QUEUE_NSPANS_THRESHOLD 10 // chunks of N blocks
 #define BLOCK_QUEUE_SIZE_THRESHOLD (100*1024*1024) // MB
+#define BLOCK_QUEUE_SPAN_TARGET_TIME 3.0f // seconds
 #define BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS 1000
 #define REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD_STANDBY (5 * 1000000) // microseconds
 #define REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD (30 * 1000000) // microseconds
@@ -73,6 +74,10 @@
 #define DROP_ON_SYNC_WEDGE_THRESHOLD (30 * 1000000000ull) // nanoseconds
 #define LAST_ACTIVITY_STALL_THRESHOLD (2.0f) // seconds
 #define DROP_PEERS_ON_SCORE -2
+#define GET_OBJECTS_CACHE_MAX_SIZE (64*1024*1024) // bytes
+#define GET_OBJECTS_CACHE_MAX_ENTRIES 32
+#define TXPOOL_SKETCH_MIN_DIFFERENCE 16
+#define TXPOOL_SKETCH_DIFFERENCE_RATIO 32 // pool txes per expected difference
 
 namespace cryptonote
 {
@@ -87,7 +92,8 @@ namespace cryptonote
                                                                                                               m_synchronized(offline),
                                                                                                               m_ask_for_txpool_complement(true),
                                                                                                               m_stopping(false),
-                                                                                                              m_no_sync(false)
+                                                                                                              m_no_sync(false),
+                                                                                                              m_get_objects_cache_size(0)
 
   {
     if(!m_p2p)
@@ -598,6 +604,10 @@ namespace cryptonote
       transaction tx;
       crypto::hash tx_hash;
 
+      // the txes which came with the block, they're likely missing from our
+      // peers' pools too, so we pass them along if relaying compact blocks
+      std::unordered_set<crypto::hash> received_txes;
+
       for(auto& tx_blob: arg.b.txs)
       {
         if(parse_and_validate_tx_from_blob(tx_blob.blob, tx))
@@ -657,6 +667,7 @@ namespace cryptonote
             
             context.m_requested_objects.erase(req_tx_it);
           }          
+          received_txes.insert(tx_hash);
           
           // we might already have the tx that the peer
           // sent in our pool, so don't verify again..
@@ -806,7 +817,7 @@ namespace cryptonote
           NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
           reg_arg.current_blockchain_height = arg.current_blockchain_height;
           reg_arg.b = b;
-          relay_block(reg_arg, context);
+          relay_block(reg_arg, context, received_txes);
         }
         else if( bvc.m_marked_as_orphaned )
         {
@@ -946,6 +957,114 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK " << arg.block_hash << " (height " << arg.current_blockchain_height << ", "
+        << arg.short_ids.size() / COMPACT_BLOCK_SHORT_ID_SIZE << " short ids, " << arg.b.txs.size() << " prefilled txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized()) // can happen if a peer connection goes to normal but another thread still hasn't finished adding queued blocks
+    {
+      LOG_DEBUG_CC(context, "Received new block while syncing, ignored");
+      return 1;
+    }
+
+    // the block blob comes without its tx hashes, the receiver rebuilds them
+    // from the prefilled txes and the short ids
+    block b;
+    if (!parse_and_validate_block_from_blob(arg.b.block, b) || !b.tx_hashes.empty()
+        || arg.short_ids.size() % COMPACT_BLOCK_SHORT_ID_SIZE || arg.prefilled_tx_indices.size() != arg.b.txs.size())
+    {
+      LOG_ERROR_CCONTEXT("sent invalid compact block, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+    const size_t n_txes = arg.short_ids.size() / COMPACT_BLOCK_SHORT_ID_SIZE + arg.b.txs.size();
+    if (n_txes > CRYPTONOTE_MAX_TX_PER_BLOCK)
+    {
+      LOG_ERROR_CCONTEXT("sent compact block with too many txes, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    std::vector<crypto::hash> tx_hashes(n_txes, crypto::null_hash);
+    std::vector<bool> prefilled(n_txes, false);
+    for (size_t i = 0; i < arg.prefilled_tx_indices.size(); ++i)
+    {
+      const uint64_t tx_idx = arg.prefilled_tx_indices[i];
+      transaction tx;
+      if (tx_idx >= n_txes || prefilled[tx_idx] || !parse_and_validate_tx_from_blob(arg.b.txs[i].blob, tx, tx_hashes[tx_idx]))
+      {
+        LOG_ERROR_CCONTEXT("sent compact block with invalid prefilled tx at index " << tx_idx << ", dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      prefilled[tx_idx] = true;
+    }
+
+    static tools::metrics::counter &rebuilt_metric = tools::metrics::get_counter("p2p_compact_blocks_received_total", "Compact blocks received from peers", "result=\"rebuilt\"");
+    static tools::metrics::counter &missing_metric = tools::metrics::get_counter("p2p_compact_blocks_received_total", "Compact blocks received from peers", "result=\"missing_txes\"");
+
+    std::vector<crypto::hash> pool_tx_hashes;
+    m_core.get_pool_transaction_hashes(pool_tx_hashes, false);
+    const std::vector<crypto::hash> resolved = resolve_compact_block_short_ids(arg.short_ids, pool_tx_hashes, arg.block_hash, arg.salt);
+
+    std::vector<uint64_t> need_tx_indices;
+    for (size_t tx_idx = 0, short_idx = 0; tx_idx < n_txes; ++tx_idx)
+    {
+      if (prefilled[tx_idx])
+        continue;
+      tx_hashes[tx_idx] = resolved[short_idx++];
+      if (tx_hashes[tx_idx] == crypto::null_hash)
+        need_tx_indices.push_back(tx_idx);
+    }
+
+    if (need_tx_indices.empty())
+    {
+      b.tx_hashes = tx_hashes;
+      b.invalidate_hashes();
+      if (get_block_hash(b) == arg.block_hash)
+      {
+        MDEBUG("Rebuilt compact block " << arg.block_hash << " from our pool");
+        rebuilt_metric.inc();
+        NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
+        fluffy_arg.b.block = block_to_blob(b);
+        fluffy_arg.b.txs = std::move(arg.b.txs);
+        fluffy_arg.current_blockchain_height = arg.current_blockchain_height;
+        return handle_notify_new_fluffy_block(command, fluffy_arg, context);
+      }
+      // a short id matched the wrong pool tx: asking for no tx gets us the
+      // full fluffy block, and the usual missing tx round trip from there
+      MDEBUG("Compact block " << arg.block_hash << " does not match its rebuilt tx hashes, requesting fluffy block");
+    }
+
+    // the fluffy block we get back won't include the prefilled txes again
+    for (size_t i = 0; i < arg.b.txs.size(); ++i)
+    {
+      if (m_core.pool_has_tx(tx_hashes[arg.prefilled_tx_indices[i]]))
+        continue;
+      const auto &tx_blob = arg.b.txs[i];
+      cryptonote::tx_verification_context tvc{};
+      if (!m_core.handle_incoming_tx(tx_blob, tvc, relay_method::block, true) || tvc.m_verifivation_failed)
+      {
+        LOG_PRINT_CCONTEXT_L1("Block verification failed: transaction verification failed, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+    }
+
+    MDEBUG("We are missing " << need_tx_indices.size() << " txes for this compact block");
+    missing_metric.inc();
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    missing_tx_req.missing_tx_indices = std::move(need_tx_indices);
+    MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_FLUFFY_MISSING_TX: missing_tx_indices.size()=" << missing_tx_req.missing_tx_indices.size() );
+    post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_get_txpool_complement(int command, NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_GET_TXPOOL_COMPLEMENT (" << arg.hashes.size() << " txes)");
@@ -976,6 +1095,106 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_get_txpool_sketch(int command, NOTIFY_GET_TXPOOL_SKETCH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_GET_TXPOOL_SKETCH (" << arg.sketch.size() / txpool_sketch::CELL_SIZE << " cells, " << arg.pool_size << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    std::unique_ptr<txpool_sketch> sketch;
+    try
+    {
+      if (arg.sketch.size() % txpool_sketch::CELL_SIZE)
+        throw std::invalid_argument("Invalid txpool sketch size");
+      sketch.reset(new txpool_sketch(arg.sketch.size() / txpool_sketch::CELL_SIZE, arg.salt));
+    }
+    catch (const std::exception &e)
+    {
+      LOG_ERROR_CCONTEXT("sent invalid txpool sketch, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    std::vector<crypto::hash> hashes;
+    if (!m_core.get_pool_transaction_hashes(hashes, false))
+    {
+      LOG_ERROR_CCONTEXT("failed to get txpool hashes");
+      return 1;
+    }
+    std::unordered_map<uint64_t, crypto::hash> by_short_id;
+    by_short_id.reserve(hashes.size());
+    for (const crypto::hash &tx_hash: hashes)
+    {
+      const uint64_t short_id = sketch->get_short_id(tx_hash);
+      if (by_short_id.emplace(short_id, tx_hash).second)
+        sketch->toggle(short_id);
+    }
+
+    std::vector<uint64_t> difference;
+    sketch->subtract(arg.sketch);
+    if (!sketch->decode(difference))
+    {
+      MDEBUG(context << "txpool sketch difference too large to decode, our pool has " << hashes.size() << " txes");
+      NOTIFY_TXPOOL_SKETCH_FAILED::request r;
+      r.pool_size = hashes.size();
+      post_notify<NOTIFY_TXPOOL_SKETCH_FAILED>(r, context);
+      return 1;
+    }
+
+    // ids we don't know are txes the peer has and we don't, they will reach
+    // us when we next reconcile from our side
+    NOTIFY_NEW_TRANSACTIONS::request new_txes;
+    for (const uint64_t short_id: difference)
+    {
+      const auto i = by_short_id.find(short_id);
+      if (i == by_short_id.end())
+        continue;
+      cryptonote::blobdata txblob;
+      if (m_core.get_pool_transaction(i->second, txblob, relay_category::broadcasted))
+        new_txes.txs.push_back(std::move(txblob));
+    }
+    MDEBUG(context << "txpool sketch decoded, difference " << difference.size() << ", sending " << new_txes.txs.size() << " txes");
+    if (new_txes.txs.empty())
+      return 1;
+
+    MLOG_P2P_MESSAGE
+    (
+        "-->>NOTIFY_NEW_TRANSACTIONS: "
+        << ", txs.size()=" << new_txes.txs.size()
+    );
+
+    post_notify<NOTIFY_NEW_TRANSACTIONS>(new_txes, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_txpool_sketch_failed(int command, NOTIFY_TXPOOL_SKETCH_FAILED::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TXPOOL_SKETCH_FAILED (" << arg.pool_size << " txes)");
+    const uint64_t previous_difference = context.m_txpool_sketch_difference;
+    if (previous_difference == 0)
+    {
+      LOG_DEBUG_CC(context, "Received unrequested NOTIFY_TXPOOL_SKETCH_FAILED, ignored");
+      return 1;
+    }
+    context.m_txpool_sketch_difference = 0;
+    if (context.m_state < cryptonote_connection_context::state_synchronizing)
+    {
+      LOG_DEBUG_CC(context, "Received NOTIFY_TXPOOL_SKETCH_FAILED while not ready, ignored");
+      return 1;
+    }
+
+    // the difference is at least the difference in pool sizes, and larger than
+    // what the last sketch could decode
+    std::vector<crypto::hash> hashes;
+    m_core.get_pool_transaction_hashes(hashes, false);
+    const uint64_t size_difference = hashes.size() > arg.pool_size ? hashes.size() - arg.pool_size : arg.pool_size - hashes.size();
+    if (!request_txpool_sketch(context, std::max(previous_difference * 4, size_difference * 2)))
+      LOG_ERROR_CCONTEXT("Failed to request txpool complement");
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTIONS (" << arg.txs.size() << " txes)");
@@ -1091,6 +1310,24 @@ namespace cryptonote
         return 1;
       }
 
+    const crypto::hash key = get_objects_cache_key(arg);
+    {
+      boost::unique_lock<boost::mutex> lock(m_get_objects_cache_lock);
+      for (auto i = m_get_objects_cache.begin(); i != m_get_objects_cache.end(); ++i)
+      {
+        if (i->key != key)
+          continue;
+        m_get_objects_cache.splice(m_get_objects_cache.begin(), m_get_objects_cache, i);
+        epee::levin::message_writer out{i->payload.size() + sizeof(epee::levin::message_writer::header)};
+        out.buffer.write(epee::to_span(i->payload));
+        lock.unlock();
+        context.m_last_request_time = boost::posix_time::microsec_clock::universal_time();
+        MLOG_P2P_MESSAGE("-->>NOTIFY_RESPONSE_GET_OBJECTS: cached response, " << out.payload_size() << " bytes");
+        m_p2p->invoke_notify_to_peer(NOTIFY_RESPONSE_GET_OBJECTS::ID, std::move(out), context);
+        return 1;
+      }
+    }
+
     NOTIFY_RESPONSE_GET_OBJECTS::request rsp;
     if(!m_core.handle_get_objects(arg, rsp, context))
     {
@@ -1102,12 +1339,53 @@ namespace cryptonote
     MLOG_P2P_MESSAGE("-->>NOTIFY_RESPONSE_GET_OBJECTS: blocks.size()="
                      << rsp.blocks.size() << ", rsp.m_current_blockchain_height=" << rsp.current_blockchain_height
                      << ", missed_ids.size()=" << rsp.missed_ids.size());
-    post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, context);
+    if (!rsp.missed_ids.empty())
+    {
+      post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, context);
+      return 1;
+    }
+
+    epee::levin::message_writer out{256 * 1024}; // optimize for block responses
+    epee::serialization::store_t_to_binary(rsp, out.buffer);
+    epee::span<const std::uint8_t> encoded = epee::to_span(out.buffer);
+    encoded.remove_prefix(sizeof(epee::levin::message_writer::header));
+    epee::byte_slice payload{{encoded}};
+    if (payload.size() <= GET_OBJECTS_CACHE_MAX_SIZE)
+    {
+      const boost::lock_guard<boost::mutex> lock(m_get_objects_cache_lock);
+      m_get_objects_cache_size += payload.size();
+      m_get_objects_cache.push_front({key, std::move(payload)});
+      while (m_get_objects_cache_size > GET_OBJECTS_CACHE_MAX_SIZE || m_get_objects_cache.size() > GET_OBJECTS_CACHE_MAX_ENTRIES)
+      {
+        m_get_objects_cache_size -= m_get_objects_cache.back().payload.size();
+        m_get_objects_cache.pop_back();
+      }
+    }
+    m_p2p->invoke_notify_to_peer(NOTIFY_RESPONSE_GET_OBJECTS::ID, std::move(out), context);
     //handler_response_blocks_now(sizeof(rsp)); // XXX
     //handler_response_blocks_now(200);
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  crypto::hash t_cryptonote_protocol_handler<t_core>::get_objects_cache_key(const NOTIFY_REQUEST_GET_OBJECTS::request& arg)
+  {
+    // responses depend on the chain, which the top block id stands for. Read
+    // without the blockchain lock, so hits are not held up by block import:
+    // a block added meanwhile only makes the response cached under the old top
+    uint64_t top_height;
+    crypto::hash top_hash;
+    m_core.get_blockchain_top_unlocked(top_height, top_hash);
+
+    std::string data;
+    data.reserve(sizeof(crypto::hash) * (arg.blocks.size() + 1) + 1);
+    data.append(top_hash.data, sizeof(top_hash.data));
+    data.push_back(arg.prune ? 1 : 0);
+    for (const crypto::hash &h: arg.blocks)
+      data.append(h.data, sizeof(h.data));
+    return crypto::cn_fast_hash(data.data(), data.size());
+  }
+  //------------------------------------------------------------------------------------------------------------------------
 
 
   template<class t_core>
@@ -1160,6 +1438,10 @@ namespace cryptonote
     }
     ++m_sync_spans_downloaded;
     m_sync_download_objects_size += size;
+    static tools::metrics::counter &spans_metric = tools::metrics::get_counter("sync_spans_downloaded_total", "Block spans downloaded while syncing");
+    static tools::metrics::counter &bytes_metric = tools::metrics::get_counter("sync_downloaded_bytes_total", "Bytes of blocks downloaded while syncing");
+    spans_metric.inc();
+    bytes_metric.inc(size);
     MDEBUG(context << " downloaded " << size << " bytes worth of blocks");
 
     /*using namespace boost::chrono;
@@ -1770,6 +2052,7 @@ skip:
     m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
     m_standby_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::check_standby_peers, this));
     m_sync_search_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::update_sync_search, this));
+    m_txpool_reconciler.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::reconcile_txpool, this));
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -2113,14 +2396,14 @@ skip:
       do
       {
         size_t nspans = m_block_queue.get_num_filled_spans();
-        size_t size = m_block_queue.get_data_size();
+        size_t size = m_block_queue.get_expected_data_size();
         const uint64_t bc_height = m_core.get_current_blockchain_height();
         const auto next_needed_pruning_stripe = get_next_needed_pruning_stripe();
         const uint32_t add_stripe = tools::get_pruning_stripe(bc_height, context.m_remote_blockchain_height, CRYPTONOTE_PRUNING_LOG_STRIPES);
         const uint32_t peer_stripe = tools::get_pruning_stripe(context.m_pruning_seed);
         const uint32_t local_stripe = tools::get_pruning_stripe(m_core.get_blockchain_pruning_seed());
         const size_t block_queue_size_threshold = m_block_download_max_size ? m_block_download_max_size : BLOCK_QUEUE_SIZE_THRESHOLD;
-        bool queue_proceed = nspans < BLOCK_QUEUE_NSPANS_THRESHOLD || size < block_queue_size_threshold;
+        bool queue_proceed = nspans == 0 || size < block_queue_size_threshold;
         // get rid of blocks we already requested, or already have
         if (skip_unneeded_hashes(context, true) && context.m_needed_objects.empty() && context.m_num_requested == 0)
         {
@@ -2288,7 +2571,13 @@ skip:
         const uint64_t first_block_height = context.m_last_response_height - context.m_needed_objects.size() + 1;
         static const uint64_t bp_fork_height = m_core.get_earliest_ideal_height_for_version(HF_VERSION_SMALLER_BP +1);
         bool sync_pruned_blocks = m_sync_pruned_blocks && first_block_height >= bp_fork_height && m_core.get_blockchain_pruning_seed();
-        span = m_block_queue.reserve_span(first_block_height, context.m_last_response_height, count_limit, context.m_connection_id, context.m_remote_address, sync_pruned_blocks, m_core.get_blockchain_pruning_seed(), context.m_pruning_seed, context.m_remote_blockchain_height, context.m_needed_objects);
+        // size the span after this peer's measured speed, but keep the one the chain is waiting on
+        // no larger than the default, so a slow peer holding it does not stall us for long
+        const uint64_t max_count = std::max<uint64_t>(count_limit, CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT);
+        uint64_t span_count = m_block_queue.get_span_size(context.m_connection_id, count_limit, std::max<uint64_t>(count_limit / 4, 1), max_count, BLOCK_QUEUE_SPAN_TARGET_TIME);
+        if (first_block_height <= m_block_queue.get_next_needed_height(m_core.get_current_blockchain_height()))
+          span_count = std::min<uint64_t>(span_count, count_limit);
+        span = m_block_queue.reserve_span(first_block_height, context.m_last_response_height, span_count, context.m_connection_id, context.m_remote_address, sync_pruned_blocks, m_core.get_blockchain_pruning_seed(), context.m_pruning_seed, context.m_remote_blockchain_height, context.m_needed_objects);
         MDEBUG(context << " span from " << first_block_height << ": " << span.first << "/" << span.second);
         if (span.second > 0)
         {
@@ -2543,7 +2832,8 @@ skip:
           MDEBUG(context << "not ready, ignoring");
           return true;
         }
-        if (!request_txpool_complement(context))
+        const bool requested = (support_flags & P2P_SUPPORT_FLAG_TXPOOL_SKETCH) ? request_txpool_sketch(context, 0) : request_txpool_complement(context);
+        if (!requested)
         {
           MERROR(context << "Failed to request txpool complement");
           return true;
@@ -2733,6 +3023,43 @@ skip:
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
+  {
+    return relay_block(arg, exclude_context, {});
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::make_compact_block(const NOTIFY_NEW_BLOCK::request& arg, const std::unordered_set<crypto::hash> &prefill, NOTIFY_NEW_COMPACT_BLOCK::request& compact_arg)
+  {
+    block b;
+    if (!parse_and_validate_block_from_blob(arg.b.block, b))
+      return false;
+
+    // txes can only be prefilled if we have them all, in block order
+    const bool have_txes = arg.b.txs.size() == b.tx_hashes.size();
+    std::vector<crypto::hash> short_id_tx_hashes;
+    short_id_tx_hashes.reserve(b.tx_hashes.size());
+    for (size_t tx_idx = 0; tx_idx < b.tx_hashes.size(); ++tx_idx)
+    {
+      if (have_txes && prefill.find(b.tx_hashes[tx_idx]) != prefill.end())
+      {
+        compact_arg.prefilled_tx_indices.push_back(tx_idx);
+        compact_arg.b.txs.push_back(arg.b.txs[tx_idx]);
+      }
+      else
+        short_id_tx_hashes.push_back(b.tx_hashes[tx_idx]);
+    }
+
+    compact_arg.block_hash = get_block_hash(b);
+    compact_arg.salt = crypto::rand<uint64_t>();
+    compact_arg.short_ids = get_compact_block_short_ids(short_id_tx_hashes, compact_arg.block_hash, compact_arg.salt);
+    compact_arg.current_blockchain_height = arg.current_blockchain_height;
+    b.tx_hashes.clear();
+    compact_arg.b.block = block_to_blob(b);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::unordered_set<crypto::hash> &prefill)
   {
     NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
     fluffy_arg.current_blockchain_height = arg.current_blockchain_height;    
@@ -2740,14 +3067,19 @@ skip:
     fluffy_arg.b = arg.b;
     fluffy_arg.b.txs = fluffy_txs;
 
-    // sort peers between fluffy ones and others
-    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections;
-    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // sort peers between compact, fluffy ones and others
+    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       // peer_id also filters out connections before handshake
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id && context.m_remote_address.get_zone() == epee::net_utils::zone::public_)
       {
-        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
+        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS) && (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS))
+        {
+          LOG_DEBUG_CC(context, "PEER SUPPORTS COMPACT BLOCKS - RELAYING SHORT TX IDS");
+          compactConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+        }
+        else if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
         {
           LOG_DEBUG_CC(context, "PEER SUPPORTS FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
           fluffyConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
@@ -2761,7 +3093,24 @@ skip:
       return true;
     });
 
-    // send fluffy ones first, we want to encourage people to run that
+    // send compact ones first, they're the smallest and the fastest to relay
+    if (!compactConnections.empty())
+    {
+      static tools::metrics::counter &relayed_metric = tools::metrics::get_counter("p2p_compact_blocks_relayed_total", "Blocks relayed to peers as compact blocks");
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+      if (make_compact_block(arg, prefill, compact_arg))
+      {
+        relayed_metric.inc();
+        epee::levin::message_writer compactBlob{16 * 1024};
+        epee::serialization::store_t_to_binary(compact_arg, compactBlob.buffer);
+        m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, std::move(compactBlob), std::move(compactConnections));
+      }
+      else
+      {
+        MERROR("Failed to make compact block, relaying fluffy block instead");
+        fluffyConnections.insert(fluffyConnections.end(), compactConnections.begin(), compactConnections.end());
+      }
+    }
     if (!fluffyConnections.empty())
     {
       epee::levin::message_writer fluffyBlob{32 * 1024};
@@ -2805,6 +3154,67 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::request_txpool_sketch(cryptonote_connection_context &context, uint64_t difference)
+  {
+    std::vector<crypto::hash> hashes;
+    if (!m_core.get_pool_transaction_hashes(hashes, false))
+    {
+      MERROR("Failed to get txpool hashes");
+      return false;
+    }
+    if (difference == 0)
+      difference = std::max<uint64_t>(TXPOOL_SKETCH_MIN_DIFFERENCE, hashes.size() / TXPOOL_SKETCH_DIFFERENCE_RATIO);
+
+    // a sketch that's not smaller than our hashes is not worth the round trip
+    const size_t cells = txpool_sketch::get_cell_count(difference);
+    if (cells * txpool_sketch::CELL_SIZE >= hashes.size() * sizeof(crypto::hash))
+      return request_txpool_complement(context);
+
+    NOTIFY_GET_TXPOOL_SKETCH::request r;
+    r.salt = crypto::rand<uint64_t>();
+    txpool_sketch sketch(cells, r.salt);
+    for (const crypto::hash &tx_hash: hashes)
+      sketch.toggle(sketch.get_short_id(tx_hash));
+    r.sketch = sketch.serialize();
+    r.pool_size = hashes.size();
+    context.m_txpool_sketch_difference = difference;
+    MLOG_P2P_MESSAGE("-->>NOTIFY_GET_TXPOOL_SKETCH: cells=" << cells << ", pool_size=" << r.pool_size);
+    post_notify<NOTIFY_GET_TXPOOL_SKETCH>(r, context);
+    MLOG_PEER_STATE("requesting txpool sketch");
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::reconcile_txpool()
+  {
+    if (!is_synchronized())
+      return true;
+
+    // catches txes that fluffing missed, from one peer at a time. Each round
+    // starts afresh: a sketch still outstanding from an earlier round is
+    // forgotten, so a late failure for it does not escalate this round's
+    std::vector<boost::uuids::uuid> candidates;
+    m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool
+    {
+      context.m_txpool_sketch_difference = 0;
+      if (context.m_state == cryptonote_connection_context::state_normal && context.m_remote_address.get_zone() == epee::net_utils::zone::public_
+          && (support_flags & P2P_SUPPORT_FLAG_TXPOOL_SKETCH))
+        candidates.push_back(context.m_connection_id);
+      return true;
+    });
+    if (candidates.empty())
+      return true;
+
+    m_p2p->for_connection(candidates[crypto::rand_idx(candidates.size())], [&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool
+    {
+      if (!request_txpool_sketch(context, 0))
+        MERROR(context << "Failed to request txpool sketch");
+      return true;
+    });
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   void t_cryptonote_protocol_handler<t_core>::hit_score(cryptonote_connection_context &context, int32_t score)
   {
     if (score <= 0)
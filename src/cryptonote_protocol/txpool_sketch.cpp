@@ -0,0 +1,172 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+#include <sodium/crypto_shorthash.h>
+#include "int-util.h"
+#include "txpool_sketch.h"
+
+// each id goes in one cell of each quarter of the sketch
+#define TXPOOL_SKETCH_HASHES 4
+
+namespace
+{
+  uint64_t mix(uint64_t x) noexcept
+  {
+    // splitmix64 finalizer, ids are already keyed so this needs no secret
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+  }
+
+  uint32_t get_check(uint64_t id) noexcept
+  {
+    return mix(id ^ 0x9e3779b97f4a7c15ull) >> 32;
+  }
+}
+
+namespace cryptonote
+{
+  std::size_t txpool_sketch::get_cell_count(std::size_t difference) noexcept
+  {
+    // peeling with 4 hashes needs about 1.3 cells per id for large sets, small
+    // ones need proportionally more slack to keep failures well under 1%
+    const std::size_t cells = difference + difference * 2 / 5 + 6 * TXPOOL_SKETCH_HASHES;
+    return (cells + TXPOOL_SKETCH_HASHES - 1) / TXPOOL_SKETCH_HASHES * TXPOOL_SKETCH_HASHES;
+  }
+
+  txpool_sketch::txpool_sketch(std::size_t cells, uint64_t salt)
+    : m_cells(cells, cell{0, 0})
+  {
+    if (cells == 0 || cells % TXPOOL_SKETCH_HASHES)
+      throw std::invalid_argument("Invalid txpool sketch size");
+
+    static_assert(sizeof(m_key) == crypto_shorthash_KEYBYTES, "Unexpected short hash key size");
+    static_assert(sizeof(m_key) <= sizeof(crypto::hash), "Short hash key too large");
+    salt = SWAP64LE(salt);
+    const crypto::hash h = crypto::cn_fast_hash(&salt, sizeof(salt));
+    memcpy(m_key, h.data, sizeof(m_key));
+  }
+
+  uint64_t txpool_sketch::get_short_id(const crypto::hash &tx_hash) const noexcept
+  {
+    static_assert(crypto_shorthash_BYTES == sizeof(uint64_t), "Unexpected short hash size");
+    uint64_t id;
+    crypto_shorthash((unsigned char*)&id, (const unsigned char*)tx_hash.data, sizeof(tx_hash.data), m_key);
+    id = SWAP64LE(id);
+    return id ? id : 1;
+  }
+
+  void txpool_sketch::toggle(uint64_t short_id) noexcept
+  {
+    const std::size_t part = m_cells.size() / TXPOOL_SKETCH_HASHES;
+    const uint32_t check = get_check(short_id);
+    for (std::size_t i = 0; i < TXPOOL_SKETCH_HASHES; ++i)
+    {
+      cell &c = m_cells[i * part + mix(short_id + i) % part];
+      c.id_xor ^= short_id;
+      c.check_xor ^= check;
+    }
+  }
+
+  std::string txpool_sketch::serialize() const
+  {
+    std::string blob;
+    blob.resize(m_cells.size() * CELL_SIZE);
+    char *ptr = &blob[0];
+    for (const cell &c: m_cells)
+    {
+      const uint64_t id_xor = SWAP64LE(c.id_xor);
+      const uint32_t check_xor = SWAP32LE(c.check_xor);
+      memcpy(ptr, &id_xor, sizeof(id_xor));
+      memcpy(ptr + sizeof(id_xor), &check_xor, sizeof(check_xor));
+      ptr += CELL_SIZE;
+    }
+    return blob;
+  }
+
+  bool txpool_sketch::subtract(const std::string &blob) noexcept
+  {
+    if (blob.size() != m_cells.size() * CELL_SIZE)
+      return false;
+    const char *ptr = blob.data();
+    for (cell &c: m_cells)
+    {
+      uint64_t id_xor;
+      uint32_t check_xor;
+      memcpy(&id_xor, ptr, sizeof(id_xor));
+      memcpy(&check_xor, ptr + sizeof(id_xor), sizeof(check_xor));
+      c.id_xor ^= SWAP64LE(id_xor);
+      c.check_xor ^= SWAP32LE(check_xor);
+      ptr += CELL_SIZE;
+    }
+    return true;
+  }
+
+  bool txpool_sketch::decode(std::vector<uint64_t> &short_ids)
+  {
+    // a cell is pure when it holds a single id, removing that id from its other
+    // cells may make those pure in turn
+    std::vector<std::size_t> pure;
+    for (std::size_t i = 0; i < m_cells.size(); ++i)
+      if (m_cells[i].id_xor && m_cells[i].check_xor == get_check(m_cells[i].id_xor))
+        pure.push_back(i);
+
+    std::unordered_set<uint64_t> seen;
+    while (!pure.empty())
+    {
+      const cell &c = m_cells[pure.back()];
+      pure.pop_back();
+      const uint64_t id = c.id_xor;
+      if (!id || c.check_xor != get_check(id))
+        continue;
+      if (!seen.insert(id).second)
+        return false;
+      short_ids.push_back(id);
+
+      toggle(id);
+      const std::size_t part = m_cells.size() / TXPOOL_SKETCH_HASHES;
+      for (std::size_t i = 0; i < TXPOOL_SKETCH_HASHES; ++i)
+      {
+        const std::size_t idx = i * part + mix(id + i) % part;
+        if (m_cells[idx].id_xor && m_cells[idx].check_xor == get_check(m_cells[idx].id_xor))
+          pure.push_back(idx);
+      }
+    }
+
+    for (const cell &c: m_cells)
+      if (c.id_xor || c.check_xor)
+        return false;
+    return true;
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /*! Invertible bloom lookup table over salted 64 bit short tx ids.
+
+      Two peers with a sketch of the same size and salt can find the symmetric
+      difference of their pools from one sketch, by subtracting it from their
+      own and peeling ids off the result. The sketch size only depends on how
+      large a difference must be decodable, not on the pool size. */
+  class txpool_sketch
+  {
+  public:
+    //! Serialized size of a cell
+    static constexpr const std::size_t CELL_SIZE = 12;
+
+    //! \return Cell count decoding a difference of `difference` ids with high probability.
+    static std::size_t get_cell_count(std::size_t difference) noexcept;
+
+    //! \throw std::invalid_argument if `cells` is 0 or not a multiple of 4.
+    txpool_sketch(std::size_t cells, uint64_t salt);
+
+    //! \return Salted short id for `tx_hash`, never 0.
+    uint64_t get_short_id(const crypto::hash &tx_hash) const noexcept;
+
+    //! Adds, or removes if already added, `short_id`.
+    void toggle(uint64_t short_id) noexcept;
+
+    std::size_t get_cell_count() const noexcept { return m_cells.size(); }
+
+    std::string serialize() const;
+
+    //! \return False if `blob` is not a sketch of the same size.
+    bool subtract(const std::string &blob) noexcept;
+
+    /*! Peels the sketch, which is left empty on success.
+
+        \return False if the difference is too large to decode. */
+    bool decode(std::vector<uint64_t> &short_ids);
+
+  private:
+    struct cell
+    {
+      uint64_t id_xor;
+      uint32_t check_xor;
+    };
+
+    std::vector<cell> m_cells;
+    unsigned char m_key[16];
+  };
+}
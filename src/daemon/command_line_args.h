@@ -141,6 +141,11 @@ namespace daemon_args
   , "Disable ZMQ RPC server"
   };
 
+  const command_line::arg_descriptor<bool> arg_no_trace = {
+    "no-trace"
+  , "Do not record block and transaction verification spans for the trace command"
+  };
+
 }  // namespace daemon_args
 
 #endif // DAEMON_COMMAND_LINE_ARGS_H
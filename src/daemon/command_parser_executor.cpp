@@ -971,12 +971,34 @@ bool t_command_parser_executor::version(const std::vector<std::string>& args)
 
 bool t_command_parser_executor::prune_blockchain(const std::vector<std::string>& args)
 {
-  if (args.size() > 1)
+  if (args.size() > 3)
   {
     std::cout << "Invalid syntax: Too many parameters. For more details, use the help command." << std::endl;
     return true;
   }
 
+  if (args.size() == 1 && args[0] == "status")
+    return m_executor.prune_blockchain(false, false, true);
+
+  bool background = false, compact = false;
+  for (size_t n = 1; n < args.size(); ++n)
+  {
+    if (args[n] == "background")
+      background = true;
+    else if (args[n] == "compact")
+      compact = true;
+    else
+    {
+      std::cout << "Invalid syntax: Unknown parameter: " << args[n] << ". For more details, use the help command." << std::endl;
+      return true;
+    }
+  }
+  if (compact && !background)
+  {
+    std::cout << "Invalid syntax: compact needs background. For more details, use the help command." << std::endl;
+    return true;
+  }
+
   if (args.empty() || args[0] != "confirm")
   {
     std::cout << "Warning: pruning from within nefelid will not shrink the database file size." << std::endl;
@@ -985,10 +1007,12 @@ bool t_command_parser_executor::prune_blockchain(const std::vector<std::string>&
     std::cout << "exit nefelid and run wownero-blockchain-prune (you will temporarily need more" << std::endl;
     std::cout << "disk space for the database conversion though). If you are OK with the database" << std::endl;
     std::cout << "file keeping the same size, re-run this command with the \"confirm\" parameter." << std::endl;
+    std::cout << "Add \"background\" to keep syncing and serving while pruning, and \"compact\" to" << std::endl;
+    std::cout << "also write a compacted copy of the database which can replace it after exiting." << std::endl;
     return true;
   }
 
-  return m_executor.prune_blockchain();
+  return m_executor.prune_blockchain(background, compact);
 }
 
 bool t_command_parser_executor::check_blockchain_pruning(const std::vector<std::string>& args)
@@ -1087,4 +1111,21 @@ show_list:
   return true;
 }
 
+bool t_command_parser_executor::trace(const std::vector<std::string>& args)
+{
+  if (args.empty())
+    return m_executor.trace(false, false, false, "");
+  if (args.size() == 1 && args[0] == "on")
+    return m_executor.trace(true, false, false, "");
+  if (args.size() == 1 && args[0] == "off")
+    return m_executor.trace(false, true, false, "");
+  if (args.size() == 1 && args[0] == "clear")
+    return m_executor.trace(false, false, true, "");
+  if (args.size() == 2 && args[0] == "dump")
+    return m_executor.trace(false, false, false, args[1]);
+
+  std::cout << "Invalid syntax: trace [on | off | clear | dump <filename>]" << std::endl;
+  return true;
+}
+
 } // namespace daemonize
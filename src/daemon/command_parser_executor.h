@@ -155,6 +155,8 @@ public:
   bool set_bootstrap_daemon(const std::vector<std::string>& args);
 
   bool flush_cache(const std::vector<std::string>& args);
+
+  bool trace(const std::vector<std::string>& args);
 };
 
 } // namespace daemonize
@@ -315,8 +315,8 @@ t_command_server::t_command_server(
     m_command_lookup.set_handler(
       "prune_blockchain"
     , std::bind(&t_command_parser_executor::prune_blockchain, &m_parser, p::_1)
-    , "prune_blockchain [confirm]"
-    , "Prune the blockchain."
+    , "prune_blockchain [confirm [background [compact]]] | status"
+    , "Prune the blockchain. With \"background\", prune in place in small batches while the daemon keeps running, and with \"compact\", write a compacted copy of the database when done. \"status\" shows the progress of background pruning."
     );
     m_command_lookup.set_handler(
       "check_blockchain_pruning"
@@ -336,6 +336,13 @@ t_command_server::t_command_server(
     , "flush_cache [bad-txs] [bad-blocks]"
     , "Flush the specified cache(s)."
     );
+    m_command_lookup.set_handler(
+      "trace"
+    , std::bind(&t_command_parser_executor::trace, &m_parser, p::_1)
+    , "trace [on | off | clear | dump <filename>]"
+    , "Show whether verification spans are being recorded, turn recording on or off, drop recorded spans,\n"
+      "or save them to <filename> in the Chrome trace format, which chrome://tracing and Perfetto can load."
+    );
 }
 
 bool t_command_server::process_command_str(const std::string& cmd)
@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include "rpc/core_rpc_server.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -48,6 +49,7 @@ public:
 private:
   cryptonote::core_rpc_server m_server;
   const std::string m_description;
+  const uint32_t m_threads;
 public:
   t_rpc(
       boost::program_options::variables_map const & vm
@@ -59,6 +61,7 @@ public:
     , bool allow_rpc_payment
     )
     : m_server{core.get(), p2p.get()}, m_description{description}
+    , m_threads{std::max<uint32_t>(1, command_line::get_arg(vm, cryptonote::core_rpc_server::arg_rpc_threads))}
   {
     MGINFO("Initializing " << m_description << " RPC server...");
 
@@ -72,7 +75,7 @@ public:
   void run()
   {
     MGINFO("Starting " << m_description << " RPC server...");
-    if (!m_server.run(2, false))
+    if (!m_server.run(m_threads, false))
     {
       throw std::runtime_error("Failed to start " + m_description + " RPC server.");
     }
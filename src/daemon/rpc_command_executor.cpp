@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include "string_tools.h"
+#include "file_io_utils.h"
 #include "common/password.h"
 #include "common/scoped_message_writer.h"
 #include "common/pruning.h"
@@ -2338,7 +2339,7 @@ bool t_rpc_command_executor::pop_blocks(uint64_t num_blocks)
   return true;
 }
 
-bool t_rpc_command_executor::prune_blockchain()
+bool t_rpc_command_executor::prune_blockchain(bool background, bool compact, bool status)
 {
     cryptonote::COMMAND_RPC_PRUNE_BLOCKCHAIN::request req;
     cryptonote::COMMAND_RPC_PRUNE_BLOCKCHAIN::response res;
@@ -2346,6 +2347,9 @@ bool t_rpc_command_executor::prune_blockchain()
     epee::json_rpc::error error_resp;
 
     req.check = false;
+    req.background = background;
+    req.compact = compact;
+    req.status = status;
 
     if (m_is_rpc)
     {
@@ -2363,7 +2367,24 @@ bool t_rpc_command_executor::prune_blockchain()
         }
     }
 
-    tools::success_msg_writer() << "Blockchain pruned";
+    if (!background && !status)
+    {
+      tools::success_msg_writer() << "Blockchain pruned";
+      return true;
+    }
+
+    if (!res.background_error.empty())
+      tools::fail_msg_writer() << "Background pruning failed: " << res.background_error;
+    else if (res.compacting)
+      tools::msg_writer() << "Blockchain pruned, writing a compacted copy to " << res.compacted_path;
+    else if (res.background_running)
+      tools::msg_writer() << "Pruning in the background: " << res.pruned_records << " records pruned (" <<
+          res.pruned_bytes / (1024 * 1024) << " MB) out of " << res.visited_records << " visited so far";
+    else if (res.background_done)
+      tools::success_msg_writer() << "Blockchain pruned: " << res.pruned_records << " records pruned (" <<
+          res.pruned_bytes / (1024 * 1024) << " MB)" << (res.compacted_path.empty() ? "" : ", compacted copy in " + res.compacted_path);
+    else
+      tools::msg_writer() << "No background pruning in progress";
     return true;
 }
 
@@ -2470,6 +2491,51 @@ bool t_rpc_command_executor::flush_cache(bool bad_txs, bool bad_blocks)
     return true;
 }
 
+bool t_rpc_command_executor::trace(bool enable, bool disable, bool clear, const std::string &dump_filename)
+{
+    cryptonote::COMMAND_RPC_TRACE::request req;
+    cryptonote::COMMAND_RPC_TRACE::response res;
+    std::string fail_message = "Unsuccessful";
+    epee::json_rpc::error error_resp;
+
+    req.enable = enable;
+    req.disable = disable;
+    req.clear = clear;
+    req.dump = !dump_filename.empty();
+
+    if (m_is_rpc)
+    {
+        if (!m_rpc_client->json_rpc_request(req, res, "trace", fail_message.c_str()))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        if (!m_rpc_server->on_trace(req, res, error_resp) || res.status != CORE_RPC_STATUS_OK)
+        {
+            tools::fail_msg_writer() << make_error(fail_message, res.status);
+            return true;
+        }
+    }
+
+    if (req.dump)
+    {
+        if (!epee::file_io_utils::save_string_to_file(dump_filename, res.trace))
+        {
+            tools::fail_msg_writer() << "Failed to save trace to " << dump_filename;
+            return true;
+        }
+        tools::success_msg_writer() << "Trace saved to " << dump_filename << " (" << res.trace.size() << " bytes)";
+    }
+    else
+    {
+        tools::msg_writer() << "Tracing is " << (res.enabled ? "on" : "off");
+    }
+
+    return true;
+}
+
 bool t_rpc_command_executor::rpc_payments()
 {
     cryptonote::COMMAND_RPC_ACCESS_DATA::request req;
@@ -156,7 +156,7 @@ public:
 
   bool pop_blocks(uint64_t num_blocks);
 
-  bool prune_blockchain();
+  bool prune_blockchain(bool background = false, bool compact = false, bool status = false);
 
   bool check_blockchain_pruning();
 
@@ -173,6 +173,8 @@ public:
   bool rpc_payments();
 
   bool flush_cache(bool bad_txs, bool invalid_blocks);
+
+  bool trace(bool enable, bool disable, bool clear, const std::string &dump_filename);
 };
 
 } // namespace daemonize
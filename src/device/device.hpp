@@ -171,6 +171,19 @@ namespace hw {
         virtual bool  sc_secret_add( crypto::secret_key &r, const crypto::secret_key &a, const crypto::secret_key &b) = 0;
         virtual crypto::secret_key  generate_keys(crypto::public_key &pub, crypto::secret_key &sec, const crypto::secret_key& recovery_key = crypto::secret_key(), bool recover = false) = 0;
         virtual bool  generate_key_derivation(const crypto::public_key &pub, const crypto::secret_key &sec, crypto::key_derivation &derivation) = 0;
+        virtual bool  generate_key_derivations(const epee::span<const crypto::public_key> pubs, const crypto::secret_key &sec, const epee::span<crypto::key_derivation> derivations, std::vector<bool> &valid)
+        {
+            valid.assign(pubs.size(), false);
+            if (derivations.size() != pubs.size())
+                return false;
+            bool r = true;
+            for (size_t i = 0; i < pubs.size(); ++i)
+            {
+                valid[i] = generate_key_derivation(pubs[i], sec, derivations.data()[i]);
+                r &= valid[i];
+            }
+            return r;
+        }
         virtual bool  conceal_derivation(crypto::key_derivation &derivation, const crypto::public_key &tx_pub_key, const std::vector<crypto::public_key> &additional_tx_pub_keys, const crypto::key_derivation &main_derivation, const std::vector<crypto::key_derivation> &additional_derivations) = 0;
         virtual bool  derivation_to_scalar(const crypto::key_derivation &derivation, const size_t output_index, crypto::ec_scalar &res) = 0;
         virtual bool  derive_secret_key(const crypto::key_derivation &derivation, const std::size_t output_index, const crypto::secret_key &sec,  crypto::secret_key &derived_sec) = 0;
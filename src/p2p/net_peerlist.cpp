@@ -33,9 +33,9 @@
 #include <functional>
 #include <fstream>
 #include <iterator>
+#include <sstream>
 
 #include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/portable_binary_oarchive.hpp>
 #include <boost/archive/portable_binary_iarchive.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/range/join.hpp>
@@ -43,6 +43,8 @@
 
 #include "net_peerlist_boost_serialization.h"
 #include "common/util.h"
+#include "common/varint.h"
+#include "span.h"
 
 
 namespace nodetool
@@ -50,6 +52,12 @@ namespace nodetool
   namespace
   {
     constexpr unsigned CURRENT_PEERLIST_STORAGE_ARCHIVE_VER = 6;
+
+    // Peers used to be stored in a boost archive, which is slow to load with full
+    // peerlists. The binary format is the magic, a version byte, then the white,
+    // gray and anchor lists, each a varint count followed by the entries.
+    constexpr const char PEERLIST_FILE_MAGIC[] = {'p', '2', 'p', 's', 't', 'a', 't', 'e'};
+    constexpr const std::uint8_t PEERLIST_FILE_VERSION = 1;
  
     struct by_zone
     {
@@ -97,15 +105,243 @@ namespace nodetool
       return elems;
     }
 
-    template<typename Archive, typename Range>
-    void save_peers(Archive& a, const Range& elems)
+ 
+    template<typename T>
+    void write_le(std::string& out, T value)
     {
-      const uint64_t size = elems.size();
-      a & size;
+      static_assert(std::is_unsigned<T>::value, "unsigned integer required");
+      for (std::size_t i = 0; i < sizeof(T); ++i, value >>= 8)
+        out.push_back(char(value & 0xff));
+    }
+
+    template<typename T>
+    bool read_le(epee::span<const std::uint8_t>& src, T& value)
+    {
+      static_assert(std::is_unsigned<T>::value, "unsigned integer required");
+      if (src.size() < sizeof(T))
+        return false;
+      value = 0;
+      for (std::size_t i = 0; i < sizeof(T); ++i)
+        value |= T(src[i]) << (8 * i);
+      src.remove_prefix(sizeof(T));
+      return true;
+    }
+
+    void write_varint(std::string& out, std::uint64_t value)
+    {
+      tools::write_varint(std::back_inserter(out), value);
+    }
+
+    bool read_varint(epee::span<const std::uint8_t>& src, std::uint64_t& value)
+    {
+      const int read = tools::read_varint(src.begin(), src.end(), value);
+      if (read <= 0 || (src[read - 1] & 0x80)) // truncated varints stop at the end of the span
+        return false;
+      src.remove_prefix(read);
+      return true;
+    }
+
+    void write_host(std::string& out, const char* host, std::uint16_t port)
+    {
+      const std::size_t length = std::strlen(host);
+      if (length > 255)
+        throw std::runtime_error("Network address host too long");
+      write_le(out, port);
+      write_le(out, std::uint8_t(length));
+      out.append(host, length);
+    }
+
+    template<std::size_t N>
+    bool read_host(epee::span<const std::uint8_t>& src, char (&host)[N], std::uint16_t& port)
+    {
+      std::uint8_t length = 0;
+      if (!read_le(src, port) || !read_le(src, length) || length >= N || src.size() < length)
+        return false;
+      std::memcpy(host, src.data(), length);
+      host[length] = 0;
+      src.remove_prefix(length);
+      return true;
+    }
+
+    void write_address(std::string& out, const epee::net_utils::network_address& na)
+    {
+      const epee::net_utils::address_type type = na.get_type_id();
+      write_le(out, std::uint8_t(type));
+      switch (type)
+      {
+        case epee::net_utils::ipv4_network_address::get_type_id():
+        {
+          const auto& ipv4 = na.as<epee::net_utils::ipv4_network_address>();
+          write_le(out, ipv4.ip());
+          write_le(out, ipv4.port());
+          break;
+        }
+        case epee::net_utils::ipv6_network_address::get_type_id():
+        {
+          const auto& ipv6 = na.as<epee::net_utils::ipv6_network_address>();
+          const boost::asio::ip::address_v6::bytes_type bytes = ipv6.ip().to_bytes();
+          out.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+          write_le(out, ipv6.port());
+          break;
+        }
+        case net::tor_address::get_type_id():
+          write_host(out, na.as<net::tor_address>().host_str(), na.as<net::tor_address>().port());
+          break;
+        case net::i2p_address::get_type_id():
+          write_host(out, na.as<net::i2p_address>().host_str(), na.as<net::i2p_address>().port());
+          break;
+        case epee::net_utils::address_type::invalid:
+        default:
+          throw std::runtime_error("Unsupported network address type");
+      }
+    }
+
+    bool read_address(epee::span<const std::uint8_t>& src, epee::net_utils::network_address& na)
+    {
+      std::uint8_t type = 0;
+      if (!read_le(src, type))
+        return false;
+      switch (epee::net_utils::address_type(type))
+      {
+        case epee::net_utils::ipv4_network_address::get_type_id():
+        {
+          std::uint32_t ip = 0;
+          std::uint16_t port = 0;
+          if (!read_le(src, ip) || !read_le(src, port))
+            return false;
+          na = epee::net_utils::ipv4_network_address{ip, port};
+          return true;
+        }
+        case epee::net_utils::ipv6_network_address::get_type_id():
+        {
+          boost::asio::ip::address_v6::bytes_type bytes;
+          std::uint16_t port = 0;
+          if (src.size() < bytes.size())
+            return false;
+          std::memcpy(bytes.data(), src.data(), bytes.size());
+          src.remove_prefix(bytes.size());
+          if (!read_le(src, port))
+            return false;
+          na = epee::net_utils::ipv6_network_address{boost::asio::ip::address_v6{bytes}, port};
+          return true;
+        }
+        case net::tor_address::get_type_id():
+        {
+          char host[net::tor_address::buffer_size()];
+          std::uint16_t port = 0;
+          if (!read_host(src, host, port))
+            return false;
+          if (std::strcmp(host, net::tor_address::unknown_str()) == 0)
+          {
+            na = net::tor_address::unknown();
+            return true;
+          }
+          expect<net::tor_address> address = net::tor_address::make(host, port);
+          if (!address)
+            return false;
+          na = std::move(*address);
+          return true;
+        }
+        case net::i2p_address::get_type_id():
+        {
+          char host[net::i2p_address::buffer_size()];
+          std::uint16_t port = 0;
+          if (!read_host(src, host, port))
+            return false;
+          if (std::strcmp(host, net::i2p_address::unknown_str()) == 0)
+          {
+            na = net::i2p_address::unknown();
+            return true;
+          }
+          expect<net::i2p_address> address = net::i2p_address::make(host);
+          if (!address)
+            return false;
+          na = std::move(*address);
+          return true;
+        }
+        default:
+          return false;
+      }
+    }
+
+    void write_entry(std::string& out, const peerlist_entry& pe)
+    {
+      write_address(out, pe.adr);
+      write_le(out, pe.id);
+      write_varint(out, std::uint64_t(pe.last_seen));
+      write_varint(out, pe.pruning_seed);
+      write_le(out, pe.rpc_port);
+      write_varint(out, pe.rpc_credits_per_hash);
+    }
+
+    bool read_entry(epee::span<const std::uint8_t>& src, peerlist_entry& pe)
+    {
+      std::uint64_t last_seen = 0, pruning_seed = 0, rpc_credits_per_hash = 0;
+      if (!read_address(src, pe.adr) || !read_le(src, pe.id) || !read_varint(src, last_seen) || !read_varint(src, pruning_seed)
+          || !read_le(src, pe.rpc_port) || !read_varint(src, rpc_credits_per_hash))
+        return false;
+      if (pruning_seed > std::numeric_limits<std::uint32_t>::max() || rpc_credits_per_hash > std::numeric_limits<std::uint32_t>::max())
+        return false;
+      pe.last_seen = std::int64_t(last_seen);
+      pe.pruning_seed = pruning_seed;
+      pe.rpc_credits_per_hash = rpc_credits_per_hash;
+      return true;
+    }
+
+    void write_entry(std::string& out, const anchor_peerlist_entry& pe)
+    {
+      write_address(out, pe.adr);
+      write_le(out, pe.id);
+      write_varint(out, std::uint64_t(pe.first_seen));
+    }
+
+    bool read_entry(epee::span<const std::uint8_t>& src, anchor_peerlist_entry& pe)
+    {
+      std::uint64_t first_seen = 0;
+      if (!read_address(src, pe.adr) || !read_le(src, pe.id) || !read_varint(src, first_seen))
+        return false;
+      pe.first_seen = std::int64_t(first_seen);
+      return true;
+    }
+
+    template<typename Range>
+    void write_entries(std::string& out, const Range& elems)
+    {
+      write_varint(out, elems.size());
       for (const auto& elem : elems)
-        a & elem;
+        write_entry(out, elem);
     }
- 
+
+    template<typename Elem>
+    bool read_entries(epee::span<const std::uint8_t>& src, std::vector<Elem>& elems)
+    {
+      std::uint64_t size = 0;
+      if (!read_varint(src, size) || size > src.size()) // entries take at least a byte each
+        return false;
+      elems.resize(size);
+      for (Elem& elem : elems)
+      {
+        if (!read_entry(src, elem))
+          return false;
+      }
+      return true;
+    }
+
+    bool is_binary_peerlist(const std::string& blob) noexcept
+    {
+      return blob.size() > sizeof(PEERLIST_FILE_MAGIC) && std::memcmp(blob.data(), PEERLIST_FILE_MAGIC, sizeof(PEERLIST_FILE_MAGIC)) == 0;
+    }
+
+    bool read_binary_peerlist(const std::string& blob, peerlist_types& types)
+    {
+      epee::span<const std::uint8_t> src = epee::strspan<std::uint8_t>(blob);
+      src.remove_prefix(sizeof(PEERLIST_FILE_MAGIC));
+      std::uint8_t version = 0;
+      if (!read_le(src, version) || version != PEERLIST_FILE_VERSION)
+        return false;
+      return read_entries(src, types.white) && read_entries(src, types.gray) && read_entries(src, types.anchor) && src.empty();
+    }
+
     template<typename T>
     std::vector<T> do_take_zone(std::vector<T>& src, epee::net_utils::zone zone)
     {
@@ -131,12 +367,6 @@ namespace nodetool
     }
   } // anonymous
 
-  struct peerlist_join
-  {
-    const peerlist_types& ours;
-    const peerlist_types& other;
-  };
-
   template<typename Archive>
   void serialize(Archive& a, peerlist_types& elem, unsigned ver)
   {
@@ -151,32 +381,33 @@ namespace nodetool
       a & peer_id;
     }
   }
- 
-  template<typename Archive>
-  void serialize(Archive& a, peerlist_join elem, unsigned ver)
-  {
-    save_peers(a, boost::range::join(elem.ours.white, elem.other.white));
-    save_peers(a, boost::range::join(elem.ours.gray, elem.other.gray));
-    save_peers(a, boost::range::join(elem.ours.anchor, elem.other.anchor));
-  }
 
   boost::optional<peerlist_storage> peerlist_storage::open(std::istream& src, const bool new_format)
   {
     try
     {
       peerlist_storage out{};
-      if (new_format)
-      {
-        boost::archive::portable_binary_iarchive a{src};
-        a >> out.m_types;
-      }
+      std::string blob{std::istreambuf_iterator<char>{src}, std::istreambuf_iterator<char>{}};
+      bool good = false;
+      if (is_binary_peerlist(blob))
+        good = read_binary_peerlist(blob, out.m_types);
       else
       {
-        boost::archive::binary_iarchive a{src};
-        a >> out.m_types;
+        std::istringstream archive_src{std::move(blob)};
+        if (new_format)
+        {
+          boost::archive::portable_binary_iarchive a{archive_src};
+          a >> out.m_types;
+        }
+        else
+        {
+          boost::archive::binary_iarchive a{archive_src};
+          a >> out.m_types;
+        }
+        good = archive_src.good();
       }
 
-      if (src.good())
+      if (good)
       {
         std::sort(out.m_types.white.begin(), out.m_types.white.end(), by_zone{});
         std::sort(out.m_types.gray.begin(), out.m_types.gray.end(), by_zone{});
@@ -228,12 +459,15 @@ namespace nodetool
   {
     try
     {
-      boost::archive::portable_binary_oarchive a{dest};
-      const peerlist_join pj{std::cref(m_types), std::cref(other)};
-      a << pj;
+      std::string blob{PEERLIST_FILE_MAGIC, sizeof(PEERLIST_FILE_MAGIC)};
+      write_le(blob, PEERLIST_FILE_VERSION);
+      write_entries(blob, boost::range::join(m_types.white, other.white));
+      write_entries(blob, boost::range::join(m_types.gray, other.gray));
+      write_entries(blob, boost::range::join(m_types.anchor, other.anchor));
+      dest.write(blob.data(), blob.size());
       return dest.good();
     }
-    catch (const boost::archive::archive_exception& e)
+    catch (const std::exception& e)
     {}
 
     return false;
@@ -298,5 +532,4 @@ namespace nodetool
 }
 
 BOOST_CLASS_VERSION(nodetool::peerlist_types, nodetool::CURRENT_PEERLIST_STORAGE_ARCHIVE_VER);
-BOOST_CLASS_VERSION(nodetool::peerlist_join, nodetool::CURRENT_PEERLIST_STORAGE_ARCHIVE_VER);
 
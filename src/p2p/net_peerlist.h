@@ -38,6 +38,7 @@
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/ranked_index.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/optional/optional.hpp>
@@ -66,7 +67,8 @@ namespace nodetool
       : m_types{}
     {}
 
-    //! \return Peers stored in stream `src` in `new_format` (portable archive or older non-portable).
+    /*! \return Peers stored in stream `src`, in the binary peerlist format, or in
+        `new_format` (portable archive or older non-portable) if written by an older version. */
     static boost::optional<peerlist_storage> open(std::istream& src, const bool new_format);
 
     //! \return Peers stored in file at `path`
@@ -80,7 +82,7 @@ namespace nodetool
     peerlist_storage& operator=(peerlist_storage&&) = default;
     peerlist_storage& operator=(const peerlist_storage&) = delete;
 
-    //! Save peers from `this` and `other` in stream `dest`.
+    //! Save peers from `this` and `other` in stream `dest`, in the binary peerlist format.
     bool store(std::ostream& dest, const peerlist_types& other) const;
 
     //! Save peers from `this` and `other` in one file at `path`.
@@ -166,8 +168,8 @@ namespace nodetool
       boost::multi_index::indexed_by<
       // access by peerlist_entry::net_adress
       boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr> >,
-      // sort by peerlist_entry::last_seen<
-      boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
+      // sort by peerlist_entry::last_seen<, ranked so the nth latest peer is found in O(log n)
+      boost::multi_index::ranked_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
       > 
     > peers_indexed;
 
@@ -220,9 +222,7 @@ namespace nodetool
   {
     // Is not thread-safe nor does it check bounds. Do this before calling. Indexing starts at 0.
     peers_indexed::index<by_time>::type& by_time_index = peerlist.get<by_time>();
-    auto by_time_it = --by_time_index.end();
-    std::advance(by_time_it, -static_cast<long long>(n));
-    return *by_time_it;
+    return *by_time_index.nth(by_time_index.size() - 1 - n);
   }
   //--------------------------------------------------------------------------------------------------
   inline 
@@ -32,6 +32,7 @@
 #include "misc_language.h"
 #include "common/perf_timer.h"
 #include "common/threadpool.h"
+#include "common/trace.h"
 #include "common/util.h"
 #include "rctSigs.h"
 #include "bulletproofs.h"
@@ -905,6 +906,7 @@ namespace rct {
         try
         {
             PERF_TIMER(verRctCLSAGSimple);
+            TRACE_SPAN(verRctCLSAGSimple);
             const size_t n = pubs.size();
 
             // Check data
@@ -1565,6 +1567,7 @@ namespace rct {
       try
       {
         PERF_TIMER(verRctSemanticsSimple);
+        TRACE_SPAN_ARG(verRctSemanticsSimple, rvv.size());
 
         tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
         tools::threadpool::waiter waiter(tpool);
@@ -1658,6 +1661,9 @@ namespace rct {
             offset += rv.p.rangeSigs.size();
           }
         }
+        TRACE_SPAN_DECLARE(bulletproof_plus_batch);
+        if (!bpp_proofs.empty())
+          TRACE_SPAN_START_ARG(bulletproof_plus_batch, bpp_proofs.size());
         if (!bpp_proofs.empty() && !verBulletproofPlus(bpp_proofs))
         {
           LOG_PRINT_L1("Aggregate range proof verified failed");
@@ -1665,6 +1671,7 @@ namespace rct {
             return false;
           return false;
         }
+        TRACE_SPAN_STOP(bulletproof_plus_batch);
         if (!bp_proofs.empty() && !verBulletproof(bp_proofs))
         {
           LOG_PRINT_L1("Aggregate range proof verified failed");
@@ -1708,6 +1715,7 @@ namespace rct {
       try
       {
         PERF_TIMER(verRctNonSemanticsSimple);
+        TRACE_SPAN_ARG(verRctNonSemanticsSimple, rv.mixRing.size());
 
         CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeSimpleBulletproof || rv.type == RCTTypeCLSAG || rv.type == RCTTypeBulletproofPlus,
             false, "verRctNonSemanticsSimple called on non simple rctSig");
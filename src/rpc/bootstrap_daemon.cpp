@@ -1,5 +1,6 @@
 #include "bootstrap_daemon.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 #include <boost/thread/locks.hpp>
@@ -15,12 +16,23 @@
 namespace cryptonote
 {
 
+  constexpr size_t bootstrap_daemon::pool::MAX_IDLE_CONNECTIONS;
+  constexpr size_t bootstrap_daemon::pool::MAX_RACES_IN_FLIGHT;
+  constexpr unsigned bootstrap_daemon::RACE_TIMEOUT_SECONDS;
+
+  tools::threadpool &bootstrap_daemon::race_threads()
+  {
+    // kept off the shared IO pool: a slow node would hold its threads, and
+    // any of its waiters could end up running a bootstrap request inline
+    static const std::unique_ptr<tools::threadpool> threads(tools::threadpool::getNew(2 * pool::MAX_RACES_IN_FLIGHT + 1));
+    return *threads;
+  }
+
   bootstrap_daemon::bootstrap_daemon(
     std::function<std::map<std::string, bool>()> get_public_nodes,
     bool rpc_payment_enabled,
     const std::string &proxy)
-    : m_selector(new bootstrap_node::selector_auto(std::move(get_public_nodes)))
-    , m_rpc_payment_enabled(rpc_payment_enabled)
+    : m_pool(std::make_shared<pool>(new bootstrap_node::selector_auto(std::move(get_public_nodes)), rpc_payment_enabled))
   {
     set_proxy(proxy);
   }
@@ -30,11 +42,10 @@ namespace cryptonote
     boost::optional<epee::net_utils::http::login> credentials,
     bool rpc_payment_enabled,
     const std::string &proxy)
-    : m_selector(nullptr)
-    , m_rpc_payment_enabled(rpc_payment_enabled)
+    : m_pool(std::make_shared<pool>(nullptr, rpc_payment_enabled))
   {
     set_proxy(proxy);
-    if (!set_server(address, std::move(credentials)))
+    if (!m_pool->set_server({address, std::move(credentials)}))
     {
       throw std::runtime_error("invalid bootstrap daemon address or credentials");
     }
@@ -42,12 +53,8 @@ namespace cryptonote
 
   std::string bootstrap_daemon::address() const noexcept
   {
-    const auto& host = m_http_client.get_host();
-    if (host.empty())
-    {
-      return std::string();
-    }
-    return host + ":" + m_http_client.get_port();
+    const boost::unique_lock<boost::mutex> lock(m_pool->mutex);
+    return m_pool->current.address;
   }
 
   boost::optional<std::pair<uint64_t, uint64_t>> bootstrap_daemon::get_height()
@@ -55,7 +62,7 @@ namespace cryptonote
     cryptonote::COMMAND_RPC_GET_INFO::request req;
     cryptonote::COMMAND_RPC_GET_INFO::response res;
 
-    if (!invoke_http_json("/getinfo", req, res))
+    if (!invoke_http_json("/getinfo", req, res, true))
     {
       return boost::none;
     }
@@ -70,16 +77,17 @@ namespace cryptonote
 
   bool bootstrap_daemon::handle_result(bool success, const std::string &status)
   {
-    const bool failed = !success || (!m_rpc_payment_enabled && status == CORE_RPC_STATUS_PAYMENT_REQUIRED);
-    if (failed && m_selector)
+    const bool failed = !success || (!m_pool->rpc_payment_enabled && status == CORE_RPC_STATUS_PAYMENT_REQUIRED);
+    if (!failed || !m_pool->selector)
     {
-      const std::string current_address = address();
-      m_http_client.disconnect();
-
-      const boost::unique_lock<boost::mutex> lock(m_selector_mutex);
-      m_selector->handle_result(current_address, !failed);
+      return success;
     }
 
+    // the next call picks another node, connections to this one are
+    // reconfigured once they are free
+    const boost::unique_lock<boost::mutex> lock(m_pool->mutex);
+    m_pool->selector->handle_result(m_pool->current.address, false);
+    m_pool->current = {};
     return success;
   }
 
@@ -89,42 +97,212 @@ namespace cryptonote
     {
       throw std::runtime_error("invalid proxy address format");
     }
-    if (!m_http_client.set_proxy(address))
+    m_pool->set_proxy(address);
+  }
+
+  std::shared_ptr<bootstrap_daemon::connection> bootstrap_daemon::pool::claim(const std::string &address)
+  {
+    // prefer a free connection already set up for the node
+    auto it = std::find_if(idle.begin(), idle.end(), [&address](const std::shared_ptr<connection> &conn) {
+      return conn->target.address == address;
+    });
+    if (it == idle.end() && !idle.empty())
+    {
+      it = idle.begin();
+    }
+    std::shared_ptr<connection> conn;
+    if (it != idle.end())
+    {
+      conn = *it;
+      idle.erase(it);
+    }
+    else
     {
-      throw std::runtime_error("failed to set proxy address");
+      conn = std::make_shared<connection>();
     }
+
+    if (conn->proxy != proxy)
+    {
+      if (!conn->http_client.set_proxy(proxy))
+      {
+        throw std::runtime_error("failed to set proxy address");
+      }
+      conn->proxy = proxy;
+    }
+    return conn;
   }
 
-  bool bootstrap_daemon::set_server(const std::string &address, const boost::optional<epee::net_utils::http::login> &credentials /* = boost::none */)
+  bool bootstrap_daemon::pool::connect(connection &conn, const server &target)
   {
-    if (!m_http_client.set_server(address, credentials))
+    if (conn.target.address == target.address)
+    {
+      return true;
+    }
+    conn.http_client.disconnect();
+    if (!conn.http_client.set_server(target.address, target.credentials))
     {
-      MERROR("Failed to set bootstrap daemon address " << address);
+      MERROR("Failed to set bootstrap daemon address " << target.address);
+      conn.target = {};
       return false;
     }
-
-    MINFO("Changed bootstrap daemon address to " << address);
+    conn.target = target;
     return true;
   }
 
+  std::shared_ptr<bootstrap_daemon::connection> bootstrap_daemon::pool::acquire()
+  {
+    std::shared_ptr<connection> conn;
+    server target;
+    {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      if (current.address.empty() && selector)
+      {
+        const boost::optional<bootstrap_node::node_info> node = selector->next_node();
+        if (!node)
+        {
+          return nullptr;
+        }
+        current = {node->address, node->credentials};
+        MINFO("Changed bootstrap daemon address to " << current.address);
+      }
+      if (current.address.empty())
+      {
+        return nullptr;
+      }
+      target = current;
+      conn = claim(target.address);
+    }
+
+    if (!connect(*conn, target))
+    {
+      release(conn);
+      return nullptr;
+    }
+    return conn;
+  }
 
-  bool bootstrap_daemon::switch_server_if_needed()
+  std::shared_ptr<bootstrap_daemon::connection> bootstrap_daemon::pool::acquire_other(const std::string &exclude)
   {
-    if (m_http_client.is_connected() || !m_selector)
+    std::shared_ptr<connection> conn;
+    server target;
     {
-      return true;
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      if (!selector || races >= MAX_RACES_IN_FLIGHT)
+      {
+        return nullptr;
+      }
+
+      // the second node is kept while it answers, and must differ from the first
+      if (racer.address.empty() || racer.address == exclude)
+      {
+        const boost::optional<bootstrap_node::node_info> node = selector->next_node(exclude);
+        if (!node)
+        {
+          return nullptr;
+        }
+        racer = {node->address, node->credentials};
+      }
+      target = racer;
+      conn = claim(target.address);
+      ++races;
     }
 
-    boost::optional<bootstrap_node::node_info> node;
+    if (!connect(*conn, target))
     {
-      const boost::unique_lock<boost::mutex> lock(m_selector_mutex);
-      node = m_selector->next_node();
+      release(conn);
+      end_race();
+      return nullptr;
     }
-    if (node) {
-      return set_server(node->address, node->credentials);
+    MDEBUG("Racing bootstrap daemon " << exclude << " against " << target.address);
+    return conn;
+  }
+
+  void bootstrap_daemon::pool::end_race()
+  {
+    const boost::unique_lock<boost::mutex> lock(mutex);
+    --races;
+  }
+
+  void bootstrap_daemon::pool::release(const std::shared_ptr<connection> &conn)
+  {
+    const boost::unique_lock<boost::mutex> lock(mutex);
+    if (idle.size() < MAX_IDLE_CONNECTIONS)
+    {
+      idle.push_back(conn);
+    }
+  }
+
+  void bootstrap_daemon::pool::promote(const connection &conn)
+  {
+    const boost::unique_lock<boost::mutex> lock(mutex);
+    if (selector && current.address != conn.target.address)
+    {
+      MINFO("Changed bootstrap daemon address to " << conn.target.address << ", which answered faster than " << current.address);
+      current = conn.target;
+    }
+  }
+
+  bool bootstrap_daemon::pool::handle_result(connection &conn, bool success, const std::string &status, std::chrono::steady_clock::duration elapsed)
+  {
+    if (!selector)
+    {
+      return success;
+    }
+
+    const bool failed = !success || (!rpc_payment_enabled && status == CORE_RPC_STATUS_PAYMENT_REQUIRED);
+    if (failed)
+    {
+      conn.http_client.disconnect();
     }
 
-    return false;
+    const boost::unique_lock<boost::mutex> lock(mutex);
+    if (failed)
+    {
+      selector->handle_result(conn.target.address, false);
+      if (current.address == conn.target.address)
+      {
+        current = {};
+      }
+      if (racer.address == conn.target.address)
+      {
+        racer = {};
+      }
+    }
+    else if (elapsed != std::chrono::steady_clock::duration::zero())
+    {
+      selector->handle_latency(conn.target.address, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed));
+    }
+
+    return success;
+  }
+
+  bool bootstrap_daemon::pool::set_server(const server &target)
+  {
+    std::shared_ptr<connection> conn;
+    {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      conn = claim(target.address);
+    }
+    if (!connect(*conn, target))
+    {
+      release(conn);
+      return false;
+    }
+
+    {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      current = target;
+    }
+    release(conn);
+    MINFO("Changed bootstrap daemon address to " << target.address);
+    return true;
+  }
+
+  void bootstrap_daemon::pool::set_proxy(const std::string &address)
+  {
+    // applied to each connection the next time it is claimed
+    const boost::unique_lock<boost::mutex> lock(mutex);
+    proxy = address;
   }
 
 }
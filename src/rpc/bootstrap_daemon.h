@@ -1,17 +1,24 @@
 #pragma  once
 
+#include <chrono>
 #include <functional>
 #include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/utility/string_ref.hpp>
 
+#include "common/threadpool.h"
+#include "misc_log_ex.h"
 #include "net/http.h"
 #include "storages/http_abstract_invoke.h"
 
 #include "bootstrap_node_selector.h"
+#include "core_rpc_server_commands_defs.h"
 
 namespace cryptonote
 {
@@ -33,58 +40,223 @@ namespace cryptonote
     boost::optional<std::pair<uint64_t, uint64_t>> get_height();
     bool handle_result(bool success, const std::string &status);
 
+    // With race set, calls also go to a second node when picking nodes
+    // automatically, and the first valid response is used
     template <class t_request, class t_response>
-    bool invoke_http_json(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct)
+    bool invoke_http_json(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct, bool race = false)
     {
-      if (!switch_server_if_needed())
-      {
-        return false;
-      }
+      const std::string path(uri.begin(), uri.end());
+      return invoke(out_struct, result_struct, race, [path](const t_request &req, t_response &res, net::http::client &client) {
+        return epee::net_utils::invoke_http_json(path, req, res, client);
+      });
+    }
 
-      const bool result = epee::net_utils::invoke_http_json(uri, out_struct, result_struct, m_http_client);
-      return handle_result(result, result_struct.status);
+    template <class t_request, class t_response>
+    bool invoke_http_bin(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct, bool race = false)
+    {
+      const std::string path(uri.begin(), uri.end());
+      return invoke(out_struct, result_struct, race, [path](const t_request &req, t_response &res, net::http::client &client) {
+        return epee::net_utils::invoke_http_bin(path, req, res, client);
+      });
     }
 
     template <class t_request, class t_response>
-    bool invoke_http_bin(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct)
+    bool invoke_http_json_rpc(const boost::string_ref command_name, const t_request &out_struct, t_response &result_struct, bool race = false)
+    {
+      const std::string method(command_name.begin(), command_name.end());
+      return invoke(out_struct, result_struct, race, [method](const t_request &req, t_response &res, net::http::client &client) {
+        return epee::net_utils::invoke_http_json_rpc("/json_rpc", method, req, res, client);
+      });
+    }
+
+    void set_proxy(const std::string &address);
+
+    // Runs invoke on a free connection to the current node. A connection
+    // still busy with an earlier request, such as the slower side of a race,
+    // is never waited on or reconfigured: another one is used instead.
+    // Races run on their own threads, and at most MAX_RACES_IN_FLIGHT of them
+    // at a time: while the slower side of earlier races still holds a
+    // connection, calls go to the current node only.
+    template <class t_request, class t_response, class t_invoke>
+    bool invoke(const t_request &req, t_response &res, bool race, const t_invoke &invoke)
     {
-      if (!switch_server_if_needed())
+      const std::shared_ptr<connection> first = m_pool->acquire();
+      if (!first)
       {
         return false;
       }
 
-      const bool result = epee::net_utils::invoke_http_bin(uri, out_struct, result_struct, m_http_client);
-      return handle_result(result, result_struct.status);
-    }
+      const std::shared_ptr<connection> second = race ? m_pool->acquire_other(first->target.address) : nullptr;
+      if (!second)
+      {
+        const auto start = std::chrono::steady_clock::now();
+        bool result = invoke(req, res, first->http_client);
+        result = m_pool->handle_result(*first, result, res.status, std::chrono::steady_clock::now() - start);
+        m_pool->release(first);
+        return result;
+      }
 
-    template <class t_request, class t_response>
-    bool invoke_http_json_rpc(const boost::string_ref command_name, const t_request &out_struct, t_response &result_struct)
-    {
-      if (!switch_server_if_needed())
+      struct race_state
       {
-        return false;
+        boost::mutex mutex;
+        boost::condition_variable cond;
+        t_request req;
+        t_response res;
+        size_t pending;
+        bool done;
+        bool result;
+      };
+      const auto state = std::make_shared<race_state>();
+      state->req = req;
+      state->pending = 2;
+      state->done = false;
+      state->result = false;
+
+      // called exactly once per side, whether it answered, failed or threw
+      const auto finish = [state, pool = m_pool](const connection &conn, bool promote, bool result, t_response &&res) {
+        const bool ok = result && res.status == CORE_RPC_STATUS_OK;
+        const boost::unique_lock<boost::mutex> lock(state->mutex);
+        --state->pending;
+        const bool last = state->pending == 0;
+        if (last)
+        {
+          pool->end_race();
+        }
+        if (!state->done && (ok || last))
+        {
+          // the faster node takes over, so the next calls do not go to the slow one
+          if (ok && promote)
+          {
+            pool->promote(conn);
+          }
+          state->res = std::move(res);
+          state->result = result;
+          state->done = true;
+          state->cond.notify_all();
+        }
+      };
+
+      tools::threadpool &tpool = race_threads();
+      for (const std::shared_ptr<connection> &conn : {first, second})
+      {
+        const bool promote = conn == second;
+        try
+        {
+          tpool.submit(nullptr, [state, conn, invoke, finish, pool = m_pool, promote]() {
+            t_response res;
+            bool result = false;
+            try
+            {
+              const auto start = std::chrono::steady_clock::now();
+              result = invoke(state->req, res, conn->http_client);
+              result = pool->handle_result(*conn, result, res.status, std::chrono::steady_clock::now() - start);
+              pool->release(conn);
+            }
+            catch (const std::exception &e)
+            {
+              // the connection is dropped rather than reused in an unknown state
+              MERROR("Bootstrap daemon request to " << conn->target.address << " failed: " << e.what());
+              result = false;
+            }
+            catch (...)
+            {
+              result = false;
+            }
+
+            try
+            {
+              finish(*conn, promote, result, std::move(res));
+            }
+            catch (...)
+            {
+              // a null waiter must never see an exception from the pool
+            }
+          }, true);
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to start bootstrap daemon request: " << e.what());
+          finish(*conn, false, false, t_response{});
+        }
       }
 
-      const bool result = epee::net_utils::invoke_http_json_rpc(
-        "/json_rpc",
-        std::string(command_name.begin(), command_name.end()),
-        out_struct,
-        result_struct,
-        m_http_client);
-      return handle_result(result, result_struct.status);
+      boost::unique_lock<boost::mutex> lock(state->mutex);
+      const auto deadline = boost::chrono::steady_clock::now() + boost::chrono::seconds(RACE_TIMEOUT_SECONDS);
+      while (!state->done)
+      {
+        if (state->cond.wait_until(lock, deadline) == boost::cv_status::timeout && !state->done)
+        {
+          // both sides are left to finish in the background
+          MWARNING("No answer from bootstrap daemons " << first->target.address << " and " << second->target.address << " in time");
+          state->done = true;
+          return false;
+        }
+      }
+      res = std::move(state->res);
+      return state->result;
     }
 
-    void set_proxy(const std::string &address);
-
   private:
-    bool set_server(const std::string &address, const boost::optional<epee::net_utils::http::login> &credentials = boost::none);
-    bool switch_server_if_needed();
+    struct server
+    {
+      std::string address;
+      boost::optional<epee::net_utils::http::login> credentials;
+    };
+
+    // only touched by the caller holding it busy, so never reconfigured mid-request
+    struct connection
+    {
+      net::http::client http_client;
+      server target;
+      std::string proxy;
+    };
+
+    // shared with the slower side of a race, which may finish after the daemon is gone
+    struct pool
+    {
+      static constexpr size_t MAX_IDLE_CONNECTIONS = 4;
+      static constexpr size_t MAX_RACES_IN_FLIGHT = 1;
+
+      pool(bootstrap_node::selector *selector, bool rpc_payment_enabled)
+        : selector(selector)
+        , rpc_payment_enabled(rpc_payment_enabled)
+      {}
+
+      //! A free connection to the current node, picking a node first if there is none
+      std::shared_ptr<connection> acquire();
+      //! A free connection to a node other than exclude for a race, none with a
+      //! fixed node or while MAX_RACES_IN_FLIGHT races still hold connections
+      std::shared_ptr<connection> acquire_other(const std::string &exclude);
+      //! Called once both sides of a race are done
+      void end_race();
+      void release(const std::shared_ptr<connection> &conn);
+      //! Makes the node of conn the current one
+      void promote(const connection &conn);
+      bool handle_result(connection &conn, bool success, const std::string &status, std::chrono::steady_clock::duration elapsed);
+      bool set_server(const server &target);
+      void set_proxy(const std::string &address);
+
+      const std::unique_ptr<bootstrap_node::selector> selector;
+      const bool rpc_payment_enabled;
+      boost::mutex mutex;
+      std::string proxy;
+      server current;
+      server racer;
+      size_t races = 0;
+      std::vector<std::shared_ptr<connection>> idle;
+
+    private:
+      std::shared_ptr<connection> claim(const std::string &address);
+      bool connect(connection &conn, const server &target);
+    };
+
+    static constexpr unsigned RACE_TIMEOUT_SECONDS = 30;
+
+    //! Runs both sides of the races in flight, and nothing else
+    static tools::threadpool &race_threads();
 
   private:
-    net::http::client m_http_client;
-    const bool m_rpc_payment_enabled;
-    const std::unique_ptr<bootstrap_node::selector> m_selector;
-    boost::mutex m_selector_mutex;
+    const std::shared_ptr<pool> m_pool;
   };
 
 }
@@ -29,6 +29,9 @@
 
 #include "bootstrap_node_selector.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "crypto/crypto.h"
 
 namespace cryptonote
@@ -36,6 +39,46 @@ namespace cryptonote
 namespace bootstrap_node
 {
 
+  constexpr size_t latency_histogram::BUCKETS;
+  constexpr uint32_t latency_histogram::MAX_SAMPLES;
+
+  void latency_histogram::record(std::chrono::milliseconds latency)
+  {
+    size_t bucket = 0;
+    for (uint64_t ms = std::max<int64_t>(latency.count(), 0); ms && bucket + 1 < BUCKETS; ms >>= 1)
+    {
+      ++bucket;
+    }
+    ++m_buckets[bucket];
+    if (++m_count >= MAX_SAMPLES)
+    {
+      m_count = 0;
+      for (uint32_t &n : m_buckets)
+      {
+        n /= 2;
+        m_count += n;
+      }
+    }
+  }
+
+  boost::optional<std::chrono::milliseconds> latency_histogram::percentile(double fraction) const
+  {
+    if (m_count == 0)
+    {
+      return boost::none;
+    }
+    uint32_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; ++bucket)
+    {
+      seen += m_buckets[bucket];
+      if (seen >= fraction * m_count)
+      {
+        return std::chrono::milliseconds(uint64_t(1) << bucket);
+      }
+    }
+    return std::chrono::milliseconds(uint64_t(1) << (BUCKETS - 1));
+  }
+
   void selector_auto::node::handle_result(bool success)
   {
     if (!success)
@@ -60,23 +103,74 @@ namespace bootstrap_node
     }
   }
 
-  boost::optional<node_info> selector_auto::next_node()
+  void selector_auto::handle_latency(const std::string &address, std::chrono::milliseconds latency)
+  {
+    auto &nodes_by_address = m_nodes.get<by_address>();
+    const auto it = nodes_by_address.find(address);
+    if (it != nodes_by_address.end())
+    {
+      nodes_by_address.modify(it, [latency](node &entry) {
+        entry.latency.record(latency);
+      });
+    }
+  }
+
+  boost::optional<std::chrono::milliseconds> selector_auto::get_latency(const std::string &address, double fraction) const
+  {
+    const auto &nodes_by_address = m_nodes.get<by_address>();
+    const auto it = nodes_by_address.find(address);
+    if (it == nodes_by_address.end())
+    {
+      return boost::none;
+    }
+    return it->latency.percentile(fraction);
+  }
+
+  boost::optional<node_info> selector_auto::next_node(const std::string &exclude)
   {
     if (!has_at_least_one_good_node())
     {
       append_new_nodes();
     }
 
-    if (m_nodes.empty())
+    // the nodes with the fewest fails
+    std::vector<const node *> candidates;
+    for (const node &entry : m_nodes.get<by_fails>())
+    {
+      if (!candidates.empty() && entry.fails != candidates.front()->fails)
+      {
+        break;
+      }
+      if (entry.address != exclude)
+      {
+        candidates.push_back(&entry);
+      }
+    }
+    if (candidates.empty())
     {
       return {};
     }
 
-    auto node = m_nodes.get<by_fails>().begin();
-    const size_t count = std::distance(node, m_nodes.get<by_fails>().upper_bound(node->fails));
-    std::advance(node, crypto::rand_idx(count));
+    // of which the fast ones, by 90th percentile latency, nodes not measured yet stay in
+    boost::optional<std::chrono::milliseconds> best;
+    for (const node *entry : candidates)
+    {
+      const auto latency = entry->latency.percentile(0.9);
+      if (latency && (!best || *latency < *best))
+      {
+        best = latency;
+      }
+    }
+    if (best)
+    {
+      candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&best](const node *entry) {
+        const auto latency = entry->latency.percentile(0.9);
+        return latency && *latency > 2 * *best;
+      }), candidates.end());
+    }
 
-    return {{node->address, {}}};
+    const node *selected = candidates[crypto::rand_idx(candidates.size())];
+    return {{selected->address, {}}};
   }
 
   bool selector_auto::has_at_least_one_good_node() const
@@ -93,7 +187,7 @@ namespace bootstrap_node
       const auto &address = node.first;
       const auto &white = node.second;
       const size_t initial_score = white ? 0 : 1;
-      updated |= m_nodes.get<by_address>().insert({address, initial_score}).second;
+      updated |= m_nodes.get<by_address>().insert({address, initial_score, {}}).second;
     }
 
     if (updated)
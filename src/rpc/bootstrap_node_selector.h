@@ -29,6 +29,8 @@
 
 #pragma  once
 
+#include <array>
+#include <chrono>
 #include <functional>
 #include <limits>
 #include <map>
@@ -53,12 +55,34 @@ namespace bootstrap_node
     boost::optional<epee::net_utils::http::login> credentials;
   };
 
+  //! Recent latencies of a node, in power of two millisecond buckets, halved as they fill up so older samples fade
+  class latency_histogram
+  {
+  public:
+    static constexpr size_t BUCKETS = 16;
+    static constexpr uint32_t MAX_SAMPLES = 64;
+
+    latency_histogram() : m_buckets(), m_count(0) {}
+
+    void record(std::chrono::milliseconds latency);
+    //! Upper bound of the bucket reaching the given fraction of samples, none without samples
+    boost::optional<std::chrono::milliseconds> percentile(double fraction) const;
+    uint32_t count() const { return m_count; }
+
+  private:
+    std::array<uint32_t, BUCKETS> m_buckets;
+    uint32_t m_count;
+  };
+
   struct selector
   {
     virtual ~selector() = default;
 
     virtual void handle_result(const std::string &address, bool success) = 0;
-    virtual boost::optional<node_info> next_node() = 0;
+    virtual void handle_latency(const std::string &address, std::chrono::milliseconds latency) = 0;
+    //! Picks a node other than exclude, if there is one
+    virtual boost::optional<node_info> next_node(const std::string &exclude) = 0;
+    boost::optional<node_info> next_node() { return next_node(std::string()); }
   };
 
   class selector_auto : public selector
@@ -69,8 +93,12 @@ namespace bootstrap_node
       , m_max_nodes(max_nodes)
     {}
 
+    using selector::next_node;
+
     void handle_result(const std::string &address, bool success) final;
-    boost::optional<node_info> next_node() final;
+    void handle_latency(const std::string &address, std::chrono::milliseconds latency) final;
+    boost::optional<node_info> next_node(const std::string &exclude) final;
+    boost::optional<std::chrono::milliseconds> get_latency(const std::string &address, double fraction) const;
 
   private:
     bool has_at_least_one_good_node() const;
@@ -82,6 +110,7 @@ namespace bootstrap_node
     {
       std::string address;
       size_t fails;
+      latency_histogram latency;
 
       void handle_result(bool success);
     };
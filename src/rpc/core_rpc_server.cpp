@@ -41,6 +41,9 @@ using namespace epee;
 #include "common/download.h"
 #include "common/util.h"
 #include "common/perf_timer.h"
+#include "common/metrics.h"
+#include "common/trace.h"
+#include "common/threadpool.h"
 #include "int-util.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/account.h"
@@ -76,12 +79,37 @@ using namespace epee;
 #define RESTRICTED_SPENT_KEY_IMAGES_COUNT 5000
 #define RESTRICTED_BLOCK_COUNT 1000
 
+// credits charged to a rate limited client when its call is admitted, before the method is known: every call costs at least one
+#define RPC_RATE_LIMIT_ESTIMATE 1
+
+#define GET_TRANSACTIONS_MIN_TXES_PER_THREAD 8
+
 #define RPC_TRACKER(rpc) \
   PERF_TIMER(rpc); \
-  RPCTracker tracker(#rpc, PERF_TIMER_NAME(rpc))
+  static tools::metrics::histogram &rpc_metric = tools::metrics::get_histogram("rpc_request_seconds", "Time taken to serve RPC requests", "method=\"" #rpc "\""); \
+  RPCTracker tracker(#rpc, PERF_TIMER_NAME(rpc), &rpc_metric)
+
+// marks the response being computed as one the response cache may keep, to use
+// only on paths where it depends on nothing but the request and the given state
+#define RPC_CACHE_RESPONSE(rpc, dependencies) do { \
+    static tools::metrics::counter &hits = tools::metrics::get_counter("rpc_cache_hits_total", "RPC responses served from the response cache", "method=\"" #rpc "\""); \
+    static tools::metrics::counter &misses = tools::metrics::get_counter("rpc_cache_misses_total", "Cacheable RPC responses computed and added to the response cache", "method=\"" #rpc "\""); \
+    cacheable_response = {dependencies, &hits, &misses}; \
+  } while(0)
 
 namespace
 {
+  struct cacheable_response_t
+  {
+    unsigned dependencies;
+    tools::metrics::counter *hits;
+    tools::metrics::counter *misses;
+  };
+  // set by handlers of the thread serving a request, see RPC_CACHE_RESPONSE
+  thread_local cacheable_response_t cacheable_response = {0, NULL, NULL};
+  // credits the calls of the request being served cost, charged to the client by the rate limiter
+  thread_local uint64_t request_credits = 0;
+
   class RPCTracker
   {
   public:
@@ -92,19 +120,23 @@ namespace
       uint64_t credits;
     };
 
-    RPCTracker(const char *rpc, tools::LoggingPerformanceTimer &timer): rpc(rpc), timer(timer) {
+    RPCTracker(const char *rpc, tools::LoggingPerformanceTimer &timer, tools::metrics::histogram *metric = NULL): rpc(rpc), timer(timer), metric(metric) {
     }
     ~RPCTracker() {
+      const uint64_t time = timer.value();
+      if (metric)
+        metric->record(time);
       try
       {
         boost::unique_lock<boost::mutex> lock(mutex);
         auto &e = tracker[rpc];
         ++e.count;
-        e.time += timer.value();
+        e.time += time;
       }
       catch (...) { /* ignore */ }
     }
     void pay(uint64_t amount) {
+      request_credits += amount;
       boost::unique_lock<boost::mutex> lock(mutex);
       auto &e = tracker[rpc];
       e.credits += amount;
@@ -115,6 +147,7 @@ namespace
   private:
     std::string rpc;
     tools::LoggingPerformanceTimer &timer;
+    tools::metrics::histogram *metric;
     static boost::mutex mutex;
     static std::unordered_map<std::string, entry_t> tracker;
   };
@@ -163,6 +196,10 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_payment_difficulty);
     command_line::add_arg(desc, arg_rpc_payment_credits);
     command_line::add_arg(desc, arg_rpc_payment_allow_free_loopback);
+    command_line::add_arg(desc, arg_rpc_threads);
+    command_line::add_arg(desc, arg_rpc_client_rate);
+    command_line::add_arg(desc, arg_rpc_client_burst);
+    command_line::add_arg(desc, arg_rpc_client_rate_allow_loopback);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::core_rpc_server(
@@ -174,6 +211,9 @@ namespace cryptonote
     , m_was_bootstrap_ever_used(false)
     , disable_rpc_ban(false)
     , m_rpc_payment_allow_free_loopback(false)
+    , m_login_required(false)
+    , m_rate_limit_allow_loopback(false)
+    , m_response_cache(std::make_shared<rpc_response_cache>())
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::set_bootstrap_daemon(
@@ -344,6 +384,16 @@ namespace cryptonote
 
     if (rpc_config->login)
       http_login.emplace(std::move(rpc_config->login->username), std::move(rpc_config->login->password).password());
+    m_login_required = bool(http_login);
+
+    const uint64_t client_rate = command_line::get_arg(vm, arg_rpc_client_rate);
+    if (restricted && client_rate > 0)
+    {
+      m_rate_limiter.reset(new rpc_rate_limiter(client_rate, command_line::get_arg(vm, arg_rpc_client_burst)));
+      m_rate_limit_allow_loopback = command_line::get_arg(vm, arg_rpc_client_rate_allow_loopback);
+      if (command_line::get_arg(vm, arg_rpc_threads) < 2)
+        MWARNING("RPC rate limiting keeps one RPC thread for priority clients, use --" << arg_rpc_threads.name << " to allow more than one public call at a time");
+    }
 
     if (m_rpc_payment)
       m_net_server.add_idle_handler([this](){ return m_rpc_payment->on_idle(); }, 60 * 1000);
@@ -378,6 +428,16 @@ namespace cryptonote
 
     m_net_server.get_config_object().m_max_content_length = MAX_RPC_CONTENT_LENGTH;
 
+    if (!restricted)
+      register_metrics();
+
+    const std::weak_ptr<rpc_response_cache> response_cache = m_response_cache;
+    m_core.get_blockchain_storage().add_block_notify([response_cache](uint64_t, epee::span<const block>) {
+      const std::shared_ptr<rpc_response_cache> cache = response_cache.lock();
+      if (cache)
+        cache->on_chain_changed();
+    });
+
     if (store_ssl_key && inited)
     {
       // new keys were generated, store for next run
@@ -389,6 +449,139 @@ namespace cryptonote
     return inited;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  void core_rpc_server::register_metrics()
+  {
+    // values already tracked elsewhere, read when /metrics is requested
+    core &c = m_core;
+    nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core>> &p2p = m_p2p;
+    const auto net_stats = [](bool in, bool bytes) {
+      uint64_t packets, total_bytes;
+      if (in)
+      {
+        CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in);
+        epee::net_utils::network_throttle_manager::get_global_throttle_in().get_stats(packets, total_bytes);
+      }
+      else
+      {
+        CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_out);
+        epee::net_utils::network_throttle_manager::get_global_throttle_out().get_stats(packets, total_bytes);
+      }
+      return (double)(bytes ? total_bytes : packets);
+    };
+    tools::metrics::set_callback("p2p_bytes_total", "Bytes transferred with peers", "direction=\"in\"", true, [net_stats](){ return net_stats(true, true); });
+    tools::metrics::set_callback("p2p_bytes_total", "Bytes transferred with peers", "direction=\"out\"", true, [net_stats](){ return net_stats(false, true); });
+    tools::metrics::set_callback("p2p_packets_total", "Packets transferred with peers", "direction=\"in\"", true, [net_stats](){ return net_stats(true, false); });
+    tools::metrics::set_callback("p2p_packets_total", "Packets transferred with peers", "direction=\"out\"", true, [net_stats](){ return net_stats(false, false); });
+    tools::metrics::set_callback("p2p_connections", "Open public peer connections", "direction=\"out\"", false, [&p2p](){
+      return (double)p2p.get_public_outgoing_connections_count(); });
+    tools::metrics::set_callback("p2p_connections", "Open public peer connections", "direction=\"in\"", false, [&p2p](){
+      return (double)(p2p.get_public_connections_count() - p2p.get_public_outgoing_connections_count()); });
+    tools::metrics::set_callback("blockchain_height", "Height of the local chain", "", false, [&c](){
+      return (double)c.get_current_blockchain_height(); });
+    tools::metrics::set_callback("blockchain_target_height", "Height of the best chain known from peers", "", false, [&c](){
+      return (double)std::max(c.get_target_blockchain_height(), c.get_current_blockchain_height()); });
+    tools::metrics::set_callback("txpool_transactions", "Transactions in the pool", "", false, [&c](){
+      return (double)c.get_pool_transactions_count(true); });
+    tools::metrics::set_callback("lmdb_read_txns_open", "Read transactions holding a snapshot", "", false, [&c](){
+      return (double)c.get_blockchain_storage().get_db().get_read_txn_stats().live; });
+    tools::metrics::set_callback("lmdb_read_txn_oldest_seconds", "Age of the oldest open read snapshot", "", false, [&c](){
+      return c.get_blockchain_storage().get_db().get_read_txn_stats().oldest_age_ms / 1000.0; });
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::use_response_cache()
+  {
+    // paid access and the bootstrap daemon make responses depend on who is asking and when
+    if (m_rpc_payment)
+      return false;
+    boost::shared_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
+    return m_bootstrap_daemon.get() == nullptr;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& context)
+  {
+    MINFO("HTTP [" << context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+
+    // authenticated clients, and local ones if allowed, skip the rate limiter,
+    // public ones share all RPC threads but one, left for the former. Local
+    // clients are limited by default, as a local Tor/i2p proxy makes every
+    // client connecting through it look local
+    const bool rate_limited = m_rate_limiter && !m_login_required && !(m_rate_limit_allow_loopback && context.m_remote_address.is_loopback());
+    std::string client;
+    if (rate_limited)
+    {
+      static tools::metrics::histogram &queue_time = tools::metrics::get_histogram("rpc_queue_seconds", "Time RPC calls wait for the rate limiter", "lane=\"public\"");
+      const size_t threads = m_net_server.get_threads_count();
+      const size_t public_slots = threads > 1 ? threads - 1 : 1;
+      client = context.m_remote_address.host_str();
+      uint64_t retry_after = 0;
+      const auto start = std::chrono::steady_clock::now();
+      const rpc_rate_limiter::admission admission = m_rate_limiter->admit(client, public_slots, RPC_RATE_LIMIT_ESTIMATE, retry_after);
+      queue_time.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+      if (admission != rpc_rate_limiter::admitted)
+      {
+        MDEBUG("Rate limiting " << client << (admission == rpc_rate_limiter::rejected_busy ? ": busy" : ": in debt"));
+        response.m_response_code = 429;
+        response.m_response_comment = "Too Many Requests";
+        response.m_additional_fields.push_back(std::make_pair("Retry-After", std::to_string(retry_after)));
+        return true;
+      }
+    }
+    request_credits = 0;
+    const auto release = epee::misc_utils::create_scope_leave_handler([this, &client, rate_limited]() {
+      if (rate_limited)
+        m_rate_limiter->release(client, RPC_RATE_LIMIT_ESTIMATE, std::max<uint64_t>(request_credits, 1));
+    });
+
+    static const std::unordered_set<std::string> cacheable_uris = {
+      "/json_rpc", "/get_info", "/getinfo", "/get_transaction_pool_hashes.bin", "/get_output_distribution.bin"
+    };
+    std::string key;
+    uint64_t generation = 0, pool_cookie = 0;
+    if (cacheable_uris.count(query_info.m_URI) && use_response_cache())
+    {
+      key = rpc_response_cache::make_key(query_info.m_URI, query_info.m_body);
+      if (!key.empty())
+      {
+        pool_cookie = m_core.get_pool_cookie();
+        rpc_response_cache::response cached;
+        if (m_response_cache->get(key, pool_cookie, cached))
+        {
+          response.m_body = std::move(cached.body);
+          response.m_mime_tipe = std::move(cached.mime_type);
+          response.m_header_info.m_content_type = std::move(cached.content_type);
+          return true;
+        }
+        generation = m_response_cache->generation();
+      }
+    }
+
+    cacheable_response = {0, NULL, NULL};
+    try
+    {
+      if (!handle_http_request_map(query_info, response, context))
+      {
+        response.m_response_code = 404;
+        response.m_response_comment = "Not found";
+      }
+    }
+    catch (const std::exception &e)
+    {
+      MERROR(context << "Exception in handle_http_request_map: " << e.what());
+      response.m_response_code = 500;
+      response.m_response_comment = "Internal Server Error";
+    }
+
+    if (!key.empty() && cacheable_response.dependencies && response.m_response_code == 200)
+    {
+      cacheable_response.misses->inc();
+      m_response_cache->put(std::move(key), cacheable_response.dependencies, generation, pool_cookie,
+          {response.m_body, response.m_mime_tipe, response.m_header_info.m_content_type}, cacheable_response.hits);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::check_payment(const std::string &client_message, uint64_t payment, const std::string &rpc, bool same_ts, std::string &message, uint64_t &credits, std::string &top_hash)
   {
     if (m_rpc_payment == NULL)
@@ -455,6 +648,17 @@ namespace cryptonote
   }
 #define CHECK_CORE_READY() do { if(!check_core_ready()){res.status =  CORE_RPC_STATUS_BUSY;return true;} } while(0)
 
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx)
+  {
+    // MAP_URI2 matches any URI containing the pattern
+    if (m_restricted || query_info.m_URI != "/metrics")
+      return false;
+    response_info.m_body = tools::metrics::render();
+    response_info.m_mime_tipe = "text/plain; version=0.0.4";
+    response_info.m_header_info.m_content_type = " text/plain; version=0.0.4";
+    return true;
+  }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res, const connection_context *ctx)
   {
@@ -552,6 +756,7 @@ namespace cryptonote
 
     res.status = CORE_RPC_STATUS_OK;
     res.donation_address = m_core.get_addy();
+    RPC_CACHE_RESPONSE(get_info, rpc_response_cache::depends_on_chain | rpc_response_cache::depends_on_pool);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -594,7 +799,8 @@ namespace cryptonote
     if (use_bootstrap_daemon)
     {
       bool r;
-      return use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_FAST>(invoke_http_mode::BIN, "/getblocks.bin", req, res, r);
+      if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_FAST>(invoke_http_mode::BIN, "/getblocks.bin", req, res, r))
+        return r;
     }
 
     CHECK_PAYMENT(req, res, 1);
@@ -1053,131 +1259,169 @@ namespace cryptonote
 
     CHECK_AND_ASSERT_MES(txs.size() + missed_txs.size() == vh.size(), false, "mismatched number of txs");
 
+    // pair each tx found with the hash string it was requested as
+    std::vector<std::string> tx_hash_strs;
+    tx_hash_strs.reserve(txs.size());
     auto txhi = req.txs_hashes.cbegin();
     auto vhi = vh.cbegin();
     auto missedi = missed_txs.cbegin();
-
-    for(auto& tx: txs)
+    for (const auto &tx: txs)
     {
-      res.txs.push_back(COMMAND_RPC_GET_TRANSACTIONS::entry());
-      COMMAND_RPC_GET_TRANSACTIONS::entry &e = res.txs.back();
-
       while (missedi != missed_txs.end() && *missedi == *vhi)
       {
           ++vhi;
           ++txhi;
           ++missedi;
       }
-
-      crypto::hash tx_hash = *vhi++;
+      const crypto::hash &tx_hash = *vhi++;
       CHECK_AND_ASSERT_MES(tx_hash == std::get<0>(tx), false, "mismatched tx hash");
-      e.tx_hash = *txhi++;
-      e.prunable_hash = epee::string_tools::pod_to_hex(std::get<2>(tx));
-      if (req.split || req.prune || std::get<3>(tx).empty())
-      {
-        // use splitted form with pruned and prunable (filled only when prune=false and the daemon has it), leaving as_hex as empty
-        e.pruned_as_hex = string_tools::buff_to_hex_nodelimer(std::get<1>(tx));
-        if (!req.prune)
-          e.prunable_as_hex = string_tools::buff_to_hex_nodelimer(std::get<3>(tx));
-        if (req.decode_as_json)
+      tx_hash_strs.push_back(*txhi++);
+    }
+
+    // encoding and db lookups are independent for each tx, large batches are spread over the IO threads
+    const uint64_t blockchain_height = m_core.get_current_blockchain_height();
+    BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+    res.txs.resize(txs.size());
+    std::vector<std::string> errors(txs.size());
+    const auto fill_entries = [&](size_t start, size_t end)
+    {
+      size_t i = start;
+      try
+      {
+        db_rtxn_guard rtxn_guard(&db);
+        for (; i < end; ++i)
         {
-          cryptonote::blobdata tx_data;
-          cryptonote::transaction t;
-          if (req.prune || std::get<3>(tx).empty())
+          const auto &tx = txs[i];
+          const crypto::hash &tx_hash = std::get<0>(tx);
+          COMMAND_RPC_GET_TRANSACTIONS::entry &e = res.txs[i];
+          e.tx_hash = tx_hash_strs[i];
+          e.prunable_hash = epee::string_tools::pod_to_hex(std::get<2>(tx));
+          // use splitted form with pruned and prunable (filled only when prune=false and the daemon has it), leaving as_hex as empty,
+          // or non-splitted form, leaving pruned_as_hex and prunable_as_hex as empty
+          const bool split = req.split || req.prune || std::get<3>(tx).empty();
+          const bool pruned = split && (req.prune || std::get<3>(tx).empty());
+          if (split)
+          {
+            e.pruned_as_hex = string_tools::buff_to_hex_nodelimer(std::get<1>(tx));
+            if (!req.prune)
+              e.prunable_as_hex = string_tools::buff_to_hex_nodelimer(std::get<3>(tx));
+          }
+          else
+          {
+            e.as_hex = string_tools::buff_to_hex_nodelimer(std::get<1>(tx) + std::get<3>(tx));
+          }
+          if (req.decode_as_json && !m_tx_json_cache.get(tx_hash, pruned, e.as_json))
           {
-            // decode pruned tx to JSON
-            tx_data = std::get<1>(tx);
-            if (cryptonote::parse_and_validate_tx_base_from_blob(tx_data, t))
+            cryptonote::transaction t;
+            if (pruned)
             {
+              // decode pruned tx to JSON
+              if (!cryptonote::parse_and_validate_tx_base_from_blob(std::get<1>(tx), t))
+              {
+                errors[i] = "Failed to parse and validate pruned tx from blob";
+                continue;
+              }
               pruned_transaction pruned_tx{t};
               e.as_json = obj_to_json_str(pruned_tx);
             }
             else
             {
-              res.status = "Failed to parse and validate pruned tx from blob";
-              return true;
+              // decode full tx to JSON
+              if (!cryptonote::parse_and_validate_tx_from_blob(std::get<1>(tx) + std::get<3>(tx), t))
+              {
+                errors[i] = "Failed to parse and validate tx from blob";
+                continue;
+              }
+              e.as_json = obj_to_json_str(t);
             }
+            m_tx_json_cache.put(tx_hash, pruned, e.as_json);
           }
-          else
+          e.in_pool = pool_tx_hashes.find(tx_hash) != pool_tx_hashes.end();
+          if (e.in_pool)
           {
-            // decode full tx to JSON
-            tx_data = std::get<1>(tx) + std::get<3>(tx);
-            if (cryptonote::parse_and_validate_tx_from_blob(tx_data, t))
+            e.block_height = e.block_timestamp = std::numeric_limits<uint64_t>::max();
+            e.confirmations = 0;
+            auto it = per_tx_pool_tx_details.find(tx_hash);
+            if (it != per_tx_pool_tx_details.end())
             {
-              e.as_json = obj_to_json_str(t);
+              e.double_spend_seen = it->second.double_spend_seen;
+              e.relayed = it->second.relayed;
+              e.received_timestamp = it->second.receive_time;
             }
             else
             {
-              res.status = "Failed to parse and validate tx from blob";
-              return true;
+              MERROR("Failed to determine pool info for " << tx_hash);
+              e.double_spend_seen = false;
+              e.relayed = false;
+              e.received_timestamp = 0;
             }
           }
-        }
-      }
-      else
-      {
-        // use non-splitted form, leaving pruned_as_hex and prunable_as_hex as empty
-        cryptonote::blobdata tx_data = std::get<1>(tx) + std::get<3>(tx);
-        e.as_hex = string_tools::buff_to_hex_nodelimer(tx_data);
-        if (req.decode_as_json)
-        {
-          cryptonote::transaction t;
-          if (cryptonote::parse_and_validate_tx_from_blob(tx_data, t))
-          {
-            e.as_json = obj_to_json_str(t);
-          }
           else
           {
-            res.status = "Failed to parse and validate tx from blob";
-            return true;
+            e.block_height = db.get_tx_block_height(tx_hash);
+            e.confirmations = blockchain_height - e.block_height;
+            e.block_timestamp = db.get_block_timestamp(e.block_height);
+            e.received_timestamp = 0;
+            e.double_spend_seen = false;
+            e.relayed = false;
+
+            // output indices too if not in pool
+            uint64_t tx_index;
+            if (!db.tx_exists(tx_hash, tx_index))
+            {
+              errors[i] = "Failed";
+              continue;
+            }
+            std::vector<std::vector<uint64_t>> indices = db.get_tx_amount_output_indices(tx_index, 1);
+            if (indices.size() != 1)
+            {
+              errors[i] = "Failed";
+              continue;
+            }
+            e.output_indices = std::move(indices.front());
           }
         }
       }
-      e.in_pool = pool_tx_hashes.find(tx_hash) != pool_tx_hashes.end();
-      if (e.in_pool)
+      catch (const std::exception &e)
       {
-        e.block_height = e.block_timestamp = std::numeric_limits<uint64_t>::max();
-        e.confirmations = 0;
-        auto it = per_tx_pool_tx_details.find(tx_hash);
-        if (it != per_tx_pool_tx_details.end())
-        {
-          e.double_spend_seen = it->second.double_spend_seen;
-          e.relayed = it->second.relayed;
-          e.received_timestamp = it->second.receive_time;
-        }
-        else
-        {
-          MERROR("Failed to determine pool info for " << tx_hash);
-          e.double_spend_seen = false;
-          e.relayed = false;
-          e.received_timestamp = 0;
-        }
+        MERROR("Failed to fill transaction entry: " << e.what());
+        for (; i < end; ++i)
+          errors[i] = "Failed";
       }
-      else
+    };
+
+    tools::threadpool& tpool = tools::threadpool::getInstanceForIO();
+    const size_t n_txes = txs.size();
+    const size_t threads = std::min<size_t>(tpool.get_max_concurrency(), (n_txes + GET_TRANSACTIONS_MIN_TXES_PER_THREAD - 1) / GET_TRANSACTIONS_MIN_TXES_PER_THREAD);
+    if (threads > 1)
+    {
+      tools::threadpool::waiter waiter(tpool);
+      const size_t txes_per_thread = (n_txes + threads - 1) / threads;
+      for (size_t start = 0; start < n_txes; start += txes_per_thread)
+        tpool.submit(&waiter, [&fill_entries, start, end = std::min(start + txes_per_thread, n_txes)]() { fill_entries(start, end); });
+      if (!waiter.wait())
       {
-        e.block_height = m_core.get_blockchain_storage().get_db().get_tx_block_height(tx_hash);
-        e.confirmations = m_core.get_current_blockchain_height() - e.block_height;
-        e.block_timestamp = m_core.get_blockchain_storage().get_db().get_block_timestamp(e.block_height);
-        e.received_timestamp = 0;
-        e.double_spend_seen = false;
-        e.relayed = false;
+        res.status = "Failed";
+        return true;
       }
+    }
+    else
+    {
+      fill_entries(0, n_txes);
+    }
 
-      // fill up old style responses too, in case an old wallet asks
-      res.txs_as_hex.push_back(e.as_hex);
-      if (req.decode_as_json)
-        res.txs_as_json.push_back(e.as_json);
-
-      // output indices too if not in pool
-      if (pool_tx_hashes.find(tx_hash) == pool_tx_hashes.end())
+    for (size_t i = 0; i < n_txes; ++i)
+    {
+      if (!errors[i].empty())
       {
-        bool r = m_core.get_tx_outputs_gindexs(tx_hash, e.output_indices);
-        if (!r)
-        {
-          res.status = "Failed";
-          return true;
-        }
+        res.txs.clear();
+        res.status = errors[i];
+        return true;
       }
+      // fill up old style responses too, in case an old wallet asks
+      res.txs_as_hex.push_back(res.txs[i].as_hex);
+      if (req.decode_as_json)
+        res.txs_as_json.push_back(res.txs[i].as_json);
     }
 
     for(const auto& miss_tx: missed_txs)
@@ -1670,6 +1914,7 @@ namespace cryptonote
     }
 
     res.status = CORE_RPC_STATUS_OK;
+    RPC_CACHE_RESPONSE(get_transaction_pool_hashes, rpc_response_cache::depends_on_pool);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -2326,6 +2571,100 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::have_block(const std::string &hash) const
+  {
+    crypto::hash h;
+    return epee::string_tools::hex_to_pod(hash, h) && m_core.get_blockchain_storage().have_block(h);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request &req) const
+  {
+    return req.height < m_core.get_current_blockchain_height();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request &req) const
+  {
+    return req.start_height <= req.end_height && req.end_height < m_core.get_current_blockchain_height();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::request &req) const
+  {
+    if (!req.hash.empty() && !have_block(req.hash))
+      return false;
+    return std::all_of(req.hashes.begin(), req.hashes.end(), [this](const std::string &hash) { return have_block(hash); });
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_BLOCK::request &req) const
+  {
+    if (!req.hash.empty())
+      return have_block(req.hash);
+    return req.height < m_core.get_current_blockchain_height();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request &req) const
+  {
+    const uint64_t height = m_core.get_current_blockchain_height();
+    return std::all_of(req.heights.begin(), req.heights.end(), [height](uint64_t h) { return h < height; });
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request &req) const
+  {
+    // to_height 0 means the top, which is ours only once synced
+    if (req.to_height == 0)
+      return m_core.is_synchronized();
+    return req.from_height <= req.to_height && req.to_height < m_core.get_current_blockchain_height();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::chain_covered_locally(const std::list<crypto::hash> &block_ids, uint64_t start_height) const
+  {
+    // the wallet's top block must be on our chain, or the split point would
+    // be a stale one, and we must have blocks after it
+    if (block_ids.empty())
+      return false;
+    uint64_t height;
+    if (!m_core.get_blockchain_storage().get_db().block_exists(block_ids.front(), &height))
+      return false;
+    return std::max(height + 1, start_height) < m_core.get_current_blockchain_height();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_BLOCKS_FAST::request &req) const
+  {
+    // our pool is not to be relied on while syncing
+    return req.requested_info == COMMAND_RPC_GET_BLOCKS_FAST::BLOCKS_ONLY && chain_covered_locally(req.block_ids, req.start_height);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_HASHES_FAST::request &req) const
+  {
+    return chain_covered_locally(req.block_ids, req.start_height);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::outputs_served_locally(const std::vector<get_outputs_out> &outputs) const
+  {
+    // only rct outputs old enough to be unlocked whatever the top, so
+    // their unlocked flag is the same as from the bootstrap daemon
+    const uint64_t height = m_core.get_current_blockchain_height();
+    if (outputs.empty() || height <= CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW)
+      return false;
+    const BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+    const uint64_t n_outputs = db.get_block_cumulative_rct_outputs({height - 1 - CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW}).front();
+    return std::all_of(outputs.begin(), outputs.end(), [n_outputs](const get_outputs_out &out) { return out.amount == 0 && out.index < n_outputs; });
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_OUTPUTS_BIN::request &req) const
+  {
+    return outputs_served_locally(req.outputs);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_OUTPUTS::request &req) const
+  {
+    return outputs_served_locally(req.outputs);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::served_locally(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request &req) const
+  {
+    return m_core.get_blockchain_storage().get_db().tx_exists(req.txid);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   template <typename COMMAND_TYPE>
   bool core_rpc_server::use_bootstrap_daemon_if_necessary(const invoke_http_mode &mode, const std::string &command_name, const typename COMMAND_TYPE::request& req, typename COMMAND_TYPE::response& res, bool &r)
   {
@@ -2344,6 +2683,12 @@ namespace cryptonote
       return false;
     }
 
+    if (served_locally(req))
+    {
+      MDEBUG("Serving " << command_name << " locally, the local chain already covers it");
+      return false;
+    }
+
     auto current_time = std::chrono::system_clock::now();
     if (current_time - m_bootstrap_height_check_time > std::chrono::seconds(30))  // update every 30s
     {
@@ -2384,17 +2729,26 @@ namespace cryptonote
       }
     }
 
+    // reads wallets wait on go to two nodes at once, the first valid response wins
+    static const std::unordered_set<std::string> raced_commands = {
+      "/getheight", "/getinfo", "/gethashes.bin", "/getblocks.bin", "/getblocks_by_height.bin", "/get_outs.bin", "/get_outs",
+      "/get_o_indexes.bin", "/gettransactions", "/is_key_image_spent", "/get_transaction_pool_hashes.bin",
+      "/get_output_distribution.bin", "getlastblockheader", "getblockheaderbyhash", "getblockheaderbyheight",
+      "getblockheadersrange", "getblock", "get_fee_estimate", "get_output_distribution", "get_version", "hard_fork_info"
+    };
+    const bool race = raced_commands.count(command_name) > 0;
+
     if (mode == invoke_http_mode::JON)
     {
-      r = m_bootstrap_daemon->invoke_http_json(command_name, req, res);
+      r = m_bootstrap_daemon->invoke_http_json(command_name, req, res, race);
     }
     else if (mode == invoke_http_mode::BIN)
     {
-      r = m_bootstrap_daemon->invoke_http_bin(command_name, req, res);
+      r = m_bootstrap_daemon->invoke_http_bin(command_name, req, res, race);
     }
     else if (mode == invoke_http_mode::JON_RPC)
     {
-      r = m_bootstrap_daemon->invoke_http_json_rpc(command_name, req, res);
+      r = m_bootstrap_daemon->invoke_http_json_rpc(command_name, req, res, race);
     }
     else
     {
@@ -2445,6 +2799,7 @@ namespace cryptonote
       return false;
     }
     res.status = CORE_RPC_STATUS_OK;
+    RPC_CACHE_RESPONSE(get_last_block_header, rpc_response_cache::depends_on_chain);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -2984,6 +3339,7 @@ namespace cryptonote
     }
     res.quantization_mask = Blockchain::get_fee_quantization_mask();
     res.status = CORE_RPC_STATUS_OK;
+    RPC_CACHE_RESPONSE(get_base_fee_estimate, rpc_response_cache::depends_on_chain);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3201,6 +3557,7 @@ namespace cryptonote
     RPC_TRACKER(pop_blocks);
 
     m_core.get_blockchain_storage().pop_blocks(req.nblocks);
+    m_response_cache->on_chain_changed();
 
     res.height = m_core.get_current_blockchain_height();
     res.status = CORE_RPC_STATUS_OK;
@@ -3351,6 +3708,7 @@ namespace cryptonote
     }
 
     res.status = CORE_RPC_STATUS_OK;
+    RPC_CACHE_RESPONSE(get_output_distribution, rpc_response_cache::depends_on_chain);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3404,6 +3762,7 @@ namespace cryptonote
     }
 
     res.status = CORE_RPC_STATUS_OK;
+    RPC_CACHE_RESPONSE(get_output_distribution_bin, rpc_response_cache::depends_on_chain);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3411,9 +3770,30 @@ namespace cryptonote
   {
     RPC_TRACKER(prune_blockchain);
 
+    if (req.compact && !req.background)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+      error_resp.message = "compact needs background";
+      return false;
+    }
+
     try
     {
-      if (!(req.check ? m_core.check_blockchain_pruning() : m_core.prune_blockchain()))
+      if (req.background || req.status)
+      {
+        if (req.background && !req.status && m_core.get_blockchain_storage().start_background_pruning(0, req.compact))
+          MINFO("Started background pruning");
+        const Blockchain::background_pruning_status status = m_core.get_blockchain_storage().get_background_pruning_status();
+        res.background_running = status.running;
+        res.background_done = status.progress.done;
+        res.compacting = status.compacting;
+        res.visited_records = status.progress.n_total_records;
+        res.pruned_records = status.progress.n_pruned_records;
+        res.pruned_bytes = status.progress.n_bytes;
+        res.compacted_path = status.compacted_path;
+        res.background_error = status.error;
+      }
+      else if (!(req.check ? m_core.check_blockchain_pruning() : m_core.prune_blockchain()))
       {
         error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
         error_resp.message = req.check ? "Failed to check blockchain pruning" : "Failed to prune blockchain";
@@ -3507,6 +3887,26 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_trace(const COMMAND_RPC_TRACE::request& req, COMMAND_RPC_TRACE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    RPC_TRACKER(trace);
+    if (req.enable && req.disable)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+      error_resp.message = "Cannot both enable and disable tracing";
+      return false;
+    }
+    if (req.dump)
+      res.trace = tools::trace::dump_chrome_trace();
+    if (req.clear)
+      tools::trace::clear();
+    if (req.enable || req.disable)
+      tools::trace::set_enabled(req.enable);
+    res.enabled = tools::trace::is_enabled();
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_rpc_access_submit_nonce(const COMMAND_RPC_ACCESS_SUBMIT_NONCE::request& req, COMMAND_RPC_ACCESS_SUBMIT_NONCE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(rpc_access_submit_nonce);
@@ -3750,4 +4150,28 @@ namespace cryptonote
     , "Allow free access from the loopback address (ie, the local host)"
     , false
     };
+
+  const command_line::arg_descriptor<uint32_t> core_rpc_server::arg_rpc_threads = {
+      "rpc-threads"
+    , "Number of threads serving each RPC server"
+    , 2
+    };
+
+  const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_client_rate = {
+      "rpc-client-rate"
+    , "Credits per second each client of the restricted RPC may spend, at the RPC payment costs, 0 to disable. Authenticated clients are not limited, and one RPC thread is kept for them"
+    , 0
+    };
+
+  const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_client_burst = {
+      "rpc-client-burst"
+    , "Credits a restricted RPC client may spend at once before being rate limited"
+    , 100000
+    };
+
+  const command_line::arg_descriptor<bool> core_rpc_server::arg_rpc_client_rate_allow_loopback = {
+      "rpc-client-rate-allow-loopback"
+    , "Do not rate limit clients connecting from the loopback address. Do not use behind a local Tor or i2p proxy, which makes every client look local"
+    , false
+    };
 }  // namespace cryptonote
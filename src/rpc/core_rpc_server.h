@@ -43,6 +43,9 @@
 #include "p2p/net_node.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
 #include "rpc_payment.h"
+#include "rpc_rate_limiter.h"
+#include "rpc_response_cache.h"
+#include "tx_json_cache.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
@@ -77,6 +80,10 @@ namespace cryptonote
     static const command_line::arg_descriptor<uint64_t> arg_rpc_payment_difficulty;
     static const command_line::arg_descriptor<uint64_t> arg_rpc_payment_credits;
     static const command_line::arg_descriptor<bool> arg_rpc_payment_allow_free_loopback;
+    static const command_line::arg_descriptor<uint32_t> arg_rpc_threads;
+    static const command_line::arg_descriptor<uint64_t> arg_rpc_client_rate;
+    static const command_line::arg_descriptor<uint64_t> arg_rpc_client_burst;
+    static const command_line::arg_descriptor<bool> arg_rpc_client_rate_allow_loopback;
 
     typedef epee::net_utils::connection_context_base connection_context;
 
@@ -96,7 +103,8 @@ namespace cryptonote
       );
     network_type nettype() const { return m_core.get_nettype(); }
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    //forward http requests to uri map, serving repeated ones from the response cache
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& context);
 
     BEGIN_URI_MAP2()
       MAP_URI_AUTO_JON2("/get_height", on_get_height, COMMAND_RPC_GET_HEIGHT)
@@ -141,6 +149,7 @@ namespace cryptonote
       MAP_URI_AUTO_JON2_IF("/update", on_update, COMMAND_RPC_UPDATE, !m_restricted)
       MAP_URI_AUTO_BIN2("/get_output_distribution.bin", on_get_output_distribution_bin, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION)
       MAP_URI_AUTO_JON2_IF("/pop_blocks", on_pop_blocks, COMMAND_RPC_POP_BLOCKS, !m_restricted)
+      MAP_URI2("/metrics", on_metrics)
       BEGIN_JSON_RPC_MAP("/json_rpc")
         MAP_JON_RPC("get_block_count",           on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
         MAP_JON_RPC("getblockcount",             on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
@@ -182,6 +191,7 @@ namespace cryptonote
         MAP_JON_RPC_WE("get_output_distribution", on_get_output_distribution, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION)
         MAP_JON_RPC_WE_IF("prune_blockchain",    on_prune_blockchain,           COMMAND_RPC_PRUNE_BLOCKCHAIN, !m_restricted)
         MAP_JON_RPC_WE_IF("flush_cache",         on_flush_cache,                COMMAND_RPC_FLUSH_CACHE, !m_restricted)
+        MAP_JON_RPC_WE_IF("trace",               on_trace,                      COMMAND_RPC_TRACE, !m_restricted)
         MAP_JON_RPC_WE("rpc_access_info",        on_rpc_access_info,            COMMAND_RPC_ACCESS_INFO)
         MAP_JON_RPC_WE("rpc_access_submit_nonce",on_rpc_access_submit_nonce,    COMMAND_RPC_ACCESS_SUBMIT_NONCE)
         MAP_JON_RPC_WE("rpc_access_pay",         on_rpc_access_pay,             COMMAND_RPC_ACCESS_PAY)
@@ -192,6 +202,7 @@ namespace cryptonote
     END_URI_MAP2()
 
     bool on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res, const connection_context *ctx = NULL);
+    bool on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context *ctx);
     bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, const connection_context *ctx = NULL);
     bool on_get_alt_blocks_hashes(const COMMAND_RPC_GET_ALT_BLOCKS_HASHES::request& req, COMMAND_RPC_GET_ALT_BLOCKS_HASHES::response& res, const connection_context *ctx = NULL);
     bool on_get_blocks_by_height(const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response& res, const connection_context *ctx = NULL);
@@ -259,6 +270,7 @@ namespace cryptonote
     bool on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_prune_blockchain(const COMMAND_RPC_PRUNE_BLOCKCHAIN::request& req, COMMAND_RPC_PRUNE_BLOCKCHAIN::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_flush_cache(const COMMAND_RPC_FLUSH_CACHE::request& req, COMMAND_RPC_FLUSH_CACHE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
+    bool on_trace(const COMMAND_RPC_TRACE::request& req, COMMAND_RPC_TRACE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_rpc_access_info(const COMMAND_RPC_ACCESS_INFO::request& req, COMMAND_RPC_ACCESS_INFO::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_rpc_access_submit_nonce(const COMMAND_RPC_ACCESS_SUBMIT_NONCE::request& req, COMMAND_RPC_ACCESS_SUBMIT_NONCE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_rpc_access_pay(const COMMAND_RPC_ACCESS_PAY::request& req, COMMAND_RPC_ACCESS_PAY::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
@@ -271,6 +283,8 @@ private:
     bool check_core_busy();
     bool check_core_ready();
     bool add_host_fail(const connection_context *ctx, unsigned int score = 1);
+    void register_metrics();
+    bool use_response_cache();
     
     //utils
     uint64_t get_block_reward(const block& blk);
@@ -287,6 +301,23 @@ private:
     enum invoke_http_mode { JON, BIN, JON_RPC };
     template <typename COMMAND_TYPE>
     bool use_bootstrap_daemon_if_necessary(const invoke_http_mode &mode, const std::string &command_name, const typename COMMAND_TYPE::request& req, typename COMMAND_TYPE::response& res, bool &r);
+    //! Whether the local chain already has what a request asks for, so it is served locally while syncing
+    template <typename REQUEST>
+    bool served_locally(const REQUEST &req) const { return false; }
+    bool served_locally(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_BLOCK::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_BLOCKS_FAST::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_HASHES_FAST::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_OUTPUTS_BIN::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_OUTPUTS::request &req) const;
+    bool served_locally(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request &req) const;
+    bool chain_covered_locally(const std::list<crypto::hash> &block_ids, uint64_t start_height) const;
+    bool outputs_served_locally(const std::vector<get_outputs_out> &outputs) const;
+    bool have_block(const std::string &hash) const;
     bool get_block_template(const account_public_address &address, const crypto::hash *prev_block, const cryptonote::blobdata &extra_nonce, size_t &reserved_offset, cryptonote::difficulty_type &difficulty, uint64_t &height, uint64_t &expected_reward, block &b, uint64_t &seed_height, crypto::hash &seed_hash, crypto::hash &next_seed_hash, epee::json_rpc::error &error_resp);
     bool check_payment(const std::string &client, uint64_t payment, const std::string &rpc, bool same_ts, std::string &message, uint64_t &credits, std::string &top_hash);
     
@@ -304,6 +335,11 @@ private:
     std::unique_ptr<rpc_payment> m_rpc_payment;
     bool disable_rpc_ban;
     bool m_rpc_payment_allow_free_loopback;
+    bool m_login_required;
+    std::unique_ptr<rpc_rate_limiter> m_rate_limiter;
+    bool m_rate_limit_allow_loopback;
+    std::shared_ptr<rpc_response_cache> m_response_cache;
+    tx_json_cache m_tx_json_cache;
   };
 }
 
@@ -88,7 +88,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 3
-#define CORE_RPC_VERSION_MINOR 14
+#define CORE_RPC_VERSION_MINOR 16
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -2755,10 +2755,16 @@ namespace cryptonote
     struct request_t: public rpc_request_base
     {
       bool check;
+      bool background;
+      bool compact;
+      bool status;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_request_base)
         KV_SERIALIZE_OPT(check, false)
+        KV_SERIALIZE_OPT(background, false)
+        KV_SERIALIZE_OPT(compact, false)
+        KV_SERIALIZE_OPT(status, false)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
@@ -2767,11 +2773,27 @@ namespace cryptonote
     {
       bool pruned;
       uint32_t pruning_seed;
+      bool background_running;
+      bool background_done;
+      bool compacting;
+      uint64_t visited_records;
+      uint64_t pruned_records;
+      uint64_t pruned_bytes;
+      std::string compacted_path;
+      std::string background_error;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_response_base)
         KV_SERIALIZE(pruned)
         KV_SERIALIZE(pruning_seed)
+        KV_SERIALIZE_OPT(background_running, false)
+        KV_SERIALIZE_OPT(background_done, false)
+        KV_SERIALIZE_OPT(compacting, false)
+        KV_SERIALIZE_OPT(visited_records, (uint64_t)0)
+        KV_SERIALIZE_OPT(pruned_records, (uint64_t)0)
+        KV_SERIALIZE_OPT(pruned_bytes, (uint64_t)0)
+        KV_SERIALIZE_OPT(compacted_path, std::string())
+        KV_SERIALIZE_OPT(background_error, std::string())
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -2801,4 +2823,37 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_TRACE
+  {
+    struct request_t: public rpc_request_base
+    {
+      bool enable;
+      bool disable;
+      bool clear;
+      bool dump;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+        KV_SERIALIZE_OPT(enable, false)
+        KV_SERIALIZE_OPT(disable, false)
+        KV_SERIALIZE_OPT(clear, false)
+        KV_SERIALIZE_OPT(dump, false)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t: public rpc_response_base
+    {
+      bool enabled;
+      std::string trace;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(enabled)
+        KV_SERIALIZE_OPT(trace, std::string())
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
 }
@@ -46,6 +46,16 @@ namespace rpc
       if (d.cached && amount == 0 && d.cached_from == from_height && d.cached_to == to_height && d.cached_top_hash == top_hash)
         return process_distribution(cumulative, d.cached_start_height, d.cached_distribution, d.cached_base);
 
+      // wallets keeping their own copy only ask for the tail, which we can slice off the cache
+      if (d.cached && amount == 0 && d.cached_from < from_height && d.cached_to == to_height && d.cached_top_hash == top_hash
+          && from_height > d.cached_start_height && from_height <= d.cached_to)
+      {
+        const std::uint64_t offset = from_height - d.cached_start_height;
+        CHECK_AND_ASSERT_MES(offset < d.cached_distribution.size(), boost::none, "Cached distribution size does not match cached bounds");
+        std::vector<std::uint64_t> tail(d.cached_distribution.begin() + offset, d.cached_distribution.end());
+        return process_distribution(cumulative, from_height, std::move(tail), d.cached_distribution[offset - 1]);
+      }
+
       std::vector<std::uint64_t> distribution;
       std::uint64_t start_height, base;
 
@@ -95,7 +105,8 @@ namespace rpc
           distribution.resize(to_height - offset + 1);
       }
 
-      if (amount == 0)
+      // do not let a tail request evict a cached distribution covering more of the chain
+      if (amount == 0 && (!d.cached || from_height <= d.cached_from))
       {
         d.cached_from = from_height;
         d.cached_to = to_height;
@@ -0,0 +1,148 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <boost/thread/thread.hpp>
+#include "rpc_rate_limiter.h"
+#include "common/metrics.h"
+
+namespace cryptonote
+{
+  rpc_rate_limiter::rpc_rate_limiter(double rate, double burst, std::chrono::milliseconds max_wait, size_t max_clients):
+    m_rate(rate),
+    m_burst(burst),
+    m_max_wait(max_wait),
+    m_max_clients(max_clients),
+    m_in_flight(0)
+  {
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_rate_limiter::admission rpc_rate_limiter::admit(const std::string &client, size_t public_slots, uint64_t estimate, uint64_t &retry_after)
+  {
+    static tools::metrics::counter &busy = tools::metrics::get_counter("rpc_rejected_total", "RPC calls turned away by the rate limiter", "reason=\"busy\"");
+    static tools::metrics::counter &rate = tools::metrics::get_counter("rpc_rejected_total", "RPC calls turned away by the rate limiter", "reason=\"rate\"");
+
+    const auto now = std::chrono::steady_clock::now();
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (m_in_flight >= public_slots)
+    {
+      busy.inc();
+      retry_after = 1;
+      return rejected_busy;
+    }
+    bucket &b = get_bucket(client, now);
+    if (b.in_flight >= std::max<size_t>(public_slots / 2, 1))
+    {
+      busy.inc();
+      retry_after = 1;
+      return rejected_busy;
+    }
+    if (b.tokens >= 0)
+    {
+      ++m_in_flight;
+      ++b.in_flight;
+      b.tokens -= estimate;
+      return admitted;
+    }
+
+    const double wait = -b.tokens / m_rate;
+    if (b.waiting || wait * 1000 > m_max_wait.count())
+    {
+      rate.inc();
+      retry_after = std::ceil(wait);
+      return rejected_rate;
+    }
+
+    // one call per client may wait, holding a public slot, so a client in
+    // debt is slowed down rather than retrying straight away
+    ++m_in_flight;
+    ++b.in_flight;
+    b.tokens -= estimate;
+    b.waiting = true;
+    lock.unlock();
+    boost::this_thread::sleep_for(boost::chrono::microseconds((uint64_t)(wait * 1000000)));
+    lock.lock();
+    // buckets with calls in flight are never evicted
+    m_buckets.find(client)->second.waiting = false;
+    return admitted;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_rate_limiter::release(const std::string &client, uint64_t estimate, uint64_t cost)
+  {
+    const auto now = std::chrono::steady_clock::now();
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (m_in_flight > 0)
+      --m_in_flight;
+    bucket &b = get_bucket(client, now);
+    if (b.in_flight > 0)
+      --b.in_flight;
+    b.tokens = std::min(m_burst, b.tokens - ((double)cost - (double)estimate));
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  size_t rpc_rate_limiter::in_flight() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_in_flight;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_rate_limiter::bucket &rpc_rate_limiter::get_bucket(const std::string &client, std::chrono::steady_clock::time_point now)
+  {
+    auto it = m_buckets.find(client);
+    if (it != m_buckets.end())
+    {
+      refill(it->second, now);
+      return it->second;
+    }
+
+    if (m_buckets.size() >= m_max_clients)
+    {
+      // full buckets hold nothing a fresh one would not
+      for (auto i = m_buckets.begin(); i != m_buckets.end(); )
+      {
+        auto next = std::next(i);
+        refill(i->second, now);
+        if (i->second.in_flight == 0 && i->second.tokens >= m_burst)
+          m_buckets.erase(i);
+        i = next;
+      }
+    }
+    return m_buckets.emplace(client, bucket{m_burst, now, 0, false}).first->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_rate_limiter::refill(bucket &b, std::chrono::steady_clock::time_point now) const
+  {
+    const double elapsed = std::chrono::duration<double>(now - b.last).count();
+    if (elapsed > 0)
+    {
+      b.tokens = std::min(m_burst, b.tokens + elapsed * m_rate);
+      b.last = now;
+    }
+  }
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+
+namespace cryptonote
+{
+  /*! Token buckets for the restricted RPC, one per client, filled with
+      credits at a fixed rate and drained by the RPC payment cost of each
+      call the client makes. A client in debt waits for the debt to be paid
+      back, or is turned away if that would take too long. The expected cost
+      of a call is charged when it is admitted, and the difference with its
+      actual cost when it ends, so concurrent calls cannot all get in on the
+      same credits.
+
+      Public clients also share a bounded number of concurrent requests, of
+      which one client may hold at most half, so some RPC threads are always
+      left to other clients, and to priority (authenticated, or explicitly
+      exempted local) clients, which skip the buckets entirely. */
+  class rpc_rate_limiter
+  {
+  public:
+    enum admission
+    {
+      admitted,
+      rejected_busy, //!< all public slots, or the client's share of them, in use
+      rejected_rate, //!< the client's debt is too large to wait for
+    };
+
+    rpc_rate_limiter(double rate, double burst, std::chrono::milliseconds max_wait = std::chrono::seconds(1), size_t max_clients = 65536);
+
+    /*! Waits until a public client may make a call, and charges it its
+        expected cost.
+        \param public_slots Concurrent public calls allowed
+        \param estimate Credits charged up front, reconciled by `release`
+        \param retry_after Seconds until the call would be admitted, set when rejected */
+    admission admit(const std::string &client, size_t public_slots, uint64_t estimate, uint64_t &retry_after);
+
+    //! Ends a call admitted with `admit`, charging the client the difference between its cost and the estimate.
+    void release(const std::string &client, uint64_t estimate, uint64_t cost);
+
+    size_t in_flight() const;
+
+  private:
+    struct bucket
+    {
+      double tokens;
+      std::chrono::steady_clock::time_point last;
+      size_t in_flight;
+      bool waiting;
+    };
+
+    bucket &get_bucket(const std::string &client, std::chrono::steady_clock::time_point now);
+    void refill(bucket &b, std::chrono::steady_clock::time_point now) const;
+
+    const double m_rate;
+    const double m_burst;
+    const std::chrono::milliseconds m_max_wait;
+    const size_t m_max_clients;
+    mutable boost::mutex m_mutex;
+    std::unordered_map<std::string, bucket> m_buckets;
+    size_t m_in_flight;
+  };
+}
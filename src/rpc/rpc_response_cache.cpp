@@ -0,0 +1,153 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <iterator>
+#include "rpc_response_cache.h"
+#include "common/metrics.h"
+
+// requests are small for all the calls worth caching, larger ones are
+// unlikely to be repeated byte for byte
+#define MAX_CACHED_REQUEST_SIZE 4096
+
+namespace cryptonote
+{
+  rpc_response_cache::rpc_response_cache(size_t max_entries, size_t max_bytes, std::chrono::milliseconds ttl):
+    m_max_entries(max_entries),
+    m_max_bytes(max_bytes),
+    m_ttl(ttl),
+    m_bytes(0),
+    m_generation(0)
+  {
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::string rpc_response_cache::make_key(const std::string &uri, const std::string &body)
+  {
+    std::string key;
+    if (body.size() > MAX_CACHED_REQUEST_SIZE)
+      return key;
+    key.reserve(uri.size() + 1 + body.size());
+    key.append(uri);
+    key.push_back('\0');
+    key.append(body);
+    return key;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool rpc_response_cache::get(const std::string &key, uint64_t pool_cookie, response &res)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    const auto it = m_entries.find(key);
+    if (it == m_entries.end())
+      return false;
+    const entry &e = it->second;
+    if (std::chrono::steady_clock::now() - e.inserted > m_ttl || ((e.dependencies & depends_on_pool) && e.pool_cookie != pool_cookie))
+    {
+      erase(it);
+      return false;
+    }
+    res = e.res;
+    if (e.hits)
+      e.hits->inc();
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  uint64_t rpc_response_cache::generation() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_generation;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_response_cache::put(std::string key, unsigned dependencies, uint64_t generation, uint64_t pool_cookie, response res, tools::metrics::counter *hits)
+  {
+    if (key.empty())
+      return;
+    const size_t bytes = key.size() + res.body.size() + res.mime_type.size() + res.content_type.size();
+    if (bytes > m_max_bytes / 4)
+      return;
+
+    const auto now = std::chrono::steady_clock::now();
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if ((dependencies & depends_on_chain) && generation != m_generation)
+      return;
+    const auto it = m_entries.find(key);
+    if (it != m_entries.end())
+      erase(it);
+    make_room(bytes, now);
+    m_entries.emplace(std::move(key), entry{std::move(res), dependencies, pool_cookie, now, hits});
+    m_bytes += bytes;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_response_cache::on_chain_changed()
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    ++m_generation;
+    for (auto it = m_entries.begin(); it != m_entries.end(); )
+    {
+      auto next = std::next(it);
+      if (it->second.dependencies & depends_on_chain)
+        erase(it);
+      it = next;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_response_cache::clear()
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    ++m_generation;
+    m_entries.clear();
+    m_bytes = 0;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  size_t rpc_response_cache::size() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_response_cache::erase(std::unordered_map<std::string, entry>::iterator it)
+  {
+    const entry &e = it->second;
+    m_bytes -= it->first.size() + e.res.body.size() + e.res.mime_type.size() + e.res.content_type.size();
+    m_entries.erase(it);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_response_cache::make_room(size_t bytes, std::chrono::steady_clock::time_point now)
+  {
+    if (m_entries.size() < m_max_entries && m_bytes + bytes <= m_max_bytes)
+      return;
+    for (auto it = m_entries.begin(); it != m_entries.end(); )
+    {
+      auto next = std::next(it);
+      if (now - it->second.inserted > m_ttl)
+        erase(it);
+      it = next;
+    }
+    // still full of live entries: drop arbitrary ones, they are all cheap to recompute
+    while (!m_entries.empty() && (m_entries.size() >= m_max_entries || m_bytes + bytes > m_max_bytes))
+      erase(m_entries.begin());
+  }
+}
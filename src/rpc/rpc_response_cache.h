@@ -0,0 +1,110 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+
+namespace tools { namespace metrics { class counter; } }
+
+namespace cryptonote
+{
+  /*! Serialized responses of RPC calls many clients make with the same
+      request, eg get_info or get_fee_estimate. Entries are keyed by URI and
+      request body, and dropped when the chain or pool they were computed
+      from changes, or when they get older than the TTL, which bounds how
+      stale the few time dependent fields (connection counts, sync state)
+      can get. */
+  class rpc_response_cache
+  {
+  public:
+    enum dependency
+    {
+      depends_on_chain = 1,
+      depends_on_pool = 2,
+    };
+
+    struct response
+    {
+      std::string body;
+      std::string mime_type;
+      std::string content_type;
+    };
+
+    rpc_response_cache(size_t max_entries = 256, size_t max_bytes = 64 * 1024 * 1024, std::chrono::milliseconds ttl = std::chrono::seconds(2));
+
+    //! \return The key of a request, or an empty string if it is too large to cache.
+    static std::string make_key(const std::string &uri, const std::string &body);
+
+    /*! \param pool_cookie Current pool cookie, entries depending on the pool
+          computed from an older one are misses.
+        \return True and the response if a fresh entry was found. */
+    bool get(const std::string &key, uint64_t pool_cookie, response &res);
+
+    //! \return Chain generation to pass to `put` for a response about to be computed.
+    uint64_t generation() const;
+
+    /*! Stores a response, unless the chain changed since `generation` was
+        read, in which case it may already be stale.
+        \param hits Counter bumped on every hit of this entry, or NULL */
+    void put(std::string key, unsigned dependencies, uint64_t generation, uint64_t pool_cookie, response res, tools::metrics::counter *hits);
+
+    //! Drops responses depending on the chain, to call on each new block or reorg.
+    void on_chain_changed();
+
+    //! Drops all responses.
+    void clear();
+
+    size_t size() const;
+
+  private:
+    struct entry
+    {
+      response res;
+      unsigned dependencies;
+      uint64_t pool_cookie;
+      std::chrono::steady_clock::time_point inserted;
+      tools::metrics::counter *hits;
+    };
+
+    void erase(std::unordered_map<std::string, entry>::iterator it);
+    void make_room(size_t bytes, std::chrono::steady_clock::time_point now);
+
+    const size_t m_max_entries;
+    const size_t m_max_bytes;
+    const std::chrono::milliseconds m_ttl;
+    mutable boost::mutex m_mutex;
+    std::unordered_map<std::string, entry> m_entries;
+    size_t m_bytes;
+    uint64_t m_generation;
+  };
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "tx_json_cache.h"
+
+namespace cryptonote
+{
+  tx_json_cache::tx_json_cache(size_t max_bytes):
+    m_max_bytes(max_bytes),
+    m_bytes(0)
+  {
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool tx_json_cache::get(const crypto::hash &txid, bool pruned, std::string &json)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    const auto it = m_entries.find(key{txid, pruned});
+    if (it == m_entries.end())
+      return false;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    json = it->second->second;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void tx_json_cache::put(const crypto::hash &txid, bool pruned, const std::string &json)
+  {
+    if (json.size() > m_max_bytes / 16)
+      return;
+    const key k{txid, pruned};
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (m_entries.find(k) != m_entries.end())
+      return;
+    while (!m_lru.empty() && m_bytes + json.size() > m_max_bytes)
+    {
+      m_bytes -= m_lru.back().second.size();
+      m_entries.erase(m_lru.back().first);
+      m_lru.pop_back();
+    }
+    m_lru.emplace_front(k, json);
+    m_entries.emplace(k, m_lru.begin());
+    m_bytes += json.size();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  size_t tx_json_cache::size() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+}
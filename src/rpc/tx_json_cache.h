@@ -0,0 +1,73 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /*! Least recently used JSON encodings of transactions, as returned by
+      get_transactions with decode_as_json. A txid fixes the whole
+      transaction, so entries never go stale, whether the transaction is
+      confirmed or still in the pool. */
+  class tx_json_cache
+  {
+  public:
+    tx_json_cache(size_t max_bytes = 64 * 1024 * 1024);
+
+    //! \param pruned True for the encoding of the pruned transaction
+    bool get(const crypto::hash &txid, bool pruned, std::string &json);
+    void put(const crypto::hash &txid, bool pruned, const std::string &json);
+
+    size_t size() const;
+
+  private:
+    struct key
+    {
+      crypto::hash txid;
+      bool pruned;
+      bool operator==(const key &other) const { return txid == other.txid && pruned == other.pruned; }
+    };
+    struct key_hash
+    {
+      size_t operator()(const key &k) const { return std::hash<crypto::hash>()(k.txid) ^ k.pruned; }
+    };
+    typedef std::list<std::pair<key, std::string>> lru_list;
+
+    const size_t m_max_bytes;
+    mutable boost::mutex m_mutex;
+    lru_list m_lru; //!< most recently used first
+    std::unordered_map<key, lru_list::iterator, key_hash> m_entries;
+    size_t m_bytes;
+  };
+}
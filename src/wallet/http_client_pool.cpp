@@ -0,0 +1,161 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "http_client_pool.h"
+#include "misc_log_ex.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "wallet.wallet2"
+
+namespace tools
+{
+
+http_client_pool::lease::lease(lease &&other) noexcept:
+  m_pool(other.m_pool),
+  m_client(other.m_client)
+{
+  other.m_client = NULL;
+}
+
+http_client_pool::lease::~lease()
+{
+  if (m_client)
+    m_pool->release(m_client);
+}
+
+http_client_pool::http_client_pool(std::unique_ptr<epee::net_utils::http::http_client_factory> factory, size_t max_clients):
+  m_factory(std::move(factory)),
+  m_max_clients(max_clients),
+  m_generation(0),
+  m_ssl_options(epee::net_utils::ssl_support_t::e_ssl_support_autodetect),
+  m_auto_connect(true)
+{
+}
+
+std::unique_ptr<epee::net_utils::http::abstract_http_client> http_client_pool::create()
+{
+  return m_factory->create();
+}
+
+http_client_pool::lease http_client_pool::acquire()
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  while (m_idle.empty() && m_clients.size() >= m_max_clients)
+    m_cond.wait(lock);
+
+  client *c;
+  if (m_idle.empty())
+  {
+    m_clients.emplace_back(new client{m_factory->create(), (uint64_t)-1});
+    c = m_clients.back().get();
+  }
+  else
+  {
+    c = m_idle.back();
+    m_idle.pop_back();
+  }
+  if (c->generation != m_generation && !apply_settings(*c))
+    MERROR("Failed to set daemon address for pooled connection: " << m_address);
+  return lease(*this, c);
+}
+
+void http_client_pool::release(client *c)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  if (c->generation != m_generation && c->http_client->is_connected())
+    c->http_client->disconnect();
+  m_idle.push_back(c);
+  m_cond.notify_one();
+}
+
+bool http_client_pool::apply_settings(client &c)
+{
+  if (c.http_client->is_connected())
+    c.http_client->disconnect();
+  c.generation = m_generation;
+  if (!m_proxy.empty() && !c.http_client->set_proxy(m_proxy))
+    return false;
+  c.http_client->set_auto_connect(m_auto_connect);
+  return m_address.empty() || c.http_client->set_server(m_address, m_login, m_ssl_options);
+}
+
+bool http_client_pool::set_server(const std::string &address, boost::optional<epee::net_utils::http::login> user, epee::net_utils::ssl_options_t ssl_options)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  m_address = address;
+  m_login = std::move(user);
+  m_ssl_options = std::move(ssl_options);
+  ++m_generation;
+  for (client *c: m_idle)
+    apply_settings(*c);
+  return true;
+}
+
+bool http_client_pool::set_proxy(const std::string &address)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  m_proxy = address;
+  ++m_generation;
+  return true;
+}
+
+void http_client_pool::set_auto_connect(bool auto_connect)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  m_auto_connect = auto_connect;
+  ++m_generation;
+}
+
+void http_client_pool::disconnect()
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  ++m_generation;
+  for (client *c: m_idle)
+    if (c->http_client->is_connected())
+      c->http_client->disconnect();
+}
+
+uint64_t http_client_pool::get_bytes_sent() const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  uint64_t bytes = 0;
+  for (const auto &c: m_clients)
+    bytes += c->http_client->get_bytes_sent();
+  return bytes;
+}
+
+uint64_t http_client_pool::get_bytes_received() const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  uint64_t bytes = 0;
+  for (const auto &c: m_clients)
+    bytes += c->http_client->get_bytes_received();
+  return bytes;
+}
+
+}
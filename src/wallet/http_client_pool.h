@@ -0,0 +1,110 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/optional/optional.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include "net/abstract_http_client.h"
+
+namespace tools
+{
+
+/*! Persistent connections to the daemon, besides the wallet's main one, so
+    calls made from different threads do not wait for each other. Clients
+    are created when first needed, up to a maximum, and all use the same
+    server, login, SSL options and proxy. */
+class http_client_pool
+{
+  struct client
+  {
+    std::unique_ptr<epee::net_utils::http::abstract_http_client> http_client;
+    uint64_t generation; //!< of the settings last applied
+  };
+
+public:
+  //! A client borrowed from the pool, returned to it when destroyed.
+  class lease
+  {
+  public:
+    lease(lease &&other) noexcept;
+    lease &operator=(lease &&other) = delete;
+    ~lease();
+
+    epee::net_utils::http::abstract_http_client &operator*() const { return *m_client->http_client; }
+    epee::net_utils::http::abstract_http_client *operator->() const { return m_client->http_client.get(); }
+
+  private:
+    friend class http_client_pool;
+    lease(http_client_pool &pool, client *c): m_pool(&pool), m_client(c) {}
+
+    http_client_pool *m_pool;
+    client *m_client;
+  };
+
+  http_client_pool(std::unique_ptr<epee::net_utils::http::http_client_factory> factory, size_t max_clients = 4);
+
+  //! Creates a client outside the pool, from the same factory.
+  std::unique_ptr<epee::net_utils::http::abstract_http_client> create();
+
+  //! Waits for an idle client if all are in use.
+  lease acquire();
+
+  bool set_server(const std::string &address, boost::optional<epee::net_utils::http::login> user, epee::net_utils::ssl_options_t ssl_options);
+  bool set_proxy(const std::string &address);
+  void set_auto_connect(bool auto_connect);
+  //! Disconnects all clients, those in use once they are returned.
+  void disconnect();
+
+  uint64_t get_bytes_sent() const;
+  uint64_t get_bytes_received() const;
+
+private:
+  void release(client *c);
+  bool apply_settings(client &c);
+
+  const std::unique_ptr<epee::net_utils::http::http_client_factory> m_factory;
+  const size_t m_max_clients;
+  mutable boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+  std::vector<std::unique_ptr<client>> m_clients;
+  std::vector<client*> m_idle;
+
+  uint64_t m_generation;
+  std::string m_address;
+  boost::optional<epee::net_utils::http::login> m_login;
+  epee::net_utils::ssl_options_t m_ssl_options;
+  std::string m_proxy;
+  bool m_auto_connect;
+};
+
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "shared_block_source.h"
+#include "common/metrics.h"
+
+namespace tools
+{
+
+shared_block_source::shared_block_source(size_t max_chunks, std::chrono::seconds ttl):
+  m_max_chunks(max_chunks),
+  m_ttl(ttl)
+{
+}
+
+void shared_block_source::expire()
+{
+  const auto now = std::chrono::steady_clock::now();
+  while (!m_order.empty())
+  {
+    auto i = m_chunks.find(m_order.front());
+    if (i != m_chunks.end() && i->second.data)
+    {
+      if (m_order.size() <= m_max_chunks && i->second.expiry > now)
+        break;
+      m_chunks.erase(i);
+    }
+    m_order.pop_front();
+  }
+}
+
+std::shared_ptr<const shared_block_source::chunk> shared_block_source::get(uint64_t start_height, const crypto::hash &top_hash, bool no_miner_tx, const fetcher_t &fetch)
+{
+  static metrics::counter &hits = metrics::get_counter("wallet_shared_chunks_total", "Block chunks wallets asked for, by whether another wallet had fetched them", "result=\"hit\"");
+  static metrics::counter &misses = metrics::get_counter("wallet_shared_chunks_total", "Block chunks wallets asked for, by whether another wallet had fetched them", "result=\"miss\"");
+
+  // fetchers parse on the threadpool, and a thread waiting for its jobs runs
+  // other queued ones, which may be another wallet asking for a chunk this
+  // very thread is fetching further down its stack: such a thread must not
+  // wait for a chunk, or it would wait for itself
+  static thread_local unsigned fetching = 0;
+
+  const key_t key{start_height, top_hash, no_miner_tx};
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  expire();
+  bool shared = true;
+  while (true)
+  {
+    auto i = m_chunks.find(key);
+    if (i == m_chunks.end())
+      break;
+    if (i->second.data)
+    {
+      hits.inc();
+      return i->second.data;
+    }
+    if (fetching > 0)
+    {
+      shared = false;
+      break;
+    }
+    // someone else is fetching it, if they fail, we try ourselves
+    m_cond.wait(lock);
+  }
+
+  misses.inc();
+  if (shared)
+    m_chunks[key].data = nullptr;
+  lock.unlock();
+
+  std::shared_ptr<chunk> data = std::make_shared<chunk>();
+  try
+  {
+    ++fetching;
+    fetch(*data);
+    --fetching;
+  }
+  catch (...)
+  {
+    --fetching;
+    if (!shared)
+      throw;
+    lock.lock();
+    m_chunks.erase(key);
+    m_cond.notify_all();
+    throw;
+  }
+  if (!shared)
+    return data;
+
+  lock.lock();
+  entry &e = m_chunks[key];
+  e.data = data;
+  e.expiry = std::chrono::steady_clock::now() + m_ttl;
+  m_order.push_back(key);
+  m_cond.notify_all();
+  return data;
+}
+
+size_t shared_block_source::size() const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  return m_chunks.size();
+}
+
+}
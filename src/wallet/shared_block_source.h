@@ -0,0 +1,95 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include "wallet2.h"
+
+namespace tools
+{
+
+/*! Blocks pulled and parsed by one wallet, handed to other wallets asking
+    for the same chunk, so a process with many wallets on the same chain
+    downloads and parses each chunk once. Only one wallet fetches a given
+    chunk, others asking for it meanwhile wait for the result, except on a
+    thread already fetching one, which fetches its own copy. Chunks are
+    kept for a short while only, as those near the top go stale quickly. */
+class shared_block_source
+{
+public:
+  typedef wallet2::parsed_blocks_chunk chunk;
+  typedef std::function<void(chunk&)> fetcher_t;
+
+  shared_block_source(size_t max_chunks = 16, std::chrono::seconds ttl = std::chrono::seconds(10));
+
+  //! Returns the chunk following top_hash, calling fetch to get it if needed. Exceptions from fetch are rethrown.
+  std::shared_ptr<const chunk> get(uint64_t start_height, const crypto::hash &top_hash, bool no_miner_tx, const fetcher_t &fetch);
+
+  size_t size() const;
+
+private:
+  struct key_t
+  {
+    uint64_t start_height;
+    crypto::hash top_hash;
+    bool no_miner_tx;
+    bool operator<(const key_t &other) const
+    {
+      if (start_height != other.start_height)
+        return start_height < other.start_height;
+      const int cmp = memcmp(top_hash.data, other.top_hash.data, sizeof(top_hash.data));
+      if (cmp)
+        return cmp < 0;
+      return no_miner_tx < other.no_miner_tx;
+    }
+  };
+  struct entry
+  {
+    std::shared_ptr<const chunk> data; //!< null while being fetched
+    std::chrono::steady_clock::time_point expiry;
+  };
+
+  void expire();
+
+  const size_t m_max_chunks;
+  const std::chrono::seconds m_ttl;
+  mutable boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+  std::map<key_t, entry> m_chunks;
+  std::deque<key_t> m_order;
+};
+
+}
@@ -51,6 +51,7 @@ using namespace epee;
 #include "cryptonote_core/tx_sanity_check.h"
 #include "wallet_rpc_helpers.h"
 #include "wallet2.h"
+#include "shared_block_source.h"
 #include "wallet_args.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "net/parse.h"
@@ -122,6 +123,8 @@ using namespace cryptonote;
 
 #define FEE_ESTIMATE_GRACE_BLOCKS 10 // estimate fee valid for that many blocks
 
+#define RCT_DISTRIBUTION_REFRESH_MARGIN 10 // blocks re-requested below the cached top, to catch small reorgs
+
 #define SECOND_OUTPUT_RELATEDNESS_THRESHOLD 0.0f
 
 #define SUBADDRESS_LOOKAHEAD_MAJOR 50
@@ -1184,7 +1187,8 @@ void wallet_device_callback::on_progress(const hw::device_progress& event)
 }
 
 wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std::unique_ptr<epee::net_utils::http::http_client_factory> http_client_factory):
-  m_http_client(http_client_factory->create()),
+  m_http_client_pool(std::move(http_client_factory)),
+  m_http_client(m_http_client_pool.create()),
   m_multisig_rescan_info(NULL),
   m_multisig_rescan_k(NULL),
   m_upper_transaction_weight_limit(0),
@@ -1259,6 +1263,7 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_credits_target(0),
   m_enable_multisig(false),
   m_pool_info_query_time(0),
+  m_rct_distribution_start_height(0),
   m_has_ever_refreshed_from_node(false),
   m_allow_mismatched_daemon_version(true)
 {
@@ -1392,10 +1397,16 @@ bool wallet2::set_daemon(std::string daemon_address, boost::optional<epee::net_u
     m_rpc_version = 0;
     m_node_rpc_proxy.invalidate();
     m_pool_info_query_time = 0;
+    {
+      const boost::lock_guard<boost::mutex> lock{m_rct_distribution_mutex};
+      m_rct_distribution_start_height = 0;
+      m_rct_distribution.clear();
+    }
   }
 
   const std::string address = get_daemon_address();
   MINFO("setting daemon to " << address);
+  m_http_client_pool.set_server(address, get_daemon_login(), ssl_options);
   bool ret =  m_http_client->set_server(address, get_daemon_login(), std::move(ssl_options));
   if (ret)
   {
@@ -1407,7 +1418,7 @@ bool wallet2::set_daemon(std::string daemon_address, boost::optional<epee::net_u
 //----------------------------------------------------------------------------------------------------
 bool wallet2::set_proxy(const std::string &address)
 {
-  return m_http_client->set_proxy(address);
+  return m_http_client->set_proxy(address) && m_http_client_pool.set_proxy(address);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::init(std::string daemon_address, boost::optional<epee::net_utils::http::login> daemon_login, const std::string &proxy_address, uint64_t upper_transaction_weight_limit, bool trusted_daemon, epee::net_utils::ssl_options_t ssl_options)
@@ -3071,10 +3082,20 @@ void wallet2::pull_blocks(bool first, bool try_incremental, uint64_t start_heigh
     req.pool_info_since = m_pool_info_query_time;
 
   {
-    const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+    boost::unique_lock<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
     uint64_t pre_call_credits = m_rpc_payment_state.credits;
     req.client = get_client_signature();
-    bool r = net_utils::invoke_http_bin("/getblocks.bin", req, res, *m_http_client, rpc_timeout);
+    // blocks come over their own connection, so the next chunk can be downloaded while
+    // other calls go to the daemon; the lock is kept when paying, to account credits exactly
+    if (pre_call_credits == 0)
+      lock.unlock();
+    bool r;
+    {
+      http_client_pool::lease http_client = m_http_client_pool.acquire();
+      r = net_utils::invoke_http_bin("/getblocks.bin", req, res, *http_client, rpc_timeout);
+    }
+    if (!lock.owns_lock())
+      lock.lock();
     THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "getblocks.bin", error::get_blocks_error, get_rpc_status(res.status));
     THROW_WALLET_EXCEPTION_IF(res.blocks.size() != res.output_indices.size(), error::wallet_internal_error,
         "mismatched blocks (" + boost::lexical_cast<std::string>(res.blocks.size()) + ") and output_indices (" +
@@ -3175,26 +3196,47 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
   hwdev.set_mode(hw::device::TRANSACTION_PARSE);
   const cryptonote::account_keys &keys = m_account.get_keys();
 
-  auto gender = [&](wallet2::is_out_data &iod) {
-    if (!hwdev.generate_key_derivation(iod.pkey, keys.m_view_secret_key, iod.derivation))
+  // derivations are computed in batches, so the view key is only prepared once
+  // per batch rather than once per tx pubkey
+  std::vector<wallet2::is_out_data*> iods;
+  for (auto &slot: tx_cache_data)
+  {
+    for (auto &iod: slot.primary)
+      iods.push_back(&iod);
+    for (auto &iod: slot.additional)
+      iods.push_back(&iod);
+  }
+
+  auto gender = [&](size_t begin, size_t end) {
+    std::vector<crypto::public_key> pkeys;
+    std::vector<crypto::key_derivation> derivations(end - begin);
+    std::vector<bool> valid;
+    pkeys.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i)
+      pkeys.push_back(iods[i]->pkey);
+    hwdev.generate_key_derivations(epee::to_span(pkeys), keys.m_view_secret_key, epee::to_mut_span(derivations), valid);
+    for (size_t i = begin; i < end; ++i)
     {
-      MWARNING("Failed to generate key derivation from tx pubkey, skipping");
-      static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
-      memcpy(&iod.derivation, rct::identity().bytes, sizeof(iod.derivation));
+      wallet2::is_out_data &iod = *iods[i];
+      if (valid[i - begin])
+      {
+        iod.derivation = derivations[i - begin];
+      }
+      else
+      {
+        MWARNING("Failed to generate key derivation from tx pubkey, skipping");
+        static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
+        memcpy(&iod.derivation, rct::identity().bytes, sizeof(iod.derivation));
+      }
     }
   };
 
-  for (size_t i = 0; i < tx_cache_data.size(); ++i)
+  const size_t n_threads = std::max<size_t>(1, tpool.get_max_concurrency());
+  const size_t batch_size = std::max<size_t>(16, (iods.size() + n_threads - 1) / n_threads);
+  for (size_t begin = 0; begin < iods.size(); begin += batch_size)
   {
-    if (tx_cache_data[i].empty())
-      continue;
-    tpool.submit(&waiter, [&gender, &tx_cache_data, i]() {
-      auto &slot = tx_cache_data[i];
-      for (auto &iod: slot.primary)
-        gender(iod);
-      for (auto &iod: slot.additional)
-        gender(iod);
-    }, true);
+    const size_t end = std::min(iods.size(), begin + batch_size);
+    tpool.submit(&waiter, [&gender, begin, end]() { gender(begin, end); }, true);
   }
   THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
 
@@ -3358,7 +3400,43 @@ void check_block_hard_fork_version(cryptonote::network_type nettype, uint8_t hf_
   daemon_is_outdated = height < start_height || height >= end_height;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_and_parse_next_blocks(bool first, bool try_incremental, uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception)
+void wallet2::parse_blocks(const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<parsed_block> &parsed_blocks, bool &error) const
+{
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
+
+  error = false;
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  parsed_blocks.resize(blocks.size());
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
+      std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+
+  boost::mutex error_lock;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    if (parsed_blocks[i].error)
+      error = true;
+    parsed_blocks[i].o_indices = std::move(o_indices[i]);
+    parsed_blocks[i].txes.resize(blocks[i].txs.size());
+    for (size_t j = 0; j < blocks[i].txs.size(); ++j)
+    {
+      tpool.submit(&waiter, [&, i, j](){
+        if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j].blob, parsed_blocks[i].txes[j]))
+        {
+          boost::unique_lock<boost::mutex> lock(error_lock);
+          error = true;
+        }
+      }, true);
+    }
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_and_parse_next_blocks(bool first, bool try_incremental, uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::shared_ptr<const parsed_blocks_chunk> &prev_chunk, std::shared_ptr<const parsed_blocks_chunk> &chunk, bool &last, bool &error, std::exception_ptr &exception)
 {
   error = false;
   last = false;
@@ -3368,37 +3446,48 @@ void wallet2::pull_and_parse_next_blocks(bool first, bool try_incremental, uint6
   {
     drop_from_short_history(short_chain_history, 3);
 
-    THROW_WALLET_EXCEPTION_IF(prev_blocks.size() != prev_parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
-
     // prepend the last 3 blocks, should be enough to guard against a block or two's reorg
-    auto s = std::next(prev_parsed_blocks.rbegin(), std::min((size_t)3, prev_parsed_blocks.size())).base();
-    for (; s != prev_parsed_blocks.end(); ++s)
+    if (prev_chunk)
     {
-      short_chain_history.push_front(s->hash);
+      const std::vector<parsed_block> &prev_parsed_blocks = prev_chunk->parsed_blocks;
+      auto s = std::next(prev_parsed_blocks.rbegin(), std::min((size_t)3, prev_parsed_blocks.size())).base();
+      for (; s != prev_parsed_blocks.end(); ++s)
+      {
+        short_chain_history.push_front(s->hash);
+      }
     }
 
     // pull the new blocks
-    std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
-    uint64_t current_height;
-    pull_blocks(first, try_incremental, start_height, blocks_start_height, short_chain_history, blocks, o_indices, current_height);
-    THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
-
-    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
-    tools::threadpool::waiter waiter(tpool);
-    parsed_blocks.resize(blocks.size());
-    for (size_t i = 0; i < blocks.size(); ++i)
+    if (m_shared_block_source)
+    {
+      // blocks only, so the chunk is the same for every wallet; the pool is queried separately.
+      // It is used as is rather than copied, as every wallet on the chain gets it
+      chunk = m_shared_block_source->get(start_height, short_chain_history.empty() ? crypto::null_hash : short_chain_history.front(), m_refresh_type == RefreshNoCoinbase, [&](shared_block_source::chunk &c) {
+        std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
+        pull_blocks(false, false, start_height, c.start_height, short_chain_history, c.blocks, o_indices, c.current_height);
+        parse_blocks(c.blocks, o_indices, c.parsed_blocks, c.error);
+      });
+      if (first)
+        update_pool_state_by_pool_query(m_process_pool_txs, true);
+    }
+    else
     {
-      tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
-        std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
+      const std::shared_ptr<parsed_blocks_chunk> c = std::make_shared<parsed_blocks_chunk>();
+      std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
+      pull_blocks(first, try_incremental, start_height, c->start_height, short_chain_history, c->blocks, o_indices, c->current_height);
+      parse_blocks(c->blocks, o_indices, c->parsed_blocks, c->error);
+      chunk = c;
     }
-    THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+    blocks_start_height = chunk->start_height;
+    error = chunk->error;
+
+    const std::vector<cryptonote::block_complete_entry> &blocks = chunk->blocks;
+    const std::vector<parsed_block> &parsed_blocks = chunk->parsed_blocks;
+    THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
     for (size_t i = 0; i < blocks.size(); ++i)
     {
       if (parsed_blocks[i].error)
-      {
-        error = true;
         break;
-      }
 
       if (!m_allow_mismatched_daemon_version)
       {
@@ -3415,27 +3504,8 @@ void wallet2::pull_and_parse_next_blocks(bool first, bool try_incremental, uint6
             : "Make sure the node you are connected to is running the latest version")
         );
       }
-
-      parsed_blocks[i].o_indices = std::move(o_indices[i]);
     }
-
-    boost::mutex error_lock;
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-      parsed_blocks[i].txes.resize(blocks[i].txs.size());
-      for (size_t j = 0; j < blocks[i].txs.size(); ++j)
-      {
-        tpool.submit(&waiter, [&, i, j](){
-          if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j].blob, parsed_blocks[i].txes[j]))
-          {
-            boost::unique_lock<boost::mutex> lock(error_lock);
-            error = true;
-          }
-        }, true);
-      }
-    }
-    THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
-    last = !blocks.empty() && cryptonote::get_block_height(parsed_blocks.back().block) + 1 == current_height;
+    last = !blocks.empty() && cryptonote::get_block_height(parsed_blocks.back().block) + 1 == chunk->current_height;
   }
   catch(...)
   {
@@ -3981,8 +4051,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
   tools::threadpool::waiter waiter(tpool);
   uint64_t blocks_start_height;
-  std::vector<cryptonote::block_complete_entry> blocks;
-  std::vector<parsed_block> parsed_blocks;
+  std::shared_ptr<const parsed_blocks_chunk> blocks;
   bool refreshed = false;
   std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
   hw::device &hwdev = m_account.get_device();
@@ -4029,8 +4098,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   while(m_run.load(std::memory_order_relaxed) && blocks_fetched < max_blocks)
   {
     uint64_t next_blocks_start_height;
-    std::vector<cryptonote::block_complete_entry> next_blocks;
-    std::vector<parsed_block> next_parsed_blocks;
+    std::shared_ptr<const parsed_blocks_chunk> next_blocks;
     bool error;
     std::exception_ptr exception;
     try
@@ -4038,22 +4106,21 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
       // pull the next set of blocks while we're processing the current one
       error = false;
       exception = NULL;
-      next_blocks.clear();
-      next_parsed_blocks.clear();
+      next_blocks.reset();
       added_blocks = 0;
-      if (!first && blocks.empty())
+      if (!first && (!blocks || blocks->blocks.empty()))
       {
         m_node_rpc_proxy.set_height(m_blockchain.size());
         break;
       }
       if (!last)
-        tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(first, try_incremental, start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, last, error, exception);});
+        tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(first, try_incremental, start_height, next_blocks_start_height, short_chain_history, blocks, next_blocks, last, error, exception);});
 
       if (!first)
       {
         try
         {
-          process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks, output_tracker_cache.get());
+          process_parsed_blocks(blocks_start_height, blocks->blocks, blocks->parsed_blocks, added_blocks, output_tracker_cache.get());
         }
         catch (const tools::error::out_of_hashchain_bounds_error&)
         {
@@ -4109,13 +4176,12 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
 
       // if we've got at least 10 blocks to refresh, assume we're starting
       // a long refresh, and setup a tracking output cache if we need to
-      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && next_blocks.size() >= 10)
+      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && next_blocks && next_blocks->blocks.size() >= 10)
         output_tracker_cache = create_output_tracker_cache();
 
       // switch to the new blocks from the daemon
       blocks_start_height = next_blocks_start_height;
       blocks = std::move(next_blocks);
-      parsed_blocks = std::move(next_parsed_blocks);
     }
     catch (const tools::error::password_needed&)
     {
@@ -4149,8 +4215,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
         first = true;
         last = false;
         start_height = 0;
-        blocks.clear();
-        parsed_blocks.clear();
+        blocks.reset();
         short_chain_history.clear();
         get_short_chain_history(short_chain_history, 1);
         ++try_count;
@@ -4195,14 +4260,14 @@ bool wallet2::refresh(bool trusted_daemon, uint64_t & blocks_fetched, bool& rece
   return ok;
 }
 //----------------------------------------------------------------------------------------------------
-bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution)
+bool wallet2::request_rct_distribution(uint64_t from_height, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base)
 {
-  MDEBUG("Requesting rct distribution");
+  MDEBUG("Requesting rct distribution from height " << from_height);
 
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res = AUTO_VAL_INIT(res);
   req.amounts.push_back(0);
-  req.from_height = 0;
+  req.from_height = from_height;
   req.cumulative = false;
   req.binary = true;
   req.compress = true;
@@ -4231,13 +4296,65 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
     MWARNING("Failed to request output distribution: results are not for amount 0");
     return false;
   }
-  for (size_t i = 1; i < res.distributions[0].data.distribution.size(); ++i)
-    res.distributions[0].data.distribution[i] += res.distributions[0].data.distribution[i-1];
   start_height = res.distributions[0].data.start_height;
+  base = res.distributions[0].data.base;
   distribution = std::move(res.distributions[0].data.distribution);
   return true;
 }
 //----------------------------------------------------------------------------------------------------
+bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution)
+{
+  // the cumulative distribution is kept across calls, and only its tail is requested again,
+  // starting a few blocks below the cached top so that small reorgs get picked up
+  const boost::lock_guard<boost::mutex> lock{m_rct_distribution_mutex};
+
+  uint64_t height = 0;
+  if (!m_rct_distribution.empty() && !m_node_rpc_proxy.get_height(height) &&
+      height == m_rct_distribution_start_height + m_rct_distribution.size() && m_blockchain.size() <= height)
+  {
+    MDEBUG("Using cached rct distribution up to height " << height);
+    start_height = m_rct_distribution_start_height;
+    distribution = m_rct_distribution;
+    return true;
+  }
+
+  if (m_rct_distribution.size() > RCT_DISTRIBUTION_REFRESH_MARGIN)
+  {
+    const uint64_t from_height = m_rct_distribution_start_height + m_rct_distribution.size() - RCT_DISTRIBUTION_REFRESH_MARGIN;
+    uint64_t new_start_height, base;
+    std::vector<uint64_t> new_distribution;
+    if (!request_rct_distribution(from_height, new_start_height, new_distribution, base))
+      return false;
+
+    // base is the cumulative count just below from_height, if it does not match ours,
+    // the chain changed deeper than the margin and we start over
+    if (new_start_height == from_height && !new_distribution.empty() &&
+        base == m_rct_distribution[from_height - m_rct_distribution_start_height - 1])
+    {
+      m_rct_distribution.resize(from_height - m_rct_distribution_start_height);
+      m_rct_distribution.reserve(m_rct_distribution.size() + new_distribution.size());
+      for (uint64_t n: new_distribution)
+        m_rct_distribution.push_back(base += n);
+      start_height = m_rct_distribution_start_height;
+      distribution = m_rct_distribution;
+      return true;
+    }
+    MDEBUG("Cached rct distribution does not match the daemon's, requesting it in full");
+  }
+
+  m_rct_distribution_start_height = 0;
+  m_rct_distribution.clear();
+
+  uint64_t base;
+  if (!request_rct_distribution(0, start_height, distribution, base))
+    return false;
+  for (size_t i = 1; i < distribution.size(); ++i)
+    distribution[i] += distribution[i-1];
+  m_rct_distribution_start_height = start_height;
+  m_rct_distribution = distribution;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
 wallet2::detached_blockchain_data wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
 {
   LOG_PRINT_L0("Detaching blockchain on height " << height);
@@ -6085,11 +6202,13 @@ void wallet2::set_offline(bool offline)
   m_offline = offline;
   m_node_rpc_proxy.set_offline(offline);
   m_http_client->set_auto_connect(!offline);
+  m_http_client_pool.set_auto_connect(!offline);
   if (offline)
   {
     boost::lock_guard<boost::recursive_mutex> lock(m_daemon_rpc_mutex);
     if(m_http_client->is_connected())
       m_http_client->disconnect();
+    m_http_client_pool.disconnect();
   }
 }
 //----------------------------------------------------------------------------------------------------
@@ -15285,12 +15404,12 @@ void wallet2::finish_rescan_bc_keep_key_images(uint64_t transfer_height, const c
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::get_bytes_sent() const
 {
-  return m_http_client->get_bytes_sent();
+  return m_http_client->get_bytes_sent() + m_http_client_pool.get_bytes_sent();
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::get_bytes_received() const
 {
-  return m_http_client->get_bytes_received();
+  return m_http_client->get_bytes_received() + m_http_client_pool.get_bytes_received();
 }
 //----------------------------------------------------------------------------------------------------
 std::vector<cryptonote::public_node> wallet2::get_public_nodes(bool white_only)
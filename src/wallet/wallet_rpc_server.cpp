@@ -32,6 +32,7 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/preprocessor/stringize.hpp>
+#include <algorithm>
 #include <cstdint>
 #include "include_base_utils.h"
 using namespace epee;
@@ -42,6 +43,7 @@ using namespace epee;
 #include "common/command_line.h"
 #include "common/i18n.h"
 #include "common/scoped_message_writer.h"
+#include "common/threadpool.h"
 #include "cryptonote_config.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/account.h"
@@ -81,6 +83,8 @@ namespace
   const command_line::arg_descriptor<std::string> arg_wallet_dir = {"wallet-dir", "Directory for newly created wallets"};
   const command_line::arg_descriptor<bool> arg_prompt_for_password = {"prompt-for-password", "Prompts for password when not provided", false};
   const command_line::arg_descriptor<bool> arg_no_initial_sync = {"no-initial-sync", "Skips the initial sync before listening for connections", false};
+  const command_line::arg_descriptor<bool> arg_multi_wallet = {"multi-wallet", "Keep every wallet opened or created from --wallet-dir, serving each at /wallet/<name>/json_rpc, and share block downloads between them", false};
+  const command_line::arg_descriptor<uint32_t> arg_wallet_idle_timeout = {"wallet-idle-timeout", "In multi wallet mode, save and unload wallets unused for this many seconds, loading them again on their next call (0 to keep them loaded)", 0};
 
   constexpr const char default_rpc_username[] = "wownero";
 
@@ -128,12 +132,13 @@ namespace tools
   }
 
   //------------------------------------------------------------------------------------------------------------------------------
-  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL)
+  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL), m_multi_wallet(false), m_wallet_idle_timeout(0), m_hosted_wallets_thread_stop(false)
   {
   }
   //------------------------------------------------------------------------------------------------------------------------------
   wallet_rpc_server::~wallet_rpc_server()
   {
+    stop_hosted_wallets_thread();
     if (m_wallet)
       delete m_wallet;
   }
@@ -147,9 +152,9 @@ namespace tools
   {
     m_stop = false;
     m_net_server.add_idle_handler([this](){
-      if (m_auto_refresh_period == 0) // disabled
+      if (m_auto_refresh_period == 0 || m_multi_wallet) // disabled, or done by hosted_wallets_thread
         return true;
-      if (boost::posix_time::microsec_clock::universal_time() < m_last_auto_refresh_time + boost::posix_time::seconds(m_auto_refresh_period))
+      if (boost::posix_time::microsec_clock::universal_time() < m_last_auto_refresh_time + boost::posix_time::seconds(m_auto_refresh_period.load()))
         return true;
       uint64_t blocks_fetched = 0;
       try {
@@ -164,6 +169,20 @@ namespace tools
         m_last_auto_refresh_time = boost::posix_time::microsec_clock::universal_time();
       return true;
     }, 1000);
+    if (m_multi_wallet)
+    {
+      if (m_wallet)
+      {
+        host_wallet(m_wallet);
+        m_wallet = NULL;
+      }
+      // hosted wallets are refreshed and unloaded on their own thread, so the
+      // RPC thread keeps serving calls meanwhile
+      m_hosted_wallets_thread_stop = false;
+      boost::thread::attributes attrs;
+      attrs.set_stack_size(THREAD_STACK_SIZE);
+      m_hosted_wallets_thread = boost::thread(attrs, [this](){ hosted_wallets_thread(); });
+    }
     m_net_server.add_idle_handler([this](){
       if (m_stop.load(std::memory_order_relaxed))
       {
@@ -179,6 +198,22 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::stop()
   {
+    stop_hosted_wallets_thread();
+    for (auto &e: m_wallets)
+    {
+      if (!e.second->wallet)
+        continue;
+      try
+      {
+        e.second->wallet->store();
+        e.second->wallet->deinit();
+      }
+      catch (const std::exception &ex)
+      {
+        LOG_ERROR("Failed to save wallet " << e.first << ": " << ex.what());
+      }
+    }
+    m_wallets.clear();
     if (m_wallet)
     {
       m_wallet->store();
@@ -223,6 +258,17 @@ namespace tools
         return false;
       }
     }
+    m_multi_wallet = command_line::get_arg(*m_vm, arg_multi_wallet);
+    m_wallet_idle_timeout = command_line::get_arg(*m_vm, arg_wallet_idle_timeout);
+    if (m_multi_wallet)
+    {
+      if (m_wallet_dir.empty())
+      {
+        MERROR(arg_multi_wallet.name << " needs " << arg_wallet_dir.name);
+        return false;
+      }
+      m_shared_block_source = std::make_shared<shared_block_source>();
+    }
 
     if (disable_auth)
     {
@@ -340,6 +386,272 @@ namespace tools
     MINFO("Background mining enabled. The daemon will mine when idle and not on battery.");
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
+  {
+    MINFO("HTTP [" << m_conn_context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+
+    // in multi wallet mode, /wallet/<name>/... goes to that wallet, and the
+    // other URIs to no wallet, to open or create them
+    epee::net_utils::http::http_request_info routed_info;
+    const epee::net_utils::http::http_request_info *info = &query_info;
+    std::string name;
+    std::shared_ptr<hosted_wallet> hosted;
+    boost::unique_lock<boost::mutex> hosted_lock;
+    if (m_multi_wallet)
+    {
+      static const std::string prefix = "/wallet/";
+      if (boost::starts_with(query_info.m_URI, prefix))
+      {
+        const size_t slash = query_info.m_URI.find('/', prefix.size());
+        if (slash != std::string::npos)
+          name = query_info.m_URI.substr(prefix.size(), slash - prefix.size());
+        if (slash != std::string::npos)
+          hosted = find_hosted_wallet(name);
+        if (!hosted)
+        {
+          response.m_response_code = 404;
+          response.m_response_comment = "Not found";
+          return true;
+        }
+        // waits if this wallet is being refreshed, calls to others go on
+        hosted_lock = boost::unique_lock<boost::mutex>(hosted->mutex);
+        if (!hosted->wallet)
+        {
+          try
+          {
+            hosted->wallet = load_wallet(m_wallet_dir + "/" + name, hosted->password ? std::string(hosted->password->data(), hosted->password->size()) : std::string());
+            if (hosted->wallet)
+              hosted->wallet->set_shared_block_source(m_shared_block_source);
+          }
+          catch (const std::exception &e)
+          {
+            MERROR("Failed to load wallet " << name << ": " << e.what());
+          }
+          if (!hosted->wallet)
+          {
+            response.m_response_code = 500;
+            response.m_response_comment = "Internal Server Error";
+            return true;
+          }
+        }
+        hosted->last_used = std::chrono::steady_clock::now();
+        routed_info = query_info;
+        routed_info.m_URI = query_info.m_URI.substr(slash);
+        info = &routed_info;
+      }
+      m_wallet = hosted ? hosted->wallet.get() : NULL;
+      m_routed_wallet = hosted;
+    }
+
+    try
+    {
+      if (!handle_http_request_map(*info, response, m_conn_context))
+      {
+        response.m_response_code = 404;
+        response.m_response_comment = "Not found";
+      }
+    }
+    catch (const std::exception &e)
+    {
+      MERROR(m_conn_context << "Exception in handle_http_request_map: " << e.what());
+      response.m_response_code = 500;
+      response.m_response_comment = "Internal Server Error";
+    }
+
+    if (m_multi_wallet)
+    {
+      // opening, creating or closing a wallet deletes the one it replaces
+      if (hosted && m_wallet != hosted->wallet.get())
+      {
+        hosted->wallet.release();
+        hosted_lock.unlock();
+        boost::unique_lock<boost::mutex> lock(m_wallets_mutex);
+        m_wallets.erase(name);
+        hosted = NULL;
+      }
+      if (hosted)
+      {
+        if (m_wallet_password)
+          hosted->password = std::move(m_wallet_password);
+      }
+      else if (m_wallet)
+      {
+        host_wallet(m_wallet);
+      }
+      m_wallet = NULL;
+      m_routed_wallet = NULL;
+    }
+    m_wallet_password = boost::none;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<wallet2> wallet_rpc_server::load_wallet(const std::string &wallet_file, const std::string &password)
+  {
+    namespace po = boost::program_options;
+    po::variables_map vm2;
+    {
+      po::options_description desc("dummy");
+      const command_line::arg_descriptor<std::string, true> arg_password = {"password", "password"};
+      const char *argv[4];
+      int argc = 3;
+      argv[0] = "wallet-rpc";
+      argv[1] = "--password";
+      argv[2] = password.c_str();
+      argv[3] = NULL;
+      vm2 = *m_vm;
+      command_line::add_arg(desc, arg_password);
+      po::store(po::parse_command_line(argc, argv, desc), vm2);
+    }
+    return tools::wallet2::make_from_file(vm2, true, wallet_file, nullptr).first;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::host_wallet(wallet2 *wallet)
+  {
+    std::unique_ptr<wallet2> wal(wallet);
+    const std::string &wallet_file = wal->get_wallet_file();
+    const std::string name = boost::starts_with(wallet_file, m_wallet_dir + "/") ? wallet_file.substr(m_wallet_dir.size() + 1) : wallet_file;
+    std::shared_ptr<hosted_wallet> hosted;
+    {
+      boost::unique_lock<boost::mutex> lock(m_wallets_mutex);
+      std::shared_ptr<hosted_wallet> &e = m_wallets[name];
+      if (!e)
+        e = std::make_shared<hosted_wallet>();
+      hosted = e;
+    }
+    boost::unique_lock<boost::mutex> lock(hosted->mutex);
+    if (m_wallet_password)
+      hosted->password = std::move(m_wallet_password);
+    hosted->last_used = std::chrono::steady_clock::now();
+    // opening a wallet already loaded keeps the loaded one, which may have changes not saved yet
+    if (hosted->wallet)
+      return;
+    wal->set_shared_block_source(m_shared_block_source);
+    hosted->wallet = std::move(wal);
+    MINFO("Serving wallet " << name << " at /wallet/" << name << "/json_rpc");
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<wallet_rpc_server::hosted_wallet> wallet_rpc_server::find_hosted_wallet(const std::string &name)
+  {
+    boost::unique_lock<boost::mutex> lock(m_wallets_mutex);
+    auto i = m_wallets.find(name);
+    return i == m_wallets.end() ? NULL : i->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::hosted_wallets_thread()
+  {
+    boost::unique_lock<boost::mutex> lock(m_hosted_wallets_thread_mutex);
+    while (!m_hosted_wallets_thread_stop)
+    {
+      m_hosted_wallets_thread_cond.wait_for(lock, boost::chrono::seconds(1));
+      if (m_hosted_wallets_thread_stop)
+        break;
+      lock.unlock();
+      if (m_wallet_idle_timeout)
+        unload_idle_wallets();
+      if (m_auto_refresh_period != 0 && boost::posix_time::microsec_clock::universal_time() >= m_last_auto_refresh_time + boost::posix_time::seconds(m_auto_refresh_period.load()))
+      {
+        // only set the last refresh time once all wallets caught up, as in single wallet mode
+        if (refresh_hosted_wallets())
+          m_last_auto_refresh_time = boost::posix_time::microsec_clock::universal_time();
+      }
+      lock.lock();
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::stop_hosted_wallets_thread()
+  {
+    if (!m_hosted_wallets_thread.joinable())
+      return;
+    {
+      boost::unique_lock<boost::mutex> lock(m_hosted_wallets_thread_mutex);
+      m_hosted_wallets_thread_stop = true;
+    }
+    m_hosted_wallets_thread_cond.notify_all();
+    m_hosted_wallets_thread.join();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::refresh_hosted_wallets()
+  {
+    std::vector<std::shared_ptr<hosted_wallet>> wallets;
+    {
+      boost::unique_lock<boost::mutex> lock(m_wallets_mutex);
+      for (const auto &e: m_wallets)
+        wallets.push_back(e.second);
+    }
+    if (wallets.empty())
+      return true;
+
+    // wallets at the same height pull the same chunks, which only one of them
+    // downloads and parses, then each scans them with its own keys. Each
+    // refresh gets a thread of its own rather than a slot on the compute pool,
+    // as the chunk parsers run there and would queue behind the refreshes
+    const size_t n_threads = std::min<size_t>(wallets.size(), std::max<unsigned>(tools::get_max_concurrency(), 1));
+    std::atomic<size_t> next(0);
+    std::atomic<bool> caught_up(true);
+    boost::thread::attributes attrs;
+    attrs.set_stack_size(THREAD_STACK_SIZE);
+    std::vector<boost::thread> threads;
+    threads.reserve(n_threads);
+    for (size_t t = 0; t < n_threads; ++t)
+    {
+      threads.push_back(boost::thread(attrs, [&wallets, &next, &caught_up](){
+        for (size_t i = next++; i < wallets.size(); i = next++)
+        {
+          hosted_wallet &hosted = *wallets[i];
+          boost::unique_lock<boost::mutex> lock(hosted.mutex);
+          if (!hosted.wallet)
+            continue;
+          uint64_t blocks_fetched = 0;
+          try
+          {
+            bool received_money = false;
+            hosted.wallet->refresh(hosted.wallet->is_trusted_daemon(), 0, blocks_fetched, received_money, true, true, REFRESH_INFICATIVE_BLOCK_CHUNK_SIZE);
+          }
+          catch (const std::exception &ex)
+          {
+            LOG_ERROR("Exception at while refreshing " << hosted.wallet->get_wallet_file() << ", what=" << ex.what());
+          }
+          if (blocks_fetched >= REFRESH_INFICATIVE_BLOCK_CHUNK_SIZE)
+            caught_up = false;
+        }
+      }));
+    }
+    for (boost::thread &thread: threads)
+      thread.join();
+    return caught_up;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::unload_idle_wallets()
+  {
+    std::vector<std::pair<std::string, std::shared_ptr<hosted_wallet>>> wallets;
+    {
+      boost::unique_lock<boost::mutex> lock(m_wallets_mutex);
+      wallets.assign(m_wallets.begin(), m_wallets.end());
+    }
+    const auto cutoff = std::chrono::steady_clock::now() - std::chrono::seconds(m_wallet_idle_timeout);
+    for (auto &e: wallets)
+    {
+      hosted_wallet &hosted = *e.second;
+      // one in use is not idle
+      boost::unique_lock<boost::mutex> lock(hosted.mutex, boost::try_to_lock);
+      if (!lock.owns_lock() || !hosted.wallet || !hosted.password || hosted.last_used > cutoff)
+        continue;
+      try
+      {
+        hosted.wallet->store();
+        hosted.wallet->deinit();
+        hosted.wallet.reset();
+        MDEBUG("Unloaded idle wallet " << e.first);
+      }
+      catch (const std::exception &ex)
+      {
+        LOG_ERROR("Failed to save idle wallet " << e.first << ": " << ex.what());
+      }
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::not_open(epee::json_rpc::error& er)
   {
       er.code = WALLET_RPC_ERROR_CODE_NOT_OPEN;
@@ -3401,6 +3713,7 @@ namespace tools
       delete m_wallet;
     }
     m_wallet = wal.release();
+    m_wallet_password = epee::wipeable_string(req.password);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3413,8 +3726,6 @@ namespace tools
       return false;
     }
 
-    namespace po = boost::program_options;
-    po::variables_map vm2;
     const char *ptr = strchr(req.filename.c_str(), '/');
 #ifdef _WIN32
     if (!ptr)
@@ -3440,23 +3751,33 @@ namespace tools
         return false;
       }
     }
-    std::string wallet_file = m_wallet_dir + "/" + req.filename;
+    if (m_multi_wallet)
     {
-      po::options_description desc("dummy");
-      const command_line::arg_descriptor<std::string, true> arg_password = {"password", "password"};
-      const char *argv[4];
-      int argc = 3;
-      argv[0] = "wallet-rpc";
-      argv[1] = "--password";
-      argv[2] = req.password.c_str();
-      argv[3] = NULL;
-      vm2 = *m_vm;
-      command_line::add_arg(desc, arg_password);
-      po::store(po::parse_command_line(argc, argv, desc), vm2);
+      // a loaded wallet holds the lock on its keys file, so opening a hosted
+      // wallet again only checks the password and keeps the loaded one
+      const std::shared_ptr<hosted_wallet> hosted = find_hosted_wallet(req.filename);
+      if (hosted)
+      {
+        boost::unique_lock<boost::mutex> lock(hosted->mutex, boost::defer_lock);
+        if (hosted != m_routed_wallet)
+          lock.lock();
+        if (hosted->wallet)
+        {
+          if (!hosted->wallet->verify_password(req.password))
+          {
+            er.code = WALLET_RPC_ERROR_CODE_INVALID_PASSWORD;
+            er.message = "Invalid password.";
+            return false;
+          }
+          hosted->last_used = std::chrono::steady_clock::now();
+          return true;
+        }
+      }
     }
+    std::string wallet_file = m_wallet_dir + "/" + req.filename;
     std::unique_ptr<tools::wallet2> wal = nullptr;
     try {
-      wal = tools::wallet2::make_from_file(vm2, true, wallet_file, nullptr).first;
+      wal = load_wallet(wallet_file, req.password);
     }
     catch (const std::exception& e)
     {
@@ -3472,6 +3793,7 @@ namespace tools
     if (m_wallet)
       delete m_wallet;
     m_wallet = wal.release();
+    m_wallet_password = epee::wipeable_string(req.password);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3511,6 +3833,7 @@ namespace tools
       {
         m_wallet->change_password(m_wallet->get_wallet_file(), req.old_password, req.new_password);
         LOG_PRINT_L0("Wallet password changed.");
+        m_wallet_password = epee::wipeable_string(req.new_password);
       }
       catch (const std::exception& e)
       {
@@ -3786,6 +4109,7 @@ namespace tools
     if (m_wallet)
       delete m_wallet;
     m_wallet = wal.release();
+    m_wallet_password = epee::wipeable_string(req.password);
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     return true;
   }
@@ -3996,6 +4320,7 @@ namespace tools
     if (m_wallet)
       delete m_wallet;
     m_wallet = wal.release();
+    m_wallet_password = epee::wipeable_string(req.password);
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     res.info = "Wallet has been restored successfully.";
     return true;
@@ -4777,6 +5102,8 @@ int main(int argc, char** argv) {
   command_line::add_arg(desc_params, arg_prompt_for_password);
   command_line::add_arg(desc_params, arg_rpc_client_secret_key);
   command_line::add_arg(desc_params, arg_no_initial_sync);
+  command_line::add_arg(desc_params, arg_multi_wallet);
+  command_line::add_arg(desc_params, arg_wallet_idle_timeout);
 
   daemonizer::init_options(hidden_options, desc_params);
   desc_params.add(hidden_options);
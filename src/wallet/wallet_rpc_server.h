@@ -32,12 +32,18 @@
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <map>
 #include <string>
 #include "common/util.h"
 #include "net/http_server_impl_base.h"
 #include "math_helper.h"
 #include "wallet_rpc_server_commands_defs.h"
 #include "wallet2.h"
+#include "shared_block_source.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "wallet.rpc"
@@ -64,7 +70,7 @@ namespace tools
 
   private:
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
 
     BEGIN_URI_MAP2()
       BEGIN_JSON_RPC_MAP("/json_rpc")
@@ -271,6 +277,22 @@ namespace tools
       bool validate_transfer(const std::list<wallet_rpc::transfer_destination>& destinations, const std::string& payment_id, std::vector<cryptonote::tx_destination_entry>& dsts, std::vector<uint8_t>& extra, bool at_least_one_destination, epee::json_rpc::error& er);
 
       void check_background_mining();
+      std::unique_ptr<wallet2> load_wallet(const std::string &wallet_file, const std::string &password);
+      void host_wallet(wallet2 *wallet);
+      void hosted_wallets_thread();
+      bool refresh_hosted_wallets();
+      void unload_idle_wallets();
+      void stop_hosted_wallets_thread();
+
+      //! A wallet served at /wallet/<name>/json_rpc in multi wallet mode
+      struct hosted_wallet
+      {
+        boost::mutex mutex; //!< held by the call or refresh using the wallet
+        std::unique_ptr<wallet2> wallet; //!< null while unloaded
+        boost::optional<epee::wipeable_string> password; //!< needed to load it again
+        std::chrono::steady_clock::time_point last_used;
+      };
+      std::shared_ptr<hosted_wallet> find_hosted_wallet(const std::string &name);
 
       wallet2 *m_wallet;
       std::string m_wallet_dir;
@@ -278,7 +300,18 @@ namespace tools
       std::atomic<bool> m_stop;
       bool m_restricted;
       const boost::program_options::variables_map *m_vm;
-      uint32_t m_auto_refresh_period;
+      std::atomic<uint32_t> m_auto_refresh_period;
       boost::posix_time::ptime m_last_auto_refresh_time;
+      bool m_multi_wallet;
+      uint32_t m_wallet_idle_timeout;
+      std::map<std::string, std::shared_ptr<hosted_wallet>> m_wallets;
+      boost::mutex m_wallets_mutex; //!< guards m_wallets, not the wallets in it
+      std::shared_ptr<hosted_wallet> m_routed_wallet; //!< the one the current call goes to, locked
+      boost::thread m_hosted_wallets_thread;
+      boost::mutex m_hosted_wallets_thread_mutex;
+      boost::condition_variable m_hosted_wallets_thread_cond;
+      bool m_hosted_wallets_thread_stop;
+      std::shared_ptr<shared_block_source> m_shared_block_source;
+      boost::optional<epee::wipeable_string> m_wallet_password; //!< of the wallet last opened or created
   };
 }
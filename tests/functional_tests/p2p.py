@@ -45,6 +45,7 @@ class P2PTest():
         self.mine(80)
         self.test_p2p_reorg()
         self.test_p2p_tx_propagation()
+        self.test_p2p_block_propagation()
 
     def reset(self):
         print('Resetting blockchain')
@@ -183,6 +184,43 @@ class P2PTest():
             assert len(res.tx_hashes) == 1
             assert res.tx_hashes[0] == txid
 
+    def test_p2p_block_propagation(self):
+        print('Testing P2P block propagation')
+        daemon2 = Daemon(idx = 2)
+        daemon3 = Daemon(idx = 3)
+
+        # the tx from the previous test is in both pools, so daemon3 can rebuild
+        # the block from its short id without asking for the tx
+        res = daemon3.get_transaction_pool_hashes()
+        assert len(res.tx_hashes) == 1
+
+        relayed = 'p2p_compact_blocks_relayed_total'
+        rebuilt = 'p2p_compact_blocks_received_total{result="rebuilt"}'
+        missing = 'p2p_compact_blocks_received_total{result="missing_txes"}'
+        metrics2 = daemon2.get_metrics()
+        metrics3 = daemon3.get_metrics()
+
+        res = daemon2.generateblocks('42ey1afDFnn4886T7196doS9GPMzexD9gXpsZJDwVjeRVdFCSoHnv7KPbBeGpzJBzHRCAs9UxqeoyFQMYbqSWYTfJJQAWDm', 1)
+        t0 = time.time()
+        top_block_hash = daemon2.get_info().top_block_hash
+
+        loops = 100
+        while daemon3.get_info().top_block_hash != top_block_hash:
+            time.sleep(0.1)
+            loops -= 1
+            assert loops >= 0
+        print('Block propagated in %.2f seconds' % (time.time() - t0))
+
+        # the block went out compact, and was rebuilt from the pool without a round trip
+        res = daemon2.get_metrics()
+        assert res.get(relayed, 0) > metrics2.get(relayed, 0)
+        res = daemon3.get_metrics()
+        assert res.get(rebuilt, 0) > metrics3.get(rebuilt, 0)
+        assert res.get(missing, 0) == metrics3.get(missing, 0)
+
+        res = daemon3.get_transaction_pool_hashes()
+        assert not 'tx_hashes' in res or len(res.tx_hashes) == 0
+
 
 if __name__ == '__main__':
     P2PTest().run_test()
@@ -0,0 +1,67 @@
+// Copyright (c) 2014-2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include <vector>
+#include "crypto/crypto.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+
+template<size_t bytes, size_t count>
+class test_cn_fast_hash_multi
+{
+public:
+  static const size_t loop_count = (bytes < 256 ? 100000 : bytes < 4096 ? 10000 : 1000) / count;
+
+  bool init()
+  {
+    m_data.resize(bytes * count);
+    crypto::rand(m_data.size(), m_data.data());
+    for (size_t i = 0; i < count; ++i)
+    {
+      m_ptrs.push_back(m_data.data() + i * bytes);
+      m_lengths.push_back(bytes);
+    }
+    m_hashes.resize(count);
+    return true;
+  }
+
+  bool test()
+  {
+    crypto::cn_fast_hash_multi(m_ptrs.data(), m_lengths.data(), count, m_hashes.data());
+    return true;
+  }
+
+private:
+  std::vector<uint8_t> m_data;
+  std::vector<const void*> m_ptrs;
+  std::vector<size_t> m_lengths;
+  std::vector<crypto::hash> m_hashes;
+};
@@ -47,3 +47,33 @@ public:
     return true;
   }
 };
+
+template<size_t count>
+class test_generate_key_derivations : public single_tx_test_base
+{
+public:
+  static const size_t loop_count = 10000 / count;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+
+    crypto::secret_key sec;
+    m_tx_pub_keys.resize(count);
+    for (auto &pub: m_tx_pub_keys)
+      crypto::generate_keys(pub, sec);
+    m_derivations.resize(count);
+    return true;
+  }
+
+  bool test()
+  {
+    std::vector<bool> valid;
+    return crypto::generate_key_derivations(epee::to_span(m_tx_pub_keys), m_bob.get_keys().m_view_secret_key, epee::to_mut_span(m_derivations), valid);
+  }
+
+private:
+  std::vector<crypto::public_key> m_tx_pub_keys;
+  std::vector<crypto::key_derivation> m_derivations;
+};
@@ -56,6 +56,7 @@
 #include "sc_reduce32.h"
 #include "sc_check.h"
 #include "cn_fast_hash.h"
+#include "cn_fast_hash_multi.h"
 #include "rct_mlsag.h"
 #include "equality.h"
 #include "range_proof.h"
@@ -65,6 +66,7 @@
 #include "multiexp.h"
 #include "sig_mlsag.h"
 #include "sig_clsag.h"
+#include "trace.h"
 
 namespace po = boost::program_options;
 
@@ -201,6 +203,9 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE2(filter, p, test_out_can_be_to_acc, true, true); // use view tag, owned
   TEST_PERFORMANCE0(filter, p, test_generate_key_image_helper);
   TEST_PERFORMANCE0(filter, p, test_generate_key_derivation);
+  TEST_PERFORMANCE1(filter, p, test_generate_key_derivations, 1);
+  TEST_PERFORMANCE1(filter, p, test_generate_key_derivations, 16);
+  TEST_PERFORMANCE1(filter, p, test_generate_key_derivations, 256);
   TEST_PERFORMANCE0(filter, p, test_generate_key_image);
   TEST_PERFORMANCE0(filter, p, test_derive_public_key);
   TEST_PERFORMANCE0(filter, p, test_derive_secret_key);
@@ -221,6 +226,9 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, 4);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
+  TEST_PERFORMANCE2(filter, p, test_cn_fast_hash_multi, 64, 4);
+  TEST_PERFORMANCE2(filter, p, test_cn_fast_hash_multi, 64, 256);
+  TEST_PERFORMANCE2(filter, p, test_cn_fast_hash_multi, 1500, 256);
 
   TEST_PERFORMANCE3(filter, p, test_sig_mlsag, 4, 2, 2); // MLSAG verification
   TEST_PERFORMANCE3(filter, p, test_sig_mlsag, 8, 2, 2);
@@ -237,6 +245,14 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 128, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 256, 2, 2);
 
+  // tracing is on by default, so it is turned back on last
+  TEST_PERFORMANCE1(filter, p, test_trace_span, false);
+  TEST_PERFORMANCE1(filter, p, test_trace_span, true);
+  TEST_PERFORMANCE1(filter, p, test_sig_clsag_trace, false);
+  TEST_PERFORMANCE1(filter, p, test_sig_clsag_trace, true);
+  TEST_PERFORMANCE0(filter, p, test_metrics_counter);
+  TEST_PERFORMANCE0(filter, p, test_metrics_histogram);
+
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, false);
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, true);
 
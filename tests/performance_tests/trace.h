@@ -0,0 +1,109 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "common/metrics.h"
+#include "common/trace.h"
+#include "ringct/multiexp.h"
+#include "sig_clsag.h"
+
+// an empty span, with recording on or off
+template<bool enabled>
+class test_trace_span
+{
+public:
+  static const size_t loop_count = 10000000;
+
+  bool init()
+  {
+    tools::trace::set_enabled(enabled);
+    return true;
+  }
+
+  bool test()
+  {
+    TRACE_SPAN(test_trace_span);
+    return true;
+  }
+};
+
+class test_metrics_counter
+{
+public:
+  static const size_t loop_count = 10000000;
+
+  bool init()
+  {
+    m_counter = &tools::metrics::get_counter("performance_test_total", "Counter bumped by performance_tests");
+    return true;
+  }
+
+  bool test()
+  {
+    m_counter->inc();
+    return true;
+  }
+
+private:
+  tools::metrics::counter *m_counter;
+};
+
+class test_metrics_histogram
+{
+public:
+  static const size_t loop_count = 10000000;
+
+  bool init()
+  {
+    m_histogram = &tools::metrics::get_histogram("performance_test_seconds", "Histogram recorded by performance_tests");
+    m_ns = 0;
+    return true;
+  }
+
+  bool test()
+  {
+    m_histogram->record(m_ns += 997);
+    return true;
+  }
+
+private:
+  tools::metrics::histogram *m_histogram;
+  uint64_t m_ns;
+};
+
+// a traced hot path, CLSAG verification, with recording on or off
+template<bool enabled>
+class test_sig_clsag_trace: public test_sig_clsag<16, 2, 2>
+{
+public:
+  bool init()
+  {
+    tools::trace::set_enabled(enabled);
+    return test_sig_clsag<16, 2, 2>::init();
+  }
+};
@@ -0,0 +1,428 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <list>
+#include <random>
+#include <set>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "misc_log_ex.h"
+#include "common/command_line.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "device/device.hpp"
+#include "ringct/rctSigs.h"
+#include "../core_tests/chaingen.h"
+#include "../../src/blockchain_utilities/bootstrap_file.h"
+#include "corpus_generator.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "replay"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+namespace replay_benchmark
+{
+  // The same fork the core rct tests use: v2 coinbases pay into the RingCT
+  // output set straight away, and borromean proofs are still valid. Later
+  // forks need block header miner signatures chaingen cannot make.
+  const std::pair<uint8_t, uint64_t> synthetic_hard_forks[] = {std::make_pair(1, 0), std::make_pair(4, 1), std::make_pair(0, 0)};
+  const cryptonote::test_options synthetic_test_options = {synthetic_hard_forks, 0};
+}
+
+namespace
+{
+  const size_t NUM_ACCOUNTS = 16;
+  const uint8_t SYNTHETIC_HF_VERSION = 4;
+  const uint64_t GENESIS_TIMESTAMP = 1338224400;
+  // room for the miner tx below the penalty free block weight
+  const size_t MAX_TXS_WEIGHT = CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V2 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+
+  // A RingCT output on the generated chain, indexed by its global index
+  struct chain_output
+  {
+    rct::ctkey ctkey; // output key and commitment, as a ring member
+    rct::key mask;
+    uint64_t amount;
+    size_t owner;
+    crypto::public_key tx_pub_key;
+    size_t index_in_tx;
+    uint64_t unlock_height;
+  };
+
+  class chain_generator
+  {
+  public:
+    chain_generator(const replay_benchmark::corpus_options &options);
+    bool run(cryptonote::core &core);
+
+  private:
+    uint64_t random(uint64_t n) { return m_rng() % n; }
+    bool add_outputs(const transaction &tx, uint64_t height, const std::vector<size_t> &owners);
+    bool pick_input(size_t owner, uint64_t height, uint64_t min_amount, size_t exclude, size_t &output);
+    void spend(size_t output);
+    bool build_tx(uint64_t height, transaction &tx, std::vector<size_t> &inputs, std::vector<size_t> &owners);
+    bool add_block(cryptonote::core &core, uint64_t height, const block &blk, const std::list<transaction> &txs);
+
+    const replay_benchmark::corpus_options m_options;
+    std::mt19937_64 m_rng;
+    test_generator m_generator;
+    std::vector<account_base> m_accounts;
+    std::vector<chain_output> m_outputs;
+    std::vector<std::vector<size_t>> m_unspent; // per account
+    std::vector<uint64_t> m_outputs_up_to; // number of outputs created at or below each height
+  };
+
+  chain_generator::chain_generator(const replay_benchmark::corpus_options &options):
+    m_options(options),
+    m_rng(options.seed),
+    m_accounts(NUM_ACCOUNTS),
+    m_unspent(NUM_ACCOUNTS)
+  {
+    for (account_base &account: m_accounts)
+      account.generate();
+  }
+
+  bool chain_generator::add_outputs(const transaction &tx, uint64_t height, const std::vector<size_t> &owners)
+  {
+    const crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
+    const bool coinbase = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
+    for (size_t o = 0; o < tx.vout.size(); ++o)
+    {
+      crypto::public_key output_public_key;
+      CHECK_AND_ASSERT_MES(get_output_public_key(tx.vout[o], output_public_key), false, "Failed to get output public key");
+
+      chain_output output;
+      output.owner = NUM_ACCOUNTS;
+      crypto::key_derivation derivation;
+      for (size_t owner: owners)
+      {
+        const account_keys &keys = m_accounts[owner].get_keys();
+        crypto::public_key derived;
+        CHECK_AND_ASSERT_MES(crypto::generate_key_derivation(tx_pub_key, keys.m_view_secret_key, derivation), false, "Failed to generate key derivation");
+        CHECK_AND_ASSERT_MES(crypto::derive_public_key(derivation, o, keys.m_account_address.m_spend_public_key, derived), false, "Failed to derive public key");
+        if (derived == output_public_key)
+        {
+          output.owner = owner;
+          break;
+        }
+      }
+      CHECK_AND_ASSERT_MES(output.owner < NUM_ACCOUNTS, false, "Output " << o << " of " << get_transaction_hash(tx) << " has no known owner");
+
+      output.ctkey.dest = rct::pk2rct(output_public_key);
+      if (coinbase)
+      {
+        // v2 coinbase outputs are RingCT outputs with an identity mask
+        output.amount = tx.vout[o].amount;
+        output.mask = rct::identity();
+        output.ctkey.mask = rct::zeroCommit(output.amount);
+        output.unlock_height = tx.unlock_time;
+      }
+      else
+      {
+        crypto::secret_key amount_key;
+        crypto::derivation_to_scalar(derivation, o, amount_key);
+        if (rct::is_rct_simple(tx.rct_signatures.type))
+          output.amount = rct::decodeRctSimple(tx.rct_signatures, rct::sk2rct(amount_key), o, output.mask, hw::get_device("default"));
+        else
+          output.amount = rct::decodeRct(tx.rct_signatures, rct::sk2rct(amount_key), o, output.mask, hw::get_device("default"));
+        output.ctkey.mask = tx.rct_signatures.outPk[o].mask;
+        output.unlock_height = height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+      }
+      output.tx_pub_key = tx_pub_key;
+      output.index_in_tx = o;
+
+      m_unspent[output.owner].push_back(m_outputs.size());
+      m_outputs.push_back(output);
+    }
+    return true;
+  }
+
+  bool chain_generator::pick_input(size_t owner, uint64_t height, uint64_t min_amount, size_t exclude, size_t &output)
+  {
+    const std::vector<size_t> &unspent = m_unspent[owner];
+    if (unspent.empty())
+      return false;
+    const size_t start = random(unspent.size());
+    for (size_t i = 0; i < unspent.size(); ++i)
+    {
+      const size_t idx = unspent[(start + i) % unspent.size()];
+      const chain_output &candidate = m_outputs[idx];
+      if (idx != exclude && candidate.unlock_height <= height && candidate.amount >= min_amount)
+      {
+        output = idx;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void chain_generator::spend(size_t output)
+  {
+    std::vector<size_t> &unspent = m_unspent[m_outputs[output].owner];
+    auto it = std::find(unspent.begin(), unspent.end(), output);
+    if (it == unspent.end())
+      return;
+    *it = unspent.back();
+    unspent.pop_back();
+  }
+
+  bool chain_generator::build_tx(uint64_t height, transaction &tx, std::vector<size_t> &inputs, std::vector<size_t> &owners)
+  {
+    const uint64_t fee = TESTS_DEFAULT_FEE;
+
+    // decoys only come from outputs old enough to be unlocked whatever they are
+    const uint64_t decoys = height >= CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW ? m_outputs_up_to[height - CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW] : 0;
+    if (decoys < m_options.ring_size)
+      return false;
+
+    // spend one or two outputs of the same account, starting from a random one
+    size_t owner = 0, input = 0;
+    bool found = false;
+    const size_t first_owner = random(NUM_ACCOUNTS);
+    for (size_t i = 0; i < NUM_ACCOUNTS && !found; ++i)
+    {
+      owner = (first_owner + i) % NUM_ACCOUNTS;
+      found = pick_input(owner, height, 4 * fee, m_outputs.size(), input);
+    }
+    if (!found)
+      return false;
+    inputs.clear();
+    inputs.push_back(input);
+    if (random(2) && pick_input(owner, height, 1, input, input))
+      inputs.push_back(input);
+
+    std::vector<tx_source_entry> sources;
+    uint64_t amount_in = 0;
+    for (size_t idx: inputs)
+    {
+      const chain_output &real = m_outputs[idx];
+      std::set<uint64_t> ring;
+      ring.insert(idx);
+      while (ring.size() < m_options.ring_size)
+        ring.insert(random(decoys));
+
+      tx_source_entry src;
+      for (uint64_t member: ring)
+      {
+        if (member == idx)
+          src.real_output = src.outputs.size();
+        src.outputs.push_back(std::make_pair(member, m_outputs[member].ctkey));
+      }
+      src.real_out_tx_key = real.tx_pub_key;
+      src.real_output_in_tx_index = real.index_in_tx;
+      src.amount = real.amount;
+      src.rct = true;
+      src.mask = real.mask;
+      sources.push_back(src);
+      amount_in += real.amount;
+    }
+
+    size_t recipient = random(NUM_ACCOUNTS - 1);
+    if (recipient >= owner)
+      ++recipient;
+    const uint64_t available = amount_in - fee;
+    const uint64_t sent = available / 4 + random(available / 2);
+    const account_public_address &change_addr = m_accounts[owner].get_keys().m_account_address;
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(sent, m_accounts[recipient].get_keys().m_account_address, false));
+    destinations.push_back(tx_destination_entry(available - sent, change_addr, false));
+
+    std::unordered_map<crypto::public_key, subaddress_index> subaddresses;
+    subaddresses[change_addr.m_spend_public_key] = {0, 0};
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    if (!construct_tx_and_get_tx_key(m_accounts[owner].get_keys(), subaddresses, sources, destinations, change_addr, std::vector<uint8_t>(), tx, tx_key, additional_tx_keys, true, {rct::RangeProofBorromean, 0}))
+    {
+      MERROR("Failed to construct transaction");
+      return false;
+    }
+
+    owners.clear();
+    owners.push_back(recipient);
+    owners.push_back(owner);
+    return true;
+  }
+
+  bool chain_generator::add_block(cryptonote::core &core, uint64_t height, const block &blk, const std::list<transaction> &txs)
+  {
+    std::vector<block_complete_entry> blocks(1);
+    block_complete_entry &bce = blocks.back();
+    bce.pruned = false;
+    bce.block = block_to_blob(blk);
+    for (const transaction &tx: txs)
+      bce.txs.push_back({tx_to_blob(tx), crypto::null_hash});
+
+    std::vector<block> pblocks;
+    if (!core.prepare_handle_incoming_blocks(blocks, pblocks))
+    {
+      MERROR("Failed to prepare to add generated block " << height);
+      return false;
+    }
+
+    std::vector<tx_verification_context> tvc;
+    core.handle_incoming_txs(bce.txs, tvc, relay_method::block, true);
+    bool ok = tvc.size() == bce.txs.size();
+    for (size_t i = 0; ok && i < tvc.size(); ++i)
+      ok = !tvc[i].m_verifivation_failed;
+    if (ok)
+    {
+      block_verification_context bvc = {};
+      core.handle_incoming_block(bce.block, pblocks.empty() ? NULL : &pblocks[0], bvc, false);
+      ok = !bvc.m_verifivation_failed && bvc.m_added_to_main_chain;
+    }
+    core.cleanup_handle_incoming_blocks();
+
+    if (!ok)
+      MERROR("Generated block " << height << " was rejected");
+    return ok;
+  }
+
+  bool chain_generator::run(cryptonote::core &core)
+  {
+    block prev;
+    if (!m_generator.construct_block(prev, m_accounts[0], GENESIS_TIMESTAMP) || !core.set_genesis_block(prev))
+    {
+      MERROR("Failed to set up the genesis block");
+      return false;
+    }
+    m_outputs_up_to.push_back(0);
+
+    uint64_t num_txs = 0;
+    bool capped = false;
+    for (uint64_t height = 1; height < m_options.blocks; ++height)
+    {
+      std::list<transaction> txs;
+      std::vector<std::vector<size_t>> tx_owners;
+      size_t txs_weight = 0;
+      while (txs.size() < m_options.txs_per_block)
+      {
+        transaction tx;
+        std::vector<size_t> inputs, owners;
+        if (!build_tx(height, tx, inputs, owners))
+          break;
+        const size_t weight = get_transaction_weight(tx);
+        if (txs_weight + weight > MAX_TXS_WEIGHT)
+        {
+          if (!capped)
+            MWARNING("Blocks are capped at " << txs.size() << " transactions to stay below the penalty free block weight");
+          capped = true;
+          break;
+        }
+        txs_weight += weight;
+        for (size_t input: inputs)
+          spend(input);
+        txs.push_back(tx);
+        tx_owners.push_back(owners);
+      }
+
+      const size_t miner = random(NUM_ACCOUNTS);
+      block blk;
+      if (!m_generator.construct_block(blk, prev, m_accounts[miner], txs, SYNTHETIC_HF_VERSION))
+      {
+        MERROR("Failed to construct block " << height);
+        return false;
+      }
+      if (!add_block(core, height, blk, txs))
+        return false;
+
+      if (!add_outputs(blk.miner_tx, height, std::vector<size_t>(1, miner)))
+        return false;
+      size_t i = 0;
+      for (const transaction &tx: txs)
+        if (!add_outputs(tx, height, tx_owners[i++]))
+          return false;
+      m_outputs_up_to.push_back(m_outputs.size());
+
+      prev = blk;
+      num_txs += txs.size();
+      if (height % 100 == 0)
+        MINFO("Generated " << height << "/" << m_options.blocks << " blocks, " << num_txs << " transactions");
+    }
+
+    MINFO("Generated " << m_options.blocks << " blocks with " << num_txs << " transactions");
+    if (num_txs == 0)
+      MWARNING("No transactions were generated, coinbase outputs only unlock after " << CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW << " blocks");
+    return true;
+  }
+}
+
+namespace replay_benchmark
+{
+  bool generate_corpus(const corpus_options &options, const std::string &output_file, const std::string &scratch_dir)
+  {
+    boost::system::error_code ec;
+    if (boost::filesystem::exists(output_file, ec))
+    {
+      MERROR("Corpus file already exists: " << output_file);
+      return false;
+    }
+    if (options.ring_size < 8)
+    {
+      MERROR("Ring size must be at least 8");
+      return false;
+    }
+
+    po::options_description desc("Generator options");
+    cryptonote::core::init_options(desc);
+    po::variables_map vm;
+    bool r = command_line::handle_error_helper(desc, [&]()
+    {
+      const std::vector<std::string> args = {"--data-dir", scratch_dir, "--db-sync-mode", "fastest"};
+      po::store(po::command_line_parser(args).options(desc).run(), vm);
+      po::notify(vm);
+      return true;
+    });
+    if (!r)
+      return false;
+
+    cryptonote::core core(nullptr);
+    if (!core.init(vm, &synthetic_test_options))
+    {
+      MERROR("Failed to initialize the scratch core");
+      return false;
+    }
+    core.get_blockchain_storage().get_db().set_batch_transactions(true);
+
+    chain_generator generator(options);
+    bool ok = generator.run(core);
+    if (ok)
+    {
+      boost::filesystem::path path(output_file);
+      BootstrapFile bootstrap;
+      ok = bootstrap.store_blockchain_raw(&core.get_blockchain_storage(), NULL, path);
+      if (!ok)
+        MERROR("Failed to write corpus to " << output_file);
+    }
+    core.deinit();
+    return ok;
+  }
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+#include "cryptonote_core/cryptonote_core.h"
+
+namespace replay_benchmark
+{
+  //! Shape of a synthetic corpus. The same seed gives the same shape.
+  struct corpus_options
+  {
+    uint64_t blocks;
+    size_t txs_per_block;
+    size_t ring_size;
+    uint64_t seed;
+  };
+
+  //! Hard fork table synthetic corpora are generated with, and must be replayed with
+  extern const std::pair<uint8_t, uint64_t> synthetic_hard_forks[];
+  extern const cryptonote::test_options synthetic_test_options;
+
+  /*! Builds a fake chain of RingCT transfers between a handful of accounts
+      and exports it in the blockchain_export format.
+
+      \param output_file must not exist yet
+      \param scratch_dir directory for the database used to validate the chain
+      \return false if the chain could not be built or written */
+  bool generate_corpus(const corpus_options &options, const std::string &output_file, const std::string &scratch_dir);
+}
@@ -0,0 +1,494 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "misc_log_ex.h"
+#include "string_tools.h"
+#include "common/command_line.h"
+#include "common/metrics.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "profile_tools.h"
+#include "serialization/binary_utils.h"
+#include "../../src/blockchain_utilities/bootstrap_file.h"
+#include "../../src/blockchain_utilities/bootstrap_serialization.h"
+#include "corpus_generator.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "replay"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+namespace
+{
+  const command_line::arg_descriptor<std::string> arg_corpus          = {"corpus", "Block corpus written by wownero-blockchain-export, or by --generate-corpus", ""};
+  const command_line::arg_descriptor<bool>        arg_generate_corpus = {"generate-corpus", "Generate a synthetic corpus first (into --corpus if given), and replay it"};
+  const command_line::arg_descriptor<uint64_t>    arg_blocks          = {"blocks", "Number of blocks in a generated corpus, including genesis", 1000};
+  const command_line::arg_descriptor<size_t>      arg_txs_per_block   = {"txs-per-block", "Transactions per block in a generated corpus", 3};
+  const command_line::arg_descriptor<size_t>      arg_ring_size       = {"ring-size", "Ring size of transactions in a generated corpus", 8};
+  const command_line::arg_descriptor<uint64_t>    arg_seed            = {"seed", "Seed for the shape of a generated corpus", 0};
+  const command_line::arg_descriptor<uint64_t>    arg_batch_size      = {"batch-size", "Blocks per prepare/commit batch, as in a sync span", BLOCKS_SYNCHRONIZING_DEFAULT_COUNT};
+  const command_line::arg_descriptor<bool>        arg_fakechain       = {"fakechain", "Replay with the fake chain rules of generated corpora"};
+  const command_line::arg_descriptor<uint64_t>    arg_stop_height     = {"stop-height", "Stop after replaying this height, 0 for the whole corpus", 0};
+  const command_line::arg_descriptor<bool>        arg_keep_data_dir   = {"keep-data-dir", "Keep the temporary data directory"};
+  const command_line::arg_descriptor<std::string> arg_log_level       = {"log-level", "0-4 or categories", ""};
+
+  // Time spent in each step of replaying a span, in ns
+  struct stage_times
+  {
+    uint64_t prepare = 0;
+    uint64_t txs = 0;
+    uint64_t blocks = 0;
+    uint64_t commit = 0;
+  };
+
+  struct corpus
+  {
+    block genesis;
+    std::vector<std::vector<block_complete_entry>> spans;
+    uint64_t num_blocks = 0;
+    uint64_t num_txs = 0;
+  };
+
+  // Hot paths already timed by PERF_TIMER or the LMDB layer
+  struct hot_path
+  {
+    const char *name;
+    const char *help;
+    const char *labels;
+    uint64_t count;
+    uint64_t sum;
+  };
+
+#define PERF_TIMER_PATH(category, name) { "perf_timer_seconds", "Time spent in PERF_TIMER sections", "category=\"" category "\",name=\"" name "\"", 0, 0 }
+  hot_path hot_paths[] = {
+    PERF_TIMER_PATH("txpool", "add_tx"),
+    PERF_TIMER_PATH("blockchain", "check_tx_inputs"),
+    PERF_TIMER_PATH("blockchain", "expand_transaction_2"),
+    PERF_TIMER_PATH("ringct", "verRct"),
+    PERF_TIMER_PATH("ringct", "verRctSemanticsSimple"),
+    PERF_TIMER_PATH("ringct", "verRctNonSemanticsSimple"),
+    PERF_TIMER_PATH("ringct", "verRctMG"),
+    PERF_TIMER_PATH("ringct", "verRctMGSimple"),
+    PERF_TIMER_PATH("ringct", "verRctCLSAGSimple"),
+    PERF_TIMER_PATH("ringct", "verRange"),
+    { "lmdb_commit_seconds", "Time taken to commit LMDB transactions", "batch=\"true\"", 0, 0 },
+  };
+#undef PERF_TIMER_PATH
+
+  bool parse_chunk(const std::string &chunk, uint8_t major_version, std::vector<bootstrap::block_package> &packages)
+  {
+    if (major_version >= 2)
+      return BootstrapFile::parse_chunk(chunk, packages);
+
+    packages.resize(1);
+    bootstrap::block_package &bp = packages[0];
+    if (major_version == 0)
+    {
+      bootstrap::block_package_1 bp1;
+      if (!::serialization::parse_binary(chunk, bp1))
+        return false;
+      bp.block = std::move(bp1.block);
+      bp.txs = std::move(bp1.txs);
+      return true;
+    }
+    return ::serialization::parse_binary(chunk, bp);
+  }
+
+  // Loads the whole corpus up front, so reading it is not part of the timings
+  bool load_corpus(const std::string &path, uint64_t stop_height, uint64_t batch_size, corpus &c)
+  {
+    std::ifstream file(path, std::ios_base::binary | std::ifstream::in);
+    if (file.fail())
+    {
+      MERROR("Failed to open corpus " << path);
+      return false;
+    }
+
+    BootstrapFile bootstrap;
+    uint8_t major_version, minor_version;
+    uint64_t block_first, block_last, block_last_pos;
+    bootstrap.seek_to_first_chunk(file, major_version, minor_version, block_first, block_last, block_last_pos);
+    if (major_version >= 2 && block_first != 0)
+    {
+      MERROR("Corpus must start at the genesis block, but starts at " << block_first);
+      return false;
+    }
+
+    uint64_t height = 0;
+    std::string chunk;
+    while (!stop_height || height <= stop_height)
+    {
+      // version 2 files end with the chunk index
+      if (major_version >= 2 && (uint64_t)file.tellg() >= block_last_pos)
+        break;
+      char buf[sizeof(uint32_t)];
+      file.read(buf, sizeof(buf));
+      if (!file)
+        break;
+      uint32_t chunk_size;
+      if (!::serialization::parse_binary(std::string(buf, sizeof(buf)), chunk_size))
+      {
+        MERROR("Failed to parse chunk size at height " << height);
+        return false;
+      }
+      if (chunk_size == 0 || chunk_size > (uint64_t)MAX_BLOCKS_PER_CHUNK_V2 * BUFFER_SIZE)
+      {
+        MERROR("Bad chunk size " << chunk_size << " at height " << height);
+        return false;
+      }
+      chunk.resize(chunk_size);
+      file.read(&chunk[0], chunk_size);
+      if (!file)
+      {
+        MERROR("Corpus is truncated at height " << height);
+        return false;
+      }
+
+      std::vector<bootstrap::block_package> packages;
+      if (!parse_chunk(chunk, major_version, packages))
+      {
+        MERROR("Failed to parse chunk at height " << height << (BootstrapFile::can_compress() ? "" : ", compressed corpora need zstd"));
+        return false;
+      }
+      for (bootstrap::block_package &bp: packages)
+      {
+        if (stop_height && height > stop_height)
+          break;
+        if (height++ == 0)
+        {
+          c.genesis = std::move(bp.block);
+          continue;
+        }
+        if (c.spans.empty() || c.spans.back().size() >= batch_size)
+          c.spans.emplace_back();
+        block_complete_entry bce;
+        bce.pruned = false;
+        bce.block = block_to_blob(bp.block);
+        for (const transaction &tx: bp.txs)
+          bce.txs.push_back({tx_to_blob(tx), crypto::null_hash});
+        c.num_txs += bp.txs.size();
+        c.spans.back().push_back(std::move(bce));
+        ++c.num_blocks;
+      }
+    }
+    return true;
+  }
+
+  bool replay_span(core &core, const std::vector<block_complete_entry> &span, stage_times &times)
+  {
+    TIME_MEASURE_NS_START(prepare_time);
+    std::vector<block> pblocks;
+    if (!core.prepare_handle_incoming_blocks(span, pblocks))
+    {
+      MERROR("Failed to prepare to add blocks");
+      return false;
+    }
+    TIME_MEASURE_NS_FINISH(prepare_time);
+    times.prepare += prepare_time;
+
+    for (size_t i = 0; i < span.size(); ++i)
+    {
+      const block_complete_entry &bce = span[i];
+
+      TIME_MEASURE_NS_START(txs_time);
+      std::vector<tx_verification_context> tvc;
+      core.handle_incoming_txs(bce.txs, tvc, relay_method::block, true);
+      TIME_MEASURE_NS_FINISH(txs_time);
+      times.txs += txs_time;
+      bool ok = tvc.size() == bce.txs.size();
+      for (size_t n = 0; ok && n < tvc.size(); ++n)
+        ok = !tvc[n].m_verifivation_failed;
+      if (!ok)
+      {
+        MERROR("Transaction verification failed at height " << core.get_current_blockchain_height());
+        core.cleanup_handle_incoming_blocks();
+        return false;
+      }
+
+      TIME_MEASURE_NS_START(block_time);
+      block_verification_context bvc = {};
+      core.handle_incoming_block(bce.block, pblocks.empty() ? NULL : &pblocks[i], bvc, false);
+      TIME_MEASURE_NS_FINISH(block_time);
+      times.blocks += block_time;
+      if (bvc.m_verifivation_failed || !bvc.m_added_to_main_chain)
+      {
+        MERROR("Block verification failed at height " << core.get_current_blockchain_height());
+        core.cleanup_handle_incoming_blocks();
+        return false;
+      }
+    }
+
+    TIME_MEASURE_NS_START(commit_time);
+    if (!core.cleanup_handle_incoming_blocks(true))
+    {
+      MERROR("Failed to commit blocks");
+      return false;
+    }
+    TIME_MEASURE_NS_FINISH(commit_time);
+    times.commit += commit_time;
+    return true;
+  }
+
+  // In bytes, or 0 if unknown
+  uint64_t get_peak_rss()
+  {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024;
+#endif
+#endif
+  }
+
+  void print_stage(const char *name, uint64_t ns, uint64_t total_ns)
+  {
+    std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setw(10) << ns / 1e9 << " s"
+      << std::setw(8) << (total_ns ? 100.0 * ns / total_ns : 0.0) << " %" << std::endl;
+  }
+
+  void print_report(const corpus &c, const stage_times &times)
+  {
+    const uint64_t total_ns = times.prepare + times.txs + times.blocks + times.commit;
+    const double seconds = total_ns / 1e9;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Replayed " << c.num_blocks << " blocks, " << c.num_txs << " transactions in " << seconds << " s" << std::endl;
+    std::cout << "  blocks/s: " << (seconds > 0 ? c.num_blocks / seconds : 0.0) << std::endl;
+    std::cout << "  txs/s:    " << (seconds > 0 ? c.num_txs / seconds : 0.0) << std::endl;
+
+    std::cout << "Stages:" << std::endl;
+    print_stage("prepare", times.prepare, total_ns);
+    print_stage("txs", times.txs, total_ns);
+    print_stage("blocks", times.blocks, total_ns);
+    print_stage("commit", times.commit, total_ns);
+
+    std::cout << "Hot paths:" << std::endl;
+    for (const hot_path &path: hot_paths)
+    {
+      const tools::metrics::histogram &h = tools::metrics::get_histogram(path.name, path.help, path.labels);
+      const uint64_t count = h.count() - path.count;
+      if (count == 0)
+        continue;
+      const uint64_t sum = h.sum() - path.sum;
+      std::cout << "  " << path.name << "{" << path.labels << "}: " << count << " calls, "
+        << sum / 1e9 << " s, " << sum / 1e3 / count << " us/call" << std::endl;
+    }
+
+    const uint64_t peak_rss = get_peak_rss();
+    if (peak_rss)
+      std::cout << "Peak RSS: " << peak_rss / (1024 * 1024) << " MB" << std::endl;
+    else
+      std::cout << "Peak RSS: unavailable" << std::endl;
+  }
+
+  bool run_benchmark(const po::variables_map &vm, const boost::filesystem::path &work_dir)
+  {
+    const bool generate = command_line::get_arg(vm, arg_generate_corpus);
+    const bool fakechain = generate || command_line::get_arg(vm, arg_fakechain);
+    std::string corpus_path = command_line::get_arg(vm, arg_corpus);
+    if (generate)
+    {
+      replay_benchmark::corpus_options options;
+      options.blocks = command_line::get_arg(vm, arg_blocks);
+      options.txs_per_block = command_line::get_arg(vm, arg_txs_per_block);
+      options.ring_size = command_line::get_arg(vm, arg_ring_size);
+      options.seed = command_line::get_arg(vm, arg_seed);
+      if (corpus_path.empty())
+        corpus_path = (work_dir / "corpus.raw").string();
+      MINFO("Generating a corpus of " << options.blocks << " blocks into " << corpus_path);
+      if (!replay_benchmark::generate_corpus(options, corpus_path, (work_dir / "generate").string()))
+        return false;
+    }
+
+    corpus c;
+    MINFO("Loading corpus " << corpus_path);
+    if (!load_corpus(corpus_path, command_line::get_arg(vm, arg_stop_height), command_line::get_arg(vm, arg_batch_size), c))
+      return false;
+    MINFO("Loaded " << c.num_blocks << " blocks and " << c.num_txs << " transactions after genesis");
+
+    cryptonote::core core(nullptr);
+    core.disable_dns_checkpoints(true);
+    if (!core.init(vm, fakechain ? &replay_benchmark::synthetic_test_options : NULL))
+    {
+      MERROR("Failed to initialize core");
+      return false;
+    }
+    core.get_blockchain_storage().get_db().set_batch_transactions(true);
+
+    bool ok = true;
+    if (fakechain)
+    {
+      ok = core.set_genesis_block(c.genesis);
+      if (!ok)
+        MERROR("Failed to set the genesis block");
+    }
+    else if (core.get_blockchain_storage().get_block_id_by_height(0) != get_block_hash(c.genesis))
+    {
+      MERROR("Corpus genesis block does not match this network, use --testnet, --stagenet or --fakechain");
+      ok = false;
+    }
+    if (ok && core.get_current_blockchain_height() != 1)
+    {
+      MERROR("Replay needs an empty database, but it has " << core.get_current_blockchain_height() << " blocks");
+      ok = false;
+    }
+
+    stage_times times;
+    if (ok)
+    {
+      // the generator went through the same code, only count the replay
+      for (hot_path &path: hot_paths)
+      {
+        const tools::metrics::histogram &h = tools::metrics::get_histogram(path.name, path.help, path.labels);
+        path.count = h.count();
+        path.sum = h.sum();
+      }
+
+      MINFO("Replaying...");
+      for (const std::vector<block_complete_entry> &span: c.spans)
+      {
+        ok = replay_span(core, span, times);
+        if (!ok)
+          break;
+      }
+    }
+    core.deinit();
+
+    if (ok)
+      print_report(c, times);
+    return ok;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+
+  po::options_description desc_options("Allowed options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, arg_corpus);
+  command_line::add_arg(desc_options, arg_generate_corpus);
+  command_line::add_arg(desc_options, arg_blocks);
+  command_line::add_arg(desc_options, arg_txs_per_block);
+  command_line::add_arg(desc_options, arg_ring_size);
+  command_line::add_arg(desc_options, arg_seed);
+  command_line::add_arg(desc_options, arg_batch_size);
+  command_line::add_arg(desc_options, arg_fakechain);
+  command_line::add_arg(desc_options, arg_stop_height);
+  command_line::add_arg(desc_options, arg_keep_data_dir);
+  command_line::add_arg(desc_options, arg_log_level);
+  cryptonote::core::init_options(desc_options);
+
+  std::vector<std::string> args(argv + 1, argv + argc);
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::command_line_parser(args).options(desc_options).run(), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  mlog_configure(mlog_get_default_log_path("replay_benchmark.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log("0,replay:INFO");
+
+  if (command_line::get_arg(vm, arg_batch_size) == 0)
+  {
+    std::cerr << "Error: batch-size must be > 0" << std::endl;
+    return 1;
+  }
+  if (command_line::get_arg(vm, arg_corpus).empty() && !command_line::get_arg(vm, arg_generate_corpus))
+  {
+    std::cerr << "Error: either --" << arg_corpus.name << " or --" << arg_generate_corpus.name << " is needed" << std::endl;
+    return 1;
+  }
+
+  // without an explicit data dir, everything goes in a temporary one
+  boost::filesystem::path work_dir;
+  bool remove_work_dir = false;
+  if (command_line::is_arg_defaulted(vm, cryptonote::arg_data_dir))
+  {
+    boost::system::error_code ec;
+    work_dir = boost::filesystem::temp_directory_path(ec) / boost::filesystem::unique_path("replay-benchmark-%%%%%%%%", ec);
+    if (ec || !boost::filesystem::create_directories(work_dir, ec))
+    {
+      std::cerr << "Error: failed to create a temporary directory: " << ec.message() << std::endl;
+      return 1;
+    }
+    remove_work_dir = !command_line::get_arg(vm, arg_keep_data_dir);
+    args.push_back(std::string("--") + cryptonote::arg_data_dir.name);
+    args.push_back(work_dir.string());
+    vm = po::variables_map();
+    po::store(po::command_line_parser(args).options(desc_options).run(), vm);
+    po::notify(vm);
+  }
+  else
+  {
+    work_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
+  }
+  MINFO("Data directory: " << work_dir.string());
+
+  const bool ok = run_benchmark(vm, work_dir);
+  if (remove_work_dir)
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(work_dir, ec);
+  }
+  return ok ? 0 : 1;
+
+  CATCH_ENTRY_L0("main", 1);
+}
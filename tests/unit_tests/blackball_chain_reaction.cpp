@@ -0,0 +1,133 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include "gtest/gtest.h"
+#include "blockchain_utilities/blackball_chain_reaction.h"
+
+namespace
+{
+  // an in memory stand in for the spent output and ring databases
+  struct rings_db
+  {
+    std::vector<std::vector<uint64_t>> rings; // absolute, all amount 0
+    std::set<output_data> spent;
+
+    bool find(const std::vector<output_data> &outs, std::vector<chain_reaction_candidate> &candidates) const
+    {
+      const auto is_spent = [this](const output_data &od) { return spent.find(od) != spent.end(); };
+      for (const output_data &od: outs)
+      {
+        for (const std::vector<uint64_t> &ring: rings)
+        {
+          chain_reaction_candidate candidate;
+          if (std::find(ring.begin(), ring.end(), od.offset) != ring.end() && find_ring_candidate(0, ring, is_spent, candidate))
+            candidates.push_back(candidate);
+        }
+      }
+      return true;
+    }
+
+    bool mark(const std::vector<chain_reaction_candidate> &candidates, std::vector<output_data> &marked)
+    {
+      for (const chain_reaction_candidate &candidate: candidates)
+        if (spent.insert(candidate.od).second)
+          marked.push_back(candidate.od);
+      return true;
+    }
+
+    bool run(const std::vector<output_data> &seeds)
+    {
+      return run_chain_reaction(seeds,
+          [this](const std::vector<output_data> &outs, std::vector<chain_reaction_candidate> &candidates) { return find(outs, candidates); },
+          [this](const std::vector<chain_reaction_candidate> &candidates, std::vector<output_data> &marked) { return mark(candidates, marked); });
+    }
+  };
+}
+
+TEST(blackball_chain_reaction, ring_candidate)
+{
+  const std::set<output_data> spent{{0, 1}, {0, 2}};
+  const auto is_spent = [&spent](const output_data &od) { return spent.find(od) != spent.end(); };
+  chain_reaction_candidate candidate;
+  ASSERT_TRUE(find_ring_candidate(0, {1, 2, 3}, is_spent, candidate));
+  ASSERT_EQ(candidate.od, output_data(0, 3));
+  ASSERT_EQ(candidate.ring_size, 3);
+  ASSERT_FALSE(find_ring_candidate(0, {1, 3, 4}, is_spent, candidate));
+  ASSERT_FALSE(find_ring_candidate(0, {1, 2}, is_spent, candidate));
+  ASSERT_FALSE(find_ring_candidate(1, {1, 2, 3}, is_spent, candidate));
+  ASSERT_FALSE(find_ring_candidate(0, {}, is_spent, candidate));
+}
+
+TEST(blackball_chain_reaction, new_ring_over_old_spent_outputs)
+{
+  // 1 and 2 were marked spent by an earlier run, which also saw the ring
+  // {3, 5}; this run only adds the ring {1, 2, 3} and marks nothing itself
+  rings_db db;
+  db.spent = {{0, 1}, {0, 2}};
+  db.rings = {{3, 5}, {1, 2, 3}};
+  const std::vector<output_data> newly_spent;
+  const std::vector<output_data> new_ring_members{{0, 1}};
+
+  // starting from newly spent outputs only misses the new ring
+  ASSERT_TRUE(db.run(newly_spent));
+  ASSERT_EQ(db.spent.size(), 2);
+
+  ASSERT_TRUE(db.run(chain_reaction_seeds(newly_spent, new_ring_members)));
+  const std::set<output_data> expected{{0, 1}, {0, 2}, {0, 3}, {0, 5}};
+  ASSERT_EQ(db.spent, expected);
+}
+
+TEST(blackball_chain_reaction, newly_spent_seeds)
+{
+  rings_db db;
+  db.spent = {{0, 1}};
+  db.rings = {{1, 2}, {2, 3, 4}, {3, 4}};
+  // 2 spent in this run resolves nothing alone: {2, 3, 4} has two unknowns
+  db.spent.insert({0, 2});
+  ASSERT_TRUE(db.run(chain_reaction_seeds({{0, 2}}, {})));
+  ASSERT_EQ(db.spent.size(), 2);
+  db.spent.insert({0, 3});
+  ASSERT_TRUE(db.run(chain_reaction_seeds({{0, 3}}, {})));
+  ASSERT_EQ(db.spent.count({0, 4}), 1);
+}
+
+TEST(blackball_chain_reaction, stop)
+{
+  rings_db db;
+  db.spent = {{0, 1}};
+  db.rings = {{1, 2}, {2, 3}};
+  int passes = 0;
+  ASSERT_FALSE(run_chain_reaction(std::vector<output_data>{{0, 1}},
+      [&](const std::vector<output_data> &outs, std::vector<chain_reaction_candidate> &candidates) { ++passes; return db.find(outs, candidates) && false; },
+      [&](const std::vector<chain_reaction_candidate> &candidates, std::vector<output_data> &marked) { return db.mark(candidates, marked); }));
+  ASSERT_EQ(passes, 1);
+  ASSERT_EQ(db.spent.size(), 1);
+}
@@ -26,6 +26,7 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <boost/uuid/uuid.hpp>
 #include "gtest/gtest.h"
 #include "crypto/crypto.h"
@@ -87,3 +88,81 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1(), na);
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, expected_data_size)
+{
+  cryptonote::block_queue bq;
+  epee::net_utils::network_address na;
+
+  bq.add_blocks(0, 20, uuid1(), na);
+  ASSERT_EQ(bq.get_data_size(), 0);
+  ASSERT_EQ(bq.get_expected_data_size(), 0);
+
+  bq.add_blocks(20, std::vector<cryptonote::block_complete_entry>(10), uuid2(), na, 10000.0f, 100000);
+  ASSERT_EQ(bq.get_data_size(), 100000);
+  ASSERT_EQ(bq.get_expected_data_size(), 100000 + 20 * 10000);
+}
+
+TEST(block_queue, span_size)
+{
+  cryptonote::block_queue bq;
+  epee::net_utils::network_address na;
+
+  // no measurement yet
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 5, 100, 3.0f), 20);
+
+  // 10 kB blocks, from a fast and a slow peer
+  bq.add_blocks(0, std::vector<cryptonote::block_complete_entry>(10), uuid1(), na, 1000000.0f, 100000);
+  bq.add_blocks(10, std::vector<cryptonote::block_complete_entry>(10), uuid2(), na, 10000.0f, 100000);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 5, 100, 3.0f), 100);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 5, 1000, 3.0f), 300);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 20, 5, 100, 3.0f), 5);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 20, 1, 100, 3.0f), 3);
+}
+
+TEST(block_queue, span_size_simulation)
+{
+  // two peers with a fixed per request latency download the same chain, once with a
+  // fixed span size, and once with spans sized after their measured speed
+  static const uint64_t nblocks = 2000;
+  static const size_t block_size = 10000;
+  static const double latency = 0.5;
+  struct peer_t { boost::uuids::uuid id; float rate; double busy_until; uint64_t pending_start, pending_n; };
+
+  const auto simulate = [](bool adaptive)
+  {
+    cryptonote::block_queue bq;
+    epee::net_utils::network_address na;
+    std::vector<peer_t> peers = {{uuid1(), 1000000.0f, 0.0, 0, 0}, {uuid2(), 20000.0f, 0.0, 0, 0}};
+    uint64_t height = 0;
+    double end = 0.0;
+    while (true)
+    {
+      peer_t &p = *std::min_element(peers.begin(), peers.end(), [](const peer_t &a, const peer_t &b) { return a.busy_until < b.busy_until; });
+      if (p.pending_n)
+      {
+        bq.add_blocks(p.pending_start, std::vector<cryptonote::block_complete_entry>(p.pending_n), p.id, na, p.rate, p.pending_n * block_size);
+        p.pending_n = 0;
+      }
+      if (height == nblocks)
+        break;
+      const uint64_t n = std::min(nblocks - height, adaptive ? bq.get_span_size(p.id, 20, 5, 100, 3.0f) : (uint64_t)20);
+      bq.add_blocks(height, n, p.id, na);
+      p.pending_start = height;
+      p.pending_n = n;
+      p.busy_until += latency + n * block_size / p.rate;
+      end = std::max(end, p.busy_until);
+      height += n;
+    }
+    for (peer_t &p: peers)
+      if (p.pending_n)
+        end = std::max(end, p.busy_until);
+    EXPECT_EQ(bq.get_max_block_height(), nblocks - 1);
+    return end;
+  };
+
+  const double fixed_time = simulate(false);
+  const double adaptive_time = simulate(true);
+  MDEBUG("fixed spans: " << fixed_time << " s, adaptive spans: " << adaptive_time << " s");
+  ASSERT_LT(adaptive_time, fixed_time * 0.6);
+}
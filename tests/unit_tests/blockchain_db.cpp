@@ -341,4 +341,150 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1].first), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, PruneBlockchainStep)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+  const uint64_t n_txes = this->m_db->get_tx_count();
+  ASSERT_EQ(3, n_txes);
+
+  // one tx per step, each visited once
+  pruning_progress_t progress;
+  uint64_t steps = 0;
+  while (!progress.done)
+  {
+    ASSERT_TRUE(this->m_db->prune_blockchain_step(progress, 0, 1));
+    ASSERT_LE(++steps, n_txes);
+  }
+  ASSERT_EQ(n_txes, steps);
+  ASSERT_EQ(n_txes, progress.n_total_records);
+  ASSERT_NE(0, this->m_db->get_blockchain_pruning_seed());
+
+  // a finished run stays finished
+  ASSERT_TRUE(this->m_db->prune_blockchain_step(progress, 0, 1));
+  ASSERT_EQ(n_txes, progress.n_total_records);
+
+  // txes in the tip window keep their prunable data
+  for (const auto &tx : this->m_txs[0])
+  {
+    cryptonote::blobdata bd;
+    ASSERT_TRUE(this->m_db->get_prunable_tx_blob(get_transaction_hash(tx.first), bd));
+  }
+}
+
+TYPED_TEST(BlockchainDBTest, PruneBlockchainStepResume)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  // the order of tx_indices, most significant 32 bit word last
+  std::vector<crypto::hash> hashes;
+  for (const auto &b : this->m_blocks)
+  {
+    hashes.push_back(get_transaction_hash(b.first.miner_tx));
+    hashes.insert(hashes.end(), b.first.tx_hashes.begin(), b.first.tx_hashes.end());
+  }
+  std::sort(hashes.begin(), hashes.end(), [](const crypto::hash &a, const crypto::hash &b) {
+    const uint32_t *va = (const uint32_t*)&a, *vb = (const uint32_t*)&b;
+    for (int n = 7; n >= 0; --n)
+      if (va[n] != vb[n])
+        return va[n] < vb[n];
+    return false;
+  });
+  ASSERT_EQ(3, hashes.size());
+
+  const auto visited_from = [this](const crypto::hash &next) {
+    pruning_progress_t progress;
+    progress.started = true;
+    progress.next_tx_hash = next;
+    EXPECT_TRUE(this->m_db->prune_blockchain_step(progress, 0, 1000));
+    EXPECT_TRUE(progress.done);
+    return progress.n_total_records;
+  };
+
+  // resuming at a tx visits it and the ones after it
+  ASSERT_EQ(3, visited_from(crypto::null_hash));
+  ASSERT_EQ(3, visited_from(hashes[0]));
+  ASSERT_EQ(2, visited_from(hashes[1]));
+  ASSERT_EQ(1, visited_from(hashes[2]));
+
+  // a tx removed since then is skipped, and the run goes on with the next one
+  crypto::hash removed = hashes[0];
+  ASSERT_NE(0xff, (unsigned char)removed.data[0]);
+  ++removed.data[0];
+  ASSERT_EQ(2, visited_from(removed));
+
+  crypto::hash last;
+  memset(&last, 0xff, sizeof(last));
+  ASSERT_EQ(0, visited_from(last));
+
+  // a run split anywhere resumes where it stopped
+  pruning_progress_t progress;
+  ASSERT_TRUE(this->m_db->prune_blockchain_step(progress, 0, 2));
+  ASSERT_FALSE(progress.done);
+  ASSERT_EQ(2, progress.n_total_records);
+  ASSERT_HASH_EQ(hashes[2], progress.next_tx_hash);
+  ASSERT_TRUE(this->m_db->prune_blockchain_step(progress, 0, 2));
+  ASSERT_TRUE(progress.done);
+  ASSERT_EQ(3, progress.n_total_records);
+}
+
+TYPED_TEST(BlockchainDBTest, CopyCompacted)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  // cancelling with no copy running does not affect the next one
+  this->m_db->cancel_copy_compacted();
+
+  const boost::filesystem::path copyPath = dirPath + "-compacted";
+  ASSERT_TRUE(boost::filesystem::create_directories(copyPath));
+  ASSERT_TRUE(this->m_db->copy_compacted(copyPath.string()));
+
+  {
+    TypeParam copy;
+    ASSERT_NO_THROW(copy.open(copyPath.string(), DBF_RDONLY));
+    ASSERT_EQ(2, copy.height());
+    ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1].first), copy.get_block_hash_from_height(1));
+    ASSERT_NO_THROW(copy.close());
+  }
+  boost::filesystem::remove_all(copyPath);
+}
+
 }  // anonymous namespace
@@ -0,0 +1,175 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include "gtest/gtest.h"
+#include "rpc/bootstrap_daemon.h"
+
+namespace
+{
+  typedef cryptonote::COMMAND_RPC_GET_HEIGHT::request request;
+  typedef cryptonote::COMMAND_RPC_GET_HEIGHT::response response;
+
+  std::string node_of(const net::http::client &client)
+  {
+    return client.get_host() + ":" + client.get_port();
+  }
+
+  bool answer(response &res)
+  {
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+
+  template <typename F>
+  bool wait_until(F f)
+  {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!f())
+    {
+      if (std::chrono::steady_clock::now() > deadline)
+        return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
+}
+
+TEST(bootstrap_daemon, slow_primary_then_second_call)
+{
+  cryptonote::bootstrap_daemon daemon([]() {
+    return std::map<std::string, bool>{{"127.0.0.1:18081", true}, {"127.0.0.1:18082", true}};
+  }, false, "");
+  request req;
+  response res;
+
+  ASSERT_TRUE(daemon.invoke(req, res, false, [](const request &, response &res, net::http::client &) { return answer(res); }));
+  const std::string slow = daemon.address();
+  ASSERT_FALSE(slow.empty());
+
+  // the primary hangs, the race is won by the other node
+  std::promise<void> unblock;
+  const std::shared_future<void> unblocked = unblock.get_future().share();
+  std::atomic<bool> slow_done(false);
+  ASSERT_TRUE(daemon.invoke(req, res, true, [&slow, unblocked, &slow_done](const request &, response &res, net::http::client &client) {
+    if (node_of(client) == slow)
+    {
+      unblocked.wait_for(std::chrono::seconds(10));
+      slow_done = true;
+    }
+    return answer(res);
+  }));
+  ASSERT_EQ(res.status, CORE_RPC_STATUS_OK);
+  ASSERT_FALSE(slow_done);
+  const std::string fast = daemon.address();
+  ASSERT_NE(fast, slow);
+
+  // the next call goes to the node that won, without waiting on the slow one
+  std::string used;
+  ASSERT_TRUE(daemon.invoke(req, res, false, [&used](const request &, response &res, net::http::client &client) {
+    used = node_of(client);
+    return answer(res);
+  }));
+  ASSERT_EQ(used, fast);
+  ASSERT_FALSE(slow_done);
+
+  // no new race while the slow side of the last one still holds a connection
+  std::atomic<size_t> calls(0);
+  const auto count = [&calls](const request &, response &res, net::http::client &) {
+    ++calls;
+    return answer(res);
+  };
+  ASSERT_TRUE(daemon.invoke(req, res, true, count));
+  ASSERT_EQ(calls, 1);
+
+  unblock.set_value();
+  ASSERT_TRUE(wait_until([&slow_done]() { return slow_done.load(); }));
+}
+
+TEST(bootstrap_daemon, race_side_throws)
+{
+  cryptonote::bootstrap_daemon daemon([]() {
+    return std::map<std::string, bool>{{"127.0.0.1:18081", true}, {"127.0.0.1:18082", true}};
+  }, false, "");
+  request req;
+  response res;
+
+  ASSERT_FALSE(daemon.invoke(req, res, true, [](const request &, response &, net::http::client &) -> bool {
+    throw std::runtime_error("failed");
+  }));
+
+  // both sides are done, so the next call races again and the other side answers
+  std::atomic<size_t> calls(0);
+  const std::string thrower = daemon.address();
+  ASSERT_TRUE(daemon.invoke(req, res, true, [&thrower, &calls](const request &, response &res, net::http::client &client) {
+    ++calls;
+    if (node_of(client) == thrower)
+      throw std::runtime_error("failed");
+    return answer(res);
+  }));
+  ASSERT_EQ(res.status, CORE_RPC_STATUS_OK);
+  ASSERT_TRUE(wait_until([&calls]() { return calls.load() == 2; }));
+}
+
+TEST(bootstrap_daemon, busy_connection_not_shared)
+{
+  cryptonote::bootstrap_daemon daemon("127.0.0.1:18081", boost::none, false, "");
+  request req;
+
+  std::promise<void> unblock;
+  const std::shared_future<void> unblocked = unblock.get_future().share();
+  std::atomic<net::http::client*> busy(nullptr);
+  std::thread t([&daemon, &req, unblocked, &busy]() {
+    response res;
+    daemon.invoke(req, res, false, [unblocked, &busy](const request &, response &res, net::http::client &client) {
+      busy = &client;
+      unblocked.wait_for(std::chrono::seconds(10));
+      return answer(res);
+    });
+  });
+  ASSERT_TRUE(wait_until([&busy]() { return busy.load() != nullptr; }));
+
+  // a second call gets its own connection to the same node instead of queueing
+  response res;
+  net::http::client *used = nullptr;
+  std::string node;
+  ASSERT_TRUE(daemon.invoke(req, res, true, [&used, &node](const request &, response &res, net::http::client &client) {
+    used = &client;
+    node = node_of(client);
+    return answer(res);
+  }));
+  ASSERT_NE(used, busy.load());
+  ASSERT_EQ(node, "127.0.0.1:18081");
+
+  unblock.set_value();
+  t.join();
+}
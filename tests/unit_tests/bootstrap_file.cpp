@@ -0,0 +1,284 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#define IN_UNIT_TESTS
+
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "serialization/binary_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_db/testdb.h"
+#include "blockchain_utilities/bootstrap_file.h"
+
+namespace
+{
+  // keeps the blocks in memory, with a weight, difficulty and coins
+  // generated derived from the height
+  class TestDB: public cryptonote::BaseTestDB
+  {
+  public:
+    TestDB() { m_open = true; }
+
+    virtual void add_block( const cryptonote::block& blk
+                          , size_t block_weight
+                          , uint64_t long_term_block_weight
+                          , const cryptonote::difficulty_type& cumulative_difficulty
+                          , const uint64_t& coins_generated
+                          , uint64_t num_rct_outs
+                          , const crypto::hash& blk_hash
+                          ) override {
+      blocks.push_back(blk);
+    }
+    virtual uint64_t height() const override { return blocks.size(); }
+    virtual cryptonote::blobdata get_block_blob_from_height(const uint64_t &h) const override { return cryptonote::block_to_blob(blocks[h]); }
+    virtual cryptonote::block get_block_from_height(const uint64_t &h) const override { return blocks[h]; }
+    virtual size_t get_block_weight(const uint64_t &h) const override { return 1000 + h; }
+    virtual cryptonote::difficulty_type get_block_cumulative_difficulty(const uint64_t &h) const override { return h * 10; }
+    virtual uint64_t get_block_already_generated_coins(const uint64_t &h) const override { return h * 1000000; }
+    virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return cryptonote::get_block_hash(blocks[h]); }
+    virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
+      if (block_height)
+        *block_height = blocks.size() - 1;
+      return blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back());
+    }
+    virtual void pop_block(cryptonote::block &blk, std::vector<cryptonote::transaction> &txs) override { blk = blocks.back(); blocks.pop_back(); }
+
+    std::vector<cryptonote::block> blocks;
+  };
+
+  cryptonote::block make_block(uint64_t height, const crypto::hash &prev_id)
+  {
+    cryptonote::block b;
+    b.major_version = CURRENT_BLOCK_MAJOR_VERSION;
+    b.minor_version = 0;
+    b.timestamp = 1000 + height;
+    b.prev_id = prev_id;
+    b.nonce = height;
+    b.miner_tx.version = 1;
+    b.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+    b.miner_tx.vin.push_back(cryptonote::txin_gen{height});
+    return b;
+  }
+
+  std::string make_chunk(const std::vector<cryptonote::block> &blocks, uint64_t block_count)
+  {
+    bootstrap::block_packages packages;
+    for (const cryptonote::block &b: blocks)
+    {
+      bootstrap::block_package bp;
+      bp.block = b;
+      bp.block_weight = 1;
+      bp.cumulative_difficulty = 1;
+      bp.coins_generated = 1;
+      packages.blocks.push_back(bp);
+    }
+    bootstrap::chunk_package cp;
+    cp.compression = bootstrap::compression_none;
+    cp.block_count = block_count;
+    EXPECT_TRUE(::serialization::dump_binary(packages, cp.data));
+    cp.data_size = cp.data.size();
+    std::string blob;
+    EXPECT_TRUE(::serialization::dump_binary(cp, blob));
+    return blob;
+  }
+
+  // writes a chunk index at the given position of a file
+  bool write_index(const std::string &path, uint64_t index_pos, bootstrap::chunk_index index)
+  {
+    std::string blob, size_blob;
+    if (!::serialization::dump_binary(index, blob))
+      return false;
+    uint32_t index_size = blob.size();
+    if (!::serialization::dump_binary(index_size, size_blob))
+      return false;
+    std::ofstream file(path, std::ios_base::binary | std::ios_base::out | std::ios::trunc);
+    file << std::string(index_pos, '\0') << size_blob << blob;
+    return file.good();
+  }
+
+  struct BlockchainAndPool
+  {
+    cryptonote::tx_memory_pool txpool;
+    cryptonote::Blockchain bc;
+    BlockchainAndPool(): txpool(bc), bc(txpool) {}
+  };
+}
+
+TEST(bootstrap_file, parse_chunk)
+{
+  std::vector<cryptonote::block> blocks;
+  for (uint64_t h = 0; h < 3; ++h)
+    blocks.push_back(make_block(h, crypto::null_hash));
+
+  std::vector<bootstrap::block_package> packages;
+  ASSERT_TRUE(BootstrapFile::parse_chunk(make_chunk(blocks, 3), packages));
+  ASSERT_EQ(packages.size(), 3);
+  for (size_t i = 0; i < 3; ++i)
+    ASSERT_EQ(cryptonote::get_block_hash(packages[i].block), cryptonote::get_block_hash(blocks[i]));
+
+  // the block count must match the blocks, and be within bounds
+  ASSERT_FALSE(BootstrapFile::parse_chunk(make_chunk(blocks, 2), packages));
+  ASSERT_FALSE(BootstrapFile::parse_chunk(make_chunk({}, 0), packages));
+
+  // truncated chunk
+  const std::string chunk = make_chunk(blocks, 3);
+  ASSERT_FALSE(BootstrapFile::parse_chunk(chunk.substr(0, chunk.size() - 1), packages));
+
+  // unknown compression
+  bootstrap::chunk_package cp;
+  ASSERT_TRUE(::serialization::parse_binary(chunk, cp));
+  cp.compression = 0xff;
+  std::string blob;
+  ASSERT_TRUE(::serialization::dump_binary(cp, blob));
+  ASSERT_FALSE(BootstrapFile::parse_chunk(blob, packages));
+}
+
+TEST(bootstrap_file, read_chunk_index)
+{
+  const std::string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  BootstrapFile bootstrap;
+  bootstrap::chunk_index index;
+  index.blocks_per_chunk = 100;
+  index.offsets = {1028, 2000, 3000};
+
+  ASSERT_TRUE(write_index(path, 4000, index));
+  {
+    std::ifstream file(path, std::ios_base::binary | std::ifstream::in);
+    file.seekg(1028);
+    bootstrap::chunk_index read;
+    ASSERT_TRUE(bootstrap.read_chunk_index(file, 4000, read));
+    ASSERT_EQ(read.blocks_per_chunk, 100);
+    ASSERT_EQ(read.offsets, index.offsets);
+    // the read position is left where it was
+    ASSERT_EQ(file.tellg(), 1028);
+
+    // no index, the file was not completely written
+    ASSERT_FALSE(bootstrap.read_chunk_index(file, 0, read));
+  }
+
+  // offsets must be increasing, and before the index
+  index.offsets = {1028, 3000, 2000};
+  ASSERT_TRUE(write_index(path, 4000, index));
+  {
+    std::ifstream file(path, std::ios_base::binary | std::ifstream::in);
+    bootstrap::chunk_index read;
+    ASSERT_FALSE(bootstrap.read_chunk_index(file, 4000, read));
+  }
+  index.offsets = {1028, 4000};
+  ASSERT_TRUE(write_index(path, 4000, index));
+  {
+    std::ifstream file(path, std::ios_base::binary | std::ifstream::in);
+    bootstrap::chunk_index read;
+    ASSERT_FALSE(bootstrap.read_chunk_index(file, 4000, read));
+  }
+
+  // blocks per chunk must be within bounds
+  index.offsets = {1028};
+  index.blocks_per_chunk = 0;
+  ASSERT_TRUE(write_index(path, 4000, index));
+  {
+    std::ifstream file(path, std::ios_base::binary | std::ifstream::in);
+    bootstrap::chunk_index read;
+    ASSERT_FALSE(bootstrap.read_chunk_index(file, 4000, read));
+  }
+
+  boost::filesystem::remove(path);
+}
+
+TEST(bootstrap_file, round_trip)
+{
+  static const uint64_t num_blocks = 250;
+
+  BlockchainAndPool bap;
+  TestDB *db = new TestDB();
+  const std::pair<uint8_t, uint64_t> hard_forks[2] = {std::make_pair((uint8_t)CURRENT_BLOCK_MAJOR_VERSION, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0)};
+  const cryptonote::test_options test_options = {hard_forks};
+  ASSERT_TRUE(bap.bc.init(db, cryptonote::FAKECHAIN, true, &test_options, 0, NULL));
+  ASSERT_EQ(db->height(), 1);
+  while (db->height() < num_blocks)
+    db->blocks.push_back(make_block(db->height(), cryptonote::get_block_hash(db->blocks.back())));
+
+  boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  BootstrapFile exporter;
+  ASSERT_TRUE(exporter.store_blockchain_indexed(&bap.bc, path, 0, 0, false));
+  // indexed files are not appended to
+  ASSERT_FALSE(exporter.store_blockchain_indexed(&bap.bc, path, 0, 0, false));
+
+  BootstrapFile bootstrap;
+  std::streampos pos;
+  uint64_t seek_height = 150, block_first;
+  ASSERT_EQ(bootstrap.count_blocks(path.string(), pos, seek_height, block_first), num_blocks);
+  ASSERT_EQ(block_first, 0);
+  ASSERT_EQ(seek_height, NUM_BLOCKS_PER_CHUNK_V2);
+
+  std::ifstream file(path.string(), std::ios_base::binary | std::ifstream::in);
+  uint8_t major_version, minor_version;
+  uint64_t block_last, block_last_pos;
+  bootstrap.seek_to_first_chunk(file, major_version, minor_version, block_first, block_last, block_last_pos);
+  ASSERT_EQ(major_version, 2);
+  ASSERT_EQ(block_first, 0);
+  ASSERT_EQ(block_last, num_blocks - 1);
+
+  bootstrap::chunk_index index;
+  ASSERT_TRUE(bootstrap.read_chunk_index(file, block_last_pos, index));
+  ASSERT_EQ(index.blocks_per_chunk, NUM_BLOCKS_PER_CHUNK_V2);
+  ASSERT_EQ(index.offsets.size(), (num_blocks + NUM_BLOCKS_PER_CHUNK_V2 - 1) / NUM_BLOCKS_PER_CHUNK_V2);
+  ASSERT_EQ(pos, index.offsets[1]);
+
+  // reading stops at the index rather than taking it for a chunk
+  uint64_t height = 0;
+  std::string chunk;
+  while (BootstrapFile::read_chunk(file, block_last_pos, index.blocks_per_chunk, chunk))
+  {
+    std::vector<bootstrap::block_package> packages;
+    ASSERT_TRUE(BootstrapFile::parse_chunk(chunk, packages));
+    for (const bootstrap::block_package &bp: packages)
+    {
+      ASSERT_LT(height, num_blocks);
+      ASSERT_EQ(cryptonote::get_block_hash(bp.block), cryptonote::get_block_hash(db->blocks[height]));
+      ASSERT_EQ(bp.block_weight, db->get_block_weight(height));
+      ASSERT_EQ(bp.cumulative_difficulty, db->get_block_cumulative_difficulty(height));
+      ASSERT_EQ(bp.coins_generated, db->get_block_already_generated_coins(height));
+      ++height;
+    }
+  }
+  ASSERT_EQ(height, num_blocks);
+
+  // resuming from the middle of the file
+  file.clear();
+  file.seekg(index.offsets[1]);
+  ASSERT_TRUE(BootstrapFile::read_chunk(file, block_last_pos, index.blocks_per_chunk, chunk));
+  std::vector<bootstrap::block_package> packages;
+  ASSERT_TRUE(BootstrapFile::parse_chunk(chunk, packages));
+  ASSERT_EQ(cryptonote::get_block_hash(packages.front().block), cryptonote::get_block_hash(db->blocks[NUM_BLOCKS_PER_CHUNK_V2]));
+
+  file.close();
+  boost::filesystem::remove(path);
+}
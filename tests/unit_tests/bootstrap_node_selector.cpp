@@ -171,3 +171,60 @@ TEST_F(bootstrap_node_selector, selector_auto_max_nodes)
 
   EXPECT_EQ(unique_nodes.size(), max_nodes);
 }
+
+TEST_F(bootstrap_node_selector, selector_auto_exclude)
+{
+  cryptonote::bootstrap_node::selector_auto selector([this]() {
+    return white_nodes;
+  });
+
+  for (size_t iterations = 0; iterations < 16; ++iterations)
+  {
+    const auto current = selector.next_node("white_node_1:18089");
+    ASSERT_TRUE(current);
+    EXPECT_EQ(current->address, "white_node_2:18081");
+  }
+}
+
+TEST_F(bootstrap_node_selector, selector_auto_fast_nodes_first)
+{
+  cryptonote::bootstrap_node::selector_auto selector([this]() {
+    return white_nodes;
+  });
+  selector.next_node();
+
+  for (size_t samples = 0; samples < 10; ++samples)
+  {
+    selector.handle_latency("white_node_1:18089", std::chrono::milliseconds(2000));
+    selector.handle_latency("white_node_2:18081", std::chrono::milliseconds(40));
+  }
+  EXPECT_EQ(*selector.get_latency("white_node_2:18081", 0.9), std::chrono::milliseconds(64));
+  EXPECT_FALSE(selector.get_latency("unknown:18081", 0.9));
+
+  for (size_t iterations = 0; iterations < 16; ++iterations)
+  {
+    EXPECT_EQ(selector.next_node()->address, "white_node_2:18081");
+  }
+}
+
+TEST(bootstrap_node_latency_histogram, percentile)
+{
+  cryptonote::bootstrap_node::latency_histogram histogram;
+  EXPECT_FALSE(histogram.percentile(0.5));
+
+  for (size_t samples = 0; samples < 9; ++samples)
+  {
+    histogram.record(std::chrono::milliseconds(3));
+  }
+  histogram.record(std::chrono::milliseconds(1000));
+  EXPECT_EQ(*histogram.percentile(0.5), std::chrono::milliseconds(4));
+  EXPECT_EQ(*histogram.percentile(1.0), std::chrono::milliseconds(1024));
+
+  // old samples fade away
+  for (size_t samples = 0; samples < 4 * cryptonote::bootstrap_node::latency_histogram::MAX_SAMPLES; ++samples)
+  {
+    histogram.record(std::chrono::milliseconds(100));
+  }
+  EXPECT_EQ(*histogram.percentile(0.5), std::chrono::milliseconds(128));
+  EXPECT_LT(histogram.count(), cryptonote::bootstrap_node::latency_histogram::MAX_SAMPLES);
+}
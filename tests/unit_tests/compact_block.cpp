@@ -0,0 +1,97 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/compact_block.h"
+
+namespace
+{
+  std::vector<crypto::hash> make_hashes(size_t n)
+  {
+    std::vector<crypto::hash> hashes(n);
+    for (auto &h: hashes)
+      h = crypto::rand<crypto::hash>();
+    return hashes;
+  }
+}
+
+TEST(compact_block, round_trip)
+{
+  const crypto::hash block_hash = crypto::rand<crypto::hash>();
+  const std::vector<crypto::hash> block_txes = make_hashes(50);
+  std::vector<crypto::hash> pool = make_hashes(200);
+  pool.insert(pool.end(), block_txes.rbegin(), block_txes.rend());
+
+  const std::string short_ids = cryptonote::get_compact_block_short_ids(block_txes, block_hash, 42);
+  ASSERT_EQ(short_ids.size(), block_txes.size() * cryptonote::COMPACT_BLOCK_SHORT_ID_SIZE);
+  ASSERT_EQ(cryptonote::resolve_compact_block_short_ids(short_ids, pool, block_hash, 42), block_txes);
+}
+
+TEST(compact_block, salted)
+{
+  const crypto::hash block_hash = crypto::rand<crypto::hash>();
+  const std::vector<crypto::hash> block_txes = make_hashes(10);
+  ASSERT_NE(cryptonote::get_compact_block_short_ids(block_txes, block_hash, 1), cryptonote::get_compact_block_short_ids(block_txes, block_hash, 2));
+  ASSERT_NE(cryptonote::get_compact_block_short_ids(block_txes, block_hash, 1), cryptonote::get_compact_block_short_ids(block_txes, crypto::rand<crypto::hash>(), 1));
+}
+
+TEST(compact_block, unknown)
+{
+  const crypto::hash block_hash = crypto::rand<crypto::hash>();
+  const std::vector<crypto::hash> block_txes = make_hashes(4);
+  const std::vector<crypto::hash> pool{block_txes[0], block_txes[2]};
+
+  const std::string short_ids = cryptonote::get_compact_block_short_ids(block_txes, block_hash, 0);
+  const std::vector<crypto::hash> resolved = cryptonote::resolve_compact_block_short_ids(short_ids, pool, block_hash, 0);
+  ASSERT_EQ(resolved.size(), 4);
+  ASSERT_EQ(resolved[0], block_txes[0]);
+  ASSERT_EQ(resolved[1], crypto::null_hash);
+  ASSERT_EQ(resolved[2], block_txes[2]);
+  ASSERT_EQ(resolved[3], crypto::null_hash);
+}
+
+TEST(compact_block, duplicate_candidates)
+{
+  const crypto::hash block_hash = crypto::rand<crypto::hash>();
+  const std::vector<crypto::hash> block_txes = make_hashes(3);
+  const std::vector<crypto::hash> pool{block_txes[0], block_txes[1], block_txes[1], block_txes[2], block_txes[0]};
+
+  const std::string short_ids = cryptonote::get_compact_block_short_ids(block_txes, block_hash, 7);
+  ASSERT_EQ(cryptonote::resolve_compact_block_short_ids(short_ids, pool, block_hash, 7), block_txes);
+}
+
+TEST(compact_block, bad_size)
+{
+  const crypto::hash block_hash = crypto::rand<crypto::hash>();
+  const std::vector<crypto::hash> block_txes = make_hashes(3);
+  std::string short_ids = cryptonote::get_compact_block_short_ids(block_txes, block_hash, 0);
+  short_ids.pop_back();
+  ASSERT_TRUE(cryptonote::resolve_compact_block_short_ids(short_ids, block_txes, block_hash, 0).empty());
+  ASSERT_TRUE(cryptonote::resolve_compact_block_short_ids({}, block_txes, block_hash, 0).empty());
+}
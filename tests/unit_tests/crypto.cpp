@@ -86,6 +86,41 @@ TEST(Crypto, null_keys)
   ASSERT_EQ(memcmp(crypto::null_pkey.data, zero, 32), 0);
 }
 
+TEST(Crypto, generate_key_derivations)
+{
+  crypto::public_key pub;
+  crypto::secret_key view_sec, sec;
+  crypto::generate_keys(pub, view_sec);
+
+  std::vector<crypto::public_key> pubs(37);
+  for (auto &p: pubs)
+    crypto::generate_keys(p, sec);
+  memset(&pubs[5], 0xff, sizeof(pubs[5])); // not a valid point
+
+  std::vector<crypto::key_derivation> derivations(pubs.size());
+  std::vector<bool> valid;
+  ASSERT_FALSE(crypto::generate_key_derivations(epee::to_span(pubs), view_sec, epee::to_mut_span(derivations), valid));
+  ASSERT_EQ(valid.size(), pubs.size());
+  for (size_t i = 0; i < pubs.size(); ++i)
+  {
+    crypto::key_derivation derivation;
+    const bool r = crypto::generate_key_derivation(pubs[i], view_sec, derivation);
+    ASSERT_EQ(r, valid[i]);
+    if (r)
+      ASSERT_EQ(memcmp(&derivation, &derivations[i], sizeof(derivation)), 0);
+  }
+
+  pubs.erase(pubs.begin() + 5);
+  derivations.resize(pubs.size());
+  ASSERT_TRUE(crypto::generate_key_derivations(epee::to_span(pubs), view_sec, epee::to_mut_span(derivations), valid));
+
+  // empty and mismatched sizes
+  ASSERT_TRUE(crypto::generate_key_derivations({}, view_sec, {}, valid));
+  ASSERT_TRUE(valid.empty());
+  derivations.pop_back();
+  ASSERT_FALSE(crypto::generate_key_derivations(epee::to_span(pubs), view_sec, epee::to_mut_span(derivations), valid));
+}
+
 TEST(Crypto, verify_32)
 {
   // all bytes are treated the same, so we can brute force just one byte
@@ -0,0 +1,140 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <thread>
+#include "gtest/gtest.h"
+#include "wallet/http_client_pool.h"
+
+namespace
+{
+  class fake_client final : public epee::net_utils::http::abstract_http_client
+  {
+  public:
+    void set_server(std::string host, std::string port, boost::optional<epee::net_utils::http::login> user, epee::net_utils::ssl_options_t ssl_options) override
+    {
+      server = host + ":" + port;
+    }
+    void set_auto_connect(bool auto_connect) override { this->auto_connect = auto_connect; }
+    bool connect(std::chrono::milliseconds timeout) override { return connected = true; }
+    bool disconnect() override { connected = false; return true; }
+    bool is_connected(bool *ssl) override { return connected; }
+    bool invoke(const boost::string_ref uri, const boost::string_ref method, const boost::string_ref body, std::chrono::milliseconds timeout, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params) override
+    {
+      connected = true;
+      bytes_sent += body.size();
+      return true;
+    }
+    bool invoke_get(const boost::string_ref uri, std::chrono::milliseconds timeout, const std::string& body, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params) override
+    {
+      return invoke(uri, "GET", body, timeout, ppresponse_info, additional_params);
+    }
+    bool invoke_post(const boost::string_ref uri, const std::string& body, std::chrono::milliseconds timeout, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params) override
+    {
+      return invoke(uri, "POST", body, timeout, ppresponse_info, additional_params);
+    }
+    uint64_t get_bytes_sent() const override { return bytes_sent; }
+    uint64_t get_bytes_received() const override { return 0; }
+
+    std::string server;
+    bool auto_connect = true;
+    bool connected = false;
+    uint64_t bytes_sent = 0;
+  };
+
+  class fake_factory final : public epee::net_utils::http::http_client_factory
+  {
+  public:
+    fake_factory(std::atomic<int> &created): created(created) {}
+    std::unique_ptr<epee::net_utils::http::abstract_http_client> create() override
+    {
+      ++created;
+      return std::unique_ptr<epee::net_utils::http::abstract_http_client>(new fake_client());
+    }
+    std::atomic<int> &created;
+  };
+}
+
+TEST(http_client_pool, reuse)
+{
+  std::atomic<int> created(0);
+  tools::http_client_pool pool(std::unique_ptr<fake_factory>(new fake_factory(created)), 2);
+  epee::net_utils::http::abstract_http_client *first;
+  {
+    tools::http_client_pool::lease c = pool.acquire();
+    first = &*c;
+  }
+  {
+    tools::http_client_pool::lease c = pool.acquire();
+    ASSERT_EQ(&*c, first);
+    tools::http_client_pool::lease c2 = pool.acquire();
+    ASSERT_NE(&*c2, first);
+  }
+  ASSERT_EQ(created, 2);
+}
+
+TEST(http_client_pool, wait_for_idle)
+{
+  std::atomic<int> created(0);
+  tools::http_client_pool pool(std::unique_ptr<fake_factory>(new fake_factory(created)), 1);
+  std::atomic<bool> acquired(false);
+  std::unique_ptr<tools::http_client_pool::lease> c(new tools::http_client_pool::lease(pool.acquire()));
+  std::thread t([&pool, &acquired]{ tools::http_client_pool::lease c = pool.acquire(); acquired = true; });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_FALSE(acquired);
+  c.reset();
+  t.join();
+  ASSERT_TRUE(acquired);
+  ASSERT_EQ(created, 1);
+}
+
+TEST(http_client_pool, settings)
+{
+  std::atomic<int> created(0);
+  tools::http_client_pool pool(std::unique_ptr<fake_factory>(new fake_factory(created)), 2);
+  ASSERT_TRUE(pool.set_server("127.0.0.1:18081", boost::none, epee::net_utils::ssl_support_t::e_ssl_support_disabled));
+  {
+    tools::http_client_pool::lease c = pool.acquire();
+    const fake_client &fc = dynamic_cast<const fake_client&>(*c);
+    ASSERT_EQ(fc.server, "127.0.0.1:18081");
+    ASSERT_TRUE(c->invoke_post("/getblocks.bin", "1234", std::chrono::seconds(1)));
+    ASSERT_TRUE(c->is_connected());
+
+    // a client in use is reconfigured once returned
+    pool.set_server("127.0.0.2:18081", boost::none, epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+    pool.set_auto_connect(false);
+    ASSERT_EQ(fc.server, "127.0.0.1:18081");
+    ASSERT_TRUE(c->is_connected());
+  }
+  tools::http_client_pool::lease c = pool.acquire();
+  const fake_client &fc = dynamic_cast<const fake_client&>(*c);
+  ASSERT_EQ(fc.server, "127.0.0.2:18081");
+  ASSERT_FALSE(fc.auto_connect);
+  ASSERT_FALSE(c->is_connected());
+  ASSERT_EQ(pool.get_bytes_sent(), 4);
+}
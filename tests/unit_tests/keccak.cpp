@@ -29,6 +29,8 @@
 
 #include "gtest/gtest.h"
 
+#include "crypto/hash.h"
+
 extern "C" {
 #include "crypto/keccak.h"
 }
@@ -162,3 +164,67 @@ TEST(keccak, alignment)
     ASSERT_TRUE(!memcmp(md, amd, 32));
   }
 }
+
+TEST(keccak, x4)
+{
+  // lanes of different lengths, finishing on different blocks
+  static const size_t lengths[][4] = {
+    {0, 0, 0, 0}, {64, 64, 64, 64}, {0, 1, 135, 136}, {137, 272, 1000, 3}, {6000, 0, 136, 135},
+  };
+  std::vector<uint8_t> data(6000);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = i * 17;
+
+  for (const auto &length: lengths)
+  {
+    uint8_t md[4][32], md_ref[32];
+    const uint8_t *const in[4] = {data.data(), data.data() + 1, data.data() + 2, data.data() + 3};
+    uint8_t *const out[4] = {md[0], md[1], md[2], md[3]};
+    keccak_x4(in, length, out, 32);
+    for (size_t lane = 0; lane < 4; ++lane)
+    {
+      keccak(in[lane], length[lane], md_ref, 32);
+      ASSERT_EQ(memcmp(md[lane], md_ref, 32), 0);
+    }
+  }
+}
+
+TEST(keccak, cn_fast_hash_multi)
+{
+  std::vector<std::string> messages;
+  for (size_t i = 0; i < 11; ++i)
+  {
+    std::string message(i * 61, '\0');
+    for (size_t j = 0; j < message.size(); ++j)
+      message[j] = i + j * 3;
+    messages.push_back(std::move(message));
+  }
+
+  for (size_t count = 0; count <= messages.size(); ++count)
+  {
+    std::vector<const void*> data;
+    std::vector<size_t> length;
+    for (size_t i = 0; i < count; ++i)
+    {
+      data.push_back(messages[i].data());
+      length.push_back(messages[i].size());
+    }
+    std::vector<crypto::hash> hashes(count);
+    crypto::cn_fast_hash_multi(data.data(), length.data(), count, hashes.data());
+    for (size_t i = 0; i < count; ++i)
+      ASSERT_EQ(hashes[i], crypto::cn_fast_hash(messages[i].data(), messages[i].size()));
+  }
+
+  // outputs overwriting inputs, as tree_hash does
+  crypto::hash pairs[8];
+  for (size_t i = 0; i < 8; ++i)
+    pairs[i] = crypto::cn_fast_hash(&i, sizeof(i));
+  crypto::hash expected[4];
+  for (size_t i = 0; i < 4; ++i)
+    expected[i] = crypto::cn_fast_hash(&pairs[2 * i], 2 * sizeof(crypto::hash));
+  const void *data[4] = {&pairs[0], &pairs[2], &pairs[4], &pairs[6]};
+  const size_t length[4] = {64, 64, 64, 64};
+  crypto::cn_fast_hash_multi(data, length, 4, pairs);
+  for (size_t i = 0; i < 4; ++i)
+    ASSERT_EQ(pairs[i], expected[i]);
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "common/metrics.h"
+
+TEST(metrics, buckets)
+{
+  using tools::metrics::histogram;
+  for (uint64_t v: {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123456789ull, 0xffffffffffffffffull})
+  {
+    const size_t bucket = histogram::get_bucket(v);
+    ASSERT_LT(bucket, histogram::BUCKETS);
+    ASSERT_GE(histogram::get_bucket_upper_bound(bucket), v);
+    if (bucket > 0)
+    {
+      ASSERT_LT(histogram::get_bucket_upper_bound(bucket - 1), v);
+    }
+  }
+  for (size_t bucket = 1; bucket < histogram::BUCKETS; ++bucket)
+  {
+    ASSERT_GT(histogram::get_bucket_upper_bound(bucket), histogram::get_bucket_upper_bound(bucket - 1));
+    ASSERT_EQ(histogram::get_bucket(histogram::get_bucket_upper_bound(bucket)), bucket);
+  }
+}
+
+TEST(metrics, quantiles)
+{
+  tools::metrics::histogram h;
+  ASSERT_EQ(h.quantile(0.5), 0);
+  for (uint64_t v = 1; v <= 1000; ++v)
+    h.record(v * 1000);
+  ASSERT_EQ(h.count(), 1000);
+  ASSERT_EQ(h.sum(), 500500000);
+  const uint64_t p50 = h.quantile(0.5), p99 = h.quantile(0.99);
+  ASSERT_GE(p50, 500000);
+  ASSERT_LE(p50, 500000 * 9 / 8);
+  ASSERT_GE(p99, 990000);
+  ASSERT_LE(p99, 990000 * 9 / 8);
+  ASSERT_GE(h.quantile(1), 1000000);
+}
+
+TEST(metrics, concurrent_counter)
+{
+  tools::metrics::counter c;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i)
+    threads.emplace_back([&c](){ for (int n = 0; n < 10000; ++n) c.inc(); });
+  for (std::thread &t: threads)
+    t.join();
+  ASSERT_EQ(c.value(), 80000);
+}
+
+TEST(metrics, render)
+{
+  tools::metrics::get_counter("unit_test_events_total", "Events", "kind=\"a\"").inc(3);
+  tools::metrics::get_histogram("unit_test_latency_seconds", "Latency").record(2000000000);
+  tools::metrics::set_callback("unit_test_gauge", "Gauge", "", false, [](){ return 42.0; });
+  ASSERT_THROW(tools::metrics::get_counter("unit_test_gauge", "Gauge"), std::runtime_error);
+
+  const std::string s = tools::metrics::render();
+  ASSERT_NE(s.find("# TYPE unit_test_events_total counter\nunit_test_events_total{kind=\"a\"} 3\n"), std::string::npos);
+  ASSERT_NE(s.find("# TYPE unit_test_latency_seconds summary\n"), std::string::npos);
+  ASSERT_NE(s.find("unit_test_latency_seconds_count 1\n"), std::string::npos);
+  ASSERT_NE(s.find("unit_test_latency_seconds_sum 2\n"), std::string::npos);
+  ASSERT_NE(s.find("# TYPE unit_test_gauge gauge\nunit_test_gauge 42\n"), std::string::npos);
+}
@@ -184,3 +184,29 @@ TEST(output_distribution, part_noncumulative)
   ASSERT_EQ(res->distribution.size(), 5);
   ASSERT_EQ(res->distribution, std::vector<uint64_t>({0, 1, 5, 1, 4}));
 }
+
+TEST(output_distribution, tail_of_cached)
+{
+  boost::optional<cryptonote::rpc::output_distribution_data> res;
+
+  res = cryptonote::rpc::RpcHandler::get_output_distribution(::get_output_distribution, 0, 0, 31, ::get_block_hash, false, test_distribution_size);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution.size(), 32);
+
+  res = cryptonote::rpc::RpcHandler::get_output_distribution(::get_output_distribution, 0, 28, 31, ::get_block_hash, false, test_distribution_size);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->start_height, 28);
+  ASSERT_EQ(res->base, 50);
+  ASSERT_EQ(res->distribution, std::vector<uint64_t>({5, 0, 2, 3}));
+
+  res = cryptonote::rpc::RpcHandler::get_output_distribution(::get_output_distribution, 0, 28, 31, ::get_block_hash, true, test_distribution_size);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution, std::vector<uint64_t>({55, 55, 57, 60}));
+
+  // the tail requests must not have replaced the full distribution
+  res = cryptonote::rpc::RpcHandler::get_output_distribution(::get_output_distribution, 0, 0, 31, ::get_block_hash, false, test_distribution_size);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution.size(), 32);
+  for (size_t i = 0; i < 32; ++i)
+    ASSERT_EQ(res->distribution[i], test_distribution[i]);
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <thread>
+#include "gtest/gtest.h"
+#include "rpc/rpc_rate_limiter.h"
+
+TEST(rpc_rate_limiter, burst)
+{
+  cryptonote::rpc_rate_limiter limiter(1, 100, std::chrono::milliseconds(0));
+  uint64_t retry_after = 0;
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("a", 1, 150);
+  ASSERT_EQ(limiter.in_flight(), 0);
+
+  // in debt for about 50 seconds, too long to wait
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::rejected_rate);
+  ASSERT_GE(retry_after, 49);
+  ASSERT_LE(retry_after, 50);
+
+  // other clients have their own bucket
+  ASSERT_EQ(limiter.admit("b", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("b", 1, 1);
+}
+
+TEST(rpc_rate_limiter, slots)
+{
+  cryptonote::rpc_rate_limiter limiter(1000, 1000);
+  uint64_t retry_after = 0;
+  ASSERT_EQ(limiter.admit("a", 2, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  ASSERT_EQ(limiter.admit("b", 2, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  ASSERT_EQ(limiter.admit("c", 2, 1, retry_after), cryptonote::rpc_rate_limiter::rejected_busy);
+  ASSERT_EQ(limiter.in_flight(), 2);
+  limiter.release("a", 1, 1);
+  ASSERT_EQ(limiter.admit("c", 2, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("b", 1, 1);
+  limiter.release("c", 1, 1);
+  ASSERT_EQ(limiter.in_flight(), 0);
+}
+
+TEST(rpc_rate_limiter, wait)
+{
+  cryptonote::rpc_rate_limiter limiter(1000, 10, std::chrono::seconds(1));
+  uint64_t retry_after = 0;
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("a", 1, 60);
+
+  // 50 credits in debt at 1000/s: waits about 50 ms
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(40));
+  limiter.release("a", 1, 1);
+}
+
+TEST(rpc_rate_limiter, refill)
+{
+  cryptonote::rpc_rate_limiter limiter(1000, 10, std::chrono::milliseconds(0));
+  uint64_t retry_after = 0;
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("a", 1, 20);
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::rejected_rate);
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("a", 1, 1);
+}
+
+TEST(rpc_rate_limiter, client_share)
+{
+  cryptonote::rpc_rate_limiter limiter(1000, 1000);
+  uint64_t retry_after = 0;
+
+  // one client may hold half the public slots, the rest is left to others
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::rejected_busy);
+  ASSERT_EQ(limiter.admit("b", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  ASSERT_EQ(limiter.in_flight(), 3);
+  limiter.release("a", 1, 1);
+  ASSERT_EQ(limiter.admit("a", 4, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("a", 1, 1);
+  limiter.release("a", 1, 1);
+  limiter.release("b", 1, 1);
+  ASSERT_EQ(limiter.in_flight(), 0);
+
+  // a single slot is not kept from the only client
+  ASSERT_EQ(limiter.admit("a", 1, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("a", 1, 1);
+}
+
+TEST(rpc_rate_limiter, estimate)
+{
+  cryptonote::rpc_rate_limiter limiter(1, 100, std::chrono::milliseconds(0));
+  uint64_t retry_after = 0;
+
+  // the estimate is charged up front, so concurrent calls cannot share the same credits
+  ASSERT_EQ(limiter.admit("a", 8, 150, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  ASSERT_EQ(limiter.admit("a", 8, 150, retry_after), cryptonote::rpc_rate_limiter::rejected_rate);
+
+  // and reconciled with the actual cost at release
+  limiter.release("a", 150, 0);
+  ASSERT_EQ(limiter.admit("a", 8, 1, retry_after), cryptonote::rpc_rate_limiter::admitted);
+  limiter.release("a", 1, 1);
+  ASSERT_EQ(limiter.in_flight(), 0);
+}
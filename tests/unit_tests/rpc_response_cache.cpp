@@ -0,0 +1,115 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <thread>
+#include "gtest/gtest.h"
+#include "rpc/rpc_response_cache.h"
+#include "common/metrics.h"
+
+namespace
+{
+  cryptonote::rpc_response_cache::response make_response(const std::string &body)
+  {
+    return {body, "application/json", " application/json"};
+  }
+}
+
+TEST(rpc_response_cache, hit)
+{
+  cryptonote::rpc_response_cache cache;
+  tools::metrics::counter hits;
+  const std::string key = cryptonote::rpc_response_cache::make_key("/get_info", "{}");
+  cryptonote::rpc_response_cache::response res;
+  ASSERT_FALSE(cache.get(key, 0, res));
+  cache.put(key, cryptonote::rpc_response_cache::depends_on_chain, cache.generation(), 0, make_response("info"), &hits);
+  ASSERT_TRUE(cache.get(key, 0, res));
+  ASSERT_EQ(res.body, "info");
+  ASSERT_EQ(res.mime_type, "application/json");
+  ASSERT_EQ(hits.value(), 1);
+  ASSERT_FALSE(cache.get(cryptonote::rpc_response_cache::make_key("/get_info", "{ }"), 0, res));
+  ASSERT_FALSE(cache.get(cryptonote::rpc_response_cache::make_key("/getinfo", "{}"), 0, res));
+}
+
+TEST(rpc_response_cache, chain_changed)
+{
+  cryptonote::rpc_response_cache cache;
+  const std::string chain_key = cryptonote::rpc_response_cache::make_key("/json_rpc", "chain");
+  const std::string pool_key = cryptonote::rpc_response_cache::make_key("/json_rpc", "pool");
+  cache.put(chain_key, cryptonote::rpc_response_cache::depends_on_chain, cache.generation(), 0, make_response("chain"), NULL);
+  cache.put(pool_key, cryptonote::rpc_response_cache::depends_on_pool, cache.generation(), 0, make_response("pool"), NULL);
+  cache.on_chain_changed();
+  cryptonote::rpc_response_cache::response res;
+  ASSERT_FALSE(cache.get(chain_key, 0, res));
+  ASSERT_TRUE(cache.get(pool_key, 0, res));
+
+  // computed before the change, may be stale already
+  const uint64_t generation = cache.generation();
+  cache.on_chain_changed();
+  cache.put(chain_key, cryptonote::rpc_response_cache::depends_on_chain, generation, 0, make_response("chain"), NULL);
+  ASSERT_FALSE(cache.get(chain_key, 0, res));
+}
+
+TEST(rpc_response_cache, pool_changed)
+{
+  cryptonote::rpc_response_cache cache;
+  const std::string key = cryptonote::rpc_response_cache::make_key("/get_transaction_pool_hashes.bin", "");
+  cache.put(key, cryptonote::rpc_response_cache::depends_on_pool, cache.generation(), 5, make_response("pool"), NULL);
+  cryptonote::rpc_response_cache::response res;
+  ASSERT_TRUE(cache.get(key, 5, res));
+  ASSERT_FALSE(cache.get(key, 6, res));
+  ASSERT_EQ(cache.size(), 0);
+}
+
+TEST(rpc_response_cache, ttl)
+{
+  cryptonote::rpc_response_cache cache(16, 1024 * 1024, std::chrono::milliseconds(10));
+  const std::string key = cryptonote::rpc_response_cache::make_key("/json_rpc", "fee");
+  cache.put(key, cryptonote::rpc_response_cache::depends_on_chain, cache.generation(), 0, make_response("fee"), NULL);
+  cryptonote::rpc_response_cache::response res;
+  ASSERT_TRUE(cache.get(key, 0, res));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_FALSE(cache.get(key, 0, res));
+}
+
+TEST(rpc_response_cache, limits)
+{
+  cryptonote::rpc_response_cache cache(4, 1024, std::chrono::seconds(60));
+  for (int i = 0; i < 10; ++i)
+    cache.put(cryptonote::rpc_response_cache::make_key("/json_rpc", std::to_string(i)), cryptonote::rpc_response_cache::depends_on_chain, cache.generation(), 0, make_response("x"), NULL);
+  ASSERT_EQ(cache.size(), 4);
+  cryptonote::rpc_response_cache::response res;
+  ASSERT_TRUE(cache.get(cryptonote::rpc_response_cache::make_key("/json_rpc", "9"), 0, res));
+
+  // too large for the byte budget
+  cache.put(cryptonote::rpc_response_cache::make_key("/json_rpc", "big"), cryptonote::rpc_response_cache::depends_on_chain, cache.generation(), 0, make_response(std::string(1024, 'x')), NULL);
+  ASSERT_FALSE(cache.get(cryptonote::rpc_response_cache::make_key("/json_rpc", "big"), 0, res));
+
+  ASSERT_TRUE(cryptonote::rpc_response_cache::make_key("/json_rpc", std::string(64 * 1024, ' ')).empty());
+  cache.clear();
+  ASSERT_EQ(cache.size(), 0);
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <thread>
+#include "gtest/gtest.h"
+#include "common/threadpool.h"
+#include "common/util.h"
+#include "wallet/shared_block_source.h"
+
+namespace
+{
+  crypto::hash make_hash(char c)
+  {
+    crypto::hash h;
+    memset(h.data, c, sizeof(h.data));
+    return h;
+  }
+}
+
+TEST(shared_block_source, fetch_once)
+{
+  tools::shared_block_source source;
+  int fetched = 0;
+  const auto fetch = [&fetched](tools::shared_block_source::chunk &c) {
+    ++fetched;
+    c.start_height = 10;
+    c.current_height = 20;
+    c.blocks.resize(3);
+    c.error = false;
+  };
+  std::shared_ptr<const tools::shared_block_source::chunk> c0 = source.get(10, make_hash(1), false, fetch);
+  std::shared_ptr<const tools::shared_block_source::chunk> c1 = source.get(10, make_hash(1), false, fetch);
+  ASSERT_EQ(fetched, 1);
+  ASSERT_EQ(c0, c1);
+  ASSERT_EQ(c1->blocks.size(), 3);
+
+  // another top, or without miner txes, is another chunk
+  source.get(10, make_hash(2), false, fetch);
+  source.get(10, make_hash(1), true, fetch);
+  ASSERT_EQ(fetched, 3);
+  ASSERT_EQ(source.size(), 3);
+}
+
+TEST(shared_block_source, concurrent)
+{
+  tools::shared_block_source source;
+  std::atomic<int> fetched(0);
+  const auto fetch = [&fetched](tools::shared_block_source::chunk &c) {
+    ++fetched;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    c.blocks.resize(1);
+  };
+  std::vector<std::thread> threads;
+  std::atomic<int> got(0);
+  for (int i = 0; i < 8; ++i)
+    threads.emplace_back([&](){ if (source.get(5, make_hash(1), false, fetch)->blocks.size() == 1) ++got; });
+  for (auto &t: threads)
+    t.join();
+  ASSERT_EQ(fetched, 1);
+  ASSERT_EQ(got, 8);
+}
+
+TEST(shared_block_source, failure)
+{
+  tools::shared_block_source source;
+  ASSERT_THROW(source.get(5, make_hash(1), false, [](tools::shared_block_source::chunk &c) { throw std::runtime_error("no daemon"); }), std::runtime_error);
+  ASSERT_EQ(source.size(), 0);
+  int fetched = 0;
+  source.get(5, make_hash(1), false, [&fetched](tools::shared_block_source::chunk &c) { ++fetched; });
+  ASSERT_EQ(fetched, 1);
+}
+
+TEST(shared_block_source, expiry)
+{
+  tools::shared_block_source source(2, std::chrono::seconds(0));
+  int fetched = 0;
+  const auto fetch = [&fetched](tools::shared_block_source::chunk &c) { ++fetched; };
+  source.get(5, make_hash(1), false, fetch);
+  source.get(5, make_hash(1), false, fetch);
+  ASSERT_EQ(fetched, 2);
+
+  tools::shared_block_source small(2, std::chrono::seconds(60));
+  for (char i = 0; i < 4; ++i)
+    small.get(5, make_hash(i), false, fetch);
+  small.get(6, make_hash(0), false, fetch);
+  ASSERT_LE(small.size(), 3);
+}
+
+TEST(shared_block_source, more_wallets_than_threads)
+{
+  // each wallet's refresh runs on the pool and parses its chunk there, waiting
+  // for parse jobs runs other wallets' refreshes on the fetching thread
+  tools::shared_block_source source;
+  tools::threadpool &tpool = tools::threadpool::getInstanceForCompute();
+  const size_t n_wallets = 4 * std::max<unsigned>(tools::get_max_concurrency(), 1) + 1;
+  std::atomic<size_t> got(0);
+  const auto fetch = [&tpool](tools::shared_block_source::chunk &c) {
+    tools::threadpool::waiter waiter(tpool);
+    for (int i = 0; i < 4; ++i)
+      tpool.submit(&waiter, [](){ std::this_thread::sleep_for(std::chrono::milliseconds(5)); }, true);
+    ASSERT_TRUE(waiter.wait());
+    c.blocks.resize(1);
+  };
+  tools::threadpool::waiter waiter(tpool);
+  for (size_t i = 0; i < n_wallets; ++i)
+    tpool.submit(&waiter, [&](){ if (source.get(5, make_hash(1), false, fetch)->blocks.size() == 1) ++got; });
+  ASSERT_TRUE(waiter.wait());
+  ASSERT_EQ(got, n_wallets);
+}
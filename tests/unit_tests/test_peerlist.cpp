@@ -72,6 +72,38 @@ TEST(peer_list, peer_list_general)
 }
 
 
+TEST(peer_list, latest_by_index)
+{
+  nodetool::peerlist_manager plm;
+  plm.init(nodetool::peerlist_types{}, false);
+
+  for (uint32_t i = 0; i < 200; ++i)
+  {
+    nodetool::peerlist_entry ple;
+    ple.adr = epee::net_utils::ipv4_network_address{MAKE_IP(123,43,i / 100,i % 100 + 1), 18080};
+    ple.id = i;
+    ple.last_seen = 1000 + (i * 7919) % 200;
+    plm.append_with_peer_gray(ple);
+  }
+  ASSERT_EQ(plm.get_gray_peers_count(), 200);
+
+  nodetool::peerlist_entry pe;
+  for (size_t i = 0; i < 200; ++i)
+  {
+    ASSERT_TRUE(plm.get_gray_peer_by_index(pe, i));
+    ASSERT_EQ(pe.last_seen, 1000 + 199 - i);
+  }
+  ASSERT_FALSE(plm.get_gray_peer_by_index(pe, 200));
+  ASSERT_FALSE(plm.get_white_peer_by_index(pe, 0));
+
+  for (size_t i = 0; i < 100; ++i)
+  {
+    ASSERT_TRUE(plm.get_random_gray_peer(pe));
+    ASSERT_TRUE(plm.remove_from_peer_gray(pe));
+  }
+  ASSERT_EQ(plm.get_gray_peers_count(), 100);
+}
+
 TEST(peer_list, merge_peer_lists)
 {
   //([^ \t]*)\t([^ \t]*):([^ \t]*) \tlast_seen: d(\d+)\.h(\d+)\.m(\d+)\.s(\d+)\n
@@ -254,3 +286,71 @@ TEST(peerlist_storage, store)
   EXPECT_EQ(24u, types.anchor[1].id);
   EXPECT_EQ(22u, types.anchor[1].first_seen);
 }
+
+TEST(peerlist_storage, binary_format)
+{
+  using address_type = epee::net_utils::address_type;
+  using zone = epee::net_utils::zone;
+
+  boost::asio::ip::address_v6::bytes_type ipv6_bytes{};
+  ipv6_bytes[0] = 0x20;
+  ipv6_bytes[15] = 0x01;
+  const epee::net_utils::ipv6_network_address ipv6{boost::asio::ip::address_v6{ipv6_bytes}, 18080};
+
+  nodetool::peerlist_types types{};
+  nodetool::peerlist_entry white{epee::net_utils::ipv4_network_address{1000, 10}, 0xfedcba9876543210, 1600000000};
+  white.pruning_seed = 385;
+  white.rpc_port = 18089;
+  white.rpc_credits_per_hash = 100;
+  types.white.push_back(white);
+  types.gray.push_back({ipv6, 84, -1});
+  types.gray.push_back({net::i2p_address::unknown(), 99, 88});
+  types.anchor.push_back({net::tor_address::unknown(), 14, 33});
+
+  std::string buffer{};
+  {
+    nodetool::peerlist_storage peers{};
+    std::ostringstream stream{};
+    EXPECT_TRUE(peers.store(stream, types));
+    buffer = stream.str();
+  }
+  ASSERT_EQ(0, buffer.compare(0, 8, "p2pstate"));
+
+  {
+    std::istringstream stream{buffer};
+    boost::optional<nodetool::peerlist_storage> read_peers = nodetool::peerlist_storage::open(stream, true);
+    ASSERT_TRUE(bool(read_peers));
+
+    nodetool::peerlist_types read = read_peers->take_zone(zone::public_);
+    ASSERT_EQ(1u, read.white.size());
+    EXPECT_EQ(address_type::ipv4, read.white[0].adr.get_type_id());
+    EXPECT_EQ(types.white[0].adr, read.white[0].adr);
+    EXPECT_EQ(0xfedcba9876543210, read.white[0].id);
+    EXPECT_EQ(1600000000, read.white[0].last_seen);
+    EXPECT_EQ(385u, read.white[0].pruning_seed);
+    EXPECT_EQ(18089u, read.white[0].rpc_port);
+    EXPECT_EQ(100u, read.white[0].rpc_credits_per_hash);
+    ASSERT_EQ(1u, read.gray.size());
+    EXPECT_EQ(address_type::ipv6, read.gray[0].adr.get_type_id());
+    EXPECT_EQ(epee::net_utils::network_address{ipv6}, read.gray[0].adr);
+    EXPECT_EQ(-1, read.gray[0].last_seen);
+
+    read = read_peers->take_zone(zone::i2p);
+    ASSERT_EQ(1u, read.gray.size());
+    EXPECT_STREQ(net::i2p_address::unknown_str(), read.gray[0].adr.template as<net::i2p_address>().host_str());
+    EXPECT_EQ(99u, read.gray[0].id);
+
+    read = read_peers->take_zone(zone::tor);
+    ASSERT_EQ(1u, read.anchor.size());
+    EXPECT_STREQ(net::tor_address::unknown_str(), read.anchor[0].adr.template as<net::tor_address>().host_str());
+    EXPECT_EQ(14u, read.anchor[0].id);
+    EXPECT_EQ(33u, read.anchor[0].first_seen);
+  }
+
+  // truncated or trailing data is rejected
+  for (const std::string bad: {buffer.substr(0, buffer.size() - 1), buffer + '\0'})
+  {
+    std::istringstream stream{bad};
+    EXPECT_FALSE(bool(nodetool::peerlist_storage::open(stream, true)));
+  }
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <thread>
+#include "gtest/gtest.h"
+#include "common/trace.h"
+
+namespace
+{
+  size_t count(const std::string &s, const std::string &what)
+  {
+    size_t n = 0;
+    for (size_t pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1))
+      ++n;
+    return n;
+  }
+
+  struct trace_enabler
+  {
+    trace_enabler(bool enable) { tools::trace::clear(); tools::trace::set_enabled(enable); }
+    ~trace_enabler() { tools::trace::set_enabled(false); tools::trace::clear(); }
+  };
+}
+
+TEST(trace, disabled)
+{
+  trace_enabler enabler(false);
+  {
+    TRACE_SPAN(unit_test_disabled);
+  }
+  ASSERT_EQ(count(tools::trace::dump_chrome_trace(), "unit_test_disabled"), 0);
+}
+
+TEST(trace, spans)
+{
+  trace_enabler enabler(true);
+  {
+    TRACE_SPAN_ARG(unit_test_outer, 42);
+    TRACE_SPAN(unit_test_inner);
+    TRACE_SPAN_STOP(unit_test_inner);
+    std::thread([](){ TRACE_SPAN(unit_test_other_thread); }).join();
+  }
+  const std::string s = tools::trace::dump_chrome_trace();
+  ASSERT_EQ(count(s, "\"name\":\"unit_test_outer\",\"ph\":\"X\""), 1);
+  ASSERT_EQ(count(s, "\"name\":\"unit_test_inner\""), 1);
+  ASSERT_EQ(count(s, "\"name\":\"unit_test_other_thread\""), 1);
+  ASSERT_EQ(count(s, "\"args\":{\"arg\":42}"), 1);
+  ASSERT_EQ(s.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0);
+
+  tools::trace::clear();
+  ASSERT_EQ(count(tools::trace::dump_chrome_trace(), "unit_test_outer"), 0);
+}
+
+TEST(trace, wraps)
+{
+  trace_enabler enabler(true);
+  for (size_t n = 0; n < tools::trace::SPANS_PER_THREAD + 10; ++n)
+  {
+    TRACE_SPAN(unit_test_wrap);
+  }
+  ASSERT_EQ(count(tools::trace::dump_chrome_trace(), "unit_test_wrap"), tools::trace::SPANS_PER_THREAD);
+}
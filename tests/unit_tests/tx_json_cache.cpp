@@ -0,0 +1,72 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "rpc/tx_json_cache.h"
+
+TEST(tx_json_cache, get_put)
+{
+  cryptonote::tx_json_cache cache;
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  std::string json;
+  ASSERT_FALSE(cache.get(txid, false, json));
+  cache.put(txid, false, "full");
+  cache.put(txid, true, "pruned");
+  ASSERT_TRUE(cache.get(txid, false, json));
+  ASSERT_EQ(json, "full");
+  ASSERT_TRUE(cache.get(txid, true, json));
+  ASSERT_EQ(json, "pruned");
+  ASSERT_FALSE(cache.get(crypto::rand<crypto::hash>(), false, json));
+}
+
+TEST(tx_json_cache, lru)
+{
+  cryptonote::tx_json_cache cache(16 * 100);
+  std::vector<crypto::hash> txids;
+  for (int i = 0; i < 16; ++i)
+  {
+    txids.push_back(crypto::rand<crypto::hash>());
+    cache.put(txids.back(), false, std::string(100, 'x'));
+  }
+  ASSERT_EQ(cache.size(), 16);
+
+  // the oldest one was used recently, the second oldest goes first
+  std::string json;
+  ASSERT_TRUE(cache.get(txids[0], false, json));
+  cache.put(crypto::rand<crypto::hash>(), false, std::string(100, 'x'));
+  ASSERT_EQ(cache.size(), 16);
+  ASSERT_TRUE(cache.get(txids[0], false, json));
+  ASSERT_FALSE(cache.get(txids[1], false, json));
+  ASSERT_TRUE(cache.get(txids[2], false, json));
+
+  // too large to be worth the space
+  const crypto::hash large = crypto::rand<crypto::hash>();
+  cache.put(large, false, std::string(1000, 'x'));
+  ASSERT_FALSE(cache.get(large, false, json));
+}
@@ -0,0 +1,203 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "misc_log_ex.h"
+#include "cryptonote_protocol/txpool_sketch.h"
+
+namespace
+{
+  // deterministic, so a rare decoding failure can't make the tests flaky
+  std::vector<crypto::hash> make_hashes(size_t n)
+  {
+    static uint64_t counter = 0;
+    std::vector<crypto::hash> hashes(n);
+    for (auto &h: hashes)
+    {
+      ++counter;
+      h = crypto::cn_fast_hash(&counter, sizeof(counter));
+    }
+    return hashes;
+  }
+
+  std::string make_sketch(const std::vector<crypto::hash> &hashes, size_t cells, uint64_t salt)
+  {
+    cryptonote::txpool_sketch sketch(cells, salt);
+    for (const auto &h: hashes)
+      sketch.toggle(sketch.get_short_id(h));
+    return sketch.serialize();
+  }
+
+  // decodes from the point of view of the peer owning `ours`
+  bool reconcile(const std::vector<crypto::hash> &ours, const std::string &theirs, size_t cells, uint64_t salt,
+      std::vector<crypto::hash> &they_lack, size_t &we_lack)
+  {
+    cryptonote::txpool_sketch sketch(cells, salt);
+    std::unordered_map<uint64_t, crypto::hash> by_short_id;
+    for (const auto &h: ours)
+    {
+      const uint64_t id = sketch.get_short_id(h);
+      by_short_id.emplace(id, h);
+      sketch.toggle(id);
+    }
+    std::vector<uint64_t> diff;
+    if (!sketch.subtract(theirs) || !sketch.decode(diff))
+      return false;
+    we_lack = 0;
+    for (const uint64_t id: diff)
+    {
+      const auto i = by_short_id.find(id);
+      if (i == by_short_id.end())
+        ++we_lack;
+      else
+        they_lack.push_back(i->second);
+    }
+    return true;
+  }
+}
+
+TEST(txpool_sketch, cell_count)
+{
+  for (size_t d: {0, 1, 2, 10, 100, 1000, 10000})
+  {
+    const size_t cells = cryptonote::txpool_sketch::get_cell_count(d);
+    ASSERT_EQ(cells % 4, 0);
+    ASSERT_GT(cells, d);
+  }
+  ASSERT_THROW(cryptonote::txpool_sketch(0, 0), std::invalid_argument);
+  ASSERT_THROW(cryptonote::txpool_sketch(10, 0), std::invalid_argument);
+}
+
+TEST(txpool_sketch, same_sets)
+{
+  const std::vector<crypto::hash> pool = make_hashes(1000);
+  const size_t cells = cryptonote::txpool_sketch::get_cell_count(10);
+  std::vector<crypto::hash> they_lack;
+  size_t we_lack = 1;
+  ASSERT_TRUE(reconcile(pool, make_sketch(pool, cells, 5), cells, 5, they_lack, we_lack));
+  ASSERT_TRUE(they_lack.empty());
+  ASSERT_EQ(we_lack, 0);
+}
+
+TEST(txpool_sketch, symmetric_difference)
+{
+  for (size_t d: {1, 5, 20, 100, 1000})
+  {
+    const std::vector<crypto::hash> common = make_hashes(2000);
+    const std::vector<crypto::hash> only_ours = make_hashes(d / 2 + 1), only_theirs = make_hashes(d - d / 2);
+    std::vector<crypto::hash> ours = common, theirs = common;
+    ours.insert(ours.end(), only_ours.begin(), only_ours.end());
+    theirs.insert(theirs.end(), only_theirs.begin(), only_theirs.end());
+    std::reverse(theirs.begin(), theirs.end());
+
+    const size_t cells = cryptonote::txpool_sketch::get_cell_count(d + 1);
+    std::vector<crypto::hash> they_lack;
+    size_t we_lack = 0;
+    ASSERT_TRUE(reconcile(ours, make_sketch(theirs, cells, d), cells, d, they_lack, we_lack));
+    ASSERT_EQ(we_lack, only_theirs.size());
+    ASSERT_EQ(they_lack.size(), only_ours.size());
+    ASSERT_EQ(std::unordered_set<crypto::hash>(they_lack.begin(), they_lack.end()), std::unordered_set<crypto::hash>(only_ours.begin(), only_ours.end()));
+  }
+}
+
+TEST(txpool_sketch, too_large)
+{
+  const std::vector<crypto::hash> ours = make_hashes(500), theirs = make_hashes(500);
+  const size_t cells = cryptonote::txpool_sketch::get_cell_count(50);
+  std::vector<crypto::hash> they_lack;
+  size_t we_lack;
+  ASSERT_FALSE(reconcile(ours, make_sketch(theirs, cells, 0), cells, 0, they_lack, we_lack));
+}
+
+TEST(txpool_sketch, bad_size)
+{
+  cryptonote::txpool_sketch sketch(32, 0);
+  ASSERT_FALSE(sketch.subtract(std::string(28 * cryptonote::txpool_sketch::CELL_SIZE, '\0')));
+  ASSERT_FALSE(sketch.subtract(std::string(32 * cryptonote::txpool_sketch::CELL_SIZE + 1, '\0')));
+  ASSERT_TRUE(sketch.subtract(std::string(32 * cryptonote::txpool_sketch::CELL_SIZE, '\0')));
+}
+
+TEST(txpool_sketch, simulation)
+{
+  // a node restarts while its peers keep a 20k tx pool, each of them missing a
+  // few txes the others have, then syncs its pool with every peer in turn, once
+  // sending its whole list of tx hashes, and once a sketch per peer, retrying
+  // with a larger one when the difference can't be decoded, like the protocol does
+  static const size_t pool_size = 20000;
+  static const size_t ours_size = pool_size - pool_size / 20;
+  static const size_t missing_per_peer = 20;
+
+  for (size_t npeers: {12, 100})
+  {
+    const std::vector<crypto::hash> pool = make_hashes(pool_size);
+    std::vector<crypto::hash> ours(pool.begin(), pool.begin() + ours_size);
+    uint64_t complement_bytes = 0, sketch_bytes = 0;
+    size_t relayed = 0;
+    for (size_t p = 0; p < npeers; ++p)
+    {
+      std::vector<crypto::hash> theirs = pool;
+      for (size_t i = 0; i < missing_per_peer; ++i)
+        theirs.erase(theirs.begin() + (p * 7919 + i * 104729) % theirs.size());
+
+      complement_bytes += ours.size() * sizeof(crypto::hash);
+
+      size_t difference = std::max<size_t>(16, ours.size() / 32);
+      std::vector<crypto::hash> they_lack;
+      size_t we_lack = 0;
+      while (true)
+      {
+        const size_t cells = cryptonote::txpool_sketch::get_cell_count(difference);
+        if (cells * cryptonote::txpool_sketch::CELL_SIZE >= ours.size() * sizeof(crypto::hash))
+        {
+          sketch_bytes += ours.size() * sizeof(crypto::hash);
+          break;
+        }
+        const uint64_t salt = p;
+        sketch_bytes += cells * cryptonote::txpool_sketch::CELL_SIZE + 16;
+        they_lack.clear();
+        if (reconcile(theirs, make_sketch(ours, cells, salt), cells, salt, they_lack, we_lack))
+          break;
+        sketch_bytes += 8;
+        difference = std::max(difference * 4, 2 * (theirs.size() > ours.size() ? theirs.size() - ours.size() : ours.size() - theirs.size()));
+      }
+
+      // the peer sends us what we lack, and we learn those txes
+      relayed += they_lack.size();
+      for (const auto &h: they_lack)
+        ours.push_back(h);
+    }
+    ASSERT_EQ(relayed, pool_size - ours_size);
+    MDEBUG(npeers << " peers: " << complement_bytes / (float)relayed << " bytes per tx relayed with full hash lists, "
+        << sketch_bytes / (float)relayed << " with sketches");
+    ASSERT_LT(sketch_bytes * 10, complement_bytes);
+  }
+}
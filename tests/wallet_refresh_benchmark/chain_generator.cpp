@@ -0,0 +1,357 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+#include "misc_log_ex.h"
+#include "crypto/crypto-ops.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "ringct/rctOps.h"
+#include "serialization/binary_archive.h"
+#include "chain_generator.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "wallet_bench"
+
+using namespace cryptonote;
+
+namespace
+{
+  const uint64_t BLOCK_REWARD = 1000000000000;
+  const uint64_t TX_FEE = 30000000;
+  const uint64_t MIN_AMOUNT = 1000000;
+  const uint64_t MAX_AMOUNT = 100000000000;
+  // keys, commitments and tx public keys of outputs the wallet does not own
+  // are drawn from this many random points
+  const size_t NUM_RANDOM_POINTS = 4096;
+
+  // A wallet output which has not been spent yet
+  struct owned_output
+  {
+    crypto::key_image key_image;
+    uint64_t amount;
+  };
+
+  class chain_builder
+  {
+  public:
+    chain_builder(const wallet_refresh_benchmark::chain_options &options, const tools::wallet2 &wallet, wallet_refresh_benchmark::synthetic_chain &chain);
+    bool build();
+
+  private:
+    uint64_t random(uint64_t n) { return m_rng() % n; }
+    bool percent(unsigned p) { return random(100) < p; }
+    template<typename T> T random_pod();
+    rct::key random_scalar();
+    const rct::key &random_point() { return m_random_points[random(m_random_points.size())]; }
+
+    const std::pair<subaddress_index, account_public_address> &pick_address();
+    bool make_miner_tx(uint64_t height, transaction &tx, std::vector<uint64_t> &indices);
+    bool make_tx(transaction &tx, std::vector<uint64_t> &indices, std::vector<owned_output> &received);
+    void add_block(const block &b, block_complete_entry &&entry, COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices &&indices);
+
+    const wallet_refresh_benchmark::chain_options &m_options;
+    const account_keys &m_keys;
+    wallet_refresh_benchmark::synthetic_chain &m_chain;
+    const network_type m_nettype;
+    std::mt19937_64 m_rng;
+    std::vector<rct::key> m_random_points;
+    std::vector<std::pair<subaddress_index, account_public_address>> m_addresses;
+    std::vector<owned_output> m_unspent;
+    uint64_t m_num_outputs;
+    crypto::hash m_top_hash;
+  };
+
+  chain_builder::chain_builder(const wallet_refresh_benchmark::chain_options &options, const tools::wallet2 &wallet, wallet_refresh_benchmark::synthetic_chain &chain):
+    m_options(options),
+    m_keys(wallet.get_account().get_keys()),
+    m_chain(chain),
+    m_nettype(wallet.nettype()),
+    m_rng(options.seed),
+    m_num_outputs(0),
+    m_top_hash(crypto::null_hash)
+  {
+    m_random_points.reserve(NUM_RANDOM_POINTS);
+    for (size_t i = 0; i < NUM_RANDOM_POINTS; ++i)
+      m_random_points.push_back(rct::scalarmultBase(random_scalar()));
+
+    // the main address first, then the subaddress table the wallet starts with
+    for (uint32_t major = 0; major < options.accounts; ++major)
+    {
+      for (uint32_t minor = 0; minor < options.subaddresses; ++minor)
+      {
+        const subaddress_index index{major, minor};
+        m_addresses.push_back(std::make_pair(index, wallet.get_subaddress(index)));
+      }
+    }
+  }
+
+  template<typename T>
+  T chain_builder::random_pod()
+  {
+    T t;
+    for (size_t i = 0; i < sizeof(T); i += sizeof(uint64_t))
+    {
+      const uint64_t r = m_rng();
+      memcpy(reinterpret_cast<char*>(&t) + i, &r, std::min(sizeof(r), sizeof(T) - i));
+    }
+    return t;
+  }
+
+  rct::key chain_builder::random_scalar()
+  {
+    rct::key k = random_pod<rct::key>();
+    sc_reduce32(k.bytes);
+    return k;
+  }
+
+  const std::pair<subaddress_index, account_public_address> &chain_builder::pick_address()
+  {
+    if (m_addresses.size() > 1 && percent(m_options.subaddress_percent))
+      return m_addresses[1 + random(m_addresses.size() - 1)];
+    return m_addresses[0];
+  }
+
+  bool chain_builder::make_miner_tx(uint64_t height, transaction &tx, std::vector<uint64_t> &indices)
+  {
+    tx.version = 2;
+    tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+    txin_gen in;
+    in.height = height;
+    tx.vin.push_back(in);
+    tx.vout.emplace_back();
+    set_tx_out(BLOCK_REWARD, rct::rct2pk(random_point()), true, random_pod<crypto::view_tag>(), tx.vout.back());
+    CHECK_AND_ASSERT_MES(add_tx_pub_key_to_extra(tx, rct::rct2pk(random_point())), false, "Failed to add tx pubkey to extra");
+    tx.rct_signatures.type = rct::RCTTypeNull;
+    indices.push_back(m_num_outputs++);
+    return true;
+  }
+
+  bool chain_builder::make_tx(transaction &tx, std::vector<uint64_t> &indices, std::vector<owned_output> &received)
+  {
+    tx.version = 2;
+    tx.unlock_time = 0;
+
+    // the first input may spend a wallet output, the others are never the wallet's
+    const bool spends = !m_unspent.empty() && percent(m_options.spend_percent);
+    for (size_t i = 0; i < m_options.inputs_per_tx; ++i)
+    {
+      txin_to_key in;
+      in.amount = 0;
+      in.key_offsets.push_back(random(std::max<uint64_t>(m_num_outputs, 1)));
+      for (size_t n = 1; n < m_options.ring_size; ++n)
+        in.key_offsets.push_back(1 + random(64));
+      if (i == 0 && spends)
+      {
+        const size_t n = random(m_unspent.size());
+        in.k_image = m_unspent[n].key_image;
+        m_chain.expected_balance -= m_unspent[n].amount;
+        ++m_chain.expected_spent;
+        m_unspent[n] = m_unspent.back();
+        m_unspent.pop_back();
+      }
+      else
+      {
+        in.k_image = random_pod<crypto::key_image>();
+      }
+      tx.vin.push_back(in);
+    }
+
+    // as in construct_tx, paying a subaddress needs one tx public key per output
+    const bool owned = percent(m_options.owned_percent);
+    const size_t owned_index = owned ? random(m_options.outputs_per_tx) : m_options.outputs_per_tx;
+    const std::pair<subaddress_index, account_public_address> *dest = owned ? &pick_address() : NULL;
+    const bool use_additional_tx_keys = dest && !dest->first.is_zero();
+    const rct::key tx_key = random_scalar();
+    std::vector<crypto::public_key> additional_tx_public_keys;
+    hw::device &hwdev = m_keys.get_device();
+
+    tx.rct_signatures.type = rct::RCTTypeBulletproofPlus;
+    tx.rct_signatures.txnFee = TX_FEE;
+    for (size_t k = 0; k < m_options.outputs_per_tx; ++k)
+    {
+      crypto::public_key out_key;
+      crypto::view_tag view_tag;
+      rct::ecdhTuple ecdh_info;
+      rct::ctkey out_pk;
+      if (k != owned_index)
+      {
+        out_key = rct::rct2pk(random_point());
+        view_tag = random_pod<crypto::view_tag>();
+        ecdh_info.mask = rct::zero();
+        ecdh_info.amount = random_pod<rct::key>();
+        out_pk.mask = random_point();
+        if (use_additional_tx_keys)
+          additional_tx_public_keys.push_back(rct::rct2pk(random_point()));
+      }
+      else
+      {
+        crypto::key_derivation derivation;
+        bool r;
+        if (use_additional_tx_keys)
+        {
+          const rct::key additional_tx_key = random_scalar();
+          additional_tx_public_keys.push_back(rct::rct2pk(rct::scalarmultKey(rct::pk2rct(dest->second.m_spend_public_key), additional_tx_key)));
+          r = crypto::generate_key_derivation(dest->second.m_view_public_key, rct::rct2sk(additional_tx_key), derivation);
+        }
+        else
+        {
+          r = crypto::generate_key_derivation(dest->second.m_view_public_key, rct::rct2sk(tx_key), derivation);
+        }
+        CHECK_AND_ASSERT_MES(r, false, "Failed to generate key derivation");
+        r = crypto::derive_public_key(derivation, k, dest->second.m_spend_public_key, out_key);
+        CHECK_AND_ASSERT_MES(r, false, "Failed to derive output key");
+        crypto::derive_view_tag(derivation, k, view_tag);
+
+        const uint64_t amount = MIN_AMOUNT + random(MAX_AMOUNT - MIN_AMOUNT);
+        crypto::secret_key scalar;
+        hwdev.derivation_to_scalar(derivation, k, scalar);
+        const rct::key amount_key = rct::sk2rct(scalar);
+        ecdh_info.mask = rct::zero();
+        ecdh_info.amount = rct::d2h(amount);
+        rct::ecdhEncode(ecdh_info, amount_key, true);
+        out_pk.mask = rct::scalarmultKey(rct::commit(amount, rct::genCommitmentMask(amount_key)), rct::INV_EIGHT);
+
+        owned_output output;
+        keypair in_ephemeral;
+        r = generate_key_image_helper_precomp(m_keys, out_key, derivation, k, dest->first, in_ephemeral, output.key_image, hwdev);
+        CHECK_AND_ASSERT_MES(r, false, "Failed to generate key image");
+        output.amount = amount;
+        received.push_back(output);
+      }
+      out_pk.dest = rct::pk2rct(out_key);
+      tx.vout.emplace_back();
+      set_tx_out(0, out_key, true, view_tag, tx.vout.back());
+      tx.rct_signatures.ecdhInfo.push_back(ecdh_info);
+      tx.rct_signatures.outPk.push_back(out_pk);
+      indices.push_back(m_num_outputs++);
+    }
+
+    CHECK_AND_ASSERT_MES(add_tx_pub_key_to_extra(tx, rct::rct2pk(rct::scalarmultBase(tx_key))), false, "Failed to add tx pubkey to extra");
+    if (!additional_tx_public_keys.empty())
+      CHECK_AND_ASSERT_MES(add_additional_tx_pub_keys_to_extra(tx.extra, additional_tx_public_keys), false, "Failed to add additional tx pubkeys to extra");
+    return true;
+  }
+
+  void chain_builder::add_block(const block &b, block_complete_entry &&entry, COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices &&indices)
+  {
+    m_top_hash = get_block_hash(b);
+    m_chain.heights[m_top_hash] = m_chain.blocks.size();
+    m_chain.num_txs += entry.txs.size();
+    m_chain.blocks.push_back(std::move(entry));
+    m_chain.output_indices.push_back(std::move(indices));
+  }
+
+  bool chain_builder::build()
+  {
+    // the wallet checks the genesis block against its own
+    block genesis;
+    CHECK_AND_ASSERT_MES(generate_genesis_block(genesis, get_config(m_nettype).GENESIS_TX, get_config(m_nettype).GENESIS_NONCE), false, "Failed to generate genesis block");
+    {
+      block_complete_entry entry;
+      entry.pruned = true;
+      entry.block = block_to_blob(genesis);
+      COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices indices;
+      indices.indices.emplace_back();
+      indices.indices.back().indices.resize(genesis.miner_tx.vout.size(), 0);
+      add_block(genesis, std::move(entry), std::move(indices));
+    }
+
+    const uint64_t start_time = time(NULL) - m_options.blocks * DIFFICULTY_TARGET_V2;
+    for (uint64_t height = 1; height < m_options.blocks; ++height)
+    {
+      block b;
+      b.major_version = HF_VERSION_VIEW_TAGS;
+      b.minor_version = HF_VERSION_VIEW_TAGS;
+      b.timestamp = start_time + height * DIFFICULTY_TARGET_V2;
+      b.prev_id = m_top_hash;
+      b.nonce = 0;
+
+      block_complete_entry entry;
+      entry.pruned = true;
+      COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices indices;
+      indices.indices.emplace_back();
+      if (!make_miner_tx(height, b.miner_tx, indices.indices.back().indices))
+        return false;
+
+      // outputs received in this block can only be spent in later ones
+      std::vector<owned_output> received;
+      for (size_t n = 0; n < m_options.txs_per_block; ++n)
+      {
+        transaction tx;
+        indices.indices.emplace_back();
+        if (!make_tx(tx, indices.indices.back().indices, received))
+          return false;
+
+        std::stringstream ss;
+        binary_archive<true> ba(ss);
+        CHECK_AND_ASSERT_MES(tx.serialize_base(ba), false, "Failed to serialize pruned tx");
+        const crypto::hash prunable_hash = random_pod<crypto::hash>();
+        b.tx_hashes.push_back(get_pruned_transaction_hash(tx, prunable_hash));
+        entry.txs.emplace_back(ss.str(), prunable_hash);
+        entry.block_weight += entry.txs.back().blob.size();
+      }
+      entry.block = block_to_blob(b);
+      entry.block_weight += entry.block.size();
+      add_block(b, std::move(entry), std::move(indices));
+
+      for (const owned_output &output: received)
+      {
+        m_unspent.push_back(output);
+        m_chain.expected_balance += output.amount;
+      }
+      m_chain.expected_transfers += received.size();
+
+      if (height % 10000 == 0)
+        MINFO("Generated " << height << "/" << m_options.blocks << " blocks");
+    }
+    return true;
+  }
+}
+
+namespace wallet_refresh_benchmark
+{
+  bool generate_chain(const chain_options &options, const tools::wallet2 &wallet, synthetic_chain &chain)
+  {
+    CHECK_AND_ASSERT_MES(options.blocks > 0, false, "The chain needs at least the genesis block");
+    CHECK_AND_ASSERT_MES(options.inputs_per_tx > 0, false, "Transactions need at least one input");
+    CHECK_AND_ASSERT_MES(options.outputs_per_tx > 0 && options.outputs_per_tx <= BULLETPROOF_PLUS_MAX_OUTPUTS, false,
+        "Transactions need between 1 and " << BULLETPROOF_PLUS_MAX_OUTPUTS << " outputs");
+    CHECK_AND_ASSERT_MES(options.ring_size > 0, false, "Ring size must be at least 1");
+    CHECK_AND_ASSERT_MES(options.owned_percent <= 100 && options.subaddress_percent <= 100 && options.spend_percent <= 100, false,
+        "Percentages must be between 0 and 100");
+    CHECK_AND_ASSERT_MES(options.accounts > 0 && options.subaddresses > 0, false, "The subaddress table must not be empty");
+
+    chain = synthetic_chain();
+    chain_builder builder(options, wallet, chain);
+    return builder.build();
+  }
+}
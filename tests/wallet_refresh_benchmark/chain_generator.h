@@ -0,0 +1,78 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "wallet/wallet2.h"
+
+namespace wallet_refresh_benchmark
+{
+  //! Shape of a synthetic chain. The same seed gives the same shape.
+  struct chain_options
+  {
+    uint64_t blocks;
+    size_t txs_per_block;
+    size_t inputs_per_tx;
+    size_t outputs_per_tx;
+    size_t ring_size;
+    unsigned owned_percent;      //!< txs paying one output to the wallet
+    unsigned subaddress_percent; //!< of those, the ones paying a subaddress
+    unsigned spend_percent;      //!< txs spending an earlier wallet output
+    uint32_t accounts;           //!< subaddress table the payments are spread over
+    uint32_t subaddresses;
+    uint64_t seed;
+  };
+
+  //! A chain as /getblocks.bin hands it out to a wallet: pruned transactions
+  //! and the global index of every output
+  struct synthetic_chain
+  {
+    std::vector<cryptonote::block_complete_entry> blocks;
+    std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> output_indices;
+    std::unordered_map<crypto::hash, uint64_t> heights;
+    uint64_t num_txs = 0;
+
+    // what the wallet should find once it has scanned the whole chain
+    uint64_t expected_transfers = 0;
+    uint64_t expected_spent = 0;
+    uint64_t expected_balance = 0;
+  };
+
+  /*! Builds a chain whose transactions pay the given wallet's address and
+      subaddresses among unrelated outputs, with view tags, and additional tx
+      public keys where a subaddress is paid. Transactions carry no proofs, as
+      a wallet never sees the prunable data.
+
+      \return false if the options cannot give a valid chain */
+  bool generate_chain(const chain_options &options, const tools::wallet2 &wallet, synthetic_chain &chain);
+}
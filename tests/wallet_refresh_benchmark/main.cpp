@@ -0,0 +1,319 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <iomanip>
+#include <iostream>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "misc_log_ex.h"
+#include "string_tools.h"
+#include "common/command_line.h"
+#include "common/util.h"
+#include "ringct/rctOps.h"
+#include "wallet/wallet2.h"
+#include "profile_tools.h"
+#include "chain_generator.h"
+#include "stand_in_daemon.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "wallet_bench"
+
+namespace po = boost::program_options;
+
+namespace
+{
+  const command_line::arg_descriptor<uint64_t>    arg_blocks             = {"blocks", "Number of blocks in the chain, including genesis", 1000};
+  const command_line::arg_descriptor<uint64_t>    arg_transfers          = {"transfers", "Size the chain so the wallet receives about this many outputs, overrides --blocks", 0};
+  const command_line::arg_descriptor<size_t>      arg_txs_per_block      = {"txs-per-block", "Transactions per block", 20};
+  const command_line::arg_descriptor<size_t>      arg_inputs_per_tx      = {"inputs-per-tx", "Inputs per transaction", 1};
+  const command_line::arg_descriptor<size_t>      arg_outputs_per_tx     = {"outputs-per-tx", "Outputs per transaction", 2};
+  const command_line::arg_descriptor<size_t>      arg_ring_size          = {"ring-size", "Ring size of inputs", 16};
+  const command_line::arg_descriptor<unsigned>    arg_owned_percent      = {"owned-percent", "Percentage of transactions paying the wallet", 25};
+  const command_line::arg_descriptor<unsigned>    arg_subaddress_percent = {"subaddress-percent", "Percentage of payments to the wallet going to a subaddress", 50};
+  const command_line::arg_descriptor<unsigned>    arg_spend_percent      = {"spend-percent", "Percentage of transactions spending a wallet output", 10};
+  const command_line::arg_descriptor<uint32_t>    arg_accounts           = {"accounts", "Subaddress accounts payments are spread over", 50};
+  const command_line::arg_descriptor<uint32_t>    arg_subaddresses       = {"subaddresses", "Subaddresses per account payments are spread over", 200};
+  const command_line::arg_descriptor<uint64_t>    arg_seed               = {"seed", "Seed for the shape of the chain", 0};
+  const command_line::arg_descriptor<std::string> arg_wallet_dir         = {"wallet-dir", "Directory to store the wallet in, a temporary one by default", ""};
+  const command_line::arg_descriptor<std::string> arg_log_level          = {"log-level", "0-4 or categories", ""};
+
+  struct refresh_results
+  {
+    uint64_t generate_ns = 0;
+    uint64_t refresh_ns = 0;
+    uint64_t store_ns = 0;
+    uint64_t blocks_fetched = 0;
+    uint64_t wallet_file_size = 0;
+    uint64_t peak_rss_before_refresh = 0;
+    uint64_t peak_rss_after_refresh = 0;
+  };
+
+  // In bytes, or 0 if unknown
+  uint64_t get_peak_rss()
+  {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024;
+#endif
+#endif
+  }
+
+  void print_rss(const char *name, uint64_t rss)
+  {
+    std::cout << "  " << name;
+    if (rss)
+      std::cout << rss / (1024 * 1024) << " MB" << std::endl;
+    else
+      std::cout << "unavailable" << std::endl;
+  }
+
+  void print_report(const wallet_refresh_benchmark::synthetic_chain &chain, const wallet_refresh_benchmark::stand_in_stats &stats, const refresh_results &results)
+  {
+    const double seconds = results.refresh_ns / 1e9;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Generated " << chain.blocks.size() << " blocks, " << chain.num_txs << " transactions in " << results.generate_ns / 1e9 << " s" << std::endl;
+    std::cout << "Refreshed " << results.blocks_fetched << " blocks, " << chain.num_txs << " transactions, "
+      << chain.expected_transfers << " transfers (" << chain.expected_spent << " spent) in " << seconds << " s" << std::endl;
+    std::cout << "  blocks/s:    " << (seconds > 0 ? results.blocks_fetched / seconds : 0.0) << std::endl;
+    std::cout << "  txs/s:       " << (seconds > 0 ? chain.num_txs / seconds : 0.0) << std::endl;
+    std::cout << "  transfers/s: " << (seconds > 0 ? chain.expected_transfers / seconds : 0.0) << std::endl;
+    std::cout << "  stand-in daemon: " << stats.requests << " calls, " << stats.bytes_received / (1024 * 1024) << " MB, "
+      << stats.serve_ns / 1e9 << " s" << std::endl;
+    std::cout << "Stored the wallet in " << results.store_ns / 1e9 << " s, " << results.wallet_file_size / 1024 << " kB" << std::endl;
+    std::cout << "Memory:" << std::endl;
+    print_rss("peak RSS with the chain generated: ", results.peak_rss_before_refresh);
+    print_rss("peak RSS after refresh:            ", results.peak_rss_after_refresh);
+  }
+
+  // Checks the wallet found what the chain was built to give it
+  bool check_wallet(const tools::wallet2 &wallet, const wallet_refresh_benchmark::synthetic_chain &chain)
+  {
+    tools::wallet2::transfer_container transfers;
+    wallet.get_transfers(transfers);
+    uint64_t spent = 0;
+    for (const tools::wallet2::transfer_details &td: transfers)
+      if (td.m_spent)
+        ++spent;
+
+    bool ok = true;
+    if (transfers.size() != chain.expected_transfers)
+    {
+      MERROR("The wallet has " << transfers.size() << " transfers, expected " << chain.expected_transfers);
+      ok = false;
+    }
+    if (spent != chain.expected_spent)
+    {
+      MERROR("The wallet has " << spent << " spent transfers, expected " << chain.expected_spent);
+      ok = false;
+    }
+    if (wallet.balance_all(false) != chain.expected_balance)
+    {
+      MERROR("The wallet has a balance of " << cryptonote::print_money(wallet.balance_all(false)) << ", expected " << cryptonote::print_money(chain.expected_balance));
+      ok = false;
+    }
+    return ok;
+  }
+
+  bool run_benchmark(const po::variables_map &vm, const boost::filesystem::path &wallet_dir)
+  {
+    wallet_refresh_benchmark::chain_options options;
+    options.blocks = command_line::get_arg(vm, arg_blocks);
+    options.txs_per_block = command_line::get_arg(vm, arg_txs_per_block);
+    options.inputs_per_tx = command_line::get_arg(vm, arg_inputs_per_tx);
+    options.outputs_per_tx = command_line::get_arg(vm, arg_outputs_per_tx);
+    options.ring_size = command_line::get_arg(vm, arg_ring_size);
+    options.owned_percent = command_line::get_arg(vm, arg_owned_percent);
+    options.subaddress_percent = command_line::get_arg(vm, arg_subaddress_percent);
+    options.spend_percent = command_line::get_arg(vm, arg_spend_percent);
+    options.accounts = command_line::get_arg(vm, arg_accounts);
+    options.subaddresses = command_line::get_arg(vm, arg_subaddresses);
+    options.seed = command_line::get_arg(vm, arg_seed);
+
+    const uint64_t transfers = command_line::get_arg(vm, arg_transfers);
+    if (transfers > 0)
+    {
+      const uint64_t owned_per_block = options.txs_per_block * options.owned_percent;
+      if (owned_per_block == 0)
+      {
+        MERROR("No transaction pays the wallet, --" << arg_transfers.name << " cannot be reached");
+        return false;
+      }
+      options.blocks = 1 + (transfers * 100 + owned_per_block - 1) / owned_per_block;
+    }
+
+    wallet_refresh_benchmark::synthetic_chain chain;
+    wallet_refresh_benchmark::stand_in_stats stats;
+    refresh_results results;
+
+    // the wallet only ever talks to the stand-in, so it is never offline
+    tools::wallet2 wallet(cryptonote::MAINNET, 1, true, std::unique_ptr<epee::net_utils::http::http_client_factory>(new wallet_refresh_benchmark::stand_in_daemon_factory(chain, stats)));
+    wallet.set_subaddress_lookahead(options.accounts, options.subaddresses);
+    wallet.allow_mismatched_daemon_version(true);
+    const boost::filesystem::path wallet_path = wallet_dir / "wallet";
+    // restoring keeps the wallet from asking a daemon for a restore height
+    wallet.generate(wallet_path.string(), "", rct::rct2sk(rct::skGen()), true, false, false);
+    wallet.set_refresh_from_block_height(0);
+
+    MINFO("Generating " << options.blocks << " blocks of " << options.txs_per_block << " transactions");
+    TIME_MEASURE_NS_START(generate_time);
+    if (!wallet_refresh_benchmark::generate_chain(options, wallet, chain))
+      return false;
+    TIME_MEASURE_NS_FINISH(generate_time);
+    results.generate_ns = generate_time;
+    results.peak_rss_before_refresh = get_peak_rss();
+
+    MINFO("Refreshing...");
+    try
+    {
+      bool received_money = false;
+      TIME_MEASURE_NS_START(refresh_time);
+      wallet.refresh(true, 0, results.blocks_fetched, received_money);
+      TIME_MEASURE_NS_FINISH(refresh_time);
+      results.refresh_ns = refresh_time;
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Refresh failed: " << e.what());
+      return false;
+    }
+    results.peak_rss_after_refresh = get_peak_rss();
+    if (results.blocks_fetched + 1 != chain.blocks.size())
+    {
+      MERROR("The wallet fetched " << results.blocks_fetched << " blocks, expected " << chain.blocks.size() - 1);
+      return false;
+    }
+    if (!check_wallet(wallet, chain))
+      return false;
+
+    MINFO("Storing...");
+    try
+    {
+      TIME_MEASURE_NS_START(store_time);
+      wallet.store();
+      TIME_MEASURE_NS_FINISH(store_time);
+      results.store_ns = store_time;
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Store failed: " << e.what());
+      return false;
+    }
+    boost::system::error_code ec;
+    results.wallet_file_size = boost::filesystem::file_size(wallet_path, ec);
+
+    print_report(chain, stats, results);
+    return true;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+
+  po::options_description desc_options("Allowed options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, arg_blocks);
+  command_line::add_arg(desc_options, arg_transfers);
+  command_line::add_arg(desc_options, arg_txs_per_block);
+  command_line::add_arg(desc_options, arg_inputs_per_tx);
+  command_line::add_arg(desc_options, arg_outputs_per_tx);
+  command_line::add_arg(desc_options, arg_ring_size);
+  command_line::add_arg(desc_options, arg_owned_percent);
+  command_line::add_arg(desc_options, arg_subaddress_percent);
+  command_line::add_arg(desc_options, arg_spend_percent);
+  command_line::add_arg(desc_options, arg_accounts);
+  command_line::add_arg(desc_options, arg_subaddresses);
+  command_line::add_arg(desc_options, arg_seed);
+  command_line::add_arg(desc_options, arg_wallet_dir);
+  command_line::add_arg(desc_options, arg_log_level);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  mlog_configure(mlog_get_default_log_path("wallet_refresh_benchmark.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log("0,wallet.wallet2:ERROR,wallet_bench:INFO");
+
+  // the wallet files go in a temporary directory unless asked otherwise
+  boost::filesystem::path wallet_dir;
+  bool remove_wallet_dir = false;
+  boost::system::error_code ec;
+  if (command_line::is_arg_defaulted(vm, arg_wallet_dir))
+  {
+    wallet_dir = boost::filesystem::temp_directory_path(ec) / boost::filesystem::unique_path("wallet-refresh-benchmark-%%%%%%%%", ec);
+    remove_wallet_dir = true;
+  }
+  else
+  {
+    wallet_dir = command_line::get_arg(vm, arg_wallet_dir);
+  }
+  if (!ec)
+    boost::filesystem::create_directories(wallet_dir, ec);
+  if (ec)
+  {
+    std::cerr << "Error: failed to create " << wallet_dir.string() << ": " << ec.message() << std::endl;
+    return 1;
+  }
+  MINFO("Wallet directory: " << wallet_dir.string());
+
+  const bool ok = run_benchmark(vm, wallet_dir);
+  if (remove_wallet_dir)
+    boost::filesystem::remove_all(wallet_dir, ec);
+  return ok ? 0 : 1;
+
+  CATCH_ENTRY_L0("main", 1);
+}
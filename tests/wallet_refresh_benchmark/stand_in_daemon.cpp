@@ -0,0 +1,169 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "misc_log_ex.h"
+#include "storages/portable_storage_template_helper.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "profile_tools.h"
+#include "stand_in_daemon.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "wallet_bench"
+
+using namespace cryptonote;
+
+namespace wallet_refresh_benchmark
+{
+  stand_in_daemon::stand_in_daemon(const synthetic_chain &chain, stand_in_stats &stats):
+    m_chain(chain),
+    m_stats(stats),
+    m_bytes_sent(0),
+    m_bytes_received(0)
+  {
+  }
+
+  bool stand_in_daemon::is_connected(bool *ssl)
+  {
+    if (ssl)
+      *ssl = false;
+    return true;
+  }
+
+  bool stand_in_daemon::invoke(const boost::string_ref uri, const boost::string_ref method, const boost::string_ref body, std::chrono::milliseconds timeout, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params)
+  {
+    m_response.clear();
+    m_bytes_sent += body.size();
+    if (ppresponse_info)
+      *ppresponse_info = std::addressof(m_response);
+
+    if (uri != "/getblocks.bin")
+    {
+      MWARNING("The stand-in daemon does not serve " << uri);
+      m_response.m_response_code = 404;
+      m_response.m_response_comment = "Not found";
+      return true;
+    }
+
+    TIME_MEASURE_NS_START(serve_time);
+    const bool r = on_get_blocks(body);
+    TIME_MEASURE_NS_FINISH(serve_time);
+    m_stats.serve_ns += serve_time;
+    ++m_stats.requests;
+    m_bytes_received += m_response.m_body.size();
+    m_stats.bytes_received += m_response.m_body.size();
+    return r;
+  }
+
+  bool stand_in_daemon::invoke_get(const boost::string_ref uri, std::chrono::milliseconds timeout, const std::string& body, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params)
+  {
+    return invoke(uri, "GET", body, timeout, ppresponse_info, additional_params);
+  }
+
+  bool stand_in_daemon::invoke_post(const boost::string_ref uri, const std::string& body, std::chrono::milliseconds timeout, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params)
+  {
+    return invoke(uri, "POST", body, timeout, ppresponse_info, additional_params);
+  }
+
+  // Picks blocks as core_rpc_server::on_get_blocks does through
+  // find_blockchain_supplement: from the most recent block both sides know,
+  // or from the requested height if that is further along
+  bool stand_in_daemon::on_get_blocks(const boost::string_ref body)
+  {
+    COMMAND_RPC_GET_BLOCKS_FAST::request req;
+    if (!epee::serialization::load_t_from_binary(req, epee::strspan<uint8_t>(body)))
+    {
+      MERROR("Failed to parse /getblocks.bin request");
+      return false;
+    }
+
+    COMMAND_RPC_GET_BLOCKS_FAST::response res;
+    res.start_height = 0;
+    res.current_height = m_chain.blocks.size();
+    res.daemon_time = time(NULL);
+    res.pool_info_extent = COMMAND_RPC_GET_BLOCKS_FAST::NONE;
+    res.status = CORE_RPC_STATUS_OK;
+
+    // the pool is always empty, but saying so stops the wallet asking for it separately
+    if (req.requested_info != COMMAND_RPC_GET_BLOCKS_FAST::BLOCKS_ONLY)
+      res.pool_info_extent = COMMAND_RPC_GET_BLOCKS_FAST::FULL;
+
+    if (req.requested_info != COMMAND_RPC_GET_BLOCKS_FAST::POOL_ONLY)
+    {
+      bool found = false;
+      for (const crypto::hash &id: req.block_ids)
+      {
+        const auto i = m_chain.heights.find(id);
+        if (i != m_chain.heights.end())
+        {
+          res.start_height = i->second;
+          found = true;
+          break;
+        }
+      }
+      if (!found)
+      {
+        MERROR("None of the wallet's block ids are on the synthetic chain");
+        res.status = "Failed";
+      }
+      else
+      {
+        if (req.start_height > res.start_height && req.start_height < m_chain.blocks.size())
+          res.start_height = req.start_height;
+
+        size_t num_txs = 0;
+        for (uint64_t height = res.start_height; height < m_chain.blocks.size(); ++height)
+        {
+          const block_complete_entry &entry = m_chain.blocks[height];
+          if (!res.blocks.empty() && (res.blocks.size() >= COMMAND_RPC_GET_BLOCKS_FAST_MAX_BLOCK_COUNT || num_txs + entry.txs.size() > COMMAND_RPC_GET_BLOCKS_FAST_MAX_TX_COUNT))
+            break;
+          res.blocks.push_back(entry);
+          res.output_indices.push_back(m_chain.output_indices[height]);
+          num_txs += entry.txs.size();
+        }
+        m_stats.blocks += res.blocks.size();
+      }
+    }
+
+    epee::byte_slice response;
+    if (!epee::serialization::store_t_to_binary(res, response))
+    {
+      MERROR("Failed to serialize /getblocks.bin response");
+      return false;
+    }
+    m_response.m_response_code = 200;
+    m_response.m_response_comment = "Ok";
+    m_response.m_mime_tipe = "application/octet-stream";
+    m_response.m_body.assign(reinterpret_cast<const char*>(response.data()), response.size());
+    return true;
+  }
+
+  std::unique_ptr<epee::net_utils::http::abstract_http_client> stand_in_daemon_factory::create()
+  {
+    return std::unique_ptr<epee::net_utils::http::abstract_http_client>(new stand_in_daemon(m_chain, m_stats));
+  }
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "net/abstract_http_client.h"
+#include "net/http_base.h"
+#include "chain_generator.h"
+
+namespace wallet_refresh_benchmark
+{
+  //! What the stand-in daemons served, summed over all the clients a wallet made
+  struct stand_in_stats
+  {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> blocks{0};
+    std::atomic<uint64_t> bytes_received{0};
+    std::atomic<uint64_t> serve_ns{0};  //!< time spent building and serializing responses
+  };
+
+  /*! An HTTP client which answers a wallet's /getblocks.bin calls from a
+      synthetic chain in memory, the way a daemon would, without a daemon or
+      a socket in the way. Any other call fails. */
+  class stand_in_daemon: public epee::net_utils::http::abstract_http_client
+  {
+  public:
+    stand_in_daemon(const synthetic_chain &chain, stand_in_stats &stats);
+
+    void set_server(std::string host, std::string port, boost::optional<epee::net_utils::http::login> user, epee::net_utils::ssl_options_t ssl_options = epee::net_utils::ssl_support_t::e_ssl_support_autodetect) override {}
+    void set_auto_connect(bool auto_connect) override {}
+    bool connect(std::chrono::milliseconds timeout) override { return true; }
+    bool disconnect() override { return true; }
+    bool is_connected(bool *ssl = NULL) override;
+    bool invoke(const boost::string_ref uri, const boost::string_ref method, const boost::string_ref body, std::chrono::milliseconds timeout, const epee::net_utils::http::http_response_info** ppresponse_info = NULL, const epee::net_utils::http::fields_list& additional_params = epee::net_utils::http::fields_list()) override;
+    bool invoke_get(const boost::string_ref uri, std::chrono::milliseconds timeout, const std::string& body = std::string(), const epee::net_utils::http::http_response_info** ppresponse_info = NULL, const epee::net_utils::http::fields_list& additional_params = epee::net_utils::http::fields_list()) override;
+    bool invoke_post(const boost::string_ref uri, const std::string& body, std::chrono::milliseconds timeout, const epee::net_utils::http::http_response_info** ppresponse_info = NULL, const epee::net_utils::http::fields_list& additional_params = epee::net_utils::http::fields_list()) override;
+    uint64_t get_bytes_sent() const override { return m_bytes_sent; }
+    uint64_t get_bytes_received() const override { return m_bytes_received; }
+
+  private:
+    bool on_get_blocks(const boost::string_ref body);
+
+    const synthetic_chain &m_chain;
+    stand_in_stats &m_stats;
+    epee::net_utils::http::http_response_info m_response;
+    uint64_t m_bytes_sent;
+    uint64_t m_bytes_received;
+  };
+
+  class stand_in_daemon_factory: public epee::net_utils::http::http_client_factory
+  {
+  public:
+    stand_in_daemon_factory(const synthetic_chain &chain, stand_in_stats &stats): m_chain(chain), m_stats(stats) {}
+    std::unique_ptr<epee::net_utils::http::abstract_http_client> create() override;
+
+  private:
+    const synthetic_chain &m_chain;
+    stand_in_stats &m_stats;
+  };
+}
@@ -669,3 +669,11 @@ class Daemon(object):
             'id': '0'
         }
         return self.rpc.send_json_rpc_request(rpc_access_account)
+
+    def get_metrics(self):
+        metrics = {}
+        for line in self.rpc.send_text_request('/metrics').splitlines():
+            if line and not line.startswith('#'):
+                name, value = line.rsplit(' ', 1)
+                metrics[name] = float(value)
+        return metrics
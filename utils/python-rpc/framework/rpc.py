@@ -80,5 +80,10 @@ class JSONRPC(object):
     def send_json_rpc_request(self, inputs):
         return self.send_request("/json_rpc", inputs, 'result')
 
+    def send_text_request(self, path):
+        res = requests.get(self.url + path)
+        assert res.status_code == 200, res.status_code
+        return res.text
+
 
 